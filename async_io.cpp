@@ -0,0 +1,440 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <iostream>
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "async_io.h"
+#include "page.h"
+#include "exceptions/file_not_found_exception.h"
+
+#ifdef BADGERDB_IO_URING
+#include <linux/io_uring.h>
+#if !defined(__NR_io_uring_setup) || !defined(__NR_io_uring_enter)
+#undef BADGERDB_IO_URING
+#endif
+#endif
+
+namespace badgerdb
+{
+
+// -----------------------------------------------------------------------------
+// IoRing::IoRing -- Constructor
+// -----------------------------------------------------------------------------
+IoRing::IoRing()
+	: ringFd(-1), sqRing(MAP_FAILED), cqRing(MAP_FAILED), sqes(MAP_FAILED), sqRingSize(0), cqRingSize(0), sqesSize(0),
+		toSubmit(0)
+{
+}
+
+// -----------------------------------------------------------------------------
+// IoRing::~IoRing -- destructor
+// -----------------------------------------------------------------------------
+IoRing::~IoRing()
+{
+	if(sqes != MAP_FAILED) munmap(sqes, sqesSize);
+	if(cqRing != MAP_FAILED) munmap(cqRing, cqRingSize);
+	if(sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+	if(ringFd >= 0) close(ringFd);
+}
+
+// -----------------------------------------------------------------------------
+// IoRing::setUp
+// -----------------------------------------------------------------------------
+bool IoRing::setUp(unsigned entries)
+{
+#ifdef BADGERDB_IO_URING
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	int ring = (int) syscall(__NR_io_uring_setup, entries, &params);
+	if(ring < 0) return false;
+
+	sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+	sqRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+	cqRing = mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+	sqes = mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+	if(sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED) {
+		if(sqes != MAP_FAILED) munmap(sqes, sqesSize);
+		if(cqRing != MAP_FAILED) munmap(cqRing, cqRingSize);
+		if(sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+		sqRing = cqRing = sqes = MAP_FAILED;
+		close(ring);
+		return false;
+	}
+
+	sqTail = (unsigned*) ((char*) sqRing + params.sq_off.tail);
+	sqMask = (unsigned*) ((char*) sqRing + params.sq_off.ring_mask);
+	sqArray = (unsigned*) ((char*) sqRing + params.sq_off.array);
+	cqHead = (unsigned*) ((char*) cqRing + params.cq_off.head);
+	cqTail = (unsigned*) ((char*) cqRing + params.cq_off.tail);
+	cqMask = (unsigned*) ((char*) cqRing + params.cq_off.ring_mask);
+	cqes = (char*) cqRing + params.cq_off.cqes;
+	ringFd = ring;
+	return true;
+#else
+	return false;
+#endif
+}
+
+// -----------------------------------------------------------------------------
+// IoRing::add
+// -----------------------------------------------------------------------------
+void IoRing::add(bool write, int fd, off_t offset, const struct iovec* iov, unsigned numIovecs, unsigned long long userData)
+{
+#ifdef BADGERDB_IO_URING
+	//the entry goes past the tail the kernel knows of, enter moves the tail over it
+	unsigned index = (*sqTail + toSubmit) & *sqMask;
+	struct io_uring_sqe* sqe = (struct io_uring_sqe*) sqes + index;
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = write ? IORING_OP_WRITEV : IORING_OP_READV;
+	sqe->fd = fd;
+	sqe->off = (unsigned long long) offset;
+	sqe->addr = (unsigned long long) iov;
+	sqe->len = numIovecs;
+	sqe->user_data = userData;
+	sqArray[index] = index;
+	toSubmit++;
+#endif
+}
+
+// -----------------------------------------------------------------------------
+// IoRing::enter
+// -----------------------------------------------------------------------------
+void IoRing::enter(unsigned waitFor)
+{
+#ifdef BADGERDB_IO_URING
+	//the kernel must see the entries before the tail that covers them
+	if(toSubmit > 0) __atomic_store_n(sqTail, *sqTail + toSubmit, __ATOMIC_RELEASE);
+
+	while(toSubmit > 0 || waitFor > 0) {
+		int done = (int) syscall(__NR_io_uring_enter, ringFd, toSubmit, waitFor, waitFor > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+		if(done < 0) {
+			if(errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+			break;
+		}
+		toSubmit -= (unsigned) done;
+		if(waitFor > 0) break;
+	}
+#endif
+}
+
+// -----------------------------------------------------------------------------
+// IoRing::nextCompletion
+// -----------------------------------------------------------------------------
+bool IoRing::nextCompletion(unsigned long long &userData, int &result)
+{
+#ifdef BADGERDB_IO_URING
+	unsigned head = *cqHead;
+	if(head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) return false;
+
+	struct io_uring_cqe* cqe = (struct io_uring_cqe*) cqes + (head & *cqMask);
+	userData = cqe->user_data;
+	result = cqe->res;
+	__atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+	return true;
+#else
+	return false;
+#endif
+}
+
+// -----------------------------------------------------------------------------
+// AsyncPageReader::AsyncPageReader -- Constructor
+// -----------------------------------------------------------------------------
+AsyncPageReader::AsyncPageReader(const std::string & fileName, int queueDepth, bool useIoUring)
+	: queueDepth(queueDepth < 1 ? 1 : queueDepth), inFlight(0), stop(false)
+{
+	fd = open(fileName.c_str(), O_RDONLY);
+	if(fd < 0) throw FileNotFoundException(fileName);
+
+	if(useIoUring && setUpRing()) return;
+
+	for(int i = 0; i < this->queueDepth; i++) threads.push_back(std::thread(&AsyncPageReader::readLoop, this));
+}
+
+// -----------------------------------------------------------------------------
+// AsyncPageReader::~AsyncPageReader -- destructor
+// -----------------------------------------------------------------------------
+AsyncPageReader::~AsyncPageReader()
+{
+	wait();
+	{
+		std::lock_guard<std::mutex> guard(latch);
+		stop = true;
+	}
+	readWanted.notify_all();
+	for(size_t i = 0; i < threads.size(); i++) threads[i].join();
+	close(fd);
+}
+
+// -----------------------------------------------------------------------------
+// AsyncPageReader::prefetch
+// -----------------------------------------------------------------------------
+void AsyncPageReader::prefetch(const PageId* pageNos, int count)
+{
+	std::unique_lock<std::mutex> lock(latch);
+
+	if(!ring.isSetUp()) {
+		//the pool takes them from here, however many there are
+		for(int i = 0; i < count; i++) pending.push_back(pageNos[i]);
+		inFlight += count;
+		lock.unlock();
+		readWanted.notify_all();
+		return;
+	}
+
+	int i = 0;
+	while(i < count) {
+		//with every slot taken, one read has to complete before the next goes in
+		if(freeSlots.empty()) enterRing(1);
+
+		while(i < count && !freeSlots.empty()) {
+			int slot = freeSlots.back();
+			freeSlots.pop_back();
+			ring.add(false, fd, filePagePosition(pageNos[i]), &iovecs[slot], 1, slot);
+			inFlight++;
+			i++;
+		}
+		enterRing(0);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// AsyncPageReader::wait
+// -----------------------------------------------------------------------------
+void AsyncPageReader::wait()
+{
+	std::unique_lock<std::mutex> lock(latch);
+	if(!ring.isSetUp()) {
+		while(inFlight > 0) readDone.wait(lock);
+		return;
+	}
+	while(inFlight > 0) enterRing(1);
+}
+
+// -----------------------------------------------------------------------------
+// AsyncPageReader::setUpRing
+// -----------------------------------------------------------------------------
+bool AsyncPageReader::setUpRing()
+{
+	if(!ring.setUp((unsigned) queueDepth)) return false;
+
+	buffers.resize((size_t) queueDepth * Page::SIZE);
+	iovecs.resize(queueDepth);
+	for(int i = 0; i < queueDepth; i++) {
+		iovecs[i].iov_base = &buffers[(size_t) i * Page::SIZE];
+		iovecs[i].iov_len = Page::SIZE;
+		freeSlots.push_back(i);
+	}
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// AsyncPageReader::enterRing
+// -----------------------------------------------------------------------------
+void AsyncPageReader::enterRing(unsigned waitFor)
+{
+	ring.enter(waitFor);
+
+	//a read that failed or ran past the end of the file only means the buffer manager reads the page itself
+	unsigned long long slot;
+	int result;
+	while(ring.nextCompletion(slot, result)) {
+		freeSlots.push_back((int) slot);
+		inFlight--;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// AsyncPageReader::readLoop
+// -----------------------------------------------------------------------------
+void AsyncPageReader::readLoop()
+{
+	std::vector<char> buffer(Page::SIZE);
+	std::unique_lock<std::mutex> lock(latch);
+	while(true) {
+		while(pending.empty() && !stop) readWanted.wait(lock);
+		if(pending.empty()) return;
+
+		PageId pageNo = pending.front();
+		pending.pop_front();
+		lock.unlock();
+		//as with io_uring, a read that fails is left to the buffer manager
+		ssize_t bytes = pread(fd, &buffer[0], Page::SIZE, filePagePosition(pageNo));
+		(void) bytes;
+		lock.lock();
+
+		inFlight--;
+		if(inFlight == 0) readDone.notify_all();
+	}
+}
+
+// -----------------------------------------------------------------------------
+// AsyncPageWriter::AsyncPageWriter -- Constructor
+// -----------------------------------------------------------------------------
+AsyncPageWriter::AsyncPageWriter(const std::string & fileName, int queueDepth, bool useIoUring)
+	: queueDepth(queueDepth < 1 ? 1 : queueDepth), inFlight(0), openSlot(-1), stop(false)
+{
+	fd = open(fileName.c_str(), O_WRONLY);
+	if(fd < 0) throw FileNotFoundException(fileName);
+
+	//the pool writes from the same slots, so that the pages are copied once either way
+	buffers.resize((size_t) this->queueDepth * ASYNCWRITEPAGES * Page::SIZE);
+	iovecs.resize(this->queueDepth);
+	slotPageNo.resize(this->queueDepth);
+	for(int i = 0; i < this->queueDepth; i++) {
+		iovecs[i].iov_base = &buffers[(size_t) i * ASYNCWRITEPAGES * Page::SIZE];
+		iovecs[i].iov_len = 0;
+		freeSlots.push_back(i);
+	}
+
+	if(useIoUring && ring.setUp((unsigned) this->queueDepth)) return;
+
+	for(int i = 0; i < this->queueDepth; i++) threads.push_back(std::thread(&AsyncPageWriter::writeLoop, this));
+}
+
+// -----------------------------------------------------------------------------
+// AsyncPageWriter::~AsyncPageWriter -- destructor
+// -----------------------------------------------------------------------------
+AsyncPageWriter::~AsyncPageWriter()
+{
+	wait();
+	{
+		std::lock_guard<std::mutex> guard(latch);
+		stop = true;
+	}
+	writeWanted.notify_all();
+	for(size_t i = 0; i < threads.size(); i++) threads[i].join();
+	close(fd);
+}
+
+// -----------------------------------------------------------------------------
+// AsyncPageWriter::write
+// -----------------------------------------------------------------------------
+void AsyncPageWriter::write(PageId pageNo, const Page* page)
+{
+	std::unique_lock<std::mutex> lock(latch);
+
+	//the page right after those of the open write joins it while there is room
+	if(openSlot >= 0) {
+		int numPages = (int) (iovecs[openSlot].iov_len / Page::SIZE);
+		if(numPages < ASYNCWRITEPAGES && pageNo == slotPageNo[openSlot] + numPages) {
+			memcpy((char*) iovecs[openSlot].iov_base + iovecs[openSlot].iov_len, page, Page::SIZE);
+			iovecs[openSlot].iov_len += Page::SIZE;
+			return;
+		}
+		startWrite();
+	}
+
+	//with every slot taken, one write has to complete before the next can take pages
+	while(freeSlots.empty()) {
+		if(ring.isSetUp()) enterRing(1);
+		else writeDone.wait(lock);
+	}
+	openSlot = freeSlots.back();
+	freeSlots.pop_back();
+	slotPageNo[openSlot] = pageNo;
+	memcpy(iovecs[openSlot].iov_base, page, Page::SIZE);
+	iovecs[openSlot].iov_len = Page::SIZE;
+}
+
+// -----------------------------------------------------------------------------
+// AsyncPageWriter::wait
+// -----------------------------------------------------------------------------
+void AsyncPageWriter::wait()
+{
+	std::unique_lock<std::mutex> lock(latch);
+	if(openSlot >= 0) startWrite();
+	if(!ring.isSetUp()) {
+		while(inFlight > 0) writeDone.wait(lock);
+		return;
+	}
+	while(inFlight > 0) enterRing(1);
+}
+
+// -----------------------------------------------------------------------------
+// AsyncPageWriter::startWrite
+// -----------------------------------------------------------------------------
+void AsyncPageWriter::startWrite()
+{
+	int slot = openSlot;
+	openSlot = -1;
+	inFlight++;
+
+	if(!ring.isSetUp()) {
+		pending.push_back(slot);
+		writeWanted.notify_one();
+		return;
+	}
+
+	//one system call submits a batch of writes, the rest of the queue depth stays free to fill the next one
+	ring.add(true, fd, filePagePosition(slotPageNo[slot]), &iovecs[slot], 1, slot);
+	if((int) ring.pending() >= std::max(1, queueDepth / 2)) enterRing(0);
+}
+
+// -----------------------------------------------------------------------------
+// AsyncPageWriter::enterRing
+// -----------------------------------------------------------------------------
+void AsyncPageWriter::enterRing(unsigned waitFor)
+{
+	ring.enter(waitFor);
+
+	unsigned long long slot;
+	int result;
+	while(ring.nextCompletion(slot, result)) {
+		if(result != (int) iovecs[slot].iov_len) {
+			std::cerr << "Page " << slotPageNo[slot] << " could not be written: " << strerror(result < 0 ? -result : EIO) << std::endl;
+			abort();
+		}
+		freeSlots.push_back((int) slot);
+		inFlight--;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// AsyncPageWriter::writeLoop
+// -----------------------------------------------------------------------------
+void AsyncPageWriter::writeLoop()
+{
+	std::unique_lock<std::mutex> lock(latch);
+	while(true) {
+		while(pending.empty() && !stop) writeWanted.wait(lock);
+		if(pending.empty()) return;
+
+		int slot = pending.front();
+		pending.pop_front();
+		const char* data = (const char*) iovecs[slot].iov_base;
+		size_t length = iovecs[slot].iov_len;
+		off_t offset = filePagePosition(slotPageNo[slot]);
+		lock.unlock();
+
+		size_t written = 0;
+		while(written < length) {
+			ssize_t result = pwrite(fd, data + written, length - written, offset + (off_t) written);
+			if(result < 0 && errno == EINTR) continue;
+			if(result <= 0) {
+				std::cerr << "Page " << slotPageNo[slot] << " could not be written: " << strerror(result < 0 ? errno : EIO) << std::endl;
+				abort();
+			}
+			written += (size_t) result;
+		}
+		lock.lock();
+
+		freeSlots.push_back(slot);
+		inFlight--;
+		writeDone.notify_all();
+	}
+}
+
+}
@@ -0,0 +1,417 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "types.h"
+#include "page.h"
+#include "file.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define BADGERDB_IO_URING
+#endif
+#endif
+
+namespace badgerdb
+{
+
+/**
+ * @brief Byte offset of page pageNo in a BlobFile: past the FileHeader the file starts with, then Page::SIZE bytes
+ * for every page before it, as File::pagePosition lays them out. Everything that reads an index file without going
+ * through File, the AsyncPageReader and the mapping of READ_ONLY_MAPPED, locates pages with this.
+ */
+inline off_t filePagePosition(PageId pageNo) { return (off_t) sizeof( FileHeader ) + (off_t) ( pageNo - 1 ) * Page::SIZE; }
+
+/**
+ * @brief Most pages with consecutive numbers that an AsyncPageWriter puts into one write.
+ */
+const int ASYNCWRITEPAGES = 8;
+
+/**
+ * @brief An io_uring of the kernel mapped into memory, as AsyncPageReader and AsyncPageWriter drive it. Requests
+ * are added to the submission queue one by one and handed to the kernel together. The owner serializes every call.
+ */
+class IoRing {
+
+ private:
+
+  /**
+   * File descriptor of the ring, -1 until it is set up.
+   */
+	int			ringFd;
+
+  /**
+   * Submission queue ring, completion queue ring and submission entries, as mapped.
+   */
+	void		*sqRing, *cqRing, *sqes;
+
+  /**
+   * Bytes mapped for sqRing, cqRing and sqes.
+   */
+	size_t	sqRingSize, cqRingSize, sqesSize;
+
+  /**
+   * Fields of the rings, pointing into the mapped memory.
+   */
+	unsigned	*sqTail, *sqMask, *sqArray, *cqHead, *cqTail, *cqMask;
+
+  /**
+   * Completion entries, pointing into cqRing.
+   */
+	void		*cqes;
+
+  /**
+   * Requests added and not handed to the kernel yet.
+   */
+	unsigned	toSubmit;
+
+ public:
+
+	IoRing();
+
+  /**
+   * Unmap and close the ring. Requests still in flight complete in the kernel.
+   */
+	~IoRing();
+
+  /**
+   * Set up the ring with room for entries requests. False if the kernel does not allow it, with nothing left behind.
+   */
+	bool setUp(unsigned entries);
+
+  /**
+   * True once setUp succeeded.
+   */
+	bool isSetUp() const { return ringFd >= 0; }
+
+  /**
+   * Requests added and not handed to the kernel yet.
+   */
+	unsigned pending() const { return toSubmit; }
+
+  /**
+   * Add a READV, or a WRITEV, of the numIovecs buffers of iov at offset of fd. The kernel sees it at the next enter.
+   * There must be no more requests in flight than the ring has room for.
+   *
+   * @param write			True to write the buffers rather than read into them
+   * @param userData	Handed back with the completion
+   */
+	void add(bool write, int fd, off_t offset, const struct iovec* iov, unsigned numIovecs, unsigned long long userData);
+
+  /**
+   * Hand every request added to the kernel in one system call and, with waitFor set, wait for at least that many
+   * completions.
+   */
+	void enter(unsigned waitFor);
+
+  /**
+   * Take the next completion off the ring. False if there is none.
+   *
+   * @param userData	The userData of its request
+   * @param result		Bytes transferred, or a negative errno
+   */
+	bool nextCompletion(unsigned long long &userData, int &result);
+};
+
+/**
+ * @brief Reads pages of an index file in the background, up to queueDepth of them at once, so that the buffer
+ * manager finds them in the page cache of the operating system when it reads them itself. The data read is thrown
+ * away. The reads go through io_uring where the kernel offers it, otherwise through a pool of queueDepth threads.
+ * Pages are located with filePagePosition. A page that is not in the file yet is skipped.
+ * Any number of threads may share one reader.
+ */
+class AsyncPageReader {
+
+ private:
+
+  /**
+   * File descriptor of the file, opened read-only.
+   */
+	int			fd;
+
+  /**
+   * Maximum number of reads in flight.
+   */
+	int			queueDepth;
+
+  /**
+   * Guards everything below.
+   */
+	std::mutex	latch;
+
+  /**
+   * Signalled when the pool has completed every read.
+   */
+	std::condition_variable	readDone;
+
+  /**
+   * Number of reads submitted and not completed yet.
+   */
+	int			inFlight;
+
+  /**
+   * Pages waiting for a thread of the pool. Unused with io_uring, where prefetch waits for a free slot instead.
+   */
+	std::deque<PageId>	pending;
+
+  /**
+   * Signalled when pages are put on pending or the pool has to stop.
+   */
+	std::condition_variable	readWanted;
+
+  /**
+   * Tells the threads of the pool to stop.
+   */
+	bool		stop;
+
+  /**
+   * The thread pool, empty with io_uring.
+   */
+	std::vector<std::thread>	threads;
+
+	// IO_URING STATE, ring IS NOT SET UP IF THE POOL IS USED INSTEAD
+
+  /**
+   * Pages read are copied here, Page::SIZE bytes for each slot of the ring.
+   */
+	std::vector<char>	buffers;
+
+  /**
+   * One iovec for each slot, pointing into buffers.
+   */
+	std::vector<struct iovec>	iovecs;
+
+  /**
+   * The ring.
+   */
+	IoRing	ring;
+
+  /**
+   * Buffer slots not used by a read in flight.
+   */
+	std::vector<int>	freeSlots;
+
+ public:
+
+  /**
+   * Open the file and set up the ring, or start the thread pool if that fails.
+   *
+   * @param fileName		Name of the index file
+   * @param queueDepth	Maximum number of reads in flight
+   * @param useIoUring	False to go straight to the thread pool
+   * @throws  FileNotFoundException If the file cannot be opened
+   */
+	AsyncPageReader(const std::string & fileName, int queueDepth, bool useIoUring = true);
+
+  /**
+   * Wait for the reads in flight and close the file.
+   */
+	~AsyncPageReader();
+
+  /**
+   * Start reading the given pages and return. Only waits, with io_uring, while queueDepth reads are in flight.
+   *
+   * @param pageNos	Pages to read
+   * @param count		Number of pages
+   */
+	void prefetch(const PageId* pageNos, int count);
+
+  /**
+   * Wait until every read started so far has completed.
+   */
+	void wait();
+
+  /**
+   * True if the reads go through io_uring rather than the thread pool.
+   */
+	bool usesIoUring() const { return ring.isSetUp(); }
+
+  /**
+   * Maximum number of reads in flight.
+   */
+	int getQueueDepth() const { return queueDepth; }
+
+ private:
+
+  /**
+   * Set up the ring and the buffers of its reads. False if the kernel does not allow it.
+   */
+	bool setUpRing();
+
+  /**
+   * Hand the reads added to the ring to the kernel and, with waitFor set, wait for at least that many
+   * completions. Then take every completion there is off the ring. The caller holds latch.
+   */
+	void enterRing(unsigned waitFor);
+
+  /**
+   * Body of a thread of the pool.
+   */
+	void readLoop();
+};
+
+/**
+ * @brief Writes pages of an index file in the background, up to queueDepth writes at once. A page is copied when it
+ * is handed over, so the caller can let go of it right away. Pages with consecutive numbers handed over one after the
+ * other go out in one write of up to ASYNCWRITEPAGES pages. With io_uring a WRITEV goes to the ring for every write
+ * and the writes waiting are submitted together, in one system call once half the queue depth of them is waiting.
+ * Without io_uring a pool of queueDepth threads writes them with pwrite. Pages are located with filePagePosition and
+ * have to be allocated in the file already. The writes go past the buffer manager, so a page handed over must not
+ * be dirty in the buffer pool with other contents, and two writes of the same page in flight at once land in either
+ * order. A write that fails aborts the process like a failed sync of the write-ahead log, as the file can no longer
+ * be trusted. Any number of threads may share one writer.
+ */
+class AsyncPageWriter {
+
+ private:
+
+  /**
+   * File descriptor of the file, opened write-only.
+   */
+	int			fd;
+
+  /**
+   * Maximum number of writes in flight.
+   */
+	int			queueDepth;
+
+  /**
+   * Guards everything below.
+   */
+	std::mutex	latch;
+
+  /**
+   * Signalled when a write completes in the pool.
+   */
+	std::condition_variable	writeDone;
+
+  /**
+   * Number of writes started and not completed yet.
+   */
+	int			inFlight;
+
+  /**
+   * ASYNCWRITEPAGES pages of buffer for every slot, a write covers the front of one slot.
+   */
+	std::vector<char>	buffers;
+
+  /**
+   * One iovec for each slot, covering the pages of its write.
+   */
+	std::vector<struct iovec>	iovecs;
+
+  /**
+   * First page of the write in each slot.
+   */
+	std::vector<PageId>	slotPageNo;
+
+  /**
+   * Slots not used by a write in flight.
+   */
+	std::vector<int>	freeSlots;
+
+  /**
+   * Slot whose write is still taking pages, -1 if there is none.
+   */
+	int			openSlot;
+
+  /**
+   * Writes waiting for a thread of the pool. Unused with io_uring.
+   */
+	std::deque<int>	pending;
+
+  /**
+   * Signalled when writes are put on pending or the pool has to stop.
+   */
+	std::condition_variable	writeWanted;
+
+  /**
+   * Tells the threads of the pool to stop.
+   */
+	bool		stop;
+
+  /**
+   * The thread pool, empty with io_uring.
+   */
+	std::vector<std::thread>	threads;
+
+  /**
+   * The ring, not set up if the pool is used instead.
+   */
+	IoRing	ring;
+
+ public:
+
+  /**
+   * Open the file and set up the ring, or start the thread pool if that fails.
+   *
+   * @param fileName		Name of the index file
+   * @param queueDepth	Maximum number of writes in flight
+   * @param useIoUring	False to go straight to the thread pool
+   * @throws  FileNotFoundException If the file cannot be opened
+   */
+	AsyncPageWriter(const std::string & fileName, int queueDepth, bool useIoUring = true);
+
+  /**
+   * Wait for the writes in flight and close the file.
+   */
+	~AsyncPageWriter();
+
+  /**
+   * Copy page pageNo and write it out. Only waits while queueDepth writes are in flight.
+   *
+   * @param pageNo	Number of the page in the file
+   * @param page		Its contents
+   */
+	void write(PageId pageNo, const Page* page);
+
+  /**
+   * Start the write still taking pages, and wait until every write has completed. The data is then in the file,
+   * though not synced.
+   */
+	void wait();
+
+  /**
+   * True if the writes go through io_uring rather than the thread pool.
+   */
+	bool usesIoUring() const { return ring.isSetUp(); }
+
+  /**
+   * Maximum number of writes in flight.
+   */
+	int getQueueDepth() const { return queueDepth; }
+
+ private:
+
+  /**
+   * Hand the write of openSlot to the ring or the pool. The caller holds latch.
+   */
+	void startWrite();
+
+  /**
+   * Hand the writes added to the ring to the kernel and, with waitFor set, wait for at least that many completions.
+   * Then take every completion there is off the ring. The caller holds latch.
+   */
+	void enterRing(unsigned waitFor);
+
+  /**
+   * Body of a thread of the pool.
+   */
+	void writeLoop();
+};
+
+}
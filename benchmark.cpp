@@ -0,0 +1,1088 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <limits.h>
+#include <float.h>
+#include <math.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <algorithm>
+#include "btree.h"
+#include "btree_search.h"
+#include "async_io.h"
+#include "page.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/no_such_key_found_exception.h"
+#include "exceptions/index_scan_completed_exception.h"
+#include "exceptions/insufficient_space_exception.h"
+
+using namespace badgerdb;
+
+// -----------------------------------------------------------------------------
+// Globals
+// -----------------------------------------------------------------------------
+const int numLookups = 2000000;
+
+// keys inserted by every run of the concurrency benchmark, split evenly over the threads
+const int numConcurrentInserts = 1000000;
+// keys covered by every scan of the concurrency benchmark
+const int concurrentScanRange = 1000;
+const int maxBenchmarkThreads = 8;
+const std::string benchRelationName = "benchRel";
+
+// keys of the index scanned by the batch scan benchmark, and the batch sizes tried
+const int numScanKeys = 1000000;
+const int scanBatchSizes[] = { 1, 16, 256, 4096 };
+
+// keys of the index probed by the resident levels benchmark, the lookups every thread makes and the pool they go through
+const int numResidentKeys = 1000000;
+const int residentLookups = 200000;
+const int residentPoolPages = 100;
+
+// leaves read ahead by the scans of the read-ahead benchmark, through a pool too small to keep the index
+const int readAheadWindows[] = { 0, 2, 8, 32 };
+const int readAheadPoolPages = 200;
+
+// pages of the file read by the async read benchmark in random order, and the queue depths tried
+const int asyncReadPages = 8192;
+const int asyncQueueDepths[] = { 1, 4, 16, 64 };
+const std::string asyncFileName = "benchAsync";
+
+// pools the mapped benchmark compares a READ_ONLY_MAPPED index against, one too small for the index and one large enough
+const int mappedPoolPages[] = { 200, 20000 };
+
+// keys already in the index of the write-ahead log benchmark, the keys every run inserts between them, and the batches the index file
+// is written out and synced after without a log
+const int numLoggedBaseKeys = 400000;
+const int numLoggedInserts = 20000;
+const int syncBatchSizes[] = { 100, 1000 };
+
+// keys of the index counted by the range count benchmark, the widths of the ranges counted and how many of each
+const int numCountKeys = 1000000;
+const int countRangeWidths[] = { 100, 10000, 1000000 };
+const int countsPerWidth = 100;
+
+// keys of the index probed by the point lookup benchmark and the lookups every thread makes
+const int numPointLookupKeys = 1000000;
+const int pointLookupsPerThread = 500000;
+
+// keys probed by each lookupBatch call of the batched lookup benchmark, the number of calls, and the range of keys a clustered
+// batch is drawn from
+const int probeBatchSize = 1000;
+const int probeBatches = 500;
+const int clusteredProbeRange = 20000;
+
+// records of the relation the range estimate benchmark bulk loads, the widths of the ranges estimated and how many of each
+const int numEstimateKeys = 1000000;
+const int estimateRangeWidths[] = { 1000, 10000, 100000 };
+const int estimatesPerWidth = 1000;
+
+// records of the relation the parallel build benchmark bulk loads, and the thread counts tried
+const int numBuildKeys = 4000000;
+const int buildThreadCounts[] = { 1, 2, 4, 8, 16, 32 };
+
+// sinks the search results so the compiler cannot drop the lookups
+volatile long long checksum = 0;
+
+// -----------------------------------------------------------------------------
+// Forward declarations
+// -----------------------------------------------------------------------------
+
+void searchBenchmark();
+template <class T, class NonLeafNode>
+void nonLeafSearchBenchmark(const char* name, int numKeys, int occupancy, T nullKey);
+template <class T, class LeafNode>
+void leafSearchBenchmark(const char* name, int numKeys, int occupancy, T nullKey);
+void concurrencyBenchmark();
+void concurrencyRun(BufMgr* bufMgr, ConcurrencyMode concurrencyMode, int numThreads, bool withScanner);
+void removeIfExists(const std::string & fileName);
+void insertKeys(BTreeIndex* index, const std::vector<int>* keys, int first, int last);
+void scanKeys(BTreeIndex* index, const std::atomic<bool>* done, long long* numScans);
+void batchScanBenchmark();
+double timeScan(BTreeIndex* index, int batchSize);
+void residentBenchmark();
+void readAheadBenchmark();
+void asyncReadBenchmark();
+void asyncWriteBenchmark();
+void mappedBenchmark();
+void walBenchmark();
+void buildLoggedBase(BufMgr* bufMgr, std::string &indexName);
+double timeLoggedInserts(BufMgr* bufMgr, const std::vector<int> &keys, int numThreads);
+double timeSyncedInserts(BufMgr* bufMgr, const std::vector<int> &keys, int batchSize);
+double timeAsyncRead(const std::vector<PageId> &pageNos, int queueDepth, bool useIoUring, bool &usedIoUring);
+double timeAsyncWrite(const std::vector<PageId> &pageNos, int queueDepth, bool useIoUring, bool &usedIoUring);
+void countBenchmark();
+double timeCountInserts(BufMgr* bufMgr, CountMode countMode, int numThreads, BTreeIndex* &index, std::string &indexName);
+double timeCountRange(BTreeIndex* index, int width);
+void lookupBenchmark();
+void pointLookups(BTreeIndex* index, int api, int seed);
+void lookupKeys(BTreeIndex* index, int seed);
+void batchLookupBenchmark();
+double timeProbes(BTreeIndex* index, const std::vector<int> &probeKeys, bool batched);
+void estimateBenchmark();
+void parallelBuildBenchmark();
+
+int main(int argc, char **argv)
+{
+	searchBenchmark();
+	concurrencyBenchmark();
+	batchScanBenchmark();
+	residentBenchmark();
+	readAheadBenchmark();
+	asyncReadBenchmark();
+	asyncWriteBenchmark();
+	mappedBenchmark();
+	walBenchmark();
+	countBenchmark();
+	lookupBenchmark();
+	batchLookupBenchmark();
+	estimateBenchmark();
+	parallelBuildBenchmark();
+	return 0;
+}
+
+// -----------------------------------------------------------------------------
+// Linear searches the nodes used before they kept a key count, for comparison
+// -----------------------------------------------------------------------------
+
+template <class T, class NonLeafNode>
+int linearFindIndexIntoPageNoArray(NonLeafNode* node, int occupancy, T key, T nullKey)
+{
+	for(int i = 0; i < occupancy; i++) {
+		if(key < node->keyArray[0]) {
+			return 0;
+		}
+		else if(key >= node->keyArray[i] && !(i == occupancy - 1 || node->keyArray[i+1] == nullKey) && key < node->keyArray[i + 1]) {
+			return i + 1;
+		}
+		else if(key >= node->keyArray[i] && (i == occupancy - 1 || node->keyArray[i + 1] == nullKey)) {
+			return i + 1;
+		}
+	}
+	return -1;
+}
+
+template <class T, class LeafNode>
+int linearFindIndexIntoKeyArray(LeafNode* leaf, int occupancy, T key, T nullKey)
+{
+	for(int i = 0; i < occupancy; i++) {
+		if(leaf->keyArray[0] == nullKey || key < leaf->keyArray[0]) return 0;
+		else if(leaf->keyArray[i] == key) return i;
+		else if(key > leaf->keyArray[i] && i != occupancy - 1 && key < leaf->keyArray[i + 1]) return i + 1;
+		else if(key > leaf->keyArray[i] && (i == occupancy - 1 || leaf->keyArray[i + 1] == nullKey)) return i + 1;
+	}
+	return -1;
+}
+
+// -----------------------------------------------------------------------------
+// searchBenchmark
+// -----------------------------------------------------------------------------
+
+void searchBenchmark()
+{
+	std::cout << "Per-lookup cost of searching one node, " << numLookups << " random probes each" << std::endl;
+	std::cout << "node                 keys    linear ns   binary ns   speedup" << std::endl;
+
+	nonLeafSearchBenchmark<int, NonLeafNodeInt>("NonLeafNodeInt", INTARRAYNONLEAFSIZE, INTARRAYNONLEAFSIZE, INT_MAX);
+	nonLeafSearchBenchmark<int, NonLeafNodeInt>("NonLeafNodeInt", INTARRAYNONLEAFSIZE / 2, INTARRAYNONLEAFSIZE, INT_MAX);
+	nonLeafSearchBenchmark<double, NonLeafNodeDouble>("NonLeafNodeDouble", DOUBLEARRAYNONLEAFSIZE, DOUBLEARRAYNONLEAFSIZE, DBL_MAX);
+	nonLeafSearchBenchmark<double, NonLeafNodeDouble>("NonLeafNodeDouble", DOUBLEARRAYNONLEAFSIZE / 2, DOUBLEARRAYNONLEAFSIZE, DBL_MAX);
+	leafSearchBenchmark<int, LeafNodeInt>("LeafNodeInt", INTARRAYLEAFSIZE, INTARRAYLEAFSIZE, INT_MAX);
+	leafSearchBenchmark<int, LeafNodeInt>("LeafNodeInt", INTARRAYLEAFSIZE / 2, INTARRAYLEAFSIZE, INT_MAX);
+	leafSearchBenchmark<double, LeafNodeDouble>("LeafNodeDouble", DOUBLEARRAYLEAFSIZE, DOUBLEARRAYLEAFSIZE, DBL_MAX);
+	leafSearchBenchmark<double, LeafNodeDouble>("LeafNodeDouble", DOUBLEARRAYLEAFSIZE / 2, DOUBLEARRAYLEAFSIZE, DBL_MAX);
+}
+
+void printSearchResult(const char* name, int numKeys, double linearNs, double binaryNs)
+{
+	printf("%-20s %5d %12.1f %11.1f %8.1fx\n", name, numKeys, linearNs, binaryNs, linearNs / binaryNs);
+}
+
+template <class T>
+std::vector<T> makeProbes(int numKeys)
+{
+	//every other integer is a key, so half the probes land between two keys
+	std::vector<T> probes(numLookups);
+	for(int i = 0; i < numLookups; i++) probes[i] = (T) (random() % (2 * numKeys + 2)) - 1;
+	return probes;
+}
+
+template <class T, class NonLeafNode>
+void nonLeafSearchBenchmark(const char* name, int numKeys, int occupancy, T nullKey)
+{
+	NonLeafNode* node = new NonLeafNode;
+	node->level = 1;
+	node->numKeys = numKeys;
+	for(int i = 0; i < occupancy; i++) node->keyArray[i] = (i < numKeys) ? (T) (2 * i) : nullKey;
+	std::vector<T> probes = makeProbes<T>(numKeys);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(int i = 0; i < numLookups; i++) checksum += linearFindIndexIntoPageNoArray(node, occupancy, probes[i], nullKey);
+	std::chrono::steady_clock::time_point middle = std::chrono::steady_clock::now();
+	for(int i = 0; i < numLookups; i++) checksum += upperBoundKey(node->keyArray, node->numKeys, probes[i]);
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+	printSearchResult(name, numKeys,
+		std::chrono::duration<double, std::nano>(middle - start).count() / numLookups,
+		std::chrono::duration<double, std::nano>(end - middle).count() / numLookups);
+	delete node;
+}
+
+template <class T, class LeafNode>
+void leafSearchBenchmark(const char* name, int numKeys, int occupancy, T nullKey)
+{
+	LeafNode* leaf = new LeafNode;
+	leaf->numKeys = numKeys;
+	for(int i = 0; i < occupancy; i++) leaf->keyArray[i] = (i < numKeys) ? (T) (2 * i) : nullKey;
+	std::vector<T> probes = makeProbes<T>(numKeys);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(int i = 0; i < numLookups; i++) checksum += linearFindIndexIntoKeyArray(leaf, occupancy, probes[i], nullKey);
+	std::chrono::steady_clock::time_point middle = std::chrono::steady_clock::now();
+	for(int i = 0; i < numLookups; i++) checksum += lowerBoundKey(leaf->keyArray, leaf->numKeys, probes[i]);
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+	printSearchResult(name, numKeys,
+		std::chrono::duration<double, std::nano>(middle - start).count() / numLookups,
+		std::chrono::duration<double, std::nano>(end - middle).count() / numLookups);
+	delete leaf;
+}
+
+// -----------------------------------------------------------------------------
+// concurrencyBenchmark
+// -----------------------------------------------------------------------------
+
+void concurrencyBenchmark()
+{
+	std::cout << std::endl << "Insert throughput of " << numConcurrentInserts << " random INTEGER keys, optionally with a thread running "
+		<< concurrentScanRange << " key scans alongside" << std::endl;
+	std::cout << "mode            threads   scanner   inserts/s   scans/s" << std::endl;
+
+	BufMgr* bufMgr = new BufMgr(20000);
+	ConcurrencyMode modes[] = { LATCH_COUPLING, B_LINK };
+	for(int m = 0; m < 2; m++) {
+		for(int numThreads = 1; numThreads <= maxBenchmarkThreads; numThreads *= 2) {
+			concurrencyRun(bufMgr, modes[m], numThreads, false);
+			concurrencyRun(bufMgr, modes[m], numThreads, true);
+		}
+	}
+	delete bufMgr;
+}
+
+void removeIfExists(const std::string & fileName)
+{
+	try {
+		File::remove(fileName);
+	} catch(FileNotFoundException e) {
+	}
+}
+
+void insertKeys(BTreeIndex* index, const std::vector<int>* keys, int first, int last)
+{
+	for(int i = first; i < last; i++) {
+		RecordId rid;
+		rid.page_number = (*keys)[i] / 100 + 1;
+		rid.slot_number = (*keys)[i] % 100 + 1;
+		index->insertEntry(&(*keys)[i], rid);
+	}
+}
+
+void scanKeys(BTreeIndex* index, const std::atomic<bool>* done, long long* numScans)
+{
+	std::mt19937 generator(12345);
+	while(!done->load()) {
+		int lowVal = generator() % numConcurrentInserts;
+		int highVal = lowVal + concurrentScanRange;
+		try {
+			index->startScan(&lowVal, GTE, &highVal, LT);
+			RecordId rid;
+			while(true) {
+				index->scanNext(rid);
+				checksum += rid.slot_number;
+			}
+		} catch(NoSuchKeyFoundException e) {
+			continue;
+		} catch(IndexScanCompletedException e) {
+		}
+		index->endScan();
+		(*numScans)++;
+	}
+}
+
+void concurrencyRun(BufMgr* bufMgr, ConcurrencyMode concurrencyMode, int numThreads, bool withScanner)
+{
+	//an empty relation, the keys are inserted straight into the index
+	removeIfExists(benchRelationName);
+	{
+		PageFile relation = PageFile::create(benchRelationName);
+	}
+	std::string indexName;
+	BTreeIndex* index = new BTreeIndex(benchRelationName, indexName, bufMgr, 0, INTEGER, INSERT_BUILD, 0.8, concurrencyMode);
+
+	std::vector<int> keys(numConcurrentInserts);
+	for(int i = 0; i < numConcurrentInserts; i++) keys[i] = i;
+	std::shuffle(keys.begin(), keys.end(), std::mt19937(numThreads));
+
+	//the scanner starts on a tree that already has some keys to find
+	int preloaded = numConcurrentInserts / 10;
+	insertKeys(index, &keys, 0, preloaded);
+
+	std::atomic<bool> done(false);
+	long long numScans = 0;
+	std::thread scanner;
+	if(withScanner) scanner = std::thread(scanKeys, index, &done, &numScans);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	int perThread = (numConcurrentInserts - preloaded) / numThreads;
+	for(int t = 0; t < numThreads; t++) {
+		int last = (t == numThreads - 1) ? numConcurrentInserts : preloaded + (t + 1) * perThread;
+		threads.push_back(std::thread(insertKeys, index, &keys, preloaded + t * perThread, last));
+	}
+	for(int t = 0; t < numThreads; t++) threads[t].join();
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+	done.store(true);
+	if(withScanner) scanner.join();
+
+	double seconds = std::chrono::duration<double>(end - start).count();
+	printf("%-14s %8d %9s %11.0f %9.0f\n", concurrencyMode == B_LINK ? "b-link" : "latch-coupling", numThreads, withScanner ? "yes" : "no", (numConcurrentInserts - preloaded) / seconds, numScans / seconds);
+
+	delete index;
+	removeIfExists(indexName);
+	removeIfExists(benchRelationName);
+}
+
+// -----------------------------------------------------------------------------
+// batchScanBenchmark
+// -----------------------------------------------------------------------------
+
+void batchScanBenchmark()
+{
+	std::cout << std::endl << "Full scan of " << numScanKeys << " INTEGER keys with scanNext and scanNextBatch" << std::endl;
+	std::cout << "batch     Mrids/s" << std::endl;
+
+	BufMgr* bufMgr = new BufMgr(20000);
+	removeIfExists(benchRelationName);
+	{
+		PageFile relation = PageFile::create(benchRelationName);
+	}
+	std::string indexName;
+	BTreeIndex* index = new BTreeIndex(benchRelationName, indexName, bufMgr, 0, INTEGER);
+
+	std::vector<int> keys(numScanKeys);
+	for(int i = 0; i < numScanKeys; i++) keys[i] = i;
+	insertKeys(index, &keys, 0, numScanKeys);
+
+	printf("%-9s %7.1f\n", "scanNext", numScanKeys / timeScan(index, 0) / 1e6);
+	for(size_t b = 0; b < sizeof(scanBatchSizes) / sizeof(scanBatchSizes[0]); b++) {
+		printf("%-9d %7.1f\n", scanBatchSizes[b], numScanKeys / timeScan(index, scanBatchSizes[b]) / 1e6);
+	}
+
+	delete index;
+	delete bufMgr;
+	removeIfExists(indexName);
+	removeIfExists(benchRelationName);
+}
+
+double timeScan(BTreeIndex* index, int batchSize)
+{
+	//batchSize 0 scans with scanNext
+	int lowVal = 0;
+	int highVal = numScanKeys;
+	std::vector<RecordId> rids(batchSize > 0 ? batchSize : 1);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	index->startScan(&lowVal, GTE, &highVal, LT);
+	if(batchSize == 0) {
+		try {
+			while(true) {
+				index->scanNext(rids[0]);
+				checksum += rids[0].slot_number;
+			}
+		} catch(IndexScanCompletedException e) {
+		}
+	} else {
+		size_t numRids;
+		while((numRids = index->scanNextBatch(&rids[0], batchSize)) > 0) {
+			for(size_t i = 0; i < numRids; i++) checksum += rids[i].slot_number;
+		}
+	}
+	index->endScan();
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration<double>(end - start).count();
+}
+
+// -----------------------------------------------------------------------------
+// residentBenchmark
+// -----------------------------------------------------------------------------
+
+void residentBenchmark()
+{
+	std::cout << std::endl << "Random point lookups on " << numResidentKeys << " INTEGER keys through a " << residentPoolPages
+		<< " page buffer pool" << std::endl;
+	std::cout << "resident   threads   lookups/s" << std::endl;
+
+	const int residentLevels[] = { 1, ALLLEVELSRESIDENT };
+	for(int r = 0; r < 2; r++) {
+		BufMgr* bufMgr = new BufMgr(residentPoolPages);
+		removeIfExists(benchRelationName);
+		{
+			PageFile relation = PageFile::create(benchRelationName);
+		}
+		std::string indexName;
+		BTreeIndex* index = new BTreeIndex(benchRelationName, indexName, bufMgr, 0, INTEGER, INSERT_BUILD, 1.0, LATCH_COUPLING,
+			MERGE_ON_UNDERFLOW, residentLevels[r]);
+
+		std::vector<int> keys(numResidentKeys);
+		for(int i = 0; i < numResidentKeys; i++) keys[i] = i;
+		insertKeys(index, &keys, 0, numResidentKeys);
+
+		for(int numThreads = 1; numThreads <= maxBenchmarkThreads; numThreads *= maxBenchmarkThreads) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			std::vector<std::thread> threads;
+			for(int t = 0; t < numThreads; t++) threads.push_back(std::thread(lookupKeys, index, t));
+			for(int t = 0; t < numThreads; t++) threads[t].join();
+			std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+			double seconds = std::chrono::duration<double>(end - start).count();
+			printf("%-10s %7d %11.0f\n", r == 0 ? "root" : "all", numThreads, (double) numThreads * residentLookups / seconds);
+		}
+
+		delete index;
+		delete bufMgr;
+		removeIfExists(indexName);
+		removeIfExists(benchRelationName);
+	}
+}
+
+void lookupKeys(BTreeIndex* index, int seed)
+{
+	std::mt19937 generator(seed);
+	std::uniform_int_distribution<int> keyDistribution(0, numResidentKeys - 1);
+	RecordId rid;
+	for(int i = 0; i < residentLookups; i++) {
+		int key = keyDistribution(generator);
+		ScanCursor* cursor = index->openScan(&key, GTE, &key, LTE);
+		cursor->scanNext(rid);
+		checksum += rid.slot_number;
+		delete cursor;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// readAheadBenchmark
+// -----------------------------------------------------------------------------
+
+void readAheadBenchmark()
+{
+	std::cout << std::endl << "Full scan of " << numScanKeys << " INTEGER keys through a " << readAheadPoolPages
+		<< " page buffer pool, reading leaves ahead" << std::endl;
+	std::cout << "window    Mrids/s      hits    misses" << std::endl;
+
+	BufMgr* bufMgr = new BufMgr(readAheadPoolPages);
+	removeIfExists(benchRelationName);
+	{
+		PageFile relation = PageFile::create(benchRelationName);
+	}
+	std::string indexName;
+	BTreeIndex* index = new BTreeIndex(benchRelationName, indexName, bufMgr, 0, INTEGER);
+
+	std::vector<int> keys(numScanKeys);
+	for(int i = 0; i < numScanKeys; i++) keys[i] = i;
+	insertKeys(index, &keys, 0, numScanKeys);
+
+	for(size_t w = 0; w < sizeof(readAheadWindows) / sizeof(readAheadWindows[0]); w++) {
+		index->setReadAhead(readAheadWindows[w]);
+		ReadAheadStats before = index->getReadAheadStats();
+		double seconds = timeScan(index, scanBatchSizes[2]);
+		ReadAheadStats after = index->getReadAheadStats();
+		printf("%-9d %7.1f %9llu %9llu\n", readAheadWindows[w], numScanKeys / seconds / 1e6, after.hits - before.hits, after.misses - before.misses);
+	}
+
+	delete index;
+	delete bufMgr;
+	removeIfExists(indexName);
+	removeIfExists(benchRelationName);
+}
+
+// -----------------------------------------------------------------------------
+// asyncReadBenchmark
+// -----------------------------------------------------------------------------
+
+void asyncReadBenchmark()
+{
+	std::cout << std::endl << "Reading " << asyncReadPages << " pages in random order, dropped from the page cache before every run"
+		<< std::endl;
+	std::cout << "depth   io_uring MB/s   thread pool MB/s" << std::endl;
+
+	//the data does not matter, only where it is
+	removeIfExists(asyncFileName);
+	int fd = open(asyncFileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	std::vector<char> data(Page::SIZE, 'x');
+	for(int i = 0; i < asyncReadPages; i++) {
+		if(write(fd, &data[0], Page::SIZE) != Page::SIZE) break;
+	}
+	fsync(fd);
+	close(fd);
+
+	std::vector<PageId> pageNos(asyncReadPages);
+	for(int i = 0; i < asyncReadPages; i++) pageNos[i] = i + 1;
+	std::shuffle(pageNos.begin(), pageNos.end(), std::mt19937(42));
+
+	double megabytes = (double) asyncReadPages * Page::SIZE / (1024 * 1024);
+	for(size_t d = 0; d < sizeof(asyncQueueDepths) / sizeof(asyncQueueDepths[0]); d++) {
+		bool usedIoUring;
+		double ringSeconds = timeAsyncRead(pageNos, asyncQueueDepths[d], true, usedIoUring);
+		bool unused;
+		double poolSeconds = timeAsyncRead(pageNos, asyncQueueDepths[d], false, unused);
+		if(usedIoUring) printf("%-7d %13.1f %18.1f\n", asyncQueueDepths[d], megabytes / ringSeconds, megabytes / poolSeconds);
+		else printf("%-7d %13s %18.1f\n", asyncQueueDepths[d], "n/a", megabytes / poolSeconds);
+	}
+
+	removeIfExists(asyncFileName);
+}
+
+double timeAsyncRead(const std::vector<PageId> &pageNos, int queueDepth, bool useIoUring, bool &usedIoUring)
+{
+	//without this every run after the first reads from memory
+	int fd = open(asyncFileName.c_str(), O_RDONLY);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	close(fd);
+
+	AsyncPageReader reader(asyncFileName, queueDepth, useIoUring);
+	usedIoUring = reader.usesIoUring();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	reader.prefetch(&pageNos[0], (int) pageNos.size());
+	reader.wait();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// -----------------------------------------------------------------------------
+// asyncWriteBenchmark
+// -----------------------------------------------------------------------------
+
+void asyncWriteBenchmark()
+{
+	std::cout << std::endl << "Writing " << asyncReadPages << " pages in random order, synced to disk at the end of every run"
+		<< std::endl;
+	std::cout << "depth   io_uring MB/s   thread pool MB/s" << std::endl;
+
+	//the file has its full size up front, so no run times the file growing
+	removeIfExists(asyncFileName);
+	int fd = open(asyncFileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	std::vector<char> data(Page::SIZE, 'x');
+	for(int i = 0; i <= asyncReadPages; i++) {
+		if(write(fd, &data[0], Page::SIZE) != Page::SIZE) break;
+	}
+	fsync(fd);
+	close(fd);
+
+	std::vector<PageId> pageNos(asyncReadPages);
+	for(int i = 0; i < asyncReadPages; i++) pageNos[i] = i + 1;
+	std::shuffle(pageNos.begin(), pageNos.end(), std::mt19937(43));
+
+	double megabytes = (double) asyncReadPages * Page::SIZE / (1024 * 1024);
+	for(size_t d = 0; d < sizeof(asyncQueueDepths) / sizeof(asyncQueueDepths[0]); d++) {
+		bool usedIoUring;
+		double ringSeconds = timeAsyncWrite(pageNos, asyncQueueDepths[d], true, usedIoUring);
+		bool unused;
+		double poolSeconds = timeAsyncWrite(pageNos, asyncQueueDepths[d], false, unused);
+		if(usedIoUring) printf("%-7d %13.1f %18.1f\n", asyncQueueDepths[d], megabytes / ringSeconds, megabytes / poolSeconds);
+		else printf("%-7d %13s %18.1f\n", asyncQueueDepths[d], "n/a", megabytes / poolSeconds);
+	}
+
+	removeIfExists(asyncFileName);
+}
+
+double timeAsyncWrite(const std::vector<PageId> &pageNos, int queueDepth, bool useIoUring, bool &usedIoUring)
+{
+	std::vector<char> data(Page::SIZE, 'y');
+	int fd = open(asyncFileName.c_str(), O_WRONLY);
+	AsyncPageWriter writer(asyncFileName, queueDepth, useIoUring);
+	usedIoUring = writer.usesIoUring();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(size_t i = 0; i < pageNos.size(); i++) writer.write(pageNos[i], (const Page*) &data[0]);
+	writer.wait();
+	fdatasync(fd);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	close(fd);
+	return seconds;
+}
+
+// -----------------------------------------------------------------------------
+// mappedBenchmark
+// -----------------------------------------------------------------------------
+
+void mappedBenchmark()
+{
+	std::cout << std::endl << "Full scan of " << numScanKeys << " INTEGER keys through the buffer pool and mapped read-only" << std::endl;
+	std::cout << "opened as             scanNext Mrids/s   batch " << scanBatchSizes[2] << " Mrids/s" << std::endl;
+
+	BufMgr* bufMgr = new BufMgr(20000);
+	removeIfExists(benchRelationName);
+	{
+		PageFile relation = PageFile::create(benchRelationName);
+	}
+	std::string indexName;
+	BTreeIndex* index = new BTreeIndex(benchRelationName, indexName, bufMgr, 0, INTEGER);
+	std::vector<int> keys(numScanKeys);
+	for(int i = 0; i < numScanKeys; i++) keys[i] = i;
+	insertKeys(index, &keys, 0, numScanKeys);
+	delete index;
+	delete bufMgr;
+
+	for(size_t p = 0; p < sizeof(mappedPoolPages) / sizeof(mappedPoolPages[0]); p++) {
+		bufMgr = new BufMgr(mappedPoolPages[p]);
+		index = new BTreeIndex(benchRelationName, indexName, bufMgr, 0, INTEGER);
+		double nextSeconds = timeScan(index, 0);
+		double batchSeconds = timeScan(index, scanBatchSizes[2]);
+		printf("%5d page pool %21.1f %20.1f\n", mappedPoolPages[p], numScanKeys / nextSeconds / 1e6, numScanKeys / batchSeconds / 1e6);
+		delete index;
+		delete bufMgr;
+	}
+
+	index = new BTreeIndex(benchRelationName, indexName, NULL, 0, INTEGER, INSERT_BUILD, 1.0, LATCH_COUPLING, MERGE_ON_UNDERFLOW, 1, READ_ONLY_MAPPED);
+	double nextSeconds = timeScan(index, 0);
+	double batchSeconds = timeScan(index, scanBatchSizes[2]);
+	printf("%-15s %21.1f %20.1f\n", "mapped", numScanKeys / nextSeconds / 1e6, numScanKeys / batchSeconds / 1e6);
+	delete index;
+
+	removeIfExists(indexName);
+	removeIfExists(benchRelationName);
+}
+
+// -----------------------------------------------------------------------------
+// walBenchmark
+// -----------------------------------------------------------------------------
+
+void walBenchmark()
+{
+	std::cout << std::endl << "Durable inserts of " << numLoggedInserts << " random INTEGER keys into an index of " << numLoggedBaseKeys
+		<< ", each committed to the write-ahead log or in batches written out and synced with the index file" << std::endl;
+	std::cout << "durability            threads   inserts/s" << std::endl;
+
+	BufMgr* bufMgr = new BufMgr(20000);
+	std::vector<int> keys(numLoggedInserts);
+	for(int i = 0; i < numLoggedInserts; i++) keys[i] = 2 * (i * (numLoggedBaseKeys / numLoggedInserts)) + 1;
+	std::shuffle(keys.begin(), keys.end(), std::mt19937(7));
+
+	for(size_t b = 0; b < sizeof(syncBatchSizes) / sizeof(syncBatchSizes[0]); b++) {
+		double seconds = timeSyncedInserts(bufMgr, keys, syncBatchSizes[b]);
+		printf("sync every %-10d %8d %11.0f\n", syncBatchSizes[b], 1, numLoggedInserts / seconds);
+	}
+	for(int numThreads = 1; numThreads <= maxBenchmarkThreads; numThreads *= 2) {
+		double seconds = timeLoggedInserts(bufMgr, keys, numThreads);
+		printf("%-21s %8d %11.0f\n", "log every insert", numThreads, numLoggedInserts / seconds);
+	}
+	delete bufMgr;
+}
+
+void buildLoggedBase(BufMgr* bufMgr, std::string &indexName)
+{
+	//the even keys, inserted without a log and written out before the clock starts
+	removeIfExists(benchRelationName);
+	{
+		PageFile relation = PageFile::create(benchRelationName);
+	}
+	BTreeIndex* index = new BTreeIndex(benchRelationName, indexName, bufMgr, 0, INTEGER, INSERT_BUILD, 0.8, B_LINK);
+	std::vector<int> keys(numLoggedBaseKeys);
+	for(int i = 0; i < numLoggedBaseKeys; i++) keys[i] = 2 * i;
+	insertKeys(index, &keys, 0, numLoggedBaseKeys);
+	delete index;
+}
+
+double timeLoggedInserts(BufMgr* bufMgr, const std::vector<int> &keys, int numThreads)
+{
+	std::string indexName;
+	buildLoggedBase(bufMgr, indexName);
+	BTreeIndex* index = new BTreeIndex(benchRelationName, indexName, bufMgr, 0, INTEGER, INSERT_BUILD, 0.8, B_LINK,
+		MERGE_ON_UNDERFLOW, 1, READ_WRITE_LOGGED);
+
+	//every insert returns once it is durable, threads waiting at the same time share one sync of the log
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	int perThread = numLoggedInserts / numThreads;
+	for(int t = 0; t < numThreads; t++) {
+		int last = (t == numThreads - 1) ? numLoggedInserts : (t + 1) * perThread;
+		threads.push_back(std::thread(insertKeys, index, &keys, t * perThread, last));
+	}
+	for(int t = 0; t < numThreads; t++) threads[t].join();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	delete index;
+	removeIfExists(indexName);
+	removeIfExists(benchRelationName);
+	return seconds;
+}
+
+double timeSyncedInserts(BufMgr* bufMgr, const std::vector<int> &keys, int batchSize)
+{
+	std::string indexName;
+	buildLoggedBase(bufMgr, indexName);
+	BTreeIndex* index = new BTreeIndex(benchRelationName, indexName, bufMgr, 0, INTEGER, INSERT_BUILD, 0.8, B_LINK);
+
+	//without a log a batch is only durable once the whole index file is written out and synced
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(int first = 0; first < numLoggedInserts; first += batchSize) {
+		insertKeys(index, &keys, first, std::min(first + batchSize, numLoggedInserts));
+		delete index;
+		int fd = open(indexName.c_str(), O_RDONLY);
+		fsync(fd);
+		close(fd);
+		index = new BTreeIndex(benchRelationName, indexName, bufMgr, 0, INTEGER, INSERT_BUILD, 0.8, B_LINK);
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	delete index;
+	removeIfExists(indexName);
+	removeIfExists(benchRelationName);
+	return seconds;
+}
+
+// -----------------------------------------------------------------------------
+// countBenchmark
+// -----------------------------------------------------------------------------
+
+void countBenchmark()
+{
+	std::cout << std::endl << "Inserts of " << numCountKeys << " random INTEGER keys and exact counts of ranges of them, with SUBTREE_COUNTS and without" << std::endl;
+	std::cout << "counts           threads   inserts/s" << std::endl;
+
+	BufMgr* bufMgr = new BufMgr(20000);
+	const CountMode countModes[] = { UNCOUNTED, SUBTREE_COUNTS };
+	BTreeIndex* indexes[2];
+	std::string indexNames[2];
+	for(int m = 0; m < 2; m++) {
+		for(int numThreads = 1; numThreads <= maxBenchmarkThreads; numThreads *= maxBenchmarkThreads) {
+			//the index of the last run is kept for the counts
+			if(numThreads > 1) {
+				delete indexes[m];
+				removeIfExists(indexNames[m]);
+			}
+			double seconds = timeCountInserts(bufMgr, countModes[m], numThreads, indexes[m], indexNames[m]);
+			printf("%-16s %7d %11.0f\n", m == 0 ? "none" : "subtree", numThreads, numCountKeys / seconds);
+		}
+	}
+
+	std::cout << "range width    scanned us/count   counted us/count" << std::endl;
+	for(size_t w = 0; w < sizeof(countRangeWidths) / sizeof(countRangeWidths[0]); w++) {
+		double scannedSeconds = timeCountRange(indexes[0], countRangeWidths[w]);
+		double countedSeconds = timeCountRange(indexes[1], countRangeWidths[w]);
+		printf("%-14d %18.1f %18.1f\n", countRangeWidths[w], scannedSeconds / countsPerWidth * 1e6, countedSeconds / countsPerWidth * 1e6);
+	}
+
+	for(int m = 0; m < 2; m++) {
+		delete indexes[m];
+		removeIfExists(indexNames[m]);
+	}
+	delete bufMgr;
+	removeIfExists(benchRelationName);
+}
+
+double timeCountInserts(BufMgr* bufMgr, CountMode countMode, int numThreads, BTreeIndex* &index, std::string &indexName)
+{
+	//both indexes are over the same empty relation, the attribute offset in the file name tells them apart
+	removeIfExists(benchRelationName);
+	{
+		PageFile relation = PageFile::create(benchRelationName);
+	}
+	index = new BTreeIndex(benchRelationName, indexName, bufMgr, countMode == SUBTREE_COUNTS ? 4 : 0, INTEGER, INSERT_BUILD, 1.0,
+		LATCH_COUPLING, MERGE_ON_UNDERFLOW, 1, READ_WRITE, countMode);
+
+	std::vector<int> keys(numCountKeys);
+	for(int i = 0; i < numCountKeys; i++) keys[i] = i;
+	std::shuffle(keys.begin(), keys.end(), std::mt19937(11));
+
+	//every insert into a counted index latches its whole path from the root, so they take turns
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	int perThread = numCountKeys / numThreads;
+	for(int t = 0; t < numThreads; t++) {
+		int last = (t == numThreads - 1) ? numCountKeys : (t + 1) * perThread;
+		threads.push_back(std::thread(insertKeys, index, &keys, t * perThread, last));
+	}
+	for(int t = 0; t < numThreads; t++) threads[t].join();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+double timeCountRange(BTreeIndex* index, int width)
+{
+	std::mt19937 generator(width);
+	std::uniform_int_distribution<int> lowDistribution(0, numCountKeys - width);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(int i = 0; i < countsPerWidth; i++) {
+		int lowVal = lowDistribution(generator);
+		int highVal = lowVal + width;
+		checksum += index->countRange(&lowVal, GTE, &highVal, LT);
+	}
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// -----------------------------------------------------------------------------
+// lookupBenchmark
+// -----------------------------------------------------------------------------
+
+void lookupBenchmark()
+{
+	std::cout << std::endl << "Random point lookups on " << numPointLookupKeys << " INTEGER keys through startScan, openScan and lookup" << std::endl;
+	std::cout << "api              threads   lookups/s" << std::endl;
+
+	BufMgr* bufMgr = new BufMgr(20000);
+	removeIfExists(benchRelationName);
+	{
+		PageFile relation = PageFile::create(benchRelationName);
+	}
+	std::string indexName;
+	BTreeIndex* index = new BTreeIndex(benchRelationName, indexName, bufMgr, 0, INTEGER);
+
+	std::vector<int> keys(numPointLookupKeys);
+	for(int i = 0; i < numPointLookupKeys; i++) keys[i] = i;
+	insertKeys(index, &keys, 0, numPointLookupKeys);
+
+	//startScan keeps one scan for the whole index, so it only runs on one thread
+	const char* apiNames[] = { "startScan", "openScan", "lookup" };
+	for(int api = 0; api < 3; api++) {
+		for(int numThreads = 1; numThreads <= maxBenchmarkThreads; numThreads *= maxBenchmarkThreads) {
+			if(api == 0 && numThreads > 1) continue;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			std::vector<std::thread> threads;
+			for(int t = 0; t < numThreads; t++) threads.push_back(std::thread(pointLookups, index, api, t));
+			for(int t = 0; t < numThreads; t++) threads[t].join();
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			printf("%-16s %7d %11.0f\n", apiNames[api], numThreads, (double) numThreads * pointLookupsPerThread / seconds);
+		}
+	}
+
+	delete index;
+	delete bufMgr;
+	removeIfExists(indexName);
+	removeIfExists(benchRelationName);
+}
+
+void pointLookups(BTreeIndex* index, int api, int seed)
+{
+	//api 0 is startScan, 1 openScan and 2 lookup
+	std::mt19937 generator(seed);
+	std::uniform_int_distribution<int> keyDistribution(0, numPointLookupKeys - 1);
+	RecordId rid;
+	for(int i = 0; i < pointLookupsPerThread; i++) {
+		int key = keyDistribution(generator);
+		if(api == 0) {
+			index->startScan(&key, GTE, &key, LTE);
+			index->scanNext(rid);
+			try {
+				RecordId nextRid;
+				index->scanNext(nextRid);
+			} catch(IndexScanCompletedException e) {
+			}
+			index->endScan();
+		} else if(api == 1) {
+			ScanCursor* cursor = index->openScan(&key, GTE, &key, LTE);
+			cursor->scanNext(rid);
+			delete cursor;
+		} else {
+			index->lookup(&key, rid);
+		}
+		checksum += rid.slot_number;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// batchLookupBenchmark
+// -----------------------------------------------------------------------------
+
+void batchLookupBenchmark()
+{
+	std::cout << std::endl << "Batches of " << probeBatchSize << " point lookups on " << numPointLookupKeys
+		<< " INTEGER keys, one lookup per key against lookupBatch" << std::endl;
+	std::cout << "probes       lookup/s  lookupBatch/s" << std::endl;
+
+	BufMgr* bufMgr = new BufMgr(20000);
+	removeIfExists(benchRelationName);
+	{
+		PageFile relation = PageFile::create(benchRelationName);
+	}
+	std::string indexName;
+	BTreeIndex* index = new BTreeIndex(benchRelationName, indexName, bufMgr, 0, INTEGER);
+
+	std::vector<int> keys(numPointLookupKeys);
+	for(int i = 0; i < numPointLookupKeys; i++) keys[i] = i;
+	insertKeys(index, &keys, 0, numPointLookupKeys);
+
+	//a clustered batch comes from a small range of keys, as the probes of a join on a sorted input do
+	const char* probeNames[] = { "random", "clustered" };
+	for(int clustered = 0; clustered < 2; clustered++) {
+		std::mt19937 generator(clustered);
+		std::uniform_int_distribution<int> startDistribution(0, numPointLookupKeys - clusteredProbeRange);
+		std::vector<int> probeKeys;
+		for(int b = 0; b < probeBatches; b++) {
+			int first = clustered ? startDistribution(generator) : 0;
+			int range = clustered ? clusteredProbeRange : numPointLookupKeys;
+			std::uniform_int_distribution<int> keyDistribution(first, first + range - 1);
+			for(int i = 0; i < probeBatchSize; i++) probeKeys.push_back(keyDistribution(generator));
+		}
+		double single = timeProbes(index, probeKeys, false);
+		double batched = timeProbes(index, probeKeys, true);
+		printf("%-10s %10.0f %14.0f\n", probeNames[clustered], probeKeys.size() / single, probeKeys.size() / batched);
+	}
+
+	delete index;
+	delete bufMgr;
+	removeIfExists(indexName);
+	removeIfExists(benchRelationName);
+}
+
+double timeProbes(BTreeIndex* index, const std::vector<int> &probeKeys, bool batched)
+{
+	std::vector<const void*> keyPtrs(probeBatchSize);
+	std::vector<RecordId> rids(probeBatchSize);
+	bool found[probeBatchSize];
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(size_t first = 0; first < probeKeys.size(); first += probeBatchSize) {
+		if(batched) {
+			for(int i = 0; i < probeBatchSize; i++) keyPtrs[i] = &probeKeys[first + i];
+			checksum += index->lookupBatch(keyPtrs.data(), probeBatchSize, rids.data(), found);
+		} else {
+			for(int i = 0; i < probeBatchSize; i++) checksum += index->lookup(&probeKeys[first + i], rids[i]);
+		}
+	}
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// -----------------------------------------------------------------------------
+// estimateBenchmark
+// -----------------------------------------------------------------------------
+
+void estimateBenchmark()
+{
+	std::cout << std::endl << "Range estimates from the statistics of a bulk load of " << numEstimateKeys
+		<< " skewed INTEGER keys, against counting the range and against assuming the keys are uniform" << std::endl;
+
+	//the keys crowd at the low end of [0, numEstimateKeys), half of them below an eighth of it
+	removeIfExists(benchRelationName);
+	{
+		PageFile relation = PageFile::create(benchRelationName);
+		std::mt19937 generator(5);
+		std::uniform_real_distribution<double> distribution(0, 1);
+		PageId pageNo;
+		Page page = relation.allocatePage(pageNo);
+		for(int i = 0; i < numEstimateKeys; i++) {
+			int key = (int) (numEstimateKeys * pow(distribution(generator), 3));
+			std::string record((const char*) &key, sizeof(int));
+			try {
+				page.insertRecord(record);
+			} catch(InsufficientSpaceException &e) {
+				relation.writePage(pageNo, page);
+				page = relation.allocatePage(pageNo);
+				page.insertRecord(record);
+			}
+		}
+		relation.writePage(pageNo, page);
+	}
+
+	BufMgr* bufMgr = new BufMgr(20000);
+	std::string indexName;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	BTreeIndex* index = new BTreeIndex(benchRelationName, indexName, bufMgr, 0, INTEGER, BULK_LOAD);
+	double buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("bulk load with statistics: %.2f s\n", buildSeconds);
+
+	std::cout << "range width   estimate us   count us   estimate error   uniform error" << std::endl;
+	for(size_t w = 0; w < sizeof(estimateRangeWidths) / sizeof(estimateRangeWidths[0]); w++) {
+		int width = estimateRangeWidths[w];
+		std::mt19937 generator(width);
+		std::uniform_int_distribution<int> lowDistribution(0, numEstimateKeys - width);
+		std::vector<int> lowVals(estimatesPerWidth);
+		for(int i = 0; i < estimatesPerWidth; i++) lowVals[i] = lowDistribution(generator);
+
+		std::vector<double> estimates(estimatesPerWidth);
+		start = std::chrono::steady_clock::now();
+		for(int i = 0; i < estimatesPerWidth; i++) {
+			int highVal = lowVals[i] + width;
+			estimates[i] = index->estimateRange(&lowVals[i], GTE, &highVal, LT);
+		}
+		double estimateSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		//errors are relative to the exact count, averaged over the ranges
+		double estimateError = 0;
+		double uniformError = 0;
+		start = std::chrono::steady_clock::now();
+		for(int i = 0; i < estimatesPerWidth; i++) {
+			int highVal = lowVals[i] + width;
+			double count = index->countRange(&lowVals[i], GTE, &highVal, LT);
+			estimateError += fabs(estimates[i] - count) / std::max(count, 1.0);
+			uniformError += fabs((double) width - count) / std::max(count, 1.0);
+		}
+		double countSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		printf("%-13d %11.2f %10.1f %15.1f%% %14.1f%%\n", width, estimateSeconds / estimatesPerWidth * 1e6, countSeconds / estimatesPerWidth * 1e6,
+			estimateError / estimatesPerWidth * 100, uniformError / estimatesPerWidth * 100);
+	}
+
+	delete index;
+	delete bufMgr;
+	removeIfExists(indexName);
+	removeIfExists(benchRelationName);
+}
+
+// -----------------------------------------------------------------------------
+// parallelBuildBenchmark
+// -----------------------------------------------------------------------------
+
+void parallelBuildBenchmark()
+{
+	std::cout << std::endl << "Bulk loads of " << numBuildKeys << " INTEGER keys in random order, by the number of threads scanning the relation ("
+		<< std::thread::hardware_concurrency() << " hardware threads)" << std::endl;
+
+	removeIfExists(benchRelationName);
+	{
+		std::vector<int> keys(numBuildKeys);
+		for(int i = 0; i < numBuildKeys; i++) keys[i] = i;
+		std::shuffle(keys.begin(), keys.end(), std::mt19937(13));
+
+		PageFile relation = PageFile::create(benchRelationName);
+		PageId pageNo;
+		Page page = relation.allocatePage(pageNo);
+		for(int i = 0; i < numBuildKeys; i++) {
+			std::string record((const char*) &keys[i], sizeof(int));
+			try {
+				page.insertRecord(record);
+			} catch(InsufficientSpaceException &e) {
+				relation.writePage(pageNo, page);
+				page = relation.allocatePage(pageNo);
+				page.insertRecord(record);
+			}
+		}
+		relation.writePage(pageNo, page);
+	}
+
+	std::cout << "threads   build s   speedup" << std::endl;
+	double oneThreadSeconds = 0;
+	for(size_t t = 0; t < sizeof(buildThreadCounts) / sizeof(buildThreadCounts[0]); t++) {
+		int numThreads = buildThreadCounts[t];
+		BufMgr* bufMgr = new BufMgr(20000);
+		std::string indexName;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		BTreeIndex* index = new BTreeIndex(benchRelationName, indexName, bufMgr, 0, INTEGER, BULK_LOAD, 1.0, LATCH_COUPLING,
+			MERGE_ON_UNDERFLOW, 1, READ_WRITE, UNCOUNTED, numThreads);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if(numThreads == 1) oneThreadSeconds = seconds;
+		printf("%-9d %7.2f %8.2fx\n", numThreads, seconds, oneThreadSeconds / seconds);
+
+		delete index;
+		delete bufMgr;
+		removeIfExists(indexName);
+	}
+	removeIfExists(benchRelationName);
+}
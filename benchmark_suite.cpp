@@ -0,0 +1,399 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <random>
+#include <fstream>
+#include <algorithm>
+#include "btree.h"
+#include "page.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/no_such_key_found_exception.h"
+#include "exceptions/index_scan_completed_exception.h"
+#include "exceptions/insufficient_space_exception.h"
+
+using namespace badgerdb;
+
+// -----------------------------------------------------------------------------
+// Globals
+// -----------------------------------------------------------------------------
+
+// Runs every combination of the values given for the parameters below, each as name=value[,value...] on the command
+// line, and writes one row of measurements per run as CSV or JSON. The keys, their order and the probes all come from
+// seed, so two runs with the same arguments do the same work.
+const char* usage =
+	"usage: benchmark_suite [name=value[,value...]]...\n"
+	"  size=N[,N...]                          records in the relation (default 100000)\n"
+	"  type=int|double|string[,...]          type of the indexed attribute (default int)\n"
+	"  order=forward|backward|random[,...]   order the records are in the relation and the inserts come in (default random)\n"
+	"  pool=N[,N...]                          pages of the buffer pool (default 100)\n"
+	"  selectivity=F[,F...]                   share of the keys every range scan covers (default 0.01)\n"
+	"  build=insert|bulk[,...]               how the index is built from the relation (default insert)\n"
+	"  inserts=N                              keys inserted after the build (default size / 10)\n"
+	"  lookups=N                              point lookups (default 100000)\n"
+	"  scans=N                                range scans (default 100)\n"
+	"  repeat=N                               runs of every combination (default 1)\n"
+	"  seed=N                                 seed of the key order and the probes (default 1)\n"
+	"  format=csv|json                        (default csv)\n"
+	"  out=FILE                               where the results go (default standard output)\n";
+
+const std::string suiteRelationName = "suiteRel";
+
+// The tuples of the relation, laid out as those of main.cpp
+typedef struct tuple {
+	int i;
+	double d;
+	char s[64];
+} RECORD;
+
+// sinks the scan results so the compiler cannot drop them
+volatile long long checksum = 0;
+
+/**
+ * One combination of the parameters
+ */
+struct SuiteRun {
+	int relationSize;
+	Datatype keyType;
+	std::string order;
+	int poolPages;
+	double selectivity;
+	BuildMethod buildMethod;
+	int repetition;
+};
+
+/**
+ * What a run measured. The page I/Os are the reads and writes the buffer manager made during each phase.
+ */
+struct SuiteResult {
+	double buildSeconds;
+	long long buildReads;
+	long long buildWrites;
+	double insertsPerSecond;
+	long long insertReads;
+	long long insertWrites;
+	double lookupsPerSecond;
+	long long lookupReads;
+	double scanRidsPerSecond;
+	long long scanRids;
+	long long scanReads;
+};
+
+// -----------------------------------------------------------------------------
+// Forward declarations
+// -----------------------------------------------------------------------------
+
+std::vector<std::string> splitValues(const std::string & values);
+const char* typeName(Datatype keyType);
+std::vector<int> keyOrder(int first, int count, const std::string & order, unsigned int seed);
+void makeKey(int key, RECORD & record);
+const void* keyOf(Datatype keyType, const RECORD & record);
+void createSuiteRelation(const std::vector<int> & keys);
+void removeIfExists(const std::string & fileName);
+SuiteResult runSuite(const SuiteRun & run, int numInserts, int numLookups, int numScans, unsigned int seed);
+void writeCsv(std::ostream & out, const std::vector<SuiteRun> & runs, const std::vector<SuiteResult> & results);
+void writeJson(std::ostream & out, const std::vector<SuiteRun> & runs, const std::vector<SuiteResult> & results);
+
+int main(int argc, char **argv)
+{
+	std::vector<std::string> sizes(1, "100000");
+	std::vector<std::string> types(1, "int");
+	std::vector<std::string> orders(1, "random");
+	std::vector<std::string> pools(1, "100");
+	std::vector<std::string> selectivities(1, "0.01");
+	std::vector<std::string> builds(1, "insert");
+	int numInserts = -1;
+	int numLookups = 100000;
+	int numScans = 100;
+	int repeat = 1;
+	unsigned int seed = 1;
+	std::string format = "csv";
+	std::string outName;
+
+	for(int a = 1; a < argc; a++) {
+		std::string arg = argv[a];
+		size_t equals = arg.find('=');
+		if(equals == std::string::npos) {
+			std::cerr << usage;
+			return 1;
+		}
+		std::string name = arg.substr(0, equals);
+		std::string value = arg.substr(equals + 1);
+		if(name == "size") sizes = splitValues(value);
+		else if(name == "type") types = splitValues(value);
+		else if(name == "order") orders = splitValues(value);
+		else if(name == "pool") pools = splitValues(value);
+		else if(name == "selectivity") selectivities = splitValues(value);
+		else if(name == "build") builds = splitValues(value);
+		else if(name == "inserts") numInserts = atoi(value.c_str());
+		else if(name == "lookups") numLookups = atoi(value.c_str());
+		else if(name == "scans") numScans = atoi(value.c_str());
+		else if(name == "repeat") repeat = atoi(value.c_str());
+		else if(name == "seed") seed = (unsigned int) strtoul(value.c_str(), NULL, 10);
+		else if(name == "format") format = value;
+		else if(name == "out") outName = value;
+		else {
+			std::cerr << usage;
+			return 1;
+		}
+	}
+
+	//every combination, the relation size changing slowest
+	std::vector<SuiteRun> runs;
+	for(size_t s = 0; s < sizes.size(); s++)
+	for(size_t t = 0; t < types.size(); t++)
+	for(size_t o = 0; o < orders.size(); o++)
+	for(size_t p = 0; p < pools.size(); p++)
+	for(size_t f = 0; f < selectivities.size(); f++)
+	for(size_t b = 0; b < builds.size(); b++)
+	for(int r = 0; r < repeat; r++) {
+		SuiteRun run;
+		run.relationSize = atoi(sizes[s].c_str());
+		run.keyType = (types[t] == "double") ? DOUBLE : (types[t] == "string") ? STRING : INTEGER;
+		run.order = orders[o];
+		run.poolPages = atoi(pools[p].c_str());
+		run.selectivity = atof(selectivities[f].c_str());
+		run.buildMethod = (builds[b] == "bulk") ? BULK_LOAD : INSERT_BUILD;
+		run.repetition = r;
+		if(run.relationSize <= 0 || run.poolPages <= 0 || (run.order != "forward" && run.order != "backward" && run.order != "random")) {
+			std::cerr << usage;
+			return 1;
+		}
+		runs.push_back(run);
+	}
+
+	std::vector<SuiteResult> results;
+	for(size_t r = 0; r < runs.size(); r++) {
+		std::cerr << "run " << r + 1 << " of " << runs.size() << ": " << runs[r].relationSize << " " << typeName(runs[r].keyType)
+			<< " keys, " << runs[r].order << ", " << runs[r].poolPages << " pages" << std::endl;
+		int inserts = (numInserts >= 0) ? numInserts : runs[r].relationSize / 10;
+		results.push_back(runSuite(runs[r], inserts, numLookups, numScans, seed));
+	}
+
+	std::ofstream outFile;
+	if(!outName.empty()) outFile.open(outName.c_str());
+	std::ostream & out = outName.empty() ? std::cout : outFile;
+	if(format == "json") writeJson(out, runs, results);
+	else writeCsv(out, runs, results);
+	return 0;
+}
+
+// -----------------------------------------------------------------------------
+// Parameters and keys
+// -----------------------------------------------------------------------------
+
+std::vector<std::string> splitValues(const std::string & values)
+{
+	std::vector<std::string> split;
+	size_t start = 0;
+	while(true) {
+		size_t comma = values.find(',', start);
+		split.push_back(values.substr(start, comma == std::string::npos ? std::string::npos : comma - start));
+		if(comma == std::string::npos) break;
+		start = comma + 1;
+	}
+	return split;
+}
+
+const char* typeName(Datatype keyType)
+{
+	return (keyType == DOUBLE) ? "double" : (keyType == STRING) ? "string" : "int";
+}
+
+/**
+ * The keys first .. first + count - 1 in the order asked for
+ */
+std::vector<int> keyOrder(int first, int count, const std::string & order, unsigned int seed)
+{
+	std::vector<int> keys(count);
+	for(int i = 0; i < count; i++) keys[i] = (order == "backward") ? first + count - 1 - i : first + i;
+	if(order == "random") std::shuffle(keys.begin(), keys.end(), std::mt19937(seed));
+	return keys;
+}
+
+/**
+ * Fill in every attribute of record from key, the string zero-padded so that it sorts as the number does
+ */
+void makeKey(int key, RECORD & record)
+{
+	memset(record.s, ' ', sizeof(record.s));
+	record.i = key;
+	record.d = (double) key;
+	sprintf(record.s, "%010d string record", key);
+}
+
+const void* keyOf(Datatype keyType, const RECORD & record)
+{
+	if(keyType == DOUBLE) return &record.d;
+	if(keyType == STRING) return record.s;
+	return &record.i;
+}
+
+void createSuiteRelation(const std::vector<int> & keys)
+{
+	removeIfExists(suiteRelationName);
+	PageFile relation = PageFile::create(suiteRelationName);
+	PageId pageNo;
+	Page page = relation.allocatePage(pageNo);
+	RECORD record;
+	for(size_t i = 0; i < keys.size(); i++) {
+		makeKey(keys[i], record);
+		std::string data(reinterpret_cast<char*>(&record), sizeof(record));
+		try {
+			page.insertRecord(data);
+		} catch(InsufficientSpaceException &e) {
+			relation.writePage(pageNo, page);
+			page = relation.allocatePage(pageNo);
+			page.insertRecord(data);
+		}
+	}
+	relation.writePage(pageNo, page);
+}
+
+void removeIfExists(const std::string & fileName)
+{
+	try {
+		File::remove(fileName);
+	} catch(FileNotFoundException e) {
+	}
+}
+
+// -----------------------------------------------------------------------------
+// runSuite
+// -----------------------------------------------------------------------------
+
+SuiteResult runSuite(const SuiteRun & run, int numInserts, int numLookups, int numScans, unsigned int seed)
+{
+	SuiteResult result;
+	const int attrByteOffset = (run.keyType == DOUBLE) ? offsetof(tuple,d) : (run.keyType == STRING) ? offsetof(tuple,s) : offsetof(tuple,i);
+	createSuiteRelation(keyOrder(0, run.relationSize, run.order, seed));
+
+	//the relation is written straight to its file, so the pool starts out empty
+	BufMgr* bufMgr = new BufMgr(run.poolPages);
+	std::string indexName;
+	bufMgr->clearBufStats();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	BTreeIndex* index = new BTreeIndex(suiteRelationName, indexName, bufMgr, attrByteOffset, run.keyType, run.buildMethod);
+	result.buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	result.buildReads = bufMgr->getBufStats().diskreads;
+	result.buildWrites = bufMgr->getBufStats().diskwrites;
+
+	//new keys above those of the relation, coming in the same order its records are in
+	std::vector<int> insertKeys = keyOrder(run.relationSize, numInserts, run.order, seed + 1);
+	RECORD record;
+	RecordId rid;
+	bufMgr->clearBufStats();
+	start = std::chrono::steady_clock::now();
+	for(int i = 0; i < numInserts; i++) {
+		makeKey(insertKeys[i], record);
+		rid.page_number = insertKeys[i] / 100 + 1;
+		rid.slot_number = insertKeys[i] % 100 + 1;
+		index->insertEntry(keyOf(run.keyType, record), rid);
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	result.insertsPerSecond = (numInserts > 0) ? numInserts / seconds : 0;
+	result.insertReads = bufMgr->getBufStats().diskreads;
+	result.insertWrites = bufMgr->getBufStats().diskwrites;
+
+	//the probes are drawn up front so that only the lookups are timed
+	const int numKeys = run.relationSize + numInserts;
+	std::mt19937 generator(seed + 2);
+	std::uniform_int_distribution<int> keyDistribution(0, numKeys - 1);
+	std::vector<RECORD> probes(numLookups);
+	for(int i = 0; i < numLookups; i++) makeKey(keyDistribution(generator), probes[i]);
+	bufMgr->clearBufStats();
+	start = std::chrono::steady_clock::now();
+	for(int i = 0; i < numLookups; i++) checksum += index->lookup(keyOf(run.keyType, probes[i]), rid);
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	result.lookupsPerSecond = (numLookups > 0) ? numLookups / seconds : 0;
+	result.lookupReads = bufMgr->getBufStats().diskreads;
+
+	//every scan covers the same number of keys, starting anywhere it fits
+	const int width = std::max(1, (int) (run.selectivity * numKeys));
+	std::uniform_int_distribution<int> lowDistribution(0, std::max(0, numKeys - width));
+	std::vector<RECORD> lows(numScans);
+	std::vector<RECORD> highs(numScans);
+	for(int i = 0; i < numScans; i++) {
+		int low = lowDistribution(generator);
+		makeKey(low, lows[i]);
+		makeKey(low + width, highs[i]);
+	}
+	result.scanRids = 0;
+	bufMgr->clearBufStats();
+	start = std::chrono::steady_clock::now();
+	for(int i = 0; i < numScans; i++) {
+		try {
+			index->startScan(keyOf(run.keyType, lows[i]), GTE, keyOf(run.keyType, highs[i]), LT);
+			while(true) {
+				index->scanNext(rid);
+				checksum += rid.slot_number;
+				result.scanRids++;
+			}
+		} catch(NoSuchKeyFoundException e) {
+			continue;
+		} catch(IndexScanCompletedException e) {
+		}
+		index->endScan();
+	}
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	result.scanRidsPerSecond = (result.scanRids > 0) ? result.scanRids / seconds : 0;
+	result.scanReads = bufMgr->getBufStats().diskreads;
+
+	delete index;
+	delete bufMgr;
+	removeIfExists(indexName);
+	removeIfExists(suiteRelationName);
+	return result;
+}
+
+// -----------------------------------------------------------------------------
+// Output
+// -----------------------------------------------------------------------------
+
+void writeCsv(std::ostream & out, const std::vector<SuiteRun> & runs, const std::vector<SuiteResult> & results)
+{
+	out << "size,type,order,pool,selectivity,build,repetition,build_s,build_reads,build_writes,inserts_per_s,insert_reads,insert_writes,"
+		"lookups_per_s,lookup_reads,scan_rids_per_s,scan_rids,scan_reads" << std::endl;
+	char line[512];
+	for(size_t r = 0; r < runs.size(); r++) {
+		const SuiteRun & run = runs[r];
+		const SuiteResult & result = results[r];
+		snprintf(line, sizeof(line), "%d,%s,%s,%d,%g,%s,%d,%.6f,%lld,%lld,%.1f,%lld,%lld,%.1f,%lld,%.1f,%lld,%lld",
+			run.relationSize, typeName(run.keyType), run.order.c_str(), run.poolPages, run.selectivity,
+			run.buildMethod == BULK_LOAD ? "bulk" : "insert", run.repetition,
+			result.buildSeconds, result.buildReads, result.buildWrites, result.insertsPerSecond, result.insertReads, result.insertWrites,
+			result.lookupsPerSecond, result.lookupReads, result.scanRidsPerSecond, result.scanRids, result.scanReads);
+		out << line << std::endl;
+	}
+}
+
+void writeJson(std::ostream & out, const std::vector<SuiteRun> & runs, const std::vector<SuiteResult> & results)
+{
+	out << "[" << std::endl;
+	char line[1024];
+	for(size_t r = 0; r < runs.size(); r++) {
+		const SuiteRun & run = runs[r];
+		const SuiteResult & result = results[r];
+		snprintf(line, sizeof(line),
+			"  {\"size\": %d, \"type\": \"%s\", \"order\": \"%s\", \"pool\": %d, \"selectivity\": %g, \"build\": \"%s\", \"repetition\": %d, "
+			"\"build_s\": %.6f, \"build_reads\": %lld, \"build_writes\": %lld, \"inserts_per_s\": %.1f, \"insert_reads\": %lld, "
+			"\"insert_writes\": %lld, \"lookups_per_s\": %.1f, \"lookup_reads\": %lld, \"scan_rids_per_s\": %.1f, \"scan_rids\": %lld, "
+			"\"scan_reads\": %lld}%s",
+			run.relationSize, typeName(run.keyType), run.order.c_str(), run.poolPages, run.selectivity,
+			run.buildMethod == BULK_LOAD ? "bulk" : "insert", run.repetition,
+			result.buildSeconds, result.buildReads, result.buildWrites, result.insertsPerSecond, result.insertReads, result.insertWrites,
+			result.lookupsPerSecond, result.lookupReads, result.scanRidsPerSecond, result.scanRids, result.scanReads,
+			r + 1 < runs.size() ? "," : "");
+		out << line << std::endl;
+	}
+	out << "]" << std::endl;
+}
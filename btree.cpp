@@ -7,9 +7,21 @@
 
 #include <limits.h>
 #include <float.h>
+#include <math.h>
+#include <algorithm>
+#include <random>
+#include <queue>
+#include <mutex>
+#include <exception>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "btree.h"
+#include "btree_search.h"
 #include "filescan.h"
 #include <file_iterator.h>
+#include <page_iterator.h>
 #include "exceptions/bad_index_info_exception.h"
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/bad_scanrange_exception.h"
@@ -20,7 +32,10 @@
 #include "exceptions/end_of_file_exception.h"
 #include "exceptions/file_exists_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
+#include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/duplicate_key_exception.h"
+#include "exceptions/read_only_index_exception.h"
+#include "exceptions/invalid_page_exception.h"
 
 
 //#define DEBUG
@@ -29,1938 +44,5087 @@ namespace badgerdb
 {
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::BTreeIndex -- Constructor
+// Buffer manager access
 // -----------------------------------------------------------------------------
-BTreeIndex::BTreeIndex(const std::string & relationName, std::string & outIndexName, BufMgr *bufMgrIn, const int attrByteOffset, const Datatype attrType) {
-    //create the filename
-    std::ostringstream idxStr;
-    idxStr << relationName << '.' << attrByteOffset;
-    outIndexName = idxStr.str();
-	
-	//set values of the private variables
-	this->bufMgr = bufMgrIn;
-    this->attributeType = attrType;
-    this->attrByteOffset = attrByteOffset;
-	scanExecuting = false;
-	headerPageNum = 1;
 
-	if(attrType == INTEGER) {
-		leafOccupancy = INTARRAYLEAFSIZE;
-		nodeOccupancy = INTARRAYNONLEAFSIZE;
-	} else if(attrType == DOUBLE) {
-		leafOccupancy = DOUBLEARRAYLEAFSIZE;
-		nodeOccupancy = DOUBLEARRAYNONLEAFSIZE;
-	} else if(attrType == STRING) {
-		leafOccupancy = STRINGARRAYLEAFSIZE;
-		nodeOccupancy = STRINGARRAYNONLEAFSIZE;
-	} else {
-		std::cout << "ERROR: non valid data type passed to BTreeIndex constructor" << std::endl;
-		return;
-	}
+std::mutex bufMgrLatch;
 
-    //Pointers to rootPage and metadata information
-	Page* metadataPage;
-	IndexMetaInfo* metadata;
-	BlobFile* bFile;
+static void bufReadPage(BufMgr* bufMgr, File* file, const PageId pageNo, Page* &page) {
+	std::lock_guard<std::mutex> guard(bufMgrLatch);
+	bufMgr->readPage(file, pageNo, page);
+}
 
-	//check if that file exists by creating a new one and having it throw an exception
-    try {
-		bFile = new BlobFile(outIndexName, true/*try to create a new one*/);
-	} catch(const FileExistsException &e) {
-		//it already exists so just read it and cast it
-		bFile = new BlobFile(outIndexName, false);
-		file = (File*) bFile;
+static void bufUnPinPage(BufMgr* bufMgr, File* file, const PageId pageNo, const bool dirty) {
+	std::lock_guard<std::mutex> guard(bufMgrLatch);
+	bufMgr->unPinPage(file, pageNo, dirty);
+}
 
-		//read the first page which contains metadata information
-		bufMgr->readPage(file, headerPageNum, metadataPage);
-		metadata = (IndexMetaInfo*) metadataPage;
+static void bufAllocPage(BufMgr* bufMgr, File* file, PageId &pageNo, Page* &page) {
+	std::lock_guard<std::mutex> guard(bufMgrLatch);
+	bufMgr->allocPage(file, pageNo, page);
+}
 
-		//make sure the metadata matches whats passed in if the file already exists
-		if(metadata->attrType != attrType ||
-			metadata->attrByteOffset != attrByteOffset ||
-			strcmp(metadata->relationName, relationName.c_str()) != 0) {
+//allocates a page written out past the buffer manager, whose reads and writes share the stream of the file
+static void fileAllocPage(File* file, PageId &pageNo) {
+	std::lock_guard<std::mutex> guard(bufMgrLatch);
+	file->allocatePage(pageNo);
+}
 
-			//if something doesnt match, then throw an exception
-			throw BadIndexInfoException("Info passed into constructor doesn't match meta info page");
-		}
+static void bufFlushFile(BufMgr* bufMgr, File* file) {
+	std::lock_guard<std::mutex> guard(bufMgrLatch);
+	bufMgr->flushFile(file);
+}
 
-		//set the root page for this index
-		rootPageNum = metadata->rootPageNo;
+// -----------------------------------------------------------------------------
+// Write-ahead logging
+// -----------------------------------------------------------------------------
 
-		//we dont need the header information anymore and we didnt change anything on that page
-		bufMgr->unPinPage(file, headerPageNum, false);
+//the insert or delete the thread is running on a READ_WRITE_LOGGED index, NULL otherwise
+static thread_local LogAction* loggedAction = NULL;
 
-		//we are going to keep the rootPage in memory
-		bufMgr->readPage(file, rootPageNum, rootPage);
+// -----------------------------------------------------------------------------
+// Node helpers
+// -----------------------------------------------------------------------------
 
-		return;
+// -----------------------------------------------------------------------------
+// NonLeafNode::init
+// -----------------------------------------------------------------------------
+template <class T>
+void NonLeafNode<T>::init(int level)
+{
+	this->level = level;
+	numKeys = 0;
+	for(int i = 0; i < CAPACITY; i++) keyArray[i] = KeyTraits<T>::nullKey();
+	for(int i = 0; i < CAPACITY + 1; i++) {
+		pageNoArray[i] = NULL;
+		countArray[i] = 0;
 	}
+	rightSibPageNo = NULL;
+	highKey = KeyTraits<T>::nullKey();
+}
 
-	//if the code reaches here then the file didnt exist but we created one
-	file = (File*) bFile;
-	
-	//make a metadata Page for this new index, should be the first page
-	PageId metadataPageId;
-	bufMgr->allocPage(file, metadataPageId, metadataPage);
-	headerPageNum = metadataPageId; //just in case it isnt 1 and we need to get at it later save where it is
-	metadata = (IndexMetaInfo*) metadataPage;
-	
-	//set variables in the metadata page
-	strncpy(metadata->relationName, relationName.c_str(), 20);
-	metadata->attrType = attrType;
-	metadata->attrByteOffset = attrByteOffset;
+// -----------------------------------------------------------------------------
+// NonLeafNode::build
+// -----------------------------------------------------------------------------
+template <class T>
+void NonLeafNode<T>::build(const T* lowKey, const T* highKey, const PageKeyPair<T>* entries, int count)
+{
+	numKeys = count - 1;
+	pageNoArray[0] = entries[0].pageNo;
+	countArray[0] = entries[0].count;
+	for(int i = 1; i < count; i++) {
+		keyArray[i - 1] = entries[i].key;
+		pageNoArray[i] = entries[i].pageNo;
+		countArray[i] = entries[i].count;
+	}
+	for(int i = numKeys; i < CAPACITY; i++) {
+		keyArray[i] = KeyTraits<T>::nullKey();
+		pageNoArray[i + 1] = NULL;
+		countArray[i + 1] = 0;
+	}
+	this->highKey = highKey != NULL ? *highKey : KeyTraits<T>::nullKey();
+}
 
-	//create a new root page
-	bufMgr->allocPage(file, rootPageNum, rootPage);
-	metadata->rootPageNo = rootPageNum;
+// -----------------------------------------------------------------------------
+// NonLeafNode::getEntries
+// -----------------------------------------------------------------------------
+template <class T>
+void NonLeafNode<T>::getEntries(std::vector<PageKeyPair<T> > &entries) const
+{
+	PageKeyPair<T> entry;
+	entry.set(pageNoArray[0], KeyTraits<T>::nullKey(), countArray[0]);
+	entries.push_back(entry);
+	for(int i = 0; i < numKeys; i++) {
+		entry.set(pageNoArray[i + 1], keyArray[i], countArray[i + 1]);
+		entries.push_back(entry);
+	}
+}
 
-	std::cout << "ROOT PAGE NUM = " << rootPageNum << std::endl;
-	//now we can unpin the metaPage. Its dirty and needs to be written to disk
-	bufMgr->unPinPage(file, metadataPageId, true);
-	
-	//the rootPage will become a non-leaf node
-	switch(attrType) {
-		case Datatype::INTEGER: {
-			//initialize the rootNode with NULL key, pageNo pairs
-			NonLeafNodeInt* rootNode = (NonLeafNodeInt*) rootPage;
-			rootNode->level = 1;
-			for(int i = 0; i < nodeOccupancy; i++) rootNode->keyArray[i] = INT_MAX;
-			for(int i = 0; i < nodeOccupancy + 1; i++) rootNode->pageNoArray[i] = NULL;
-
-			//create an empty left leaf page and right leaf page of the attribute type
-			Page* leftLeafPage, *rightLeafPage; 
-			PageId leftLeafPageId, rightLeafPageId;
-
-			bufMgr->allocPage(file, leftLeafPageId, leftLeafPage);
-			bufMgr->allocPage(file, rightLeafPageId, rightLeafPage);
-			
-			LeafNodeInt* leftLeafNode = (LeafNodeInt*) leftLeafPage;
-			LeafNodeInt* rightLeafNode = (LeafNodeInt*) rightLeafPage;
-			
-			//initialize the leaf page
-			for(int i = 0; i < leafOccupancy; i++) {
-				leftLeafNode->keyArray[i] = INT_MAX;
-				rightLeafNode->keyArray[i] = INT_MAX;
-			}
+// -----------------------------------------------------------------------------
+// NonLeafNode::upperBound
+// -----------------------------------------------------------------------------
+template <class T>
+int NonLeafNode<T>::upperBound(const T& key) const
+{
+	return upperBoundKey(keyArray, numKeys, key);
+}
 
-			leftLeafNode->rightSibPageNo = rightLeafPageId;
-			rightLeafNode->rightSibPageNo = NULL;
+// -----------------------------------------------------------------------------
+// NonLeafNode::insertAt
+// -----------------------------------------------------------------------------
+template <class T>
+void NonLeafNode<T>::insertAt(int i, const T& key, PageId rightChild, unsigned int rightCount)
+{
+	for(int j = numKeys; j > i; j--) {
+		keyArray[j] = keyArray[j - 1];
+		pageNoArray[j + 1] = pageNoArray[j];
+		countArray[j + 1] = countArray[j];
+	}
+	keyArray[i] = key;
+	pageNoArray[i + 1] = rightChild;
+	countArray[i + 1] = rightCount;
+	numKeys++;
+}
 
-			rootNode->pageNoArray[0] = leftLeafPageId;
-			rootNode->pageNoArray[1] = rightLeafPageId;
+// -----------------------------------------------------------------------------
+// NonLeafNode::removeAt
+// -----------------------------------------------------------------------------
+template <class T>
+void NonLeafNode<T>::removeAt(int i)
+{
+	for(int j = i; j < numKeys - 1; j++) {
+		keyArray[j] = keyArray[j + 1];
+		pageNoArray[j + 1] = pageNoArray[j + 2];
+		countArray[j + 1] = countArray[j + 2];
+	}
+	numKeys--;
+	keyArray[numKeys] = KeyTraits<T>::nullKey();
+	pageNoArray[numKeys + 1] = NULL;
+	countArray[numKeys + 1] = 0;
+}
 
-			//unpin the new leaf page. its dirty
-			bufMgr->unPinPage(file, leftLeafPageId, true);
-			bufMgr->unPinPage(file, rightLeafPageId, true);
-			break;
-		}
-		case Datatype::DOUBLE: {
-			//initialize the rootNode with NULL key, pageNo pairs
-			NonLeafNodeDouble* rootNode = (NonLeafNodeDouble*) rootPage;
-			rootNode->level = 1;
-			for(int i = 0; i < nodeOccupancy; i++) rootNode->keyArray[i] = DBL_MAX;
-			for(int i = 0; i < nodeOccupancy + 1; i++) rootNode->pageNoArray[i] = NULL;
-
-			//create an empty left leaf page and right leaf page of the attribute type
-			Page* leftLeafPage, *rightLeafPage; 
-			PageId leftLeafPageId, rightLeafPageId;
-
-			bufMgr->allocPage(file, leftLeafPageId, leftLeafPage);
-			bufMgr->allocPage(file, rightLeafPageId, rightLeafPage);
-			
-			LeafNodeDouble* leftLeafNode = (LeafNodeDouble*) leftLeafPage;
-			LeafNodeDouble* rightLeafNode = (LeafNodeDouble*) rightLeafPage;
-			
-			//initialize the leaf page
-			for(int i = 0; i < leafOccupancy; i++) {
-				leftLeafNode->keyArray[i] = DBL_MAX;
-				rightLeafNode->keyArray[i] = DBL_MAX;
-			}
+// -----------------------------------------------------------------------------
+// LeafNode::init
+// -----------------------------------------------------------------------------
+template <class T>
+void LeafNode<T>::init()
+{
+	for(int i = 0; i < CAPACITY; i++) keyArray[i] = KeyTraits<T>::nullKey();
+	rightSibPageNo = NULL;
+	leftSibPageNo = NULL;
+	includedPageNo = NULL;
+	numKeys = 0;
+	highKey = KeyTraits<T>::nullKey();
+}
 
-			leftLeafNode->rightSibPageNo = rightLeafPageId;
-			rightLeafNode->rightSibPageNo = NULL;
+// -----------------------------------------------------------------------------
+// LeafNode::build
+// -----------------------------------------------------------------------------
+template <class T>
+void LeafNode<T>::build(const T* lowKey, const T* highKey, const RIDKeyPair<T>* entries, int count)
+{
+	numKeys = count;
+	for(int i = 0; i < count; i++) {
+		keyArray[i] = entries[i].key;
+		ridArray[i] = entries[i].rid;
+	}
+	for(int i = count; i < CAPACITY; i++) keyArray[i] = KeyTraits<T>::nullKey();
+	this->highKey = highKey != NULL ? *highKey : KeyTraits<T>::nullKey();
+}
 
-			rootNode->pageNoArray[0] = leftLeafPageId;
-			rootNode->pageNoArray[1] = rightLeafPageId;
+// -----------------------------------------------------------------------------
+// LeafNode::getEntries
+// -----------------------------------------------------------------------------
+template <class T>
+void LeafNode<T>::getEntries(std::vector<RIDKeyPair<T> > &entries) const
+{
+	RIDKeyPair<T> entry;
+	for(int i = 0; i < numKeys; i++) {
+		entry.set(ridArray[i], keyArray[i]);
+		entries.push_back(entry);
+	}
+}
 
-			//unpin the new leaf page. its dirty
-			bufMgr->unPinPage(file, leftLeafPageId, true);
-			bufMgr->unPinPage(file, rightLeafPageId, true);
-			break;
-		}
-		case Datatype::STRING: {
-			//initialize the rootNode with NULL key, pageNo pairs
-			NonLeafNodeString* rootNode = (NonLeafNodeString*) rootPage;
-			rootNode->level = 1;
-			for(int i = 0; i < nodeOccupancy; i++) strncpy(rootNode->keyArray[i], "", STRINGSIZE);
-			for(int i = 0; i < nodeOccupancy + 1; i++) rootNode->pageNoArray[i] = NULL;
-
-			//create an empty left leaf page and right leaf page of the attribute type
-			Page* leftLeafPage, *rightLeafPage; 
-			PageId leftLeafPageId, rightLeafPageId;
-
-			bufMgr->allocPage(file, leftLeafPageId, leftLeafPage);
-			bufMgr->allocPage(file, rightLeafPageId, rightLeafPage);
-			
-			LeafNodeString* leftLeafNode = (LeafNodeString*) leftLeafPage;
-			LeafNodeString* rightLeafNode = (LeafNodeString*) rightLeafPage;
-			
-			//initialize the leaf page
-			for(int i = 0; i < leafOccupancy; i++) {
-				strncpy(leftLeafNode->keyArray[i], "", STRINGSIZE);
-                strncpy(rightLeafNode->keyArray[i], "", STRINGSIZE);
-			}
+// -----------------------------------------------------------------------------
+// LeafNode::lowerBound
+// -----------------------------------------------------------------------------
+template <class T>
+int LeafNode<T>::lowerBound(const T& key) const
+{
+	return lowerBoundKey(keyArray, numKeys, key);
+}
 
-			leftLeafNode->rightSibPageNo = rightLeafPageId;
-			rightLeafNode->rightSibPageNo = NULL;
+// -----------------------------------------------------------------------------
+// LeafNode::upperBound
+// -----------------------------------------------------------------------------
+template <class T>
+int LeafNode<T>::upperBound(const T& key) const
+{
+	return upperBoundKey(keyArray, numKeys, key);
+}
 
-			rootNode->pageNoArray[0] = leftLeafPageId;
-			rootNode->pageNoArray[1] = rightLeafPageId;
+// -----------------------------------------------------------------------------
+// LeafNode::insertAt
+// -----------------------------------------------------------------------------
+template <class T>
+void LeafNode<T>::insertAt(int i, const T& key, const RecordId& rid)
+{
+	for(int j = numKeys; j > i; j--) {
+		keyArray[j] = keyArray[j - 1];
+		ridArray[j] = ridArray[j - 1];
+	}
+	keyArray[i] = key;
+	ridArray[i] = rid;
+	numKeys++;
+}
 
-			//unpin the new leaf page. its dirty
-			bufMgr->unPinPage(file, leftLeafPageId, true);
-			bufMgr->unPinPage(file, rightLeafPageId, true);
-			break;
-		}
-		default: { break; }
+// -----------------------------------------------------------------------------
+// LeafNode::removeAt
+// -----------------------------------------------------------------------------
+template <class T>
+void LeafNode<T>::removeAt(int i)
+{
+	for(int j = i; j < numKeys - 1; j++) {
+		keyArray[j] = keyArray[j + 1];
+		ridArray[j] = ridArray[j + 1];
 	}
+	numKeys--;
+	keyArray[numKeys] = KeyTraits<T>::nullKey();
+}
 
-	//insert records from this relation into the tree
-	//Create a file scanner for this relaion and buffer manager
-	FileScan* fileScan = new FileScan(relationName, bufMgr);
-	RecordId rid;
-	const char* recordPtr;
-	std::string record;
-	try {
-		//when we reach the end of this file, an exception will be thrown so we will exit then
-		while(true) {
-			fileScan->scanNext(rid);
-			record = fileScan->getRecord();
-			recordPtr = record.c_str();
+// -----------------------------------------------------------------------------
+// Split helpers
+// -----------------------------------------------------------------------------
 
-			switch(attrType) {
-				case INTEGER:
-					insertEntry((void*) (recordPtr + attrByteOffset), rid);
-					break;
-				case DOUBLE:
-					insertEntry((void*) (recordPtr + attrByteOffset), rid);
-					break;
-				case STRING: {
-					char keyBuf[STRINGSIZE + 1];
-                    char* src = (char*)(recordPtr + attrByteOffset);
-                    for(int i = 0; i < STRINGSIZE; src++, i++) keyBuf[i] = *(src);
-                    keyBuf[STRINGSIZE] = '\0';
-                    std::string key = std::string(keyBuf);
-					insertEntry((void*) &key, rid);
-					break;
-                }
-				default: { break; }
+/**
+ * Smallest index in [first, last] at which the weights of entries[0 .. index - 1] reach half of those of all
+ * count entries
+ */
+template <class Node, class Entry>
+static int evenSplit(const Entry* entries, int count, int first, int last) {
+	long long total = 0;
+	for(int i = 0; i < count; i++) total += Node::entryWeight(entries[i].key);
+
+	long long weight = 0;
+	for(int i = 0; i < first; i++) weight += Node::entryWeight(entries[i].key);
+	int split = first;
+	while(split < last && weight < total / 2) weight += Node::entryWeight(entries[split++].key);
+	return split;
+}
+
+/**
+ * Where to split the entries of a leaf, entries[0 .. split - 1] staying on the left and the rest going right.
+ * Starts at an even split by weight and moves outwards until both halves fit a leaf, using the separator
+ * of the keys around the split as the fence between them. Sets separator to it.
+ */
+template <class T>
+static int splitLeafEntries(const std::vector<RIDKeyPair<T> > &entries, const T* lowKey, const T* highKey, T &separator) {
+	const int count = entries.size();
+	const int even = evenSplit<LeafNode<T> >(entries.data(), count, 1, count - 1);
+	for(int distance = 0; distance < count; distance++) {
+		for(int split = even - distance; split <= even + distance; split += 2 * distance) {
+			if(split >= 1 && split <= count - 1) {
+				separator = KeyTraits<T>::separator(entries[split - 1].key, entries[split].key);
+				if(LeafNode<T>::fits(lowKey, &separator, entries.data(), split) &&
+					LeafNode<T>::fits(&separator, highKey, entries.data() + split, count - split)) return split;
 			}
+			if(distance == 0) break;
 		}
-	} catch (EndOfFileException &e) {
-		//end of the scan has been reached
 	}
+	separator = KeyTraits<T>::separator(entries[even - 1].key, entries[even].key);
+	return even;
+}
 
-	delete fileScan;
+/**
+ * Where to split the entries of a non-leaf, children 0 .. split - 1 staying on the left and the rest going right.
+ * The key of child split moves up into the parent. Starts at an even split by weight and moves outwards
+ * until both halves fit a node, leaving each at least one key when there are enough.
+ */
+template <class T>
+static int splitNonLeafEntries(const std::vector<PageKeyPair<T> > &entries, const T* lowKey, const T* highKey) {
+	const int count = entries.size();
+	const int first = count >= 4 ? 2 : 1;
+	const int last = count >= 4 ? count - 2 : count - 1;
+	const int even = evenSplit<NonLeafNode<T> >(entries.data() + 1, count - 1, first - 1, last - 1) + 1;
+	for(int distance = 0; distance < count; distance++) {
+		for(int split = even - distance; split <= even + distance; split += 2 * distance) {
+			if(split >= first && split <= last &&
+				NonLeafNode<T>::fits(lowKey, &entries[split].key, entries.data(), split) &&
+				NonLeafNode<T>::fits(&entries[split].key, highKey, entries.data() + split, count - split)) return split;
+			if(distance == 0) break;
+		}
+	}
+	return even;
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::~BTreeIndex -- destructor
+// Included column helpers
 // -----------------------------------------------------------------------------
-BTreeIndex::~BTreeIndex()
-{
-	// Destructor. Method does not throw any exceptions as is indicated in the header file. All exceptions are caught in here itself.
 
-	// TODO: Performing cleanup by clearing up state variables
+/**
+ * Rid of row i of an included column page whose rows take rowSize bytes
+ */
+static RecordId includedRowRid(const IncludedPage* page, int i, int rowSize) {
+	RecordId rid;
+	memcpy(&rid, page->rows + i * rowSize, sizeof(RecordId));
+	return rid;
+}
 
-	// Ending any initialized scan  and unpinning any B+ Tree pages that are pinned by invoking the endScan method.
-	// endScan method can throw the ScanNotInitializedException and PageNotPinned (thrown by unPinPage) which are caught in here
-	if(scanExecuting)
-	{
-		try {
-			endScan();
-		} catch(const ScanNotInitializedException &e) { 
-			std::cout << "ScanNotInitializedException thrown in BTreeIndex destructor\n"; 
-		}
+/**
+ * Index of the first row of an included column page whose rid is not less than rid, numRows if there is none
+ */
+static int findIncludedRow(const IncludedPage* page, const RecordId &rid, int rowSize) {
+	int low = 0;
+	int high = page->numRows;
+	while(low < high) {
+		int middle = (low + high) / 2;
+		if(ridLess(includedRowRid(page, middle, rowSize), rid)) low = middle + 1;
+		else high = middle;
 	}
-	
-	bufMgr->unPinPage(file, rootPageNum, true);
+	return low;
+}
 
-	// Flushing the index file from the buffer manager if it exists
-	if(file) {
-		bufMgr->flushFile(file);
+/**
+ * Orders the numbers of rows of included columns by the rids of the rows
+ */
+struct IncludedRowLess {
+	IncludedRowLess(const char* rows, int rowSize) : rows(rows), rowSize(rowSize) {}
+
+	bool operator()(size_t a, size_t b) const {
+		RecordId ridA, ridB;
+		memcpy(&ridA, rows + a * rowSize, sizeof(RecordId));
+		memcpy(&ridB, rows + b * rowSize, sizeof(RecordId));
+		return ridLess(ridA, ridB);
 	}
-	
-	// Deleting the file object instance. This automatically invokes the destructor of the File class and closes the index file.
-	delete file;
-	
-	// TODO: Remember to clean up any state variables. Maybe state variables that we set up in the constructor? 
-	// NOTE: The ~FileScan method (which also shuts down scan and unpins any pinned pages) sets the currentPage to null, clears the dirty bit and sets the file iterator 
-	// to point to the beginning of the file. Not sure if that's what they mean by perform any cleanup. This is not done in any other version though.
-	// NOTE: Printng out error messages for now. We can remove them if required.
-}
 
-// -----------------------------------------------------------------------------
-// BTreeIndex::insertEntry
-// -----------------------------------------------------------------------------
-const void BTreeIndex::insertEntry(const void *key, const RecordId rid) 
-{
-	//root page should already be in the buffer
+	const char* rows;
+	int rowSize;
+};
 
-	//cast the rootPage to a non leaf node depending on type
-	switch(attributeType) {
-		case Datatype::INTEGER: {
-			NonLeafNodeInt* rootNode = (NonLeafNodeInt*) rootPage;
-			bool restructured;
-			bool comingFromLeaf;
-			PageId newPageId;
+/**
+ * Orders indexes into an array of rids by the rids they point at
+ */
+struct RidIndexLess {
+	RidIndexLess(const RecordId* rids) : rids(rids) {}
 
-			traverseAndInsert(rootPage, rootNode->level, true, key, rid, restructured, newPageId, comingFromLeaf);
+	bool operator()(size_t a, size_t b) const {
+		return ridLess(rids[a], rids[b]);
+	}
 
-			//if the root was restructured then update the metapage!!!
-			if(restructured) {
-				if(rootNode->keyArray[nodeOccupancy - 1] == INT_MAX) {
-                    //we have room so just put it on this page
-					insertIntoNonLeafPage(rootPage, (void*) &middleInt, newPageId);
+	const RecordId* rids;
+};
 
-				} else {
-					PageId addedPageId;
-					restructure(rootPage, false, (void*) &middleInt, newPageId, addedPageId);
+/**
+ * Puts rows of included columns, rowSize bytes each, in ridLess order of their rids
+ */
+static void sortIncludedRows(std::vector<char> &rows, int rowSize) {
+	std::vector<size_t> order(rows.size() / rowSize);
+	for(size_t i = 0; i < order.size(); i++) order[i] = i;
+	std::sort(order.begin(), order.end(), IncludedRowLess(rows.data(), rowSize));
+
+	std::vector<char> sorted(rows.size());
+	for(size_t i = 0; i < order.size(); i++) memcpy(&sorted[i * rowSize], &rows[order[i] * rowSize], rowSize);
+	rows.swap(sorted);
+}
 
-					//create a new NonLeafPage and put the middle int on it
-					Page* newRootPage;
-					PageId newRootPageId;
-					bufMgr->allocPage(file, newRootPageId, newRootPage);
-					NonLeafNodeInt* newRoot = (NonLeafNodeInt*) newRootPage;
+/**
+ * Appends rows of included columns to a new list of IncludedPage pages, one page at a time. Used by a bulk load,
+ * which allocates pages straight from the buffer manager, or writes them out past it with pageWriter.
+ */
+class IncludedRowWriter {
+public:
+	IncludedRowWriter(BufMgr* bufMgr, File* file, int rowSize, AsyncPageWriter* pageWriter = NULL)
+		: bufMgr(bufMgr), file(file), rowSize(rowSize), pageWriter(pageWriter), page(NULL), pageNo(NULL), firstPageNo(NULL) {
+		if(pageWriter != NULL) buffer.resize(Page::SIZE);
+	}
 
-					//we know this can never be just above the leaves so set level to 0
-					newRoot->level = 0;
+	void add(const char* row) {
+		if(page == NULL || (page->numRows + 1) * rowSize > INCLUDEDPAGESIZE) {
+			Page* newPage;
+			PageId newPageNo;
+			if(pageWriter != NULL) {
+				fileAllocPage(file, newPageNo);
+				newPage = (Page*) &buffer[0];
+			} else {
+				bufAllocPage(bufMgr, file, newPageNo, newPage);
+			}
 
-					//null eveything in this new page
-					newRoot->pageNoArray[nodeOccupancy] = NULL;
-					for(int i = 0; i < nodeOccupancy; i++) {
-						newRoot->keyArray[i] = INT_MAX;
-						newRoot->pageNoArray[i] = NULL;
-					}
+			//link the new page to the end of the list, which lets go of the buffer
+			if(page != NULL) {
+				page->nextPageNo = newPageNo;
+				release();
+			} else {
+				firstPageNo = newPageNo;
+			}
 
-					//the only value in the new root is the middle value passed up from the child
-					newRoot->keyArray[0] = middleInt;
+			page = (IncludedPage*) newPage;
+			pageNo = newPageNo;
+			page->numRows = 0;
+			page->nextPageNo = NULL;
+		}
+		memcpy(page->rows + page->numRows * rowSize, row, rowSize);
+		page->numRows++;
+	}
 
-					//the left child is the old root page
-					newRoot->pageNoArray[0] = rootPageNum;
+	void finish() {
+		if(page != NULL) {
+			release();
+			page = NULL;
+		}
+	}
 
-					//the right child is the one that was added by the restructure method
-					newRoot->pageNoArray[1] = addedPageId;
+	void release() {
+		if(pageWriter != NULL) pageWriter->write(pageNo, (Page*) page);
+		else bufUnPinPage(bufMgr, file, pageNo, true);
+	}
 
-					//unpin the old root page and update the class references
-					bufMgr->unPinPage(file, rootPageNum, true);
-					rootPageNum = newRootPageId;
-					rootPage = newRootPage;
+	BufMgr* bufMgr;
+	File* file;
+	int rowSize;
+	AsyncPageWriter* pageWriter;
 
-                    //update the meta info
-                    //read in the metainfo so it can be updated
-                    Page* metadataPage;
-					
-                    bufMgr->readPage(file, headerPageNum, metadataPage);
-                    IndexMetaInfo* metadata = (IndexMetaInfo*) metadataPage;
+  /**
+   * The page being filled when it goes to pageWriter.
+   */
+	std::vector<char> buffer;
+	IncludedPage* page;
+	PageId pageNo;
+	PageId firstPageNo;
+};
 
-                    metadata->rootPageNo = newRootPageId;
+// -----------------------------------------------------------------------------
+// Bulk load helpers
+// -----------------------------------------------------------------------------
 
-                    //unpin the metadataPage
-                    bufMgr->unPinPage(file, headerPageNum, true);
-				}
+/**
+ * Appends key-rid pairs, or the rids of a heap order scan, to a new run of the sort file, one page at a time
+ */
+template <class RunPage>
+class SortRunWriter {
+public:
+	SortRunWriter(BufMgr* bufMgr, File* sortFile) : bufMgr(bufMgr), sortFile(sortFile), page(NULL), pageNo(NULL), firstPageNo(NULL) {}
+
+	void add(const typename RunPage::Entry &pair) {
+		if(page == NULL || page->numEntries == RunPage::CAPACITY) {
+			Page* newPage;
+			PageId newPageNo;
+			bufAllocPage(bufMgr, sortFile, newPageNo, newPage);
+
+			//link the new page to the end of the run
+			if(page != NULL) {
+				page->nextPageNo = newPageNo;
+				bufUnPinPage(bufMgr, sortFile, pageNo, true);
+			} else {
+				firstPageNo = newPageNo;
 			}
 
-			break;
+			page = (RunPage*) newPage;
+			pageNo = newPageNo;
+			page->numEntries = 0;
+			page->nextPageNo = NULL;
 		}
-		case Datatype::DOUBLE: {
-			NonLeafNodeDouble* rootNode = (NonLeafNodeDouble*) rootPage;
-			bool restructured;
-			bool comingFromLeaf;
-			PageId newPageId;
-
-			traverseAndInsert(rootPage, rootNode->level, true, key, rid, restructured, newPageId, comingFromLeaf);
-             
-			//TODO: if the root was restructured then update the metapage!!!
-			if(restructured) {
-				if(rootNode->keyArray[nodeOccupancy - 1] == DBL_MAX) {
-                    //we have room so just put it on this page
-					insertIntoNonLeafPage(rootPage, (void*) &middleDouble, newPageId); 
-				} else {
-                    //TODO: FIXME copy from int
-				}
-			}
+		page->entries[page->numEntries++] = pair;
+	}
 
-            break;
+	void finish() {
+		if(page != NULL) {
+			bufUnPinPage(bufMgr, sortFile, pageNo, true);
+			page = NULL;
 		}
-		case Datatype::STRING: {
-            NonLeafNodeString* rootNode = (NonLeafNodeString*) rootPage;
-			bool restructured;
-			bool comingFromLeaf;
-			PageId newPageId;
+	}
 
-			traverseAndInsert(rootPage, rootNode->level, true, key, rid, restructured, newPageId, comingFromLeaf);
+	BufMgr* bufMgr;
+	File* sortFile;
+	RunPage* page;
+	PageId pageNo;
+	PageId firstPageNo;
+};
 
-			//if the root was restructured then update the metapage!!!
-			if(restructured) {
-				if(strcmp(rootNode->keyArray[nodeOccupancy - 1], "") == 0) {
-                    //we have room so just put it on this page
-					insertIntoNonLeafPage(rootPage, (void*) &middleString, newPageId);
+/**
+ * Appends key-rid pairs handed to it in sorted order to a new run of the sort file, and their rows of included
+ * columns, if they come with any, to a list of rows of the run. Both grow a page at a time, so the pages of the
+ * run and of its rows follow on one another.
+ */
+template <class T>
+struct PairRunWriter {
+	PairRunWriter(BufMgr* bufMgr, File* sortFile, int rowSize) : pairs(bufMgr, sortFile), rows(bufMgr, sortFile, rowSize) {}
 
-				} else {
+	void add(const RIDKeyPair<T> &pair, const char* row) {
+		pairs.add(pair);
+		if(row != NULL) rows.add(row);
+	}
 
-                    // TODO: change to strings!!!!!
-				}
-			}
-			break;
-		}
-		default: {};
+	void finish() {
+		pairs.finish();
+		rows.finish();
 	}
 
-}
+	SortRunWriter<SortRunPage<T> > pairs;
+	IncludedRowWriter rows;
+};
 
-// -----------------------------------------------------------------------------
-// BTreeIndex::startScan
-// -----------------------------------------------------------------------------
-const void BTreeIndex::startScan(const void* lowValParm, const Operator lowOpParm, const void* highValParm, const Operator highOpParm) {
+/**
+ * Orders the numbers of key-rid pairs like the pairs themselves
+ */
+template <class T>
+struct PairOrderLess {
+	PairOrderLess(const std::vector<RIDKeyPair<T> > &entries) : entries(entries) {}
 
-	if(scanExecuting) {
-		return;
+	bool operator()(size_t a, size_t b) const {
+		return entries[a] < entries[b];
 	}
 
-	//set the local values for this class to the values passed in
-	lowOp = lowOpParm;
-	highOp = highOpParm;
+	const std::vector<RIDKeyPair<T> > &entries;
+};
 
-	// lowOp must be either GT/GTE and highOp must be LT/LTE. BadOpCodesException is thrown if that is not the case.
-	if( !((lowOp == GT)||(lowOp == GTE)) || !((highOp == LT)||(highOp == LTE)) ) {
-		throw BadOpcodesException();
+/**
+ * Sorts key-rid pairs, and their rows of included columns, rowSize bytes each, along with them if there are any
+ */
+template <class T>
+static void sortEntries(std::vector<RIDKeyPair<T> > &entries, std::vector<char> &rows, int rowSize) {
+	if(rows.empty()) {
+		std::sort(entries.begin(), entries.end());
+		return;
 	}
 
-	//root page should already be pinned in the bufMgr
-	switch(attributeType) {
-		case INTEGER: {
-			lowValInt = *((int*) lowValParm);
-			highValInt = *((int*) highValParm);
+	std::vector<size_t> order(entries.size());
+	for(size_t i = 0; i < order.size(); i++) order[i] = i;
+	std::sort(order.begin(), order.end(), PairOrderLess<T>(entries));
 
-			// Method throws exception if lower bound > upper bound
-			if(lowValInt > highValInt) {
-				throw BadScanrangeException();
-			}
+	std::vector<RIDKeyPair<T> > sortedEntries(entries.size());
+	std::vector<char> sortedRows(rows.size());
+	for(size_t i = 0; i < order.size(); i++) {
+		sortedEntries[i] = entries[order[i]];
+		memcpy(&sortedRows[i * rowSize], &rows[order[i] * rowSize], rowSize);
+	}
+	entries.swap(sortedEntries);
+	rows.swap(sortedRows);
+}
 
-			//traverse to get to the leafPageId
-			Page* leafPage;
-			PageId leafPageId;
-			traverse(rootPage, ((NonLeafNodeInt*) rootPage)->level, lowValParm, leafPageId);
-			bufMgr->readPage(file, leafPageId, leafPage);
-			LeafNodeInt* leaf = (LeafNodeInt*) leafPage;
-            currentPageNum = leafPageId;
-
-			//find the first record then set the class variables
-			bool firstRecordFound = false;
-			while(!firstRecordFound) {
-				//loop through all the keys on the leaf
-				for(int i = 0; i < leafOccupancy; i++) {
-
-                    //for any non-NULL key, check if the value is in the range
-					if(leaf->keyArray[i] != INT_MAX && 
-						((lowOp == GT && leaf->keyArray[i] > lowValInt) || (lowOp == GTE && leaf->keyArray[i] >= lowValInt)) && 
-						((highOp == LT && leaf->keyArray[i] < highValInt) || (highOp == LTE && leaf->keyArray[i] <= highValInt))) {
-						
-                        //we have found the first value in the range so set the state variables
-                        currentPageData = leafPage;
-						currentPageNum = leafPageId;
-						nextEntry = i;
-						firstRecordFound = true;
-						break;
-					} 
-				}
+/**
+ * Adds up the leaf space taken by key-rid pairs handed to it in sorted order, every distinct key takes one entry
+ */
+template <class T>
+struct LeafWeightCounter {
+	LeafWeightCounter() : weight(0), count(0) {}
+
+	void add(const RIDKeyPair<T> &pair, const char* row) {
+		if(count == 0 || pair.key != lastKey) weight += LeafNode<T>::entryWeight(pair.key);
+		lastKey = pair.key;
+		count++;
+	}
 
-				//if the first record still hasnt been found, check the next page
-				if(!firstRecordFound) {
-					//read in the next page if you can
-					if(leaf->rightSibPageNo != NULL) {
-						PageId nextPageId = leaf->rightSibPageNo;
-						bufMgr->readPage(file, nextPageId, leafPage);
-
-						//unpin the previous one
-						bufMgr->unPinPage(file, leafPageId, false);
-						
-						//set the new pointer to the page that was just read in
-						leafPageId = nextPageId;
-						leaf = (LeafNodeInt*) leafPage;
-					} else {
-						//we've reached the end of our data and still havent found anything greater than the lowParm
-
-						//unpin the current page
-						bufMgr->unPinPage(file, leafPageId, false);
-
-						nextEntry = -1;
-						firstRecordFound = true; //just to break out of the loop
-                        throw NoSuchKeyFoundException();
-					}
-					
-				}
-			}
+	long long weight;
+	long long count;
+	T lastKey;
+};
 
-			break;
+/**
+ * Collects the IndexStatistics of the keys of every rid handed to it, in any order. The bucket bounds come from
+ * a reservoir sample of HISTOGRAMSAMPLESIZE keys, the distinct count from a HyperLogLog sketch of all of them.
+ */
+template <class T>
+class StatisticsCollector {
+public:
+	StatisticsCollector() : numRids(0), generator(HISTOGRAMSAMPLESIZE) {
+		memset(sketch, 0, SKETCHREGISTERS);
+	}
+
+	void add(const T &key) {
+		//the low bits pick the register, the trailing zeros of the rest are what it keeps the maximum of
+		unsigned long long hash = KeyTraits<T>::hash(key);
+		unsigned long long rest = hash / SKETCHREGISTERS;
+		unsigned char rank = (rest == 0) ? 64 : __builtin_ctzll(rest) + 1;
+		unsigned char &reg = sketch[hash % SKETCHREGISTERS];
+		if(rank > reg) reg = rank;
+
+		//every key seen so far is in the sample with the same chance
+		if((int) sample.size() < HISTOGRAMSAMPLESIZE) {
+			sample.push_back(key);
+		} else {
+			std::uniform_int_distribution<long long> slotDistribution(0, numRids);
+			long long slot = slotDistribution(generator);
+			if(slot < HISTOGRAMSAMPLESIZE) sample[slot] = key;
 		}
-		case DOUBLE: {
-		    lowValDouble = *((double*) lowValParm);
-			highValDouble = *((double*) highValParm);
+		numRids++;
+	}
 
-			// Method throws exception if lower bound > upper bound
-			if(lowValDouble > highValDouble) {
-				throw BadScanrangeException();
+	/**
+	 * Take in the keys added to other as if they had been added here. The merged sample draws from both, each
+	 * side in proportion to the number of keys it was taken from.
+	 */
+	void merge(StatisticsCollector<T> &other) {
+		for(int i = 0; i < SKETCHREGISTERS; i++) sketch[i] = std::max(sketch[i], other.sketch[i]);
+
+		//a full sample is not in random order, the first keys to come in stay on the first slots they took
+		std::shuffle(sample.begin(), sample.end(), generator);
+		std::shuffle(other.sample.begin(), other.sample.end(), generator);
+		std::vector<T> merged;
+		size_t a = 0;
+		size_t b = 0;
+		std::uniform_real_distribution<double> sideDistribution(0, 1);
+		double shareOfA = (double) numRids / std::max(1LL, numRids + other.numRids);
+		while((int) merged.size() < HISTOGRAMSAMPLESIZE && (a < sample.size() || b < other.sample.size())) {
+			if(b == other.sample.size() || (a < sample.size() && sideDistribution(generator) < shareOfA)) {
+				merged.push_back(sample[a++]);
+			} else {
+				merged.push_back(other.sample[b++]);
 			}
+		}
+		sample.swap(merged);
+		numRids += other.numRids;
+	}
 
-			//traverse to get to the leafPageId
-			Page* leafPage;
-			PageId leafPageId;
-			traverse(rootPage, ((NonLeafNodeDouble*) rootPage)->level, lowValParm, leafPageId);
-			bufMgr->readPage(file, leafPageId, leafPage);
-			LeafNodeDouble* leaf = (LeafNodeDouble*) leafPage;
-            currentPageNum = leafPageId;
-
-			//find the first record then set the class variables
-			bool firstRecordFound = false;
-			while(!firstRecordFound) {
-				//loop through all the keys on the leaf
-				for(int i = 0; i < leafOccupancy; i++) {
-
-                    //for any non-NULL key, check if the value is in the range
-					if(leaf->keyArray[i] != DBL_MAX && 
-						((lowOp == GT && leaf->keyArray[i] > lowValDouble) || (lowOp == GTE && leaf->keyArray[i] >= lowValDouble)) && 
-						((highOp == LT && leaf->keyArray[i] < highValDouble) || (highOp == LTE && leaf->keyArray[i] <= highValDouble))) {
-						
-                        //we have found the first key in the range so set the state variables
-						currentPageData = leafPage;
-						currentPageNum = leafPageId;
-						nextEntry = i;
-						firstRecordFound = true;
-						break;
-					} 
-				}
+	/**
+	 * The statistics of the keys added, allocated with new.
+	 */
+	IndexStatistics<T>* finish() {
+		IndexStatistics<T>* stats = new IndexStatistics<T>();
+		stats->numRids = numRids;
+		stats->distinctKeys = std::min(numRids, distinctEstimate());
+		memcpy(stats->sketch, sketch, SKETCHREGISTERS);
+
+		//bucket i takes the sample from rank i * n / numBuckets on and the same share of all rids
+		std::sort(sample.begin(), sample.end());
+		long long n = sample.size();
+		stats->numBuckets = (int) std::min((long long) histogramSize<T>(), n);
+
+		//an empty relation leaves no bounds, estimateRange then finds nothing
+		if(stats->numBuckets == 0) return stats;
+		for(int i = 0; i <= stats->numBuckets; i++) {
+			long long rank = (i == stats->numBuckets) ? n - 1 : i * n / stats->numBuckets;
+			stats->bucketBounds[i] = sample[rank];
+		}
+		for(int i = 0; i < stats->numBuckets; i++) {
+			stats->bucketCounts[i] = numRids * (i + 1) / stats->numBuckets - numRids * i / stats->numBuckets;
+		}
+		return stats;
+	}
 
-				//if the first record still hasnt been found, check the next page
-				if(!firstRecordFound) {
-					//read in the next page if you can
-					if(leaf->rightSibPageNo != NULL) {
-						PageId nextPageId = leaf->rightSibPageNo;
-						bufMgr->readPage(file, nextPageId, leafPage);
-
-						//unpin the previous one
-						bufMgr->unPinPage(file, leafPageId, false);
-						
-						//set the new pointer to the page that was just read in
-						leafPageId = nextPageId;
-						leaf = (LeafNodeDouble*) leafPage;
-					} else {
-						//we've reached the end of our data and still havent found anything greater than the lowParm
-
-						//unpin the current page
-						bufMgr->unPinPage(file, leafPageId, false);
-
-						nextEntry = -1;
-						firstRecordFound = true; //just to break out of the loop
-                        throw NoSuchKeyFoundException();
-					}
-					
-				}
-			}
-			break;
+private:
+	long long distinctEstimate() {
+		const double m = SKETCHREGISTERS;
+		double sum = 0;
+		int zeros = 0;
+		for(int i = 0; i < SKETCHREGISTERS; i++) {
+			sum += ldexp(1.0, -sketch[i]);
+			if(sketch[i] == 0) zeros++;
 		}
-		case STRING: {
-			char keyBufLow[STRINGSIZE + 1];
-            char* src = (char*)(lowValParm);
-            for(int i = 0; i < STRINGSIZE; src++, i++) keyBufLow[i] = *(src);
-            keyBufLow[STRINGSIZE] = '\0';
-            lowValString.assign(std::string(keyBufLow));
-
-			char keyBufHigh[STRINGSIZE + 1];
-            src = (char*)(highValParm);
-            for(int i = 0; i < STRINGSIZE; src++, i++) keyBufHigh[i] = *(src);
-            keyBufHigh[STRINGSIZE] = '\0';
-            highValString.assign(std::string(keyBufHigh)); 
-
-			// Method throws exception if lower bound > upper bound
-			if(strcmp(lowValString.c_str(), highValString.c_str()) > 0) {
-				throw BadScanrangeException();
-			}
+		double estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
 
-			//traverse to get to the leafPageId
-			Page* leafPage;
-			PageId leafPageId;
-			traverse(rootPage, ((NonLeafNodeString*) rootPage)->level, (void*) &lowValString, leafPageId);
-			bufMgr->readPage(file, leafPageId, leafPage);
-			LeafNodeString* leaf = (LeafNodeString*) leafPage;
-            currentPageNum = leafPageId;
-            
-
-			//find the first record then set the class variables
-			bool firstRecordFound = false;
-			while(!firstRecordFound) {
-				//loop through all the keys on the leaf
-				for(int i = 0; i < leafOccupancy; i++) {
-                    
-                    //copy the first 10 characters into a null-terminated string buffer
-                    char leafKey[STRINGSIZE + 1];
-                    src = (char*)(leaf->keyArray[i]);
-                    for(int i = 0; i < STRINGSIZE; src++, i++) leafKey[i] = *(src);
-                    leafKey[STRINGSIZE] = '\0';
-
-					if(!std::string(leaf->keyArray[i]).empty() && 
-						((lowOp == GT  && strcmp(std::string(leafKey).c_str(), lowValString.c_str())  > 0) || (lowOp == GTE  && strcmp(std::string(leafKey).c_str(), lowValString.c_str())  >= 0)) && 
-						((highOp == LT && strcmp(std::string(leafKey).c_str(), highValString.c_str()) < 0) || (highOp == LTE && strcmp(std::string(leafKey).c_str(), highValString.c_str()) <= 0))) {
-						
-                        //we have found the first record in the range so set the state variables
-                        currentPageData = leafPage;
-						currentPageNum = leafPageId;
-						nextEntry = i;
-						firstRecordFound = true;
-						break;
-					} 
-				}
+		//few keys leave registers empty, their share counts them better
+		if(estimate <= 2.5 * m && zeros > 0) estimate = m * log(m / zeros);
+		return (long long) (estimate + 0.5);
+	}
 
-				//if the first record still hasnt been found, check the next page
-				if(!firstRecordFound) {
-					//read in the next page if you can
-					if(leaf->rightSibPageNo != NULL) {
-						PageId nextPageId = leaf->rightSibPageNo;
-						bufMgr->readPage(file, nextPageId, leafPage);
-
-						//unpin the previous one
-						bufMgr->unPinPage(file, leafPageId, false);
-						
-						//set the new pointer to the page that was just read in
-						leafPageId = nextPageId;
-						leaf = (LeafNodeString*) leafPage;
-					} else {
-						//we've reached the end of our data and still havent found anything greater than the lowParm
-
-						//unpin the current page
-						bufMgr->unPinPage(file, leafPageId, false);
-
-						nextEntry = -1;
-						firstRecordFound = true; //just to break out of the loop
-                        throw NoSuchKeyFoundException();
-					}
-				}
-			}
+	long long numRids;
+	std::vector<T> sample;
+	std::mt19937_64 generator;
+	unsigned char sketch[SKETCHREGISTERS];
+};
 
-			break;
-		}
-		default: { break; }
-	
+/**
+ * Fills leaves left to right with key-rid pairs handed to it in sorted order. The entries are spread evenly,
+ * by the space they take, over as many leaves as the fill factor asks for.
+ * The leaves are allocated in chain order, so the rightSibPageNo chain is physically contiguous apart from the
+ * posting list pages of keys with more than one rid, which are allocated as their rids come in, and the rows of
+ * included columns of each leaf.
+ * The entries of a leaf are collected until the first key of the next one comes in, which gives the separator
+ * between them, and only then written out, followed by their rows.
+ */
+template <class T>
+class LeafPacker {
+public:
+	LeafPacker(BufMgr* bufMgr, File* file, AsyncPageWriter* pageWriter, long long totalWeight, long long weightPerLeaf, int rowSize, std::vector<PageKeyPair<T> > &leaves)
+		: bufMgr(bufMgr), file(file), pageWriter(pageWriter), totalWeight(totalWeight), rowSize(rowSize), leaves(leaves),
+		  leaf(NULL), leafPageId(NULL), posting(NULL), postingPageNo(NULL),
+		  currentLeaf(-1), weightAdded(0), entriesAdded(0) {
+		numLeaves = std::max(1LL, (totalWeight + weightPerLeaf - 1) / weightPerLeaf);
+		if(pageWriter != NULL) leafBuffer.resize(Page::SIZE);
 	}
 
+	void add(const RIDKeyPair<T> &pair, const char* row) {
+		//more rids of the same key go to its posting list
+		if(entriesAdded > 0 && pair.key == lastKey) {
+			addToPosting(pair.rid);
+			addRow(row);
+			leaves.back().count++;
+			return;
+		}
+		finishPosting();
+
+		//move on once this leaf has its share, a key on its own is never too much for a leaf
+		int weight = LeafNode<T>::entryWeight(pair.key);
+		if(leaf == NULL) {
+			nextLeaf(pair.key);
+		} else if(!entries.empty() && currentLeaf < numLeaves - 1 && weightAdded + weight > leafBoundary(currentLeaf)) {
+			nextLeaf(KeyTraits<T>::separator(lastKey, pair.key));
+		}
 
-	//after we know everything is good to go, then set scanExecuting = true
-	scanExecuting = true;
-}
+		entries.push_back(pair);
+		addRow(row);
+		leaves.back().count++;
+		weightAdded += weight;
+		lastKey = pair.key;
+		entriesAdded++;
+	}
 
-// -----------------------------------------------------------------------------
-// BTreeIndex::scanNext
-// -----------------------------------------------------------------------------
-const void BTreeIndex::scanNext(RecordId& outRid) 
-{
-	if(!scanExecuting) throw ScanNotInitializedException();
+	void finish() {
+		finishPosting();
 
-    //if next entry was set to -1 in the previous scan next (or start scan) then we are done scanning so throw the exception
-	if(nextEntry == -1) throw  IndexScanCompletedException();
+		//an empty relation still gets its one leaf
+		if(leaf == NULL) nextLeaf(KeyTraits<T>::nullKey());
+		writeLeaf(NULL);
+	}
 
-	//current page should already be read in and referenced
-	switch(attributeType) {
-		case INTEGER: {
-			LeafNodeInt* leaf = (LeafNodeInt*) currentPageData;
-			outRid = leaf->ridArray[nextEntry];
-
-			if(nextEntry == leafOccupancy - 1 || leaf->keyArray[nextEntry+1] == INT_MAX) {
-				//bring in the next page if we can 
-				if(leaf->rightSibPageNo != NULL) {
-					Page* nextPage;
-					PageId newPageId = leaf->rightSibPageNo;
-					bufMgr->readPage(file, newPageId, nextPage);
-
-					//unpin the previous page
-					bufMgr->unPinPage(file, currentPageNum, false);
-					currentPageData = nextPage;
-					currentPageNum = newPageId;
-
-					leaf = (LeafNodeInt*) nextPage;
-                
-                    //check if the next value on the new page is still within the criteria for the scan
-					if((highOp == LT && leaf->keyArray[0] < highValInt) || (highOp == LTE && leaf->keyArray[0] <= highValInt)) {
-						nextEntry = 0;
-					} else {
-						nextEntry = -1;
-					}
-				} else {
-                    //if there is no next page then set nextEntry to -1
-					nextEntry = -1;
-				}
-				
-			} else {
-                //normal operation, just see if the next entry matches the scan criteria
-				if((highOp == LT && leaf->keyArray[nextEntry+1] < highValInt) || (highOp == LTE && leaf->keyArray[nextEntry+1] <= highValInt)) {
-					nextEntry++;
-				} else {
-					nextEntry = -1;
-				}
-			}
+private:
+	long long leafBoundary(int leafNum) {
+		return totalWeight * (leafNum + 1) / numLeaves;
+	}
 
-			break;
+	/**
+	 * Start a new leaf whose low key, the separator in the parent, is given. The previous leaf ends below it.
+	 */
+	void nextLeaf(const T &separator) {
+		Page* newPage;
+		PageId newPageId;
+		if(pageWriter != NULL) {
+			fileAllocPage(file, newPageId);
+			newPage = (Page*) &leafBuffer[0];
+		} else {
+			bufAllocPage(bufMgr, file, newPageId, newPage);
 		}
-		case DOUBLE: {
-			LeafNodeDouble* leaf = (LeafNodeDouble*) currentPageData;
-			outRid = leaf->ridArray[nextEntry];
-
-			if(nextEntry == leafOccupancy - 1 || leaf->keyArray[nextEntry+1] == DBL_MAX) {
-				//bring in the next page if we can
-				if(leaf->rightSibPageNo != NULL) {
-					Page* nextPage;
-					PageId newPageId = leaf->rightSibPageNo;
-					bufMgr->readPage(file, newPageId, nextPage);
-
-					//unpin the previous page
-					bufMgr->unPinPage(file, currentPageNum, false);
-					currentPageData = nextPage;
-					currentPageNum = newPageId;
-
-					leaf = (LeafNodeDouble*) nextPage;
-
-                    //check if the next value on the new page is still within the criteria for the scan
-					if((highOp == LT && leaf->keyArray[0] < highValDouble) || (highOp == LTE && leaf->keyArray[0] <= highValDouble)) {
-						nextEntry = 0;
-					} else {
-						nextEntry = -1;
-					}
-				} else {
-                    //if there is no next page then set nextEntry to -1 
-					nextEntry = -1;
-				}
-				
-			} else {
-                //normal operation, just see if the next entry matches the scan criteria
-				if((highOp == LT && leaf->keyArray[nextEntry+1] < highValDouble) || (highOp == LTE && leaf->keyArray[nextEntry+1] <= highValDouble)) {
-					nextEntry++;
-				} else {
-					nextEntry = -1;
-				}
-			}
-		
-			break;
-		} 
-		case STRING: { 
-		    LeafNodeString* leaf = (LeafNodeString*) currentPageData;
-			outRid = leaf->ridArray[nextEntry];
-
-			if(nextEntry == leafOccupancy - 1 || strcmp(leaf->keyArray[nextEntry+1], "") == 0) {
-				//bring in the next page if we can
-				if(leaf->rightSibPageNo != NULL) {
-					Page* nextPage;
-					PageId newPageId = leaf->rightSibPageNo;
-					bufMgr->readPage(file, newPageId, nextPage);
-
-					//unpin the previous page
-					bufMgr->unPinPage(file, currentPageNum, false);
-					currentPageData = nextPage;
-					currentPageNum = newPageId;
-
-					leaf = (LeafNodeString*) nextPage;
-
-                    char leafKey[STRINGSIZE + 1];
-                    char* src = (char*)(leaf->keyArray[0]);
-                    for(int i = 0; i < STRINGSIZE; src++, i++) leafKey[i] = *(src);
-                    leafKey[STRINGSIZE] = '\0';
-
-                    //check if the next value on the new page is still within the criteria for the scan
-					if((highOp == LT && strcmp(std::string(leafKey).c_str(), highValString.c_str()) < 0) || (highOp == LTE && strcmp(std::string(leafKey).c_str(), highValString.c_str()) <= 0)) {
-						nextEntry = 0;
-					} else {
-						nextEntry = -1;
-					}
-				} else {
-                    //if there is no next page then set nextEntry to -1 
-					nextEntry = -1;
-				}
-				
-			} else {
-                char leafKey[STRINGSIZE + 1];
-                char* src = (char*)(leaf->keyArray[nextEntry + 1]);
-                for(int i = 0; i < STRINGSIZE; src++, i++) leafKey[i] = *(src);
-                leafKey[STRINGSIZE] = '\0';
-
-                //normal operation, just see if the next entry matches the scan criteria
-				if((highOp == LT && strcmp(std::string(leafKey).c_str(), highValString.c_str()) < 0) || (highOp == LTE && strcmp(std::string(leafKey).c_str(), highValString.c_str()) <= 0)) {
-					nextEntry++;
-				} else {
-					nextEntry = -1;
-				}
-			}
-			break;
+
+		//the previous leaf is written first, it may be in the same buffer
+		if(leaf != NULL) {
+			leaf->rightSibPageNo = newPageId;
+			writeLeaf(&separator);
 		}
-		default: { break; }
-	}
-}
+		LeafNode<T>* newLeaf = (LeafNode<T>*) newPage;
+		newLeaf->init();
+		newLeaf->leftSibPageNo = leafPageId;
 
-// -----------------------------------------------------------------------------
-// BTreeIndex::endScan
-// -----------------------------------------------------------------------------
-const void BTreeIndex::endScan() 
-{
-	// Method terminates the current scan and  throws a ScanNotInitializedException if invoked before a succesful startScan call
-	if(!scanExecuting){
-		throw ScanNotInitializedException();
+		leaf = newLeaf;
+		leafPageId = newPageId;
+		currentLeaf++;
+
+		PageKeyPair<T> leafSeparator;
+		leafSeparator.set(newPageId, separator, 0);
+		leaves.push_back(leafSeparator);
 	}
-	scanExecuting = false;
 
-	// Unpinning all the pages that have been pinned for the purpose of scan
-	//try {
-		bufMgr->unPinPage(file, currentPageNum, false);
-	//} catch(const PageNotPinnedException &e) {
-	//	std::cout << "PageNotPinned thrown in endScan()\n";
-	//}
-	// TODO: Should the dirty bit be set to false irrespective of whether the page is actually dirty or not?
-	// TODO: Check if the currentPage is the only page pinned for the purpose of the scan 
-}
+	/**
+	 * Put the collected entries on the current leaf and release it
+	 */
+	void writeLeaf(const T* highKey) {
+		const T* lowKey = currentLeaf > 0 ? &leaves.back().key : NULL;
+		leaf->build(lowKey, highKey, entries.data(), entries.size());
+
+		//the rows came in key order, the leaf keeps them in rid order
+		if(!rows.empty()) {
+			sortIncludedRows(rows, rowSize);
+			IncludedRowWriter writer(bufMgr, file, rowSize, pageWriter);
+			for(size_t i = 0; i < rows.size(); i += rowSize) writer.add(&rows[i]);
+			writer.finish();
+			leaf->includedPageNo = writer.firstPageNo;
+			rows.clear();
+		}
+		if(pageWriter != NULL) pageWriter->write(leafPageId, (Page*) leaf);
+		else bufUnPinPage(bufMgr, file, leafPageId, true);
+		leaf = NULL;
+		entries.clear();
+	}
 
+	void addRow(const char* row) {
+		if(row != NULL) rows.insert(rows.end(), row, row + rowSize);
+	}
 
-// -----------------------------------------------------------------------------
-// BTreeIndex::insertIntoNonLeafPage
-// -----------------------------------------------------------------------------
-const void BTreeIndex::insertIntoNonLeafPage(Page* page, const void* keyPtr, PageId pageId) {
-	switch(attributeType) {
-		case INTEGER: {
-			NonLeafNodeInt* node = (NonLeafNodeInt*) page;
-			int key = *((int*) keyPtr);
-
-            //find where the key would go and move all the entries over from that point until the end
-			for(int i = 0; i < nodeOccupancy; i++) {
-				if(node->keyArray[i] == INT_MAX) {
-					node->keyArray[i] = key;
-					node->pageNoArray[i+1] = pageId;
-					break;
-				} else if(key < node->keyArray[i]) {
-					//move everything over to the right
-					for(int j = nodeOccupancy - 1; j > i; j--) {
-						node->keyArray[j] = node->keyArray[j-1];
-						node->pageNoArray[j+1] = node->pageNoArray[j];
-					}
-					node->keyArray[i] = key;
-					node->pageNoArray[i+1] = pageId;
-					break;
-				}
-			}
-			break;
+	void addToPosting(const RecordId &rid) {
+		RecordId &entryRid = entries.back().rid;
+		if(posting != NULL && posting->numRids < POSTINGPAGESIZE) {
+			posting->ridArray[posting->numRids++] = rid;
+			return;
 		}
-		case DOUBLE: {
-			NonLeafNodeDouble* node = (NonLeafNodeDouble*) page;
-			double key = *((double*) keyPtr);
-
-            //find where the key would go and move all the entries over from that point until the end
-			for(int i = 0; i < nodeOccupancy; i++) {
-				if(node->keyArray[i] == DBL_MAX) {
-					node->keyArray[i] = key;
-					node->pageNoArray[i+1] = pageId;
-					break;
-				} else if(key < node->keyArray[i]) {
-					//move everything over to the right
-					for(int j = nodeOccupancy - 1; j > i; j--) { // CHANGED TO j>i 
-						node->keyArray[j] = node->keyArray[j-1];
-						node->pageNoArray[j+1] = node->pageNoArray[j];
-					}
-					node->keyArray[i] = key;
-					node->pageNoArray[i+1] = pageId;
-					break;
-				}
-			}
-			break;
+
+		Page* newPage;
+		PageId newPageNo;
+		bufAllocPage(bufMgr, file, newPageNo, newPage);
+		PostingPage* newPosting = (PostingPage*) newPage;
+		newPosting->nextPageNo = NULL;
+		newPosting->numRids = 0;
+
+		if(posting == NULL) {
+			//the rid already on the leaf is the first one of the list
+			newPosting->ridArray[newPosting->numRids++] = entryRid;
+			entryRid.page_number = newPageNo;
+			entryRid.slot_number = POSTINGSLOT;
+		} else {
+			posting->nextPageNo = newPageNo;
+			bufUnPinPage(bufMgr, file, postingPageNo, true);
 		}
-		case STRING: {
-			NonLeafNodeString* node = (NonLeafNodeString*) page;
-			std::string key = *((std::string*) keyPtr);
-        
-            //find where the key would go and move all the entries over from that point until the end
-			for(int i = 0; i < nodeOccupancy; i++) {
-				if(strcmp(node->keyArray[i], "") == 0) {
-					strncpy(node->keyArray[i], key.c_str(), STRINGSIZE);
-					node->pageNoArray[i+1] = pageId;
-					break;
-				} else if(strcmp(key.c_str(), node->keyArray[i]) < 0) {
-					//move everything over to the right
-					for(int j = nodeOccupancy - 1; j > i; j--) {
-						strncpy(node->keyArray[j], node->keyArray[j-1], STRINGSIZE);
-						node->pageNoArray[j+1] = node->pageNoArray[j];
-					}
-					strncpy(node->keyArray[i], key.c_str(), STRINGSIZE);
-					node->pageNoArray[i+1] = pageId;
-					break;
-				}
-			}
-			break;
+		newPosting->ridArray[newPosting->numRids++] = rid;
+		posting = newPosting;
+		postingPageNo = newPageNo;
+	}
+
+	void finishPosting() {
+		if(posting != NULL) {
+			bufUnPinPage(bufMgr, file, postingPageNo, true);
+			posting = NULL;
 		}
-		default: {break; }
 	}
-}
 
-// -----------------------------------------------------------------------------
-// BTreeIndex::restructure
-// -----------------------------------------------------------------------------
-const void BTreeIndex::restructure(Page* fullPage, bool isLeaf, const void* keyPtr, PageId newPageIdFromChild, PageId &newPageId) {
-	switch(attributeType) {
-		case INTEGER: {
-			if(isLeaf) {
-				//cast the fullPage to a leaf
-				LeafNodeInt* fullLeaf = (LeafNodeInt*) fullPage;
-
-				//create a new page
-				Page* newLeafPage;
-				bufMgr->allocPage(file, newPageId, newLeafPage);
-				LeafNodeInt* newLeaf = (LeafNodeInt*) newLeafPage;
-
-				//NULL everything in the new page
-				for(int i = 0; i < leafOccupancy; i++) {
-					newLeaf->keyArray[i] = INT_MAX;
-					//not NULLing the rids here because we just assume if the key is NULL then so is the associated rid so don't access it
-				}
+	BufMgr* bufMgr;
+	File* file;
+	AsyncPageWriter* pageWriter;
+
+  /**
+   * The leaf being filled when it goes to pageWriter.
+   */
+	std::vector<char> leafBuffer;
+	long long totalWeight;
+	long long numLeaves;
+	int rowSize;
+	std::vector<PageKeyPair<T> > &leaves;
+	std::vector<RIDKeyPair<T> > entries;
+
+  /**
+   * Rows of included columns of the rids of the current leaf, posting lists included.
+   */
+	std::vector<char> rows;
+	LeafNode<T>* leaf;
+	PageId leafPageId;
+	PostingPage* posting;
+	PageId postingPageNo;
+	int currentLeaf;
+	long long weightAdded;
+	long long entriesAdded;
+	T lastKey;
+};
 
-				//get the middle value and index from the page
-				int middleIndex;
-				findMiddleValue(fullPage, true, keyPtr, middleIndex);
+/**
+ * Orders the heads of the runs being merged so the smallest pair is on top of the priority queue
+ */
+template <class T>
+struct SortRunHeadGreater {
+	bool operator()(const std::pair<RIDKeyPair<T>, int> &a, const std::pair<RIDKeyPair<T>, int> &b) const {
+		return b.first < a.first;
+	}
+};
 
-				//copy all the keys and rids over from middleIndex
-				for(int i = middleIndex; i < leafOccupancy; i++) {
-					newLeaf->keyArray[i-middleIndex] = fullLeaf->keyArray[i];
-					fullLeaf->keyArray[i] = INT_MAX;
-					newLeaf->ridArray[i-middleIndex] = fullLeaf->ridArray[i];
-					//not NULLing rids here again, just check if corresponding key is null to see if the data is valid
-				}
+/**
+ * Start reading the BULKLOADPREFETCHPAGES pages after pageNo, short of endPageNo, unless they already were.
+ * A run is written out before the next one starts, so its pages follow on one another in the sort file
+ */
+static void prefetchSortRun(AsyncPageReader* reader, PageId pageNo, PageId endPageNo, PageId &prefetchedTo) {
+	if(reader == NULL || pageNo < prefetchedTo) return;
+
+	PageId pageNos[BULKLOADPREFETCHPAGES];
+	int count = 0;
+	while(count < BULKLOADPREFETCHPAGES && pageNo + 1 + count < endPageNo) {
+		pageNos[count] = pageNo + 1 + count;
+		count++;
+	}
+	if(count > 0) reader->prefetch(pageNos, count);
+	prefetchedTo = pageNo + count;
+}
+
+/**
+ * Create the temporary sort file of a bulk load
+ */
+static File* createSortFile(const std::string &sortFileName) {
+	//left over from a build that did not finish, nothing in it is needed
+	try {
+		return new BlobFile(sortFileName, true);
+	} catch(const FileExistsException &e) {
+		File::remove(sortFileName);
+		return new BlobFile(sortFileName, true);
+	}
+}
 
-				newLeaf->rightSibPageNo = fullLeaf->rightSibPageNo;
-				fullLeaf->rightSibPageNo = newPageId;
+/**
+ * What the threads of the relation scan of a bulk load share. Every thread has a buffer of key-rid pairs and
+ * statistics of its own, the rest is guarded by the latches.
+ */
+template <class T>
+struct ParallelScanState {
+	ParallelScanState(int numThreads) : entries(numThreads), rows(numThreads), collectors(numThreads), errors(numThreads), sortFile(NULL) {}
+
+	File* relationFile;
+
+  /**
+   * Next relation page along its chain that no thread has taken yet, Page::INVALID_NUMBER once all have been.
+   */
+	PageId nextPageNo;
+
+  /**
+   * Guards nextPageNo. Held while the pages are pinned so that each thread gets the next ones along the chain.
+   */
+	std::mutex pageLatch;
+
+  /**
+   * Number of pairs a thread buffers before it writes them out as a sorted run.
+   */
+	int runCapacity;
+
+	std::vector<std::vector<RIDKeyPair<T> > > entries;
+
+  /**
+   * Rows of included columns of the pairs of each thread, one for one, if the index has them.
+   */
+	std::vector<std::vector<char> > rows;
+	std::vector<StatisticsCollector<T> > collectors;
+
+  /**
+   * What each thread threw, if it did.
+   */
+	std::vector<std::exception_ptr> errors;
+
+  /**
+   * Guards sortFile and runFirstPage. Held while a run is written so that its pages follow on one another.
+   */
+	std::mutex runLatch;
+
+	std::string sortFileName;
+	File* sortFile;
+	std::vector<PageId> runFirstPage;
+	std::vector<PageId> runFirstRowPage;
+};
 
-				//unpin the page that was created
-				bufMgr->unPinPage(file, newPageId, true);
-			} else {
-				//cast the fullPage to a nonleaf
-				NonLeafNodeInt* fullNode = (NonLeafNodeInt*) fullPage;
-
-				//create a new page
-				Page* newNodePage;
-				bufMgr->allocPage(file, newPageId, newNodePage);
-				NonLeafNodeInt* newNode = (NonLeafNodeInt*) newNodePage;
-
-				//NULL everything in the new page 
-				newNode->pageNoArray[nodeOccupancy] = NULL;
-				for(int i = 0; i < nodeOccupancy; i++) {
-					newNode->keyArray[i] = INT_MAX;
-					newNode->pageNoArray[i] = NULL;
-				}
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::TypedBTreeIndex -- Constructor
+// -----------------------------------------------------------------------------
+template <class T>
+TypedBTreeIndex<T>::TypedBTreeIndex(const std::string & relationName, const std::string & indexName, BufMgr *bufMgrIn, const int attrByteOffset, const BuildMethod buildMethod, const double fillFactor, const ConcurrencyMode concurrencyMode, const DeleteMode deleteMode, const int residentLevels, const OpenMode openMode, const CountMode countMode, const int buildThreads, const int includedOffset, const int includedLength) {
+	//set values of the private variables
+	this->bufMgr = bufMgrIn;
+	mappedFile = NULL;
+	mappedSize = 0;
+	log = NULL;
+	this->attrByteOffset = attrByteOffset;
+	this->includedOffset = includedOffset;
+	this->includedLength = includedLength;
+	this->concurrencyMode = concurrencyMode;
+	this->deleteMode = deleteMode;
+	this->residentLevels = residentLevels;
+	mergeCount.store(0);
+	scan = NULL;
+	statistics = NULL;
+	readAheadLeaves = 0;
+	readAheadStop = false;
+	readAheadStats.hits = 0;
+	readAheadStats.misses = 0;
+	spillFileName = indexName + ".rids";
+	spillCount.store(0);
+	headerPageNum = 1;
 
-				//get the middle value and index from the page
-				int middleIndex;
-				findMiddleValue(fullPage, false, keyPtr, middleIndex);
+	//a full page of rows splits in two, so it has to hold at least two of them
+	if(includedLength < 0 || INCLUDEDPAGESIZE / includedRowSize() < 2) throw BadIndexInfoException("Included columns do not fit on a page");
 
-				//if the keyPtr we are trying to insert is the middle one the some special stuff happens
-				if(*((int*) keyPtr) == middleInt) {
-					newNode->pageNoArray[0] = newPageIdFromChild;
+	if(openMode == READ_ONLY_MAPPED) {
+		file = NULL;
+		openMapped(relationName, indexName);
+		return;
+	}
 
-					for(int i = middleIndex + 1; i < nodeOccupancy; i++) {
-						newNode->keyArray[i-middleIndex-1] = fullNode->keyArray[i];
-						fullNode->keyArray[i] = INT_MAX;
-						newNode->pageNoArray[i-middleIndex] = fullNode->pageNoArray[i+1];
-					}
-				} else {
-					for(int i = middleIndex + 1; i < nodeOccupancy; i++) {
-						newNode->keyArray[i-middleIndex-1] = fullNode->keyArray[i];
-						fullNode->keyArray[i] = INT_MAX;
-						newNode->pageNoArray[i-middleIndex-1] = fullNode->pageNoArray[i];
-					}
-					newNode->pageNoArray[nodeOccupancy-middleIndex-1] = fullNode->pageNoArray[nodeOccupancy];
-				}
+    //Pointers to rootPage and metadata information
+	Page* metadataPage;
+	IndexMetaInfo* metadata;
+	BlobFile* bFile;
 
-				//unpin the page that was created
-				bufMgr->unPinPage(file, newPageId, true);
-			}
-			break;
-		}
-		case DOUBLE: {
-		    if(isLeaf) {
-				//cast the fullPage to a leaf
-				LeafNodeDouble* fullLeaf = (LeafNodeDouble*) fullPage;
-
-				//create a new page
-				Page* newLeafPage;
-				bufMgr->allocPage(file, newPageId, newLeafPage);
-				LeafNodeDouble* newLeaf = (LeafNodeDouble*) newLeafPage;
-
-				//NULL everything in the new page
-				for(int i = 0; i < leafOccupancy; i++) {
-					newLeaf->keyArray[i] = DBL_MAX;
-					//not NULLing the rids here because we just assume if the key is NULL then so is the associated rid so don't access it
-				}
+	//check if that file exists by creating a new one and having it throw an exception
+    try {
+		bFile = new BlobFile(indexName, true/*try to create a new one*/);
+	} catch(const FileExistsException &e) {
+		//it already exists so just read it and cast it
+		bFile = new BlobFile(indexName, false);
+		file = (File*) bFile;
 
-				//get the middle value and index from the page
-				int middleIndex;
-				findMiddleValue(fullPage, true, keyPtr, middleIndex);
+		//read the first page which contains metadata information
+		readPage(headerPageNum, metadataPage);
+		metadata = (IndexMetaInfo*) metadataPage;
 
-				//copy all the keys and rids over from middleIndex
-				for(int i = middleIndex; i < leafOccupancy; i++) {
-					newLeaf->keyArray[i-middleIndex] = fullLeaf->keyArray[i];
-					fullLeaf->keyArray[i] = DBL_MAX;
-					newLeaf->ridArray[i-middleIndex] = fullLeaf->ridArray[i];
-					//not NULLing rids here again, just check if corresponding key is null to see if the data is valid
-				}
+		//make sure the metadata matches whats passed in if the file already exists
+		checkMetaInfo(metadata, relationName);
+		unPinPage(headerPageNum, false);
 
-				newLeaf->rightSibPageNo = fullLeaf->rightSibPageNo;
-				fullLeaf->rightSibPageNo = newPageId;
+		//a log left behind by a crash goes onto the file before the root is looked up
+		openLog(indexName, openMode, false);
+		readPage(headerPageNum, metadataPage);
+		metadata = (IndexMetaInfo*) metadataPage;
 
-				//unpin the page that was created
-				bufMgr->unPinPage(file, newPageId, true);
-			} else {
-				//cast the fullPage to a nonleaf
-				NonLeafNodeDouble* fullNode = (NonLeafNodeDouble*) fullPage;
-
-				//create a new page
-				Page* newNodePage;
-				bufMgr->allocPage(file, newPageId, newNodePage);
-				NonLeafNodeDouble* newNode = (NonLeafNodeDouble*) newNodePage;
-
-				//NULL everything in the new page 
-				newNode->pageNoArray[nodeOccupancy] = NULL;
-				for(int i = 0; i < nodeOccupancy; i++) {
-					newNode->keyArray[i] = DBL_MAX;
-					newNode->pageNoArray[i] = NULL;
-				}
+		//set the root page for this index
+		rootPageNum = metadata->rootPageNo;
+		freePageNo = metadata->freePageNo;
+		setCounted(metadata->counted);
+		PageId statisticsPageNo = metadata->statisticsPageNo;
 
-				//get the middle value and index from the page
-				int middleIndex;
-				findMiddleValue(fullPage, false, keyPtr, middleIndex);
+		//we dont need the header information anymore and we didnt change anything on that page
+		unPinPage(headerPageNum, false);
+		readStatistics(statisticsPageNo);
 
-				//if the keyPtr we are trying to insert is the middle one the some special stuff happens
-				if(*((double*) keyPtr) == middleDouble) {
-					newNode->pageNoArray[0] = newPageIdFromChild;
+		//we are going to keep the rootPage in memory
+		readPage(rootPageNum, rootPage);
 
-					for(int i = middleIndex + 1; i < nodeOccupancy; i++) {
-						newNode->keyArray[i-middleIndex-1] = fullNode->keyArray[i];
-						fullNode->keyArray[i] = DBL_MAX;
-						newNode->pageNoArray[i-middleIndex] = fullNode->pageNoArray[i+1];
-					}
-				} else {
-					for(int i = middleIndex + 1; i < nodeOccupancy; i++) {
-						newNode->keyArray[i-middleIndex-1] = fullNode->keyArray[i];
-						fullNode->keyArray[i] = DBL_MAX;
-						newNode->pageNoArray[i-middleIndex-1] = fullNode->pageNoArray[i];
-					}
-					newNode->pageNoArray[nodeOccupancy-middleIndex+1] = fullNode->pageNoArray[nodeOccupancy];
-				}
+		return;
+	}
 
-				//unpin the page that was created
-				bufMgr->unPinPage(file, newPageId, true);
-			}
-		
-			break;
-		}
-		case STRING: {
-			if(isLeaf) {
-				//cast the fullPage to a leaf
-				LeafNodeString* fullLeaf = (LeafNodeString*) fullPage;
-
-				//create a new page
-				Page* newLeafPage;
-				bufMgr->allocPage(file, newPageId, newLeafPage);
-				LeafNodeString* newLeaf = (LeafNodeString*) newLeafPage;
-
-				//NULL everything in the new page
-				for(int i = 0; i < leafOccupancy; i++) {
-					strncpy(newLeaf->keyArray[i], "", STRINGSIZE);
-					//not NULLing the rids here because we just assume if the key is NULL then so is the associated rid so don't access it
-				}
+	//if the code reaches here then the file didnt exist but we created one
+	file = (File*) bFile;
 
-				//get the middle value and index from the page
-				int middleIndex;
-				findMiddleValue(fullPage, true, keyPtr, middleIndex);
+	//make a metadata Page for this new index, should be the first page
+	PageId metadataPageId;
+	bufAllocPage(bufMgr, file, metadataPageId, metadataPage);
+	headerPageNum = metadataPageId; //just in case it isnt 1 and we need to get at it later save where it is
+	metadata = (IndexMetaInfo*) metadataPage;
 
-				//copy all the keys and rids over from middleIndex
-				for(int i = middleIndex; i < leafOccupancy; i++) {
-					strncpy(newLeaf->keyArray[i-middleIndex], fullLeaf->keyArray[i], STRINGSIZE);
-					strncpy(fullLeaf->keyArray[i], "", STRINGSIZE);
-					newLeaf->ridArray[i-middleIndex] = fullLeaf->ridArray[i];
-					//not NULLing rids here again, just check if corresponding key is null to see if the data is valid
-				}
+	//set variables in the metadata page
+	strncpy(metadata->relationName, relationName.c_str(), 20);
+	metadata->attrType = KeyTraits<T>::TYPE;
+	metadata->attrByteOffset = attrByteOffset;
+	metadata->freePageNo = NULL;
+	freePageNo = NULL;
+	metadata->counted = countMode == SUBTREE_COUNTS;
+	setCounted(metadata->counted);
+	metadata->statisticsPageNo = NULL;
+	metadata->includedOffset = includedOffset;
+	metadata->includedLength = includedLength;
+
+	//a bulk load allocates the leaves first and the root last, so it fills in the root page number itself
+	if(buildMethod == BULK_LOAD) {
+		unPinPage(metadataPageId, true);
+		bulkLoad(relationName, indexName, fillFactor, buildThreads);
+		openLog(indexName, openMode, true);
+		return;
+	}
 
-				newLeaf->rightSibPageNo = fullLeaf->rightSibPageNo;
-				fullLeaf->rightSibPageNo = newPageId;
+	//create a new root page
+	bufAllocPage(bufMgr, file, rootPageNum, rootPage);
+	metadata->rootPageNo = rootPageNum;
 
-				//unpin the page that was created
-				bufMgr->unPinPage(file, newPageId, true);
-			} else {
-				//cast the fullPage to a nonleaf
-				NonLeafNodeString* fullNode = (NonLeafNodeString*) fullPage;
-
-				//create a new page
-				Page* newNodePage;
-				bufMgr->allocPage(file, newPageId, newNodePage);
-				NonLeafNodeString* newNode = (NonLeafNodeString*) newNodePage;
-
-				//NULL everything in the new page 
-				newNode->pageNoArray[nodeOccupancy] = NULL;
-				for(int i = 0; i < nodeOccupancy; i++) {
-					strncpy(newNode->keyArray[i], "", STRINGSIZE);
-					newNode->pageNoArray[i] = NULL;
-				}
+	//now we can unpin the metaPage. Its dirty and needs to be written to disk
+	unPinPage(metadataPageId, true);
 
-				//get the middle value and index from the page
-				int middleIndex;
-				findMiddleValue(fullPage, false, keyPtr, middleIndex);
+	//the rootPage will become a non-leaf node just above the leaves
+	NonLeafNode<T>* rootNode = (NonLeafNode<T>*) rootPage;
+	rootNode->init(1);
 
-				//if the keyPtr we are trying to insert is the middle one the some special stuff happens
-				if(strcmp((*((std::string*) keyPtr)).c_str(), middleString.c_str()) == 0) {
-					newNode->pageNoArray[0] = newPageIdFromChild;
+	//with no keys yet, everything goes into its one empty leaf until that splits
+	Page* leafPage;
+	PageId leafPageId;
+	bufAllocPage(bufMgr, file, leafPageId, leafPage);
+	((LeafNode<T>*) leafPage)->init();
+	rootNode->childAt(0) = leafPageId;
 
-					for(int i = middleIndex + 1; i < nodeOccupancy; i++) {
-						strncpy(newNode->keyArray[i-middleIndex-1], fullNode->keyArray[i], STRINGSIZE);
-						strncpy(fullNode->keyArray[i], "", STRINGSIZE);
-						newNode->pageNoArray[i-middleIndex] = fullNode->pageNoArray[i+1];
-					}
-				} else {
-					for(int i = middleIndex + 1; i < nodeOccupancy; i++) {
-						strncpy(newNode->keyArray[i-middleIndex-1], fullNode->keyArray[i], STRINGSIZE);
-						strncpy(fullNode->keyArray[i], "", STRINGSIZE);
-						newNode->pageNoArray[i-middleIndex-1] = fullNode->pageNoArray[i];
-					}
-					newNode->pageNoArray[nodeOccupancy-middleIndex-1] = fullNode->pageNoArray[nodeOccupancy];
-				}
+	//unpin the new leaf page. its dirty
+	unPinPage(leafPageId, true);
 
-				//unpin the page that was created
-				bufMgr->unPinPage(file, newPageId, true);
-			}
-			break;
+	//insert records from this relation into the tree
+	//Create a file scanner for this relaion and buffer manager
+	FileScan* fileScan = new FileScan(relationName, bufMgr);
+	RecordId rid;
+	std::string record;
+	StatisticsCollector<T> collector;
+	try {
+		//when we reach the end of this file, an exception will be thrown so we will exit then
+		while(true) {
+			fileScan->scanNext(rid);
+			record = fileScan->getRecord();
+			T key = KeyTraits<T>::fromRecord(record.c_str() + attrByteOffset);
+			collector.add(key);
+			insertEntry(key, rid, includedLength > 0 ? record.c_str() + includedOffset : NULL);
 		}
-		default: { break; }
+	} catch (EndOfFileException &e) {
+		//end of the scan has been reached
 	}
+
+	delete fileScan;
+	statistics = collector.finish();
+	writeStatistics();
+	openLog(indexName, openMode, true);
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::traverseAndInsert
+// TypedBTreeIndex::bulkLoad
 // -----------------------------------------------------------------------------
-const void BTreeIndex::traverseAndInsert(Page* page, int pageLevel, bool isRoot, const void* keyPtr, const RecordId rid, bool &restructured, PageId &newPageId, bool &comingFromLeaf) {
-	switch(attributeType) {
-		case INTEGER: {
-			int key = *((int*) keyPtr);
-			NonLeafNodeInt* nodeInt = (NonLeafNodeInt*) page;
+template <class T>
+void TypedBTreeIndex<T>::bulkLoad(const std::string & relationName, const std::string & indexName, const double fillFactor, const int numThreads) {
+	//anything outside of (0, 1] packs the nodes full
+	double fill = (fillFactor > 0 && fillFactor <= 1) ? fillFactor : 1.0;
+	int threads = (numThreads == HARDWARETHREADS) ? (int) std::thread::hardware_concurrency() : numThreads;
+	threads = std::max(1, threads);
+
+	//the threads take the pages of the relation along its chain and spill a sorted run whenever their buffer fills up
+	ParallelScanState<T> state(threads);
+	PageFile relation(relationName, false);
+	FileIterator firstPage = relation.begin();
+	state.relationFile = &relation;
+	state.nextPageNo = (firstPage == relation.end()) ? Page::INVALID_NUMBER : (*firstPage).page_number();
+	const int rowSize = includedRowSize();
+	int pairsPerPage = SortRunPage<T>::CAPACITY;
+
+	//a pair shares the pages of a run with its row of included columns
+	if(includedLength > 0) pairsPerPage = Page::SIZE / (sizeof(RIDKeyPair<T>) + rowSize);
+	state.runCapacity = std::max(1, BULKLOADRUNPAGES * pairsPerPage / threads);
+	state.sortFileName = indexName + ".sort";
+
+	if(threads == 1) {
+		parallelScanThread(&state, 0);
+	} else {
+		std::vector<std::thread> scanThreads;
+		for(int t = 0; t < threads; t++) scanThreads.push_back(std::thread(&TypedBTreeIndex<T>::parallelScanThread, this, &state, t));
+		for(int t = 0; t < threads; t++) scanThreads[t].join();
+	}
 
-			if(isRoot && nodeInt->keyArray[0] == INT_MAX) {
-				//set the first key in the root 
-				nodeInt->keyArray[0] = key;
+	//the frames of the relation pages are tied to this File, which goes away on return
+	bufFlushFile(bufMgr, &relation);
+	File* sortFile = state.sortFile;
+	std::vector<PageId> &runFirstPage = state.runFirstPage;
+	std::vector<PageId> &runFirstRowPage = state.runFirstRowPage;
+	for(int t = 0; t < threads; t++) {
+		if(state.errors[t]) {
+			if(sortFile != NULL) {
+				bufFlushFile(bufMgr, sortFile);
+				delete sortFile;
+				File::remove(state.sortFileName);
 			}
+			std::rethrow_exception(state.errors[t]);
+		}
+	}
 
-			if(pageLevel == 0) {
-				comingFromLeaf = false;
-
-				//find where the key would go
-				int index = findIndexIntoPageNoArray(page, keyPtr);
-
-				//read in that page
-				Page* child;
-				bufMgr->readPage(file, nodeInt->pageNoArray[index], child);
-
-				//recurse into that child
-				PageId pageIdFromChild;
-				bool childRestructured;
-				bool fromLeaf;
-				traverseAndInsert(child, ((NonLeafNodeInt*) child)->level, false, keyPtr, rid, childRestructured, pageIdFromChild, fromLeaf);
-
-				if(childRestructured) {
-					if(fromLeaf) {
-						//read the pageIdFromChild and set its level to 1
-						Page* pageFromChild;
-						NonLeafNodeInt* nodeFromChild;
-						bufMgr->readPage(file, pageIdFromChild, pageFromChild);
-						nodeFromChild = (NonLeafNodeInt*) pageFromChild;
-						nodeFromChild->level = 1;
-
-						//unpin the page
-						bufMgr->unPinPage(file, pageIdFromChild, true);
-					}
-					//if there is room we can just add the key here and shift everything over
-					if(nodeInt->keyArray[nodeOccupancy - 1] == INT_MAX) {
-						restructured = false;
-
-						insertIntoNonLeafPage(page, (void*) &middleInt, pageIdFromChild);
-
-					} else {
-						restructured = true;
-						//save the value of middleInt that the previous restructure set
-						int middleIntFromChild = middleInt;
-
-						restructure(page, false, (void*) &middleIntFromChild, pageIdFromChild, newPageId);
-
-						//only need to insert if not equal 
-						if(middleIntFromChild < middleInt) {
-							//insert it onto old node (nodeInt)
-							insertIntoNonLeafPage(page, (void*) &middleIntFromChild, pageIdFromChild);
-						} else if(middleIntFromChild > middleInt) {
-							//insert it onto the new node the child created
-							//read in that page
-							Page* newNodePage;
-							bufMgr->readPage(file, newPageId, newNodePage);
-
-							insertIntoNonLeafPage(newNodePage, (void*) &middleIntFromChild, pageIdFromChild);
-
-							//TODO: unpin that page
-                            bufMgr->unPinPage(file, newPageId, true);
-						}
-					}
-				}
+	for(int t = 1; t < threads; t++) state.collectors[0].merge(state.collectors[t]);
+	statistics = state.collectors[0].finish();
+	writeStatistics();
+
+	//the pairs each thread has left are sorted, they are merged in memory or join the runs of the others
+	std::vector<RIDKeyPair<T> > entries;
+	std::vector<char> rows;
+	if(sortFile == NULL) {
+		std::vector<size_t> bounds(1, 0);
+		for(int t = 0; t < threads; t++) {
+			entries.insert(entries.end(), state.entries[t].begin(), state.entries[t].end());
+			rows.insert(rows.end(), state.rows[t].begin(), state.rows[t].end());
+			std::vector<RIDKeyPair<T> >().swap(state.entries[t]);
+			std::vector<char>().swap(state.rows[t]);
+			bounds.push_back(entries.size());
+		}
+
+		//merge neighbouring pieces two at a time until one sorted piece is left. Rows of included columns have to
+		//move along with their pairs, so those are sorted again in one go instead
+		if(!rows.empty()) {
+			sortEntries(entries, rows, rowSize);
+			bounds.clear();
+		}
+		while(bounds.size() > 2) {
+			std::vector<size_t> merged(1, 0);
+			for(size_t i = 2; i < bounds.size(); i += 2) {
+				std::inplace_merge(entries.begin() + bounds[i - 2], entries.begin() + bounds[i - 1], entries.begin() + bounds[i]);
+				merged.push_back(bounds[i]);
 			}
-			else {
-				comingFromLeaf = true;
-				//we are the parent of the leaf
-				//find what page the leaf is on
-				int idx = findIndexIntoPageNoArray(page, keyPtr);
-
-				//read in the leaf page and cast
-				Page* leafPage;
-				PageId leafPageId = nodeInt->pageNoArray[idx];
-				bufMgr->readPage(file, leafPageId, leafPage);
-				LeafNodeInt* leaf = (LeafNodeInt*) leafPage;
-
-				//find the index into the key array where the rid would go
-				int index = findIndexIntoKeyArray(leafPage, keyPtr);
-
-				//try to insert into the leaf page
-				//if the last place in the leaf is NULL then we dont have to restructure 
-				if(leaf->keyArray[leafOccupancy - 1] == INT_MAX) {
-					restructured = false;
-
-					//move entries over one place (start at the end)
-					for(int i = leafOccupancy - 1; i > index; i--) {
-						leaf->keyArray[i] = leaf->keyArray[i - 1];
-						leaf->ridArray[i] = leaf->ridArray[i - 1];
-					}
+			if(bounds.size() % 2 == 0) merged.push_back(bounds.back());
+			bounds.swap(merged);
+		}
+	} else {
+		for(int t = 0; t < threads; t++) {
+			if(!state.entries[t].empty()) writeSortRun(sortFile, state.entries[t], state.rows[t], runFirstPage, runFirstRowPage);
+		}
+	}
 
-					//actually insert the entry
-					leaf->keyArray[index] = key;
-					leaf->ridArray[index].page_number = rid.page_number;
-					leaf->ridArray[index].slot_number = rid.slot_number;
-				} else {
-					restructured = true;
-
-					restructure(leafPage, true, keyPtr, NULL, newPageId);
-					
-					//now actually put the entry passed in on one of these pages
-					if(*((int*) keyPtr) >= middleInt) {
-						Page* newLeafPage;
-						bufMgr->readPage(file, newPageId, newLeafPage);
-
-						LeafNodeInt* newLeaf = (LeafNodeInt*) newLeafPage;
-
-						int index = findIndexIntoKeyArray(newLeafPage, keyPtr);
-
-						//move the keys over on this page
-						for(int i = leafOccupancy - 1; i > index; i--) {
-							newLeaf->keyArray[i] = newLeaf->keyArray[i - 1];
-							newLeaf->ridArray[i].page_number = newLeaf->ridArray[i - 1].page_number;
-							newLeaf->ridArray[i].slot_number = newLeaf->ridArray[i - 1].slot_number;
-						}
-
-						//actually insert the record
-						newLeaf->keyArray[index] = key;
-						newLeaf->ridArray[index].page_number = rid.page_number;
-						newLeaf->ridArray[index].slot_number = rid.slot_number;					
-						
-						//unpin the new leafPage created
-						bufMgr->unPinPage(file, newPageId, true);
-					} else {
-						int index = findIndexIntoKeyArray(leafPage, keyPtr);
-						
-						//move the keys over on this page
-						for(int i = leafOccupancy - 1; i > index; i--) {
-							leaf->keyArray[i] = leaf->keyArray[i - 1];
-							leaf->ridArray[i].page_number = leaf->ridArray[i - 1].page_number;
-							leaf->ridArray[i].slot_number = leaf->ridArray[i - 1].slot_number;
-						}
-
-						//actually insert the record
-						leaf->keyArray[index] = key;
-						leaf->ridArray[index].page_number = rid.page_number;
-						leaf->ridArray[index].slot_number = rid.slot_number;
-					}
+	//fill the leaves in key order, every distinct key takes one entry. The leaves and their rows are written once
+	//each, past the buffer pool, several writes at a time
+	std::vector<PageKeyPair<T> > children;
+	long long weightPerLeaf = std::max((long long) LeafNode<T>::MAXENTRYWEIGHT, (long long) (fill * LeafNode<T>::CAPACITY));
+	AsyncPageWriter* pageWriter = new AsyncPageWriter(file->filename(), BULKLOADWRITEDEPTH);
 
-				}
-				//unpin the leaf page
-				bufMgr->unPinPage(file, leafPageId, true);
-			}
+	if(sortFile == NULL) {
+		//everything fit in memory
+		LeafWeightCounter<T> counter;
+		for(size_t i = 0; i < entries.size(); i++) counter.add(entries[i], NULL);
 
-			break;
+		LeafPacker<T> packer(bufMgr, file, pageWriter, counter.weight, weightPerLeaf, rowSize, children);
+		for(size_t i = 0; i < entries.size(); i++) packer.add(entries[i], rows.empty() ? NULL : &rows[i * rowSize]);
+		packer.finish();
+	} else {
+		//the merges read every run a page at a time, the reader keeps the next pages of each on their way
+		AsyncPageReader* reader = NULL;
+		try {
+			reader = new AsyncPageReader(state.sortFileName, BULKLOADMERGEFANIN * BULKLOADPREFETCHPAGES);
+		} catch(const FileNotFoundException &e) {
+			reader = NULL;
 		}
-		case DOUBLE: {
-			double key = *((double*) keyPtr);
-			NonLeafNodeDouble* nodeDouble = (NonLeafNodeDouble*) page;
 
-			if(isRoot && nodeDouble->keyArray[0] == DBL_MAX) {
-				//set the first key in the root 
-				nodeDouble->keyArray[0] = key;
+		//merge groups of runs into longer runs until they can all be merged at once
+		while((int) runFirstPage.size() > BULKLOADMERGEFANIN) {
+			std::vector<PageId> mergedRuns;
+			std::vector<PageId> mergedRowRuns;
+			for(int r = 0; r < (int) runFirstPage.size(); r += BULKLOADMERGEFANIN) {
+				PairRunWriter<T> writer(bufMgr, sortFile, rowSize);
+				mergeSortRuns(sortFile, runFirstPage, runFirstRowPage, r, std::min(r + BULKLOADMERGEFANIN, (int) runFirstPage.size()), writer, reader);
+				writer.finish();
+				mergedRuns.push_back(writer.pairs.firstPageNo);
+				if(includedLength > 0) mergedRowRuns.push_back(writer.rows.firstPageNo);
 			}
+			runFirstPage.swap(mergedRuns);
+			runFirstRowPage.swap(mergedRowRuns);
+		}
+		//one more pass over the runs finds how many leaves the keys take, without their rows
+		LeafWeightCounter<T> counter;
+		mergeSortRuns(sortFile, runFirstPage, std::vector<PageId>(), 0, (int) runFirstPage.size(), counter, reader);
+
+		LeafPacker<T> packer(bufMgr, file, pageWriter, counter.weight, weightPerLeaf, rowSize, children);
+		mergeSortRuns(sortFile, runFirstPage, runFirstRowPage, 0, (int) runFirstPage.size(), packer, reader);
+		packer.finish();
+
+		//the runs are not needed anymore
+		delete reader;
+		bufFlushFile(bufMgr, sortFile);
+		delete sortFile;
+		File::remove(state.sortFileName);
+	}
 
-			if(pageLevel == 0) {
-				comingFromLeaf = false;
-
-				//find where the key would go
-				int index = findIndexIntoPageNoArray(page, keyPtr);
-
-				//read in that page
-				Page* child;
-				bufMgr->readPage(file, nodeDouble->pageNoArray[index], child);
-
-				//recurse into that child
-				PageId pageIdFromChild;
-				bool childRestructured;
-				bool fromLeaf;
-				traverseAndInsert(child, ((NonLeafNodeDouble*) child)->level, false, keyPtr, rid, childRestructured, pageIdFromChild, fromLeaf);
-
-				if(childRestructured) {
-					if(fromLeaf) {
-						//read the pageIdFromChild and set its level to 1
-						Page* pageFromChild;
-						NonLeafNodeDouble* nodeFromChild;
-						bufMgr->readPage(file, pageIdFromChild, pageFromChild);
-						nodeFromChild = (NonLeafNodeDouble*) pageFromChild;
-						nodeFromChild->level = 1;
-
-						//unpin the page
-						bufMgr->unPinPage(file, pageIdFromChild, true);
-					}
-					//if there is room we can just add the key here and shift everything over
-					if(nodeDouble->keyArray[nodeOccupancy - 1] == DBL_MAX) {
-						restructured = false;
-
-						insertIntoNonLeafPage(page, (void*) &middleDouble, pageIdFromChild);
-
-					} else {
-						restructured = true;
-						//save the value of middleDouble that the previous restructure set
-						double middleDoubleFromChild = middleDouble;
-
-						restructure(page, false, (void*) &middleDoubleFromChild, pageIdFromChild, newPageId);
-
-						//only need to insert if not equal
-						if(middleDoubleFromChild < middleDouble) {
-							//insert it onto old node (nodeDouble)
-							insertIntoNonLeafPage(page, (void*) &middleDoubleFromChild, pageIdFromChild);
-						} else if(middleDoubleFromChild > middleDouble) {
-							//insert it onto the new node the child created
-							//read in that page
-							Page* newNodePage;
-							bufMgr->readPage(file, newPageId, newNodePage);
-
-							insertIntoNonLeafPage(newNodePage, (void*) &middleDoubleFromChild, pageIdFromChild);
-
-							//unpin that page
-                            bufMgr->unPinPage(file, newPageId, true);
-						}
-					}
-				}
+	//the leaves are in the file before anything reads them through the buffer pool
+	delete pageWriter;
+
+	//build the non-leaf levels bottom-up from the low key and page number of every node on the level below
+	long long weightPerNode = std::max(2LL * NonLeafNode<T>::MAXENTRYWEIGHT, (long long) (fill * NonLeafNode<T>::CAPACITY));
+	int level = 1;
+	while(true) {
+		int numChildren = children.size();
+
+		//the first child of a node brings no key to it, so weights[i] is that of the keys of children 1 .. i
+		std::vector<long long> weights(numChildren, 0);
+		for(int i = 1; i < numChildren; i++) weights[i] = weights[i - 1] + NonLeafNode<T>::entryWeight(children[i].key);
+		long long totalWeight = weights[numChildren - 1];
+		int numNodes = (int) std::max(1LL, (totalWeight + weightPerNode - 1) / weightPerNode);
+		numNodes = std::max(1, std::min(numNodes, numChildren / 2));
+
+		std::vector<PageKeyPair<T> > parents;
+		NonLeafNode<T>* prevNode = NULL;
+		PageId prevNodePageId = NULL;
+		int first = 0;
+		for(int j = 0; j < numNodes; j++) {
+			//spread the keys evenly by weight, leaving at least two children for every node still to come
+			int last = first + 1;
+			if(j == numNodes - 1) {
+				last = numChildren;
+			} else {
+				long long boundary = totalWeight * (j + 1) / numNodes;
+				while(numChildren - (last + 1) >= 2 * (numNodes - j - 1) && (last - first < 2 || weights[last] <= boundary)) last++;
 			}
-			else {
-				comingFromLeaf = true;
-				//we are the parent of the leaf
-				//find what page the leaf is on
-				int idx = findIndexIntoPageNoArray(page, keyPtr);
-
-				//read in the leaf page and cast
-				Page* leafPage;
-				PageId leafPageId = nodeDouble->pageNoArray[idx];
-				bufMgr->readPage(file, leafPageId, leafPage);
-				LeafNodeDouble* leaf = (LeafNodeDouble*) leafPage;
-
-				//find the index into the key array where the rid would go
-				int index = findIndexIntoKeyArray(leafPage, keyPtr);
-
-				//try to insert into the leaf page
-				//if the last place in the leaf is NULL then we dont have to restructure 
-				if(leaf->keyArray[leafOccupancy - 1] == DBL_MAX) {
-					restructured = false;
-
-					//move entries over one place (start at the end)
-					for(int i = leafOccupancy - 1; i > index; i--) {
-						leaf->keyArray[i] = leaf->keyArray[i - 1];
-						leaf->ridArray[i] = leaf->ridArray[i - 1];
-					}
 
-					//actually insert the entry
-					leaf->keyArray[index] = key;
-					leaf->ridArray[index].page_number = rid.page_number;
-					leaf->ridArray[index].slot_number = rid.slot_number;
-				} else {
-					restructured = true;
-
-					restructure(leafPage, true, keyPtr, NULL, newPageId);
-					
-					//now actually put the entry passed in on one of these pages
-					if(*((double*) keyPtr) >= middleDouble) {
-						Page* newLeafPage;
-						bufMgr->readPage(file, newPageId, newLeafPage);
-
-						LeafNodeDouble* newLeaf = (LeafNodeDouble*) newLeafPage;
-
-						int index = findIndexIntoKeyArray(newLeafPage, keyPtr);
-
-						//move the keys over on this page
-						for(int i = leafOccupancy - 1; i > index; i--) {
-							newLeaf->keyArray[i] = newLeaf->keyArray[i - 1];
-							newLeaf->ridArray[i].page_number = newLeaf->ridArray[i - 1].page_number;
-							newLeaf->ridArray[i].slot_number = newLeaf->ridArray[i - 1].slot_number;
-						}
-
-						//actually insert the record
-						newLeaf->keyArray[index] = key;
-						newLeaf->ridArray[index].page_number = rid.page_number;
-						newLeaf->ridArray[index].slot_number = rid.slot_number;					
-						
-						//unpin the new leafPage created
-						bufMgr->unPinPage(file, newPageId, true);
-					} else {
-						int index = findIndexIntoKeyArray(leafPage, keyPtr);
-						
-						//move the keys over on this page
-						for(int i = leafOccupancy - 1; i > index; i--) {
-							leaf->keyArray[i] = leaf->keyArray[i - 1];
-							leaf->ridArray[i].page_number = leaf->ridArray[i - 1].page_number;
-							leaf->ridArray[i].slot_number = leaf->ridArray[i - 1].slot_number;
-						}
-
-						//actually insert the record
-						leaf->keyArray[index] = key;
-						leaf->ridArray[index].page_number = rid.page_number;
-						leaf->ridArray[index].slot_number = rid.slot_number;
-					}
-
-				}
-				//unpin the leaf page
-				bufMgr->unPinPage(file, leafPageId, true);
-			}
+			Page* nodePage;
+			PageId nodePageId;
+			bufAllocPage(bufMgr, file, nodePageId, nodePage);
+			NonLeafNode<T>* node = (NonLeafNode<T>*) nodePage;
 
-			break;
-		}
-		case STRING: {
-            std::string key = *((std::string*) keyPtr);
-			NonLeafNodeString* nodeString = (NonLeafNodeString*) page;
+			//null eveything in this new page
+			node->init(level);
 
-			if(isRoot && strcmp(nodeString->keyArray[0], "") == 0) {
-				//set the first key in the root 
-				strncpy(nodeString->keyArray[0], key.c_str(), STRINGSIZE);
+			//the first key of the next node is the high key, and the node is kept until it can link to that one
+			node->build(j > 0 ? &children[first].key : NULL, last < numChildren ? &children[last].key : NULL, &children[first], last - first);
+			if(prevNode != NULL) {
+				prevNode->rightSibPageNo = nodePageId;
+				unPinPage(prevNodePageId, true);
 			}
 
-			if(pageLevel == 0) {
-				comingFromLeaf = false;
+			//the node holds every rid its children do
+			unsigned int count = 0;
+			for(int i = first; i < last; i++) count += children[i].count;
+			PageKeyPair<T> parent;
+			parent.set(nodePageId, children[first].key, count);
+			parents.push_back(parent);
+
+			if(numNodes == 1) {
+				//we are going to keep the rootPage in memory
+				rootPageNum = nodePageId;
+				rootPage = nodePage;
+			} else if(j == numNodes - 1) {
+				unPinPage(nodePageId, true);
+			} else {
+				prevNode = node;
+				prevNodePageId = nodePageId;
+			}
+			first = last;
+		}
 
-				//find where the key would go
-				int index = findIndexIntoPageNoArray(page, keyPtr);
+		if(numNodes == 1) break;
 
-				//read in that page
-				Page* child;
-				bufMgr->readPage(file, nodeString->pageNoArray[index], child);
+		children.swap(parents);
+		level = 0;
+	}
 
-				//recurse into that child
-				PageId pageIdFromChild;
-				bool childRestructured;
-				bool fromLeaf;
-				traverseAndInsert(child, ((NonLeafNodeString*) child)->level, false, keyPtr, rid, childRestructured, pageIdFromChild, fromLeaf);
+	//update the meta info with the page the root ended up on
+	Page* metadataPage;
+	readPage(headerPageNum, metadataPage);
+	IndexMetaInfo* metadata = (IndexMetaInfo*) metadataPage;
+	metadata->rootPageNo = rootPageNum;
+	unPinPage(headerPageNum, true);
+}
 
-				if(childRestructured) {
-					if(fromLeaf) {
-						//read the pageIdFromChild and set its level to 1
-						Page* pageFromChild;
-						bufMgr->readPage(file, pageIdFromChild, pageFromChild);
-						NonLeafNodeString* nodeFromChild = (NonLeafNodeString*) pageFromChild;
-						nodeFromChild->level = 1;
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::parallelScanThread
+// -----------------------------------------------------------------------------
+template <class T>
+void TypedBTreeIndex<T>::parallelScanThread(ParallelScanState<T>* state, int threadNum) {
+	std::vector<RIDKeyPair<T> > &entries = state->entries[threadNum];
+	std::vector<char> &rows = state->rows[threadNum];
+	StatisticsCollector<T> &collector = state->collectors[threadNum];
+	const int rowSize = includedRowSize();
+	PageId pageNos[BUILDSCANPAGES];
+	Page* pages[BUILDSCANPAGES];
+	int numPages = 0;
+	RIDKeyPair<T> pair;
 
-						//unpin the page
-						bufMgr->unPinPage(file, pageIdFromChild, true);
-					}
-					//if there is room we can just add the key here and shift everything over
-					if(strcmp(nodeString->keyArray[nodeOccupancy - 1], "") == 0) {
-						restructured = false;
-
-						insertIntoNonLeafPage(page, (void*) &middleString, pageIdFromChild);
-
-					} else {
-						restructured = true;
-						//save the value of middleInt that the previous restructure set
-						std::string middleStringFromChild = middleString;
-
-						restructure(page, false, (void*) &middleStringFromChild, pageIdFromChild, newPageId);
-
-						//only need to insert if 
-						if(strcmp(middleStringFromChild.c_str(), middleString.c_str()) < 0) {
-							//insert it onto old node 
-							insertIntoNonLeafPage(page, (void*) &middleStringFromChild, pageIdFromChild);
-						} else if(strcmp(middleStringFromChild.c_str(), middleString.c_str()) > 0) {
-							//insert it onto the new node the child created
-							//read in that page
-							Page* newNodePage;
-							bufMgr->readPage(file, newPageId, newNodePage);
-
-							insertIntoNonLeafPage(newNodePage, (void*) &middleStringFromChild, pageIdFromChild);
-
-							//unpin that page
-                            bufMgr->unPinPage(file, newPageId, true);
-						}
-					}
+	try {
+		while(true) {
+			//the next pages along the chain are this thread's alone
+			{
+				std::lock_guard<std::mutex> guard(state->pageLatch);
+				while(numPages < BUILDSCANPAGES && state->nextPageNo != Page::INVALID_NUMBER) {
+					bufReadPage(bufMgr, state->relationFile, state->nextPageNo, pages[numPages]);
+					pageNos[numPages] = state->nextPageNo;
+					state->nextPageNo = pages[numPages]->next_page_number();
+					numPages++;
 				}
 			}
-			else {
-				comingFromLeaf = true;
-				//we are the parent of the leaf
-				//find what page the leaf is on
-				int idx = findIndexIntoPageNoArray(page, keyPtr);
-
-				//read in the leaf page and cast
-				Page* leafPage;
-				PageId leafPageId = nodeString->pageNoArray[idx];
-				bufMgr->readPage(file, leafPageId, leafPage);
-				LeafNodeString* leaf = (LeafNodeString*) leafPage;
-
-				//find the index into the key array where the rid would go
-				int index = findIndexIntoKeyArray(leafPage, keyPtr);
-
-				//try to insert into the leaf page
-				//if the last place in the leaf is NULL then we dont have to restructure 
-				if(strcmp(leaf->keyArray[leafOccupancy - 1], "") == 0) {
-					restructured = false;
-
-					//move entries over one place (start at the end)
-					for(int i = leafOccupancy - 1; i > index; i--) {
-						strncpy(leaf->keyArray[i], leaf->keyArray[i - 1], STRINGSIZE);
-						leaf->ridArray[i] = leaf->ridArray[i - 1];
+			if(numPages == 0) break;
+
+			//Page only hands out copies of its records, so the key is taken from the copy and nothing else is kept
+			for(int p = 0; p < numPages; p++) {
+				for(PageIterator it = pages[p]->begin(); it != pages[p]->end(); ++it) {
+					const std::string &record = *it;
+					pair.rid = it.getCurrentRecord();
+					pair.key = KeyTraits<T>::fromRecord(record.c_str() + attrByteOffset);
+					collector.add(pair.key);
+					entries.push_back(pair);
+
+					//the row of included columns goes through the sort with the pair
+					if(includedLength > 0) {
+						size_t end = rows.size();
+						rows.resize(end + rowSize);
+						memcpy(&rows[end], &pair.rid, sizeof(RecordId));
+						memcpy(&rows[end + sizeof(RecordId)], record.c_str() + includedOffset, includedLength);
 					}
 
-					//actually insert the entry
-					strncpy(leaf->keyArray[index], key.c_str(), STRINGSIZE);
-					leaf->ridArray[index].page_number = rid.page_number;
-					leaf->ridArray[index].slot_number = rid.slot_number;
-				} else {
-					restructured = true;
-
-					restructure(leafPage, true, keyPtr, NULL, newPageId);
-					
-					//now actually put the entry passed in on one of these pages
-					if(strcmp((*((std::string*) keyPtr)).c_str(), middleString.c_str()) >= 0) {
-						Page* newLeafPage;
-						bufMgr->readPage(file, newPageId, newLeafPage);
-
-						LeafNodeString* newLeaf = (LeafNodeString*) newLeafPage;
-
-						int index = findIndexIntoKeyArray(newLeafPage, keyPtr);
-
-						//move the keys over on this page
-						for(int i = leafOccupancy - 1; i > index; i--) {
-							strncpy(newLeaf->keyArray[i], newLeaf->keyArray[i - 1], STRINGSIZE);
-							newLeaf->ridArray[i].page_number = newLeaf->ridArray[i - 1].page_number;
-							newLeaf->ridArray[i].slot_number = newLeaf->ridArray[i - 1].slot_number;
-						}
-
-						//actually insert the record
-						strncpy(newLeaf->keyArray[index], key.c_str(), STRINGSIZE);
-						newLeaf->ridArray[index].page_number = rid.page_number;
-						newLeaf->ridArray[index].slot_number = rid.slot_number;					
-						
-						//unpin the new leafPage created
-						bufMgr->unPinPage(file, newPageId, true);
-					} else {
-						int index = findIndexIntoKeyArray(leafPage, keyPtr);
-						
-						//move the keys over on this page
-						for(int i = leafOccupancy - 1; i > index; i--) {
-							strncpy(leaf->keyArray[i], leaf->keyArray[i - 1], STRINGSIZE);
-							leaf->ridArray[i].page_number = leaf->ridArray[i - 1].page_number;
-							leaf->ridArray[i].slot_number = leaf->ridArray[i - 1].slot_number;
-						}
-
-						//actually insert the record
-						strncpy(leaf->keyArray[index], key.c_str(), STRINGSIZE);
-						leaf->ridArray[index].page_number = rid.page_number;
-						leaf->ridArray[index].slot_number = rid.slot_number;
+					//the run is sorted before the latch is taken, only writing it out is one thread at a time
+					if((int) entries.size() == state->runCapacity) {
+						sortEntries(entries, rows, rowSize);
+						std::lock_guard<std::mutex> guard(state->runLatch);
+						if(state->sortFile == NULL) state->sortFile = createSortFile(state->sortFileName);
+						writeSortRun(state->sortFile, entries, rows, state->runFirstPage, state->runFirstRowPage);
 					}
-
 				}
-				//unpin the leaf page
-				bufMgr->unPinPage(file, leafPageId, true);
 			}
-			
-			break;
+			while(numPages > 0) {
+				numPages--;
+				bufUnPinPage(bufMgr, state->relationFile, pageNos[numPages], false);
+			}
+		}
+		sortEntries(entries, rows, rowSize);
+	} catch(...) {
+		//the main thread rethrows it once every thread is done
+		state->errors[threadNum] = std::current_exception();
+		while(numPages > 0) {
+			numPages--;
+			bufUnPinPage(bufMgr, state->relationFile, pageNos[numPages], false);
 		}
-		default:
-			break;
-
 	}
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::findIndexIntoKeyArray (assumes leaf page)
+// TypedBTreeIndex::writeSortRun
 // -----------------------------------------------------------------------------
-int BTreeIndex::findIndexIntoKeyArray(Page* page, const void* keyPtr) {
-	switch(attributeType) {
-		case INTEGER: {
-			int key = *((int*) keyPtr);
-			LeafNodeInt* leaf = (LeafNodeInt*) page;
-			for(int i = 0; i < leafOccupancy; i++) {
-				if(leaf->keyArray[0] == INT_MAX || key < leaf->keyArray[0]) return 0;
-                else if(leaf->keyArray[i] == key) throw DuplicateKeyException();
-				else if(key > leaf->keyArray[i] && i != leafOccupancy - 1 && key < leaf->keyArray[i + 1]) return i + 1;
-				else if(key > leaf->keyArray[i] && (i == leafOccupancy - 1 || leaf->keyArray[i + 1] == INT_MAX)) return i + 1;
-			}
-			break;
+template <class T>
+void TypedBTreeIndex<T>::writeSortRun(File* sortFile, std::vector<RIDKeyPair<T> > &entries, std::vector<char> &rows, std::vector<PageId> &runFirstPage, std::vector<PageId> &runFirstRowPage) {
+	const int rowSize = includedRowSize();
+	PairRunWriter<T> writer(bufMgr, sortFile, rowSize);
+	for(size_t i = 0; i < entries.size(); i++) writer.add(entries[i], rows.empty() ? NULL : &rows[i * rowSize]);
+	writer.finish();
+
+	runFirstPage.push_back(writer.pairs.firstPageNo);
+	if(!rows.empty()) runFirstRowPage.push_back(writer.rows.firstPageNo);
+	entries.clear();
+	rows.clear();
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::mergeSortRuns
+// -----------------------------------------------------------------------------
+template <class T>
+template <class Sink>
+void TypedBTreeIndex<T>::mergeSortRuns(File* sortFile, const std::vector<PageId> &runFirstPage, const std::vector<PageId> &runFirstRowPage, int firstRun, int lastRun, Sink &sink, AsyncPageReader* reader) {
+	int numRuns = lastRun - firstRun;
+	const bool withRows = !runFirstRowPage.empty();
+	const int rowSize = includedRowSize();
+	std::vector<PageId> pageNo(numRuns);
+	std::vector<SortRunPage<T>*> page(numRuns);
+	std::vector<int> nextEntry(numRuns);
+	std::vector<PageId> rowPageNo(numRuns);
+	std::vector<IncludedPage*> rowPage(numRuns);
+	std::vector<int> nextRow(numRuns);
+	std::vector<PageId> endPageNo(numRuns);
+	std::vector<PageId> prefetchedTo(numRuns);
+	std::priority_queue<std::pair<RIDKeyPair<T>, int>, std::vector<std::pair<RIDKeyPair<T>, int> >, SortRunHeadGreater<T> > heads;
+
+	//pin the first page of every run, and of its rows, and queue up its first pair
+	for(int r = 0; r < numRuns; r++) {
+		Page* runPage;
+		pageNo[r] = runFirstPage[firstRun + r];
+		endPageNo[r] = (firstRun + r + 1 < (int) runFirstPage.size()) ? runFirstPage[firstRun + r + 1] : UINT_MAX;
+		prefetchedTo[r] = NULL;
+		prefetchSortRun(reader, pageNo[r], endPageNo[r], prefetchedTo[r]);
+		bufReadPage(bufMgr, sortFile, pageNo[r], runPage);
+		page[r] = (SortRunPage<T>*) runPage;
+		nextEntry[r] = 0;
+		if(withRows) {
+			rowPageNo[r] = runFirstRowPage[firstRun + r];
+			bufReadPage(bufMgr, sortFile, rowPageNo[r], runPage);
+			rowPage[r] = (IncludedPage*) runPage;
+			nextRow[r] = 0;
 		}
-		case DOUBLE: {
-		    double key = *((double*) keyPtr);
-			LeafNodeDouble* leaf = (LeafNodeDouble*) page;
-			for(int i = 0; i < leafOccupancy; i++) {
-				if(leaf->keyArray[0] == DBL_MAX || key < leaf->keyArray[0]) return 0;
-                else if(leaf->keyArray[i] == key) throw DuplicateKeyException();
-				else if(key > leaf->keyArray[i] && i != leafOccupancy - 1 && key < leaf->keyArray[i + 1]) return i + 1;
-				else if(key > leaf->keyArray[i] && (i == leafOccupancy - 1 || leaf->keyArray[i + 1] == DBL_MAX)) return i + 1;
+		heads.push(std::make_pair(page[r]->entries[0], r));
+	}
+
+	while(!heads.empty()) {
+		int r = heads.top().second;
+		sink.add(heads.top().first, withRows ? rowPage[r]->rows + nextRow[r] * rowSize : NULL);
+		heads.pop();
+
+		//the rows of a run are in the order of its pairs, and run out with them
+		if(withRows && ++nextRow[r] == rowPage[r]->numRows) {
+			PageId nextPageNo = rowPage[r]->nextPageNo;
+			bufUnPinPage(bufMgr, sortFile, rowPageNo[r], false);
+			if(nextPageNo != NULL) {
+				Page* runPage;
+				prefetchSortRun(reader, nextPageNo, endPageNo[r], prefetchedTo[r]);
+				bufReadPage(bufMgr, sortFile, nextPageNo, runPage);
+				rowPageNo[r] = nextPageNo;
+				rowPage[r] = (IncludedPage*) runPage;
+				nextRow[r] = 0;
 			}
+		}
+
+		//move on to the next pair of that run, and to the next page of the run when this one is used up
+		nextEntry[r]++;
+		if(nextEntry[r] == page[r]->numEntries) {
+			PageId nextPageNo = page[r]->nextPageNo;
+			bufUnPinPage(bufMgr, sortFile, pageNo[r], false);
+			if(nextPageNo == NULL) continue;
+
+			Page* runPage;
+			prefetchSortRun(reader, nextPageNo, endPageNo[r], prefetchedTo[r]);
+			bufReadPage(bufMgr, sortFile, nextPageNo, runPage);
+			pageNo[r] = nextPageNo;
+			page[r] = (SortRunPage<T>*) runPage;
+			nextEntry[r] = 0;
+		}
+		heads.push(std::make_pair(page[r]->entries[nextEntry[r]], r));
+	}
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::~TypedBTreeIndex -- destructor
+// -----------------------------------------------------------------------------
+template <class T>
+TypedBTreeIndex<T>::~TypedBTreeIndex()
+{
+	// Destructor. Method does not throw any exceptions as is indicated in the header file. All exceptions are caught in here itself.
+
+	// Ending any initialized scan  and unpinning any B+ Tree pages that are pinned by invoking the endScan method.
+	// endScan method can throw the ScanNotInitializedException and PageNotPinned (thrown by unPinPage) which are caught in here
+	if(scan != NULL)
+	{
+		try {
+			endScan();
+		} catch(const ScanNotInitializedException &e) {
+			std::cout << "ScanNotInitializedException thrown in BTreeIndex destructor\n";
+		}
+	}
+
+	//every scan is closed by now, so the read-ahead thread has nothing left to fetch for
+	if(readAheadThread.joinable()) {
+		{
+			std::lock_guard<std::mutex> guard(readAheadLatch);
+			readAheadStop = true;
+		}
+		readAheadWork.notify_all();
+		readAheadThread.join();
+	}
+
+	// Flushing the index file from the buffer manager if it exists
+	if(file) {
+		flushIndex();
+	}
+
+	//everything the log would redo is in the files now
+	if(log != NULL) {
+		log->checkpoint(file->filename());
+		delete log;
+		File::remove(file->filename() + LOGFILESUFFIX);
+	}
+
+	// Deleting the file object instance. This automatically invokes the destructor of the File class and closes the index file.
+	delete file;
+
+	if(mappedFile != NULL) munmap(mappedFile, mappedSize);
+	delete statistics;
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::checkMetaInfo
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::checkMetaInfo(const IndexMetaInfo* metadata, const std::string & relationName)
+{
+	if(metadata->attrType != KeyTraits<T>::TYPE ||
+		metadata->attrByteOffset != attrByteOffset ||
+		metadata->includedLength != includedLength ||
+		(includedLength > 0 && metadata->includedOffset != includedOffset) ||
+		strcmp(metadata->relationName, relationName.c_str()) != 0) {
+
+		//if something doesnt match, then throw an exception
+		throw BadIndexInfoException("Info passed into constructor doesn't match meta info page");
+	}
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::setCounted
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::setCounted(const bool counted)
+{
+	//the counts up a path only stay exact if no other writer is anywhere on it, which only latch coupling can tell
+	this->counted = counted;
+	if(counted) concurrencyMode = LATCH_COUPLING;
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::openMapped
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::openMapped(const std::string & relationName, const std::string & indexName)
+{
+	//a log left by a crash has to be replayed first, which takes a mode that can write the file
+	if(File::exists(indexName + LOGFILESUFFIX)) throw BadIndexInfoException("Index file has a write-ahead log to recover");
+
+	int fd = open(indexName.c_str(), O_RDONLY);
+	if(fd < 0) throw FileNotFoundException(indexName);
+
+	//the mapping stays valid once the descriptor is closed
+	struct stat fileStat;
+	void* mapping = MAP_FAILED;
+	if(fstat(fd, &fileStat) == 0 && fileStat.st_size >= filePagePosition(headerPageNum) + (off_t) Page::SIZE) {
+		mappedSize = fileStat.st_size;
+		mapping = mmap(NULL, mappedSize, PROT_READ, MAP_SHARED, fd, 0);
+	}
+	close(fd);
+	if(mapping == MAP_FAILED) throw BadIndexInfoException("Index file could not be mapped");
+	mappedFile = (char*) mapping;
+
+	//pages are only ever read here, a stray write faults instead of changing the file
+	Page* metadataPage;
+	readPage(headerPageNum, metadataPage);
+	IndexMetaInfo* metadata = (IndexMetaInfo*) metadataPage;
+	try {
+		checkMetaInfo(metadata, relationName);
+		rootPageNum = metadata->rootPageNo;
+		setCounted(metadata->counted);
+		readPage(rootPageNum, rootPage);
+		readStatistics(metadata->statisticsPageNo);
+	} catch(...) {
+		munmap(mappedFile, mappedSize);
+		mappedFile = NULL;
+		throw;
+	}
+	freePageNo = metadata->freePageNo;
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::writeStatistics
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::writeStatistics()
+{
+	Page* statisticsPage;
+	PageId statisticsPageNo;
+	bufAllocPage(bufMgr, file, statisticsPageNo, statisticsPage);
+	memcpy((char*) statisticsPage, statistics, sizeof(IndexStatistics<T>));
+	unPinPage(statisticsPageNo, true);
+
+	Page* metadataPage;
+	readPage(headerPageNum, metadataPage);
+	((IndexMetaInfo*) metadataPage)->statisticsPageNo = statisticsPageNo;
+	unPinPage(headerPageNum, true);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::readStatistics
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::readStatistics(PageId pageNo)
+{
+	if(pageNo == NULL) return;
+
+	Page* statisticsPage;
+	readPage(pageNo, statisticsPage);
+	statistics = new IndexStatistics<T>();
+	memcpy(statistics, (char*) statisticsPage, sizeof(IndexStatistics<T>));
+	unPinPage(pageNo, false);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::readPage
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::readPage(PageId pageNo, Page* &page)
+{
+	INDEX_STAT(pageReads, 1);
+	if(mappedFile == NULL) {
+		bufReadPage(bufMgr, file, pageNo, page);
+		return;
+	}
+	//the file is laid out as File lays it out, after its header
+	if(pageNo == NULL || (size_t) filePagePosition(pageNo) + Page::SIZE > mappedSize) throw InvalidPageException(pageNo, "");
+	page = (Page*) (mappedFile + filePagePosition(pageNo));
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::unPinPage
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::unPinPage(PageId pageNo, bool dirty)
+{
+	INDEX_STAT(pageUnpins, 1);
+	if(mappedFile != NULL) return;
+
+	//the buffer manager may write a page out as soon as it is unpinned, which has to wait for the log
+	if(dirty && loggedAction != NULL) {
+		loggedAction->dirtyPageNos.push_back(pageNo);
+		return;
+	}
+	bufUnPinPage(bufMgr, file, pageNo, dirty);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::flushIndex
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::flushIndex()
+{
+	unPinPage(rootPageNum, true);
+	for(size_t i = 0; i < formerRoots.size(); i++) unPinPage(formerRoots[i], true);
+	formerRoots.clear();
+
+	//nodes were changed through their resident pages without ever being unpinned dirty
+	for(size_t i = 0; i < residentPageNos.size(); i++) {
+		if(residentPages.get(residentPageNos[i])->exchange(NULL) != NULL) unPinPage(residentPageNos[i], true);
+	}
+	residentPageNos.clear();
+
+	bufFlushFile(bufMgr, file);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::openLog
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::openLog(const std::string & indexName, const OpenMode openMode, const bool built)
+{
+	std::string logName = indexName + LOGFILESUFFIX;
+	if(built && File::exists(logName)) File::remove(logName);
+	if(openMode != READ_WRITE_LOGGED && !File::exists(logName)) return;
+
+	WriteAheadLog* walLog = new WriteAheadLog(logName);
+	if(built) {
+		//the log only covers what comes after the file is on disk
+		flushIndex();
+		readPage(rootPageNum, rootPage);
+		walLog->checkpoint(indexName);
+	} else if(!walLog->isEmpty()) {
+		redoLog(*walLog);
+		bufFlushFile(bufMgr, file);
+		walLog->checkpoint(indexName);
+	}
+
+	if(openMode != READ_WRITE_LOGGED) {
+		delete walLog;
+		File::remove(logName);
+		return;
+	}
+	log = walLog;
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::redoLog
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::redoLog(WriteAheadLog &walLog)
+{
+	std::vector<char> group;
+	while(walLog.readGroup(group)) {
+		size_t offset = 0;
+		LogRecord record;
+		while(WriteAheadLog::nextRecord(group, offset, record)) {
+			Page* page;
+			if(record.type == LOGROOTPAGE || record.type == LOGFREELIST) {
+				readPage(headerPageNum, page);
+				if(record.type == LOGROOTPAGE) ((IndexMetaInfo*) page)->rootPageNo = record.pageNo;
+				else ((IndexMetaInfo*) page)->freePageNo = record.pageNo;
+				unPinPage(headerPageNum, true);
+				if(record.length == 0) continue;
+			}
+
+			readLoggedPage(record.pageNo, page);
+			switch(record.type) {
+				case LOGPAGEIMAGE: {
+					memcpy(page, record.payload, Page::SIZE);
+					break;
+				}
+				case LOGLEAFINSERT:
+				case LOGLEAFDELETE: {
+					//the leaf is as it was when the change was made, the log has it whole further up
+					LeafNode<T>* leaf = (LeafNode<T>*) page;
+					T key;
+					RecordId rid;
+					memcpy(&key, record.payload, sizeof(T));
+					memcpy(&rid, record.payload + sizeof(T), sizeof(RecordId));
+					if(record.type == LOGLEAFINSERT) leaf->insertAt(findIndexIntoKeyArray(page, key), key, rid);
+					else leaf->removeAt(leaf->lowerBound(key));
+					break;
+				}
+				default: {
+					memcpy(&((FreePage*) page)->nextPageNo, record.payload, sizeof(PageId));
+					break;
+				}
+			}
+			unPinPage(record.pageNo, true);
+		}
+	}
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::readLoggedPage
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::readLoggedPage(PageId pageNo, Page* &page)
+{
+	try {
+		readPage(pageNo, page);
+		return;
+	} catch(const InvalidPageException &e) {
+	}
+
+	//the page was allocated after the file was last written out, along with any before it
+	PageId newPageNo;
+	bufAllocPage(bufMgr, file, newPageNo, page);
+	while(newPageNo < pageNo) {
+		unPinPage(newPageNo, true);
+		bufAllocPage(bufMgr, file, newPageNo, page);
+	}
+	if(newPageNo != pageNo) {
+		unPinPage(newPageNo, true);
+		throw InvalidPageException(pageNo, file->filename());
+	}
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::startLogAction
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::startLogAction(LogAction &action)
+{
+	if(log == NULL) return;
+	checkpointLatch.lockShared();
+	action.lsn = 0;
+	loggedAction = &action;
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::finishLogAction
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::finishLogAction(LogAction &action)
+{
+	if(loggedAction == NULL) return;
+
+	//nothing is left to append unless an exception cut the insert or delete short
+	appendAction();
+	for(size_t i = 0; i < action.freedPageNos.size(); i++) pushFreePage(action.freedPageNos[i], action.freedPages[i]);
+
+	if(action.lsn > 0) log->commit(action.lsn);
+	loggedAction = NULL;
+	for(size_t i = 0; i < action.dirtyPageNos.size(); i++) unPinPage(action.dirtyPageNos[i], true);
+	checkpointLatch.unlockShared();
+
+	if(log->size() >= CHECKPOINTLOGSIZE) checkpointLog();
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::checkpointLog
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::checkpointLog()
+{
+	checkpointLatch.lockExclusive();
+
+	//another insert or delete may have emptied the log while this one waited
+	if(log->size() < CHECKPOINTLOGSIZE) {
+		checkpointLatch.unlockExclusive();
+		return;
+	}
+
+	std::vector<PageId> pageNos;
+	pageNos.swap(unwrittenPageNos);
+	pageNos.push_back(headerPageNum);
+	std::sort(pageNos.begin(), pageNos.end());
+	pageNos.erase(std::unique(pageNos.begin(), pageNos.end()), pageNos.end());
+
+	try {
+		//the buffer pool has the pages as the log leaves them, and keeps them dirty until it writes them itself.
+		//The writer copies every page, so it is pinned no longer than it takes to hand it over
+		AsyncPageWriter writer(file->filename(), CHECKPOINTWRITEDEPTH);
+		for(size_t i = 0; i < pageNos.size(); i++) {
+			Page* page;
+			readPage(pageNos[i], page);
+			writer.write(pageNos[i], page);
+			unPinPage(pageNos[i], false);
+			loggedPages.get(pageNos[i])->store(false, std::memory_order_relaxed);
+		}
+		writer.wait();
+		log->checkpoint(file->filename());
+	} catch(...) {
+		checkpointLatch.unlockExclusive();
+		throw;
+	}
+	checkpointLatch.unlockExclusive();
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::logPage
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::logPage(PageId pageNo, Page* page)
+{
+	if(loggedAction == NULL) return;
+	std::vector<PageId> &pageNos = loggedAction->pageNos;
+	if(std::find(pageNos.begin(), pageNos.end(), pageNo) != pageNos.end()) return;
+
+	pageNos.push_back(pageNo);
+	loggedAction->pages.push_back(page);
+	loggedPages.get(pageNo)->store(true, std::memory_order_relaxed);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::logLeafChange
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::logLeafChange(LogRecordType type, PageId pageNo, Page* page, const T& key, const RecordId rid)
+{
+	if(loggedAction == NULL) return;
+
+	//the first change to a leaf since the log was emptied logs it whole, as does one to a leaf logged whole anyway
+	std::vector<PageId> &pageNos = loggedAction->pageNos;
+	if(!loggedPages.get(pageNo)->load(std::memory_order_relaxed) || std::find(pageNos.begin(), pageNos.end(), pageNo) != pageNos.end()) {
+		logPage(pageNo, page);
+		return;
+	}
+
+	char payload[sizeof(T) + sizeof(RecordId)];
+	memcpy(payload, &key, sizeof(T));
+	memcpy(payload + sizeof(T), &rid, sizeof(RecordId));
+	WriteAheadLog::addRecord(loggedAction->records, type, pageNo, payload, sizeof(payload));
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::logPath
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::logPath(std::vector<LatchedPage> &path)
+{
+	for(size_t i = 0; i < path.size(); i++) logPage(path[i].pageNo, path[i].page);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::logRootPage
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::logRootPage(PageId pageNo)
+{
+	if(loggedAction != NULL) WriteAheadLog::addRecord(loggedAction->records, LOGROOTPAGE, pageNo, NULL, 0);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::appendAction
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::appendAction()
+{
+	LogAction* action = loggedAction;
+	if(action == NULL || (action->pageNos.empty() && action->records.empty())) return;
+
+	//the pages come after the records, so a leaf logged both ways ends up as it is now
+	for(size_t i = 0; i < action->pageNos.size(); i++) {
+		WriteAheadLog::addRecord(action->records, LOGPAGEIMAGE, action->pageNos[i], action->pages[i], Page::SIZE);
+	}
+	action->lsn = log->append(action->records);
+	addUnwrittenPages(action->records);
+	action->records.clear();
+	action->pageNos.clear();
+	action->pages.clear();
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::appendFreeList
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::appendFreeList(PageId pageNo, const PageId* nextPageNo)
+{
+	if(loggedAction == NULL) return;
+	std::vector<char> group;
+	WriteAheadLog::addRecord(group, LOGFREELIST, pageNo, nextPageNo, nextPageNo != NULL ? sizeof(PageId) : 0);
+	loggedAction->lsn = log->append(group);
+	addUnwrittenPages(group);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::addUnwrittenPages
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::addUnwrittenPages(const std::vector<char> &group)
+{
+	std::lock_guard<std::mutex> guard(unwrittenLatch);
+	size_t offset = 0;
+	LogRecord record;
+	while(WriteAheadLog::nextRecord(group, offset, record)) {
+		//the free list may have run out
+		if(record.pageNo != NULL) unwrittenPageNos.push_back(record.pageNo);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::insertEntry
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::insertEntry(const void *key, const RecordId rid)
+{
+	insertEntry(KeyTraits<T>::fromPtr(key), rid);
+}
+
+template <class T>
+const void TypedBTreeIndex<T>::insertEntry(const void *key, const RecordId rid, const void* includedBytes)
+{
+	if(mappedFile != NULL) throw ReadOnlyIndexException();
+	if(includedLength == 0) throw BadIndexInfoException("Index has no included columns");
+	insertEntry(KeyTraits<T>::fromPtr(key), rid, (const char*) includedBytes);
+}
+
+template <class T>
+const void TypedBTreeIndex<T>::insertEntry(const T& key, const RecordId rid, const char* includedBytes)
+{
+	StatsScope scope(statsRegistry, INSERT_LATENCY);
+	if(mappedFile != NULL) throw ReadOnlyIndexException();
+
+	LogAction action;
+	startLogAction(action);
+	try {
+		//the bytes go onto the leaf's included column pages along with the entry
+		if(concurrencyMode == B_LINK) {
+			blinkInsert(key, rid, includedBytes);
+		} else if(counted || !optimisticInsert(key, rid, includedBytes)) {
+			//most inserts land on a leaf with room and only latch it exclusively, this one goes down again
+			//latching everything that may split. Every insert into a counted index changes the whole path
+			traverseAndInsert(key, rid, includedBytes);
+		}
+	} catch(...) {
+		finishLogAction(action);
+		throw;
+	}
+	finishLogAction(action);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::optimisticInsert
+// -----------------------------------------------------------------------------
+template <class T>
+bool TypedBTreeIndex<T>::optimisticInsert(const T& key, const RecordId rid, const char* includedBytes)
+{
+	PageId leafPageId;
+	Page* leafPage;
+	PageLatch* leafLatch;
+	traverse(key, true, NULL, leafPageId, leafPage, leafLatch);
+
+	//another rid of a key already on the leaf goes into its posting list, which never splits the leaf
+	LeafNode<T>* leaf = (LeafNode<T>*) leafPage;
+	int index = findIndexIntoKeyArray(leafPage, key);
+	bool present = (index < leaf->numKeys && leaf->isKeyAt(index, key));
+	if(!present && !leaf->hasRoom(key)) {
+		leafLatch->unlockExclusive();
+		unPinPage(leafPageId, false);
+		return false;
+	}
+
+	bool restructured;
+	PageId newPageId;
+	T middleKey;
+	try {
+		insertIntoLeafPage(leafPageId, leafPage, key, rid, includedBytes, restructured, newPageId, middleKey);
+	} catch(const DuplicateKeyException &e) {
+		leafLatch->unlockExclusive();
+		unPinPage(leafPageId, false);
+		throw;
+	}
+
+	appendAction();
+	leafLatch->unlockExclusive();
+	unPinPage(leafPageId, true);
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::deleteEntry
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::deleteEntry(const void *key)
+{
+	deleteEntry(KeyTraits<T>::fromPtr(key), NULL);
+}
+
+template <class T>
+const void TypedBTreeIndex<T>::deleteEntry(const void *key, const RecordId rid)
+{
+	deleteEntry(KeyTraits<T>::fromPtr(key), &rid);
+}
+
+template <class T>
+const void TypedBTreeIndex<T>::deleteEntry(const T& key, const RecordId* rid)
+{
+	StatsScope scope(statsRegistry);
+	INDEX_STAT(deletes, 1);
+	if(mappedFile != NULL) throw ReadOnlyIndexException();
+
+	//a B_LINK descent may be on its way to a page without holding its latch, so pages are never merged away
+	bool lazy = (deleteMode == LAZY_DELETE || concurrencyMode == B_LINK);
+
+	LogAction action;
+	startLogAction(action);
+	try {
+		//most deletes leave the leaf at least half full and only latch it exclusively, this one goes down again
+		//latching everything that may have to give up a key. Every delete from a counted index changes the whole path
+		if(counted || !optimisticDelete(key, rid, lazy)) traverseAndDelete(key, rid, lazy);
+	} catch(...) {
+		finishLogAction(action);
+		throw;
+	}
+	finishLogAction(action);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::optimisticDelete
+// -----------------------------------------------------------------------------
+template <class T>
+bool TypedBTreeIndex<T>::optimisticDelete(const T& key, const RecordId* rid, bool allowUnderflow)
+{
+	PageId leafPageId;
+	Page* leafPage;
+	PageLatch* leafLatch;
+	traverse(key, true, NULL, leafPageId, leafPage, leafLatch);
+
+	//a posting list always has two rids or more, so taking one rid out of it leaves the entry on the leaf
+	LeafNode<T>* leaf = (LeafNode<T>*) leafPage;
+	int index = leaf->lowerBound(key);
+	bool present = (index < leaf->numKeys && leaf->isKeyAt(index, key));
+	bool keepsEntry = (rid != NULL && present && leaf->ridAt(index).slot_number == POSTINGSLOT);
+	if(!allowUnderflow && present && !keepsEntry && !leaf->canLoseEntry(index)) {
+		leafLatch->unlockExclusive();
+		unPinPage(leafPageId, false);
+		return false;
+	}
+
+	bool entryRemoved;
+	if(!removeFromLeafPage(leafPageId, leafPage, key, rid, entryRemoved)) {
+		leafLatch->unlockExclusive();
+		unPinPage(leafPageId, false);
+		throw NoSuchKeyFoundException();
+	}
+
+	appendAction();
+	leafLatch->unlockExclusive();
+	unPinPage(leafPageId, true);
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::openScan
+// -----------------------------------------------------------------------------
+template <class T>
+ScanCursor* TypedBTreeIndex<T>::openScan(const void* lowValParm, const Operator lowOpParm, const void* highValParm, const Operator highOpParm, const ScanDirection direction) {
+	return openScan(KeyTraits<T>::fromPtr(lowValParm), lowOpParm, KeyTraits<T>::fromPtr(highValParm), highOpParm, direction);
+}
+
+template <class T>
+TypedScanCursor<T>* TypedBTreeIndex<T>::openScan(const T& lowValParm, const Operator lowOpParm, const T& highValParm, const Operator highOpParm, const ScanDirection direction) {
+	StatsScope scope(statsRegistry);
+	return new TypedScanCursor<T>(this, lowValParm, lowOpParm, highValParm, highOpParm, direction);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::openHeapOrderScan
+// -----------------------------------------------------------------------------
+template <class T>
+HeapOrderCursor* TypedBTreeIndex<T>::openHeapOrderScan(const void* lowValParm, const Operator lowOpParm, const void* highValParm, const Operator highOpParm, size_t memoryRids) {
+	ScanCursor* source = openScan(KeyTraits<T>::fromPtr(lowValParm), lowOpParm, KeyTraits<T>::fromPtr(highValParm), highOpParm);
+
+	//every cursor spills to a file of its own
+	return new HeapOrderCursor(bufMgr, spillFileName + std::to_string(spillCount.fetch_add(1)), source, memoryRids);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::startScan
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::startScan(const void* lowValParm, const Operator lowOpParm, const void* highValParm, const Operator highOpParm, const ScanDirection direction) {
+	startScan(KeyTraits<T>::fromPtr(lowValParm), lowOpParm, KeyTraits<T>::fromPtr(highValParm), highOpParm, direction);
+}
+
+template <class T>
+const void TypedBTreeIndex<T>::startScan(const T& lowValParm, const Operator lowOpParm, const T& highValParm, const Operator highOpParm, const ScanDirection direction) {
+	StatsScope scope(statsRegistry, STARTSCAN_LATENCY);
+	//a scan that is still executing is ended first
+	if(scan != NULL) endScan();
+
+	scan = openScan(lowValParm, lowOpParm, highValParm, highOpParm, direction);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::scanNext
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::scanNext(RecordId& outRid)
+{
+	if(scan == NULL) throw ScanNotInitializedException();
+
+	scan->scanNext(outRid);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::scanNextBatch
+// -----------------------------------------------------------------------------
+template <class T>
+size_t TypedBTreeIndex<T>::scanNextBatch(RecordId* out, size_t max)
+{
+	if(scan == NULL) throw ScanNotInitializedException();
+
+	return scan->scanNextBatch(out, max);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::scanNextEntries
+// -----------------------------------------------------------------------------
+template <class T>
+size_t TypedBTreeIndex<T>::scanNextEntries(RecordId* outRids, void* outKeys, void* outIncluded, size_t max)
+{
+	if(scan == NULL) throw ScanNotInitializedException();
+
+	return scan->scanNextEntries(outRids, (T*) outKeys, (char*) outIncluded, max);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::endScan
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::endScan()
+{
+	// Method terminates the current scan and  throws a ScanNotInitializedException if invoked before a succesful startScan call
+	if(scan == NULL){
+		throw ScanNotInitializedException();
+	}
+
+	// Unpinning all the pages that have been pinned for the purpose of scan
+	StatsScope scope(statsRegistry);
+	delete scan;
+	scan = NULL;
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::lookup
+// -----------------------------------------------------------------------------
+template <class T>
+bool TypedBTreeIndex<T>::lookup(const void* key, RecordId& outRid)
+{
+	return lookup(KeyTraits<T>::fromPtr(key), outRid);
+}
+
+template <class T>
+bool TypedBTreeIndex<T>::lookup(const T& key, RecordId& outRid)
+{
+	StatsScope scope(statsRegistry);
+	INDEX_STAT(lookups, 1);
+	PageId leafPageId;
+	Page* leafPage;
+	PageLatch* leafLatch;
+	traverse(key, false, NULL, leafPageId, leafPage, leafLatch);
+
+	bool found = findOnLeaf(leafPage, key, outRid);
+	leafLatch->unlockShared();
+	unPinPage(leafPageId, false);
+	return found;
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::lookupBatch
+// -----------------------------------------------------------------------------
+template <class T>
+size_t TypedBTreeIndex<T>::lookupBatch(const void* const* keys, size_t numKeys, RecordId* outRids, bool* found)
+{
+	StatsScope scope(statsRegistry);
+	INDEX_STAT(lookups, numKeys);
+	//in key order each key is on the leaf of the one before or under a node further right
+	std::vector<std::pair<T, size_t> > probes(numKeys);
+	for(size_t i = 0; i < numKeys; i++) probes[i] = std::make_pair(KeyTraits<T>::fromPtr(keys[i]), i);
+	std::sort(probes.begin(), probes.end());
+
+	//the nodes from the root down to the leaf of the last key, with the upper bound of the keys under each.
+	//latch coupling keeps the whole path latched, B_LINK only the leaf and relies on nodes never being freed
+	bool coupled = (concurrencyMode == LATCH_COUPLING);
+	std::vector<LatchedPage> path;
+	std::vector<T> highKeys;
+	std::vector<char> bounded;
+	bool atLeaf = false;
+	size_t numFound = 0;
+	for(size_t i = 0; i < numKeys; i++) {
+		const T& key = probes[i].first;
+
+		//go back up to the lowest node the key is still under and descend again from there
+		size_t keep = path.size();
+		while(keep > 1 && bounded[keep - 1] && !(key < highKeys[keep - 1])) keep--;
+		releaseLookupPath(path, keep, atLeaf);
+		highKeys.resize(path.size());
+		bounded.resize(path.size());
+
+		if(path.empty()) {
+			LatchedPage root;
+			rootLatch.lockShared();
+			root.pageNo = rootPageNum;
+			root.page = rootPage;
+			root.latch = latches.get(root.pageNo);
+			root.keepPinned = true;
+			if(coupled) root.latch->lockShared();
+			rootLatch.unlockShared();
+			if(!coupled) root.latch->lockShared();
+			path.push_back(root);
+			highKeys.push_back(T());
+			bounded.push_back(false);
+		} else if(!coupled && !atLeaf) {
+			path.back().latch->lockShared();
+		}
+
+		while(true) {
+			LatchedPage& node = path.back();
+			if(!coupled) {
+				//a node split since its parent was read only has its own high key to go by
+				PageId pageNo = node.pageNo;
+				bool pinned = !node.keepPinned;
+				if(atLeaf) moveRight<LeafNode<T> >(key, false, node.pageNo, node.page, node.latch, pinned);
+				else moveRight<NonLeafNode<T> >(key, false, node.pageNo, node.page, node.latch, pinned);
+				node.keepPinned = !pinned;
+				if(node.pageNo != pageNo) {
+					if(atLeaf) bounded.back() = ((LeafNode<T>*) node.page)->getHighKey(highKeys.back());
+					else bounded.back() = ((NonLeafNode<T>*) node.page)->getHighKey(highKeys.back());
+				}
+			}
+			if(atLeaf) break;
+
+			NonLeafNode<T>* parent = (NonLeafNode<T>*) node.page;
+			bool childIsLeaf = (parent->level == 1);
+			int slot = findIndexIntoPageNoArray(node.page, key);
+			T highKey = highKeys.back();
+			bool childBounded = bounded.back();
+			if(slot < parent->numKeys) {
+				highKey = parent->keyAt(slot);
+				childBounded = true;
+			}
+
+			LatchedPage child;
+			bool childPinned;
+			child.pageNo = parent->childAt(slot);
+			readNode(child.pageNo, !childIsLeaf && (int) path.size() < residentLevels, child.page, childPinned);
+			child.keepPinned = !childPinned;
+			child.latch = latches.get(child.pageNo);
+			if(!coupled) node.latch->unlockShared();
+			child.latch->lockShared();
+
+			path.push_back(child);
+			highKeys.push_back(highKey);
+			bounded.push_back(childBounded);
+			atLeaf = childIsLeaf;
+		}
+
+		size_t slot = probes[i].second;
+		found[slot] = findOnLeaf(path.back().page, key, outRids[slot]);
+		if(found[slot]) numFound++;
+	}
+	releaseLookupPath(path, 0, atLeaf);
+	return numFound;
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::releaseLookupPath
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::releaseLookupPath(std::vector<LatchedPage> &path, size_t keep, bool &atLeaf) {
+	while(path.size() > keep) {
+		//in B_LINK mode only the leaf is latched
+		if(concurrencyMode == LATCH_COUPLING || atLeaf) path.back().latch->unlockShared();
+		if(!path.back().keepPinned) unPinPage(path.back().pageNo, false);
+		path.pop_back();
+		atLeaf = false;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::findOnLeaf
+// -----------------------------------------------------------------------------
+template <class T>
+bool TypedBTreeIndex<T>::findOnLeaf(Page* leafPage, const T& key, RecordId& outRid)
+{
+	LeafNode<T>* leaf = (LeafNode<T>*) leafPage;
+	int index = leaf->lowerBound(key);
+	if(index == leaf->numKeys || !leaf->isKeyAt(index, key)) return false;
+
+	//posting lists are in ridLess order, so the first rid of a key is the first one of its list
+	outRid = leaf->ridAt(index);
+	if(outRid.slot_number == POSTINGSLOT) {
+		PageId pageNo = outRid.page_number;
+		Page* page;
+		readPage(pageNo, page);
+		outRid = ((PostingPage*) page)->ridArray[0];
+		unPinPage(pageNo, false);
+	}
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::countRange
+// -----------------------------------------------------------------------------
+template <class T>
+size_t TypedBTreeIndex<T>::countRange(const void* lowValParm, const Operator lowOpParm, const void* highValParm, const Operator highOpParm)
+{
+	return countRange(KeyTraits<T>::fromPtr(lowValParm), lowOpParm, KeyTraits<T>::fromPtr(highValParm), highOpParm);
+}
+
+template <class T>
+size_t TypedBTreeIndex<T>::countRange(const T& lowValParm, const Operator lowOpParm, const T& highValParm, const Operator highOpParm)
+{
+	StatsScope scope(statsRegistry);
+	if( !((lowOpParm == GT)||(lowOpParm == GTE)) || !((highOpParm == LT)||(highOpParm == LTE)) ) {
+		throw BadOpcodesException();
+	}
+	if(highValParm < lowValParm) {
+		throw BadScanrangeException();
+	}
+
+	//without counts every rid in the range is scanned
+	if(!counted) {
+		TypedScanCursor<T>* cursor;
+		try {
+			cursor = openScan(lowValParm, lowOpParm, highValParm, highOpParm);
+		} catch(const NoSuchKeyFoundException &e) {
+			return 0;
+		}
+		size_t count = 0;
+		RecordId rids[COUNTSCANBATCH];
+		size_t found;
+		while((found = cursor->scanNextBatch(rids, COUNTSCANBATCH)) > 0) count += found;
+		delete cursor;
+		return count;
+	}
+
+	//every writer of a counted index holds the root latched exclusively until it is done, so with the root latched
+	//shared nothing below it changes
+	rootLatch.lockShared();
+	PageId pageNo = rootPageNum;
+	Page* page = rootPage;
+	PageLatch* latch = latches.get(pageNo);
+	latch->lockShared();
+	rootLatch.unlockShared();
+
+	size_t count = countSubtree(page, false, 1, &lowValParm, lowOpParm, &highValParm, highOpParm);
+	latch->unlockShared();
+	return count;
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::estimateRange
+// -----------------------------------------------------------------------------
+template <class T>
+double TypedBTreeIndex<T>::estimateRange(const void* lowValParm, const Operator lowOpParm, const void* highValParm, const Operator highOpParm)
+{
+	return estimateRange(KeyTraits<T>::fromPtr(lowValParm), lowOpParm, KeyTraits<T>::fromPtr(highValParm), highOpParm);
+}
+
+template <class T>
+double TypedBTreeIndex<T>::estimateRange(const T& lowValParm, const Operator lowOpParm, const T& highValParm, const Operator highOpParm)
+{
+	if( !((lowOpParm == GT)||(lowOpParm == GTE)) || !((highOpParm == LT)||(highOpParm == LTE)) ) {
+		throw BadOpcodesException();
+	}
+	if(highValParm < lowValParm) {
+		throw BadScanrangeException();
+	}
+
+	//a file built before statistics were kept has nothing to estimate from
+	if(statistics == NULL) return countRange(lowValParm, lowOpParm, highValParm, highOpParm);
+	if(statistics->numBuckets == 0) return 0;
+
+	double lowPosition = KeyTraits<T>::position(lowValParm);
+	double highPosition = KeyTraits<T>::position(highValParm);
+	double estimate = 0;
+	for(int i = 0; i < statistics->numBuckets; i++) {
+		const T& first = statistics->bucketBounds[i];
+		const T& last = statistics->bucketBounds[i + 1];
+		bool firstInRange = (lowOpParm == GT ? lowValParm < first : lowValParm <= first) && (highOpParm == LT ? first < highValParm : first <= highValParm);
+		bool lastInRange = (lowOpParm == GT ? lowValParm < last : lowValParm <= last) && (highOpParm == LT ? last < highValParm : last <= highValParm);
+
+		//a bucket of a single key, or one the range covers, is in it whole
+		if(firstInRange && (lastInRange || !(first < last))) {
+			estimate += statistics->bucketCounts[i];
+			continue;
+		}
+
+		//otherwise the share of the bucket between its bounds the range overlaps
+		double firstPosition = KeyTraits<T>::position(first);
+		double lastPosition = KeyTraits<T>::position(last);
+		double overlap = std::min(highPosition, lastPosition) - std::max(lowPosition, firstPosition);
+		if(overlap > 0 && lastPosition > firstPosition) estimate += statistics->bucketCounts[i] * overlap / (lastPosition - firstPosition);
+	}
+
+	//a range narrower than the gaps between keys still holds an average key, if it is anywhere among the keys
+	const T& lowest = statistics->bucketBounds[0];
+	const T& highest = statistics->bucketBounds[statistics->numBuckets];
+	bool overlapsKeys = (lowOpParm == GT ? lowValParm < highest : lowValParm <= highest) && (highOpParm == LT ? lowest < highValParm : lowest <= highValParm);
+	double ridsPerKey = (double) statistics->numRids / std::max(1LL, statistics->distinctKeys);
+	if(overlapsKeys && estimate < ridsPerKey) estimate = ridsPerKey;
+	return std::min(estimate, (double) statistics->numRids);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::countSubtree
+// -----------------------------------------------------------------------------
+template <class T>
+size_t TypedBTreeIndex<T>::countSubtree(Page* page, bool isLeaf, int depth, const T* lowVal, const Operator lowOp, const T* highVal, const Operator highOp)
+{
+	if(isLeaf) {
+		LeafNode<T>* leaf = (LeafNode<T>*) page;
+		int start = (lowVal == NULL) ? 0 : (lowOp == GTE ? leaf->lowerBound(*lowVal) : leaf->upperBound(*lowVal));
+		int end = (highVal == NULL) ? leaf->numKeys : (highOp == LTE ? leaf->upperBound(*highVal) : leaf->lowerBound(*highVal));
+		size_t count = 0;
+		for(int i = start; i < end; i++) {
+			RecordId rid = leaf->ridAt(i);
+			count += (rid.slot_number == POSTINGSLOT) ? postingLength(rid.page_number) : 1;
+		}
+		return count;
+	}
+
+	//the children between the ones the bounds fall into are in the range as a whole
+	NonLeafNode<T>* node = (NonLeafNode<T>*) page;
+	int first = (lowVal == NULL) ? 0 : findIndexIntoPageNoArray(page, *lowVal);
+	int last = (highVal == NULL) ? node->numKeys : findIndexIntoPageNoArray(page, *highVal);
+	size_t count = 0;
+	for(int i = first + 1; i < last; i++) count += node->countAt(i);
+
+	//only the children the bounds fall into are read, the bound left of each is already met
+	bool childIsLeaf = (node->level == 1);
+	for(int i = first; i <= last; i += std::max(1, last - first)) {
+		Page* child;
+		bool pinned;
+		PageId childPageNo = node->childAt(i);
+		readNode(childPageNo, !childIsLeaf && depth < residentLevels, child, pinned);
+		count += countSubtree(child, childIsLeaf, depth + 1, i == first ? lowVal : NULL, lowOp, i == last ? highVal : NULL, highOp);
+		if(pinned) unPinPage(childPageNo, false);
+	}
+	return count;
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::setReadAhead
+// -----------------------------------------------------------------------------
+template <class T>
+void TypedBTreeIndex<T>::setReadAhead(int numLeaves)
+{
+	//mapped leaves are read where they are, there is nothing to fetch them into
+	if(mappedFile != NULL) return;
+
+	readAheadLeaves = numLeaves;
+	if(numLeaves > 0 && !readAheadThread.joinable()) readAheadThread = std::thread(&TypedBTreeIndex<T>::readAheadLoop, this);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::getReadAheadStats
+// -----------------------------------------------------------------------------
+template <class T>
+ReadAheadStats TypedBTreeIndex<T>::getReadAheadStats()
+{
+	std::lock_guard<std::mutex> guard(readAheadLatch);
+	return readAheadStats;
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::getStats
+// -----------------------------------------------------------------------------
+template <class T>
+IndexStats TypedBTreeIndex<T>::getStats(bool walkLeaves)
+{
+	IndexStats stats;
+	statsRegistry.read(stats);
+
+	//the pages read for the snapshot are not counted in it
+	treeShape(stats, walkLeaves);
+	return stats;
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::treeShape
+// -----------------------------------------------------------------------------
+template <class T>
+void TypedBTreeIndex<T>::treeShape(IndexStats &stats, bool walkLeaves)
+{
+	//splits only ever move keys right, so the leftmost child of every node stays where it is
+	rootLatch.lockShared();
+	PageId pageNo = rootPageNum;
+	Page* page = rootPage;
+	PageLatch* latch = latches.get(pageNo);
+	latch->lockShared();
+	rootLatch.unlockShared();
+
+	bool pinned = false;
+	int height = 1;
+	for(int depth = 1; ((NonLeafNode<T>*) page)->level != 1; depth++) {
+		PageId childPageId = ((NonLeafNode<T>*) page)->childAt(0);
+		Page* child;
+		bool childPinned;
+		readNode(childPageId, depth < residentLevels, child, childPinned);
+		PageLatch* childLatch = latches.get(childPageId);
+		childLatch->lockShared();
+		latch->unlockShared();
+		if(pinned) unPinPage(pageNo, false);
+
+		pageNo = childPageId;
+		page = child;
+		latch = childLatch;
+		pinned = childPinned;
+		height++;
+	}
+	PageId leafPageNo = ((NonLeafNode<T>*) page)->childAt(0);
+	latch->unlockShared();
+	if(pinned) unPinPage(pageNo, false);
+	stats.treeHeight = height + 1;
+
+	stats.numLeaves = -1;
+	stats.leafFill = -1;
+	if(!walkLeaves) return;
+
+	//leaves split or merged while the walk moves along may be counted twice or not at all
+	long long numLeaves = 0;
+	double fill = 0;
+	while(leafPageNo != NULL) {
+		Page* leafPage;
+		readPage(leafPageNo, leafPage);
+		PageLatch* leafLatch = latches.get(leafPageNo);
+		leafLatch->lockShared();
+		LeafNode<T>* leaf = (LeafNode<T>*) leafPage;
+		fill += leaf->fill();
+		PageId nextPageNo = leaf->rightSibPageNo;
+		leafLatch->unlockShared();
+		unPinPage(leafPageNo, false);
+
+		numLeaves++;
+		leafPageNo = nextPageNo;
+	}
+	stats.numLeaves = numLeaves;
+	stats.leafFill = fill / numLeaves;
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::readAheadLoop
+// -----------------------------------------------------------------------------
+template <class T>
+void TypedBTreeIndex<T>::readAheadLoop()
+{
+	//only this thread reads through it, at a queue depth of the read-ahead set last
+	AsyncPageReader* reader = NULL;
+
+	std::unique_lock<std::mutex> lock(readAheadLatch);
+	while(true) {
+		while(!readAheadStop && readAheadQueue.empty()) readAheadWork.wait(lock);
+		if(readAheadStop) break;
+
+		if(reader == NULL || reader->getQueueDepth() != readAheadLeaves) {
+			delete reader;
+			try {
+				reader = new AsyncPageReader(file->filename(), readAheadLeaves);
+			} catch(const FileNotFoundException &e) {
+				reader = NULL;
+			}
+		}
+
+		TypedScanCursor<T>* cursor = readAheadQueue.front();
+		readAheadQueue.pop_front();
+		fetchAhead(cursor, lock, reader);
+		cursor->readAheadQueued = false;
+		readAheadDone.notify_all();
+	}
+	lock.unlock();
+	delete reader;
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::fetchAhead
+// -----------------------------------------------------------------------------
+template <class T>
+void TypedBTreeIndex<T>::fetchAhead(TypedScanCursor<T>* cursor, std::unique_lock<std::mutex> &lock, AsyncPageReader* reader)
+{
+	while(cursor->readAheadNext != NULL && (int) cursor->readAheadPages.size() < readAheadLeaves) {
+		PageId pageNo = cursor->readAheadNext;
+		unsigned int generation = cursor->readAheadGeneration;
+		unsigned int fetchMergeCount = cursor->readAheadMergeCount;
+		int ahead = cursor->readAheadIssued > 0 ? cursor->readAheadIssued - 1 : 0;
+		lock.unlock();
+
+		//the read is what the scan would otherwise wait for. A pool full of pinned pages ends the read-ahead
+		Page* page;
+		try {
+			readPage(pageNo, page);
+		} catch(const BufferExceededException &e) {
+			lock.lock();
+			if(generation == cursor->readAheadGeneration) cursor->readAheadNext = NULL;
+			continue;
+		}
+
+		//a merge that freed the page bumps the merge count before it lets go of the latch
+		PageLatch* latch = latches.get(pageNo);
+		latch->lockShared();
+		bool valid = (mergeCount.load() == fetchMergeCount);
+		PageId nextPageNo = NULL;
+		bool hasKey = false;
+		T firstKey;
+		if(valid) {
+			LeafNode<T>* leaf = (LeafNode<T>*) page;
+			if(leaf->numKeys == 0 || cursor->withinHighBound(leaf->keyAt(0))) nextPageNo = leaf->rightSibPageNo;
+			if(leaf->numKeys > 0) {
+				hasKey = true;
+				firstKey = leaf->keyAt(0);
+			}
+		}
+		latch->unlockShared();
+
+		//the leaves the right links lead to next are read together, the parent of this one names them
+		if(reader != NULL && nextPageNo != NULL && hasKey && ahead == 0) ahead = prefetchLeaves(firstKey, readAheadLeaves, reader);
+
+		lock.lock();
+		if(!valid || generation != cursor->readAheadGeneration) {
+			//the scan has moved somewhere else meanwhile, it starts the read-ahead over from there
+			unPinPage(pageNo, false);
+			if(generation == cursor->readAheadGeneration) cursor->readAheadNext = NULL;
+			continue;
+		}
+		cursor->readAheadPages.push_back(std::make_pair(pageNo, page));
+		cursor->readAheadNext = nextPageNo;
+		cursor->readAheadIssued = ahead;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::prefetchLeaves
+// -----------------------------------------------------------------------------
+template <class T>
+int TypedBTreeIndex<T>::prefetchLeaves(const T& key, int count, AsyncPageReader* reader)
+{
+	bool coupled = (concurrencyMode == LATCH_COUPLING);
+
+	rootLatch.lockShared();
+	PageId pageNo = rootPageNum;
+	Page* page = rootPage;
+	PageLatch* latch = latches.get(pageNo);
+	if(coupled) latch->lockShared();
+	rootLatch.unlockShared();
+	if(!coupled) latch->lockShared();
+
+	bool pinned = false;
+	for(int depth = 1; ; depth++) {
+		if(!coupled) moveRight<NonLeafNode<T> >(key, false, pageNo, page, latch, pinned);
+		if(((NonLeafNode<T>*) page)->level == 1) break;
+
+		PageId childPageId = ((NonLeafNode<T>*) page)->childAt(findIndexIntoPageNoArray(page, key));
+		Page* child;
+		bool childPinned;
+		readNode(childPageId, depth < residentLevels, child, childPinned);
+		PageLatch* childLatch = latches.get(childPageId);
+		if(!coupled) {
+			latch->unlockShared();
+			if(pinned) unPinPage(pageNo, false);
+		}
+		childLatch->lockShared();
+		if(coupled) {
+			latch->unlockShared();
+			if(pinned) unPinPage(pageNo, false);
+		}
+
+		pageNo = childPageId;
+		page = child;
+		latch = childLatch;
+		pinned = childPinned;
+	}
+
+	//a page freed or split off once the latch is let go of is read for nothing, which does no harm
+	NonLeafNode<T>* node = (NonLeafNode<T>*) page;
+	std::vector<PageId> pageNos;
+	for(int i = findIndexIntoPageNoArray(page, key) + 1; i <= node->numKeys && (int) pageNos.size() < count; i++) {
+		pageNos.push_back(node->childAt(i));
+	}
+	latch->unlockShared();
+	if(pinned) unPinPage(pageNo, false);
+
+	if(!pageNos.empty()) reader->prefetch(&pageNos[0], (int) pageNos.size());
+	return (int) pageNos.size();
+}
+
+// -----------------------------------------------------------------------------
+// TypedScanCursor::TypedScanCursor -- Constructor
+// -----------------------------------------------------------------------------
+template <class T>
+TypedScanCursor<T>::TypedScanCursor(TypedBTreeIndex<T>* index, const T& lowValParm, const Operator lowOpParm, const T& highValParm, const Operator highOpParm, const ScanDirection direction) {
+	this->index = index;
+	this->direction = direction;
+	completed = false;
+
+	//set the local values for this class to the values passed in
+	lowOp = lowOpParm;
+	highOp = highOpParm;
+
+	// lowOp must be either GT/GTE and highOp must be LT/LTE. BadOpCodesException is thrown if that is not the case.
+	if( !((lowOp == GT)||(lowOp == GTE)) || !((highOp == LT)||(highOp == LTE)) ) {
+		throw BadOpcodesException();
+	}
+
+	lowVal = lowValParm;
+	highVal = highValParm;
+
+	// Method throws exception if lower bound > upper bound
+	if(highVal < lowVal) {
+		throw BadScanrangeException();
+	}
+
+	readAheadNext = NULL;
+	readAheadMergeCount = 0;
+	readAheadGeneration = 0;
+	readAheadQueued = false;
+	readAheadIssued = 0;
+
+	//traverse to get to the leaf the low value is on, or the high value for a descending scan
+	const T& startVal = (direction == ASCENDING) ? lowVal : highVal;
+	index->traverse(startVal, false, NULL, currentPageNum, currentPageData, currentLatch);
+
+	//find the first record, possibly on a leaf further right, or further left
+	resumeKey = startVal;
+	resumeInclusive = (direction == ASCENDING) ? (lowOp == GTE) : (highOp == LTE);
+	resumeRid.page_number = UINT_MAX;
+	resumeRid.slot_number = USHRT_MAX;
+	postingPageNo = NULL;
+	postingIndex = 0;
+	if(!seekNextEntry(true)) {
+		currentLatch->unlockShared();
+		index->unPinPage(currentPageNum, false);
+		stopReadAhead();
+		throw NoSuchKeyFoundException();
+	}
+	readAhead();
+
+	//keep the leaf pinned but let writers at it between calls
+	scanVersion = currentLatch->getVersion();
+	scanMergeCount = index->mergeCount.load();
+	currentLatch->unlockShared();
+}
+
+// -----------------------------------------------------------------------------
+// TypedScanCursor::~TypedScanCursor -- destructor
+// -----------------------------------------------------------------------------
+template <class T>
+TypedScanCursor<T>::~TypedScanCursor()
+{
+	StatsScope scope(index->statsRegistry);
+	index->unPinPage(currentPageNum, false);
+	stopReadAhead();
+}
+
+// -----------------------------------------------------------------------------
+// TypedScanCursor::readAhead
+// -----------------------------------------------------------------------------
+template <class T>
+void TypedScanCursor<T>::readAhead()
+{
+	//the read-ahead only fetches leaves to the right
+	if(index->readAheadLeaves == 0 || direction == DESCENDING) return;
+
+	LeafNode<T>* leaf = (LeafNode<T>*) currentPageData;
+	std::lock_guard<std::mutex> guard(index->readAheadLatch);
+	if(readAheadNext == NULL && readAheadPages.empty()) {
+		//start over right of this leaf, unless the scan ends on it
+		if(leaf->rightSibPageNo == NULL) return;
+		if(leaf->numKeys > 0 && !withinHighBound(leaf->keyAt(leaf->numKeys - 1))) return;
+		readAheadNext = leaf->rightSibPageNo;
+		readAheadMergeCount = index->mergeCount.load();
+		readAheadIssued = 0;
+	}
+	if(readAheadQueued || readAheadNext == NULL || (int) readAheadPages.size() >= index->readAheadLeaves) return;
+
+	readAheadQueued = true;
+	index->readAheadQueue.push_back(this);
+	index->readAheadWork.notify_one();
+}
+
+// -----------------------------------------------------------------------------
+// TypedScanCursor::takeReadAhead
+// -----------------------------------------------------------------------------
+template <class T>
+bool TypedScanCursor<T>::takeReadAhead(PageId pageNo, Page* &page)
+{
+	if(index->readAheadLeaves == 0) return false;
+
+	std::lock_guard<std::mutex> guard(index->readAheadLatch);
+	if(!readAheadPages.empty() && readAheadPages.front().first == pageNo) {
+		page = readAheadPages.front().second;
+		readAheadPages.pop_front();
+		index->readAheadStats.hits++;
+		return true;
+	}
+	index->readAheadStats.misses++;
+
+	//the read-ahead is behind, or leaves split or merged since they were fetched, or the scan went down the tree
+	//again. Either way it starts over from the leaf the scan moves on to
+	for(size_t i = 0; i < readAheadPages.size(); i++) index->unPinPage(readAheadPages[i].first, false);
+	readAheadPages.clear();
+	readAheadNext = NULL;
+	readAheadIssued = 0;
+	readAheadGeneration++;
+	return false;
+}
+
+// -----------------------------------------------------------------------------
+// TypedScanCursor::stopReadAhead
+// -----------------------------------------------------------------------------
+template <class T>
+void TypedScanCursor<T>::stopReadAhead()
+{
+	std::unique_lock<std::mutex> lock(index->readAheadLatch);
+	readAheadNext = NULL;
+	readAheadGeneration++;
+
+	//still waiting for the read-ahead thread, or being fetched for
+	std::deque<TypedScanCursor<T>*> &queue = index->readAheadQueue;
+	typename std::deque<TypedScanCursor<T>*>::iterator it = std::find(queue.begin(), queue.end(), this);
+	if(it != queue.end()) {
+		queue.erase(it);
+		readAheadQueued = false;
+	}
+	while(readAheadQueued) index->readAheadDone.wait(lock);
+
+	for(size_t i = 0; i < readAheadPages.size(); i++) index->unPinPage(readAheadPages[i].first, false);
+	readAheadPages.clear();
+}
+
+// -----------------------------------------------------------------------------
+// TypedScanCursor::resumeScan
+// -----------------------------------------------------------------------------
+template <class T>
+bool TypedScanCursor<T>::resumeScan()
+{
+	if(currentLatch->getVersion() == scanVersion) return seekNextEntry(false);
+
+	//inserts only ever move entries right, where seekNextEntry looks for them anyway. Moving left, it only finds
+	//them as long as the leaf still covers resumeKey
+	LeafNode<T>* leaf = (LeafNode<T>*) currentPageData;
+	if(index->mergeCount.load() == scanMergeCount && (direction == ASCENDING || !leaf->pastHighKey(resumeKey))) return seekNextEntry(true);
+
+	//the entries may have gone to another leaf and the page may not even be a leaf any more
+	currentLatch->unlockShared();
+	index->unPinPage(currentPageNum, false);
+	index->traverse(resumeKey, false, NULL, currentPageNum, currentPageData, currentLatch);
+	return seekNextEntry(true);
+}
+
+// -----------------------------------------------------------------------------
+// TypedScanCursor::seekNextEntry
+// -----------------------------------------------------------------------------
+template <class T>
+bool TypedScanCursor<T>::seekNextEntry(bool search)
+{
+	LeafNode<T>* leaf = (LeafNode<T>*) currentPageData;
+	if(search) seekResumePoint();
+
+	//bring in the next page once this one is used up, coupling the latches left to right, or the page on the left
+	while(nextEntry >= leaf->numKeys || nextEntry < 0) {
+		if(nextEntry < 0) {
+			if(!moveLeft()) return false;
+			leaf = (LeafNode<T>*) currentPageData;
+			continue;
+		}
+		if(leaf->rightSibPageNo == NULL) return false;
+
+		Page* nextPage;
+		PageId nextPageId = leaf->rightSibPageNo;
+		if(!takeReadAhead(nextPageId, nextPage)) index->readPage(nextPageId, nextPage);
+		PageLatch* nextLatch = index->latches.get(nextPageId);
+		nextLatch->lockShared();
+
+		//unlatch and unpin the previous page
+		currentLatch->unlockShared();
+		index->unPinPage(currentPageNum, false);
+		currentPageData = nextPage;
+		currentPageNum = nextPageId;
+		currentLatch = nextLatch;
+
+		//a split may have moved entries we already returned onto this leaf
+		leaf = (LeafNode<T>*) nextPage;
+		seekResumePoint();
+		readAhead();
+	}
+
+	//check if the next value is still within the criteria for the scan
+	return withinEndBound(leaf->keyAt(nextEntry));
+}
+
+// -----------------------------------------------------------------------------
+// TypedScanCursor::moveLeft
+// -----------------------------------------------------------------------------
+template <class T>
+bool TypedScanCursor<T>::moveLeft()
+{
+	LeafNode<T>* leaf = (LeafNode<T>*) currentPageData;
+	PageId leftPageId = leaf->leftSibPageNo;
+	if(leftPageId == NULL) return false;
+
+	//writers latch leaves left to right, so this one is let go of before the one on its left is latched
+	unsigned int mergeCount = index->mergeCount.load();
+	currentLatch->unlockShared();
+	Page* leftPage;
+	index->readPage(leftPageId, leftPage);
+	PageLatch* leftLatch = index->latches.get(leftPageId);
+	leftLatch->lockShared();
+
+	//a split of the left leaf puts a new one in between, a merge may have freed either page
+	if(index->mergeCount.load() != mergeCount || ((LeafNode<T>*) leftPage)->rightSibPageNo != currentPageNum) {
+		leftLatch->unlockShared();
+		index->unPinPage(leftPageId, false);
+		index->unPinPage(currentPageNum, false);
+		index->traverse(resumeKey, false, NULL, currentPageNum, currentPageData, currentLatch);
+	} else {
+		index->unPinPage(currentPageNum, false);
+		currentPageData = leftPage;
+		currentPageNum = leftPageId;
+		currentLatch = leftLatch;
+	}
+	seekResumePoint();
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// TypedScanCursor::seekResumePoint
+// -----------------------------------------------------------------------------
+template <class T>
+void TypedScanCursor<T>::seekResumePoint()
+{
+	LeafNode<T>* leaf = (LeafNode<T>*) currentPageData;
+	nextEntry = leaf->lowerBound(resumeKey);
+	postingPageNo = NULL;
+	postingIndex = 0;
+	bool onKey = (nextEntry < leaf->numKeys && leaf->isKeyAt(nextEntry, resumeKey));
+
+	//a descending scan goes on left of the key unless it has rids left to return
+	if(direction == DESCENDING && !onKey) nextEntry--;
+	if(resumeInclusive || !onKey) return;
+
+	//the key the scan stopped in may have more rids, after the last one returned
+	RecordId entryRid = leaf->ridAt(nextEntry);
+	if(entryRid.slot_number != POSTINGSLOT) {
+		if(!ridLess(resumeRid, entryRid)) nextEntry += entryStep();
+		return;
+	}
+
+	PageId pageNo = entryRid.page_number;
+	while(pageNo != NULL) {
+		Page* page;
+		index->readPage(pageNo, page);
+		PostingPage* posting = (PostingPage*) page;
+		if(ridLess(resumeRid, posting->ridArray[posting->numRids - 1])) {
+			postingPageNo = pageNo;
+			postingIndex = std::upper_bound(posting->ridArray, posting->ridArray + posting->numRids, resumeRid, ridLess) - posting->ridArray;
+			index->unPinPage(pageNo, false);
+			return;
+		}
+		PageId nextPageNo = posting->nextPageNo;
+		index->unPinPage(pageNo, false);
+		pageNo = nextPageNo;
+	}
+	nextEntry += entryStep();
+}
+
+// -----------------------------------------------------------------------------
+// TypedScanCursor::readPosting
+// -----------------------------------------------------------------------------
+template <class T>
+size_t TypedScanCursor<T>::readPosting(RecordId* out, size_t max)
+{
+	LeafNode<T>* leaf = (LeafNode<T>*) currentPageData;
+	PageId pageNo = (postingPageNo != NULL) ? postingPageNo : leaf->ridAt(nextEntry).page_number;
+	size_t numOut = 0;
+	while(numOut < max) {
+		Page* page;
+		index->readPage(pageNo, page);
+		PostingPage* posting = (PostingPage*) page;
+
+		size_t count = std::min((size_t) (posting->numRids - postingIndex), max - numOut);
+		memcpy(out + numOut, posting->ridArray + postingIndex, count * sizeof(RecordId));
+		numOut += count;
+		postingIndex += (int) count;
+
+		bool pageDone = (postingIndex == posting->numRids);
+		PageId nextPageNo = posting->nextPageNo;
+		index->unPinPage(pageNo, false);
+		if(!pageDone) {
+			postingPageNo = pageNo;
+			break;
+		}
+
+		postingIndex = 0;
+		if(nextPageNo == NULL) {
+			//the list is used up, the next entry of the leaf is next
+			postingPageNo = NULL;
+			break;
+		}
+		pageNo = nextPageNo;
+		postingPageNo = pageNo;
+	}
+
+	resumeKey = leaf->keyAt(nextEntry);
+	resumeRid = out[numOut - 1];
+	resumeInclusive = false;
+	if(postingPageNo == NULL) nextEntry += entryStep();
+	return numOut;
+}
+
+// -----------------------------------------------------------------------------
+// TypedScanCursor::scanNext
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedScanCursor<T>::scanNext(RecordId& outRid)
+{
+	StatsScope scope(index->statsRegistry, SCANNEXT_LATENCY);
+
+    //if the previous scan next completed the scan we are done scanning so throw the exception
+	if(completed) throw  IndexScanCompletedException();
+
+	currentLatch->lockShared();
+	if(!resumeScan()) {
+		currentLatch->unlockShared();
+		completed = true;
+		throw  IndexScanCompletedException();
+	}
+
+	LeafNode<T>* leaf = (LeafNode<T>*) currentPageData;
+	if(leaf->ridAt(nextEntry).slot_number == POSTINGSLOT) {
+		readPosting(&outRid, 1);
+	} else {
+		outRid = leaf->ridAt(nextEntry);
+		resumeKey = leaf->keyAt(nextEntry);
+		resumeRid = outRid;
+		resumeInclusive = false;
+		nextEntry += entryStep();
+	}
+
+	scanVersion = currentLatch->getVersion();
+	scanMergeCount = index->mergeCount.load();
+	currentLatch->unlockShared();
+}
+
+// -----------------------------------------------------------------------------
+// TypedScanCursor::scanNextBatch
+// -----------------------------------------------------------------------------
+template <class T>
+size_t TypedScanCursor<T>::scanNextBatch(RecordId* out, size_t max)
+{
+	StatsScope scope(index->statsRegistry);
+	return readEntries(out, NULL, NULL, max);
+}
+
+// -----------------------------------------------------------------------------
+// TypedScanCursor::scanNextEntries
+// -----------------------------------------------------------------------------
+template <class T>
+size_t TypedScanCursor<T>::scanNextEntries(RecordId* outRids, T* outKeys, char* outIncluded, size_t max)
+{
+	StatsScope scope(index->statsRegistry);
+	if(outIncluded != NULL && index->includedLength == 0) throw BadIndexInfoException("Index has no included columns");
+	return readEntries(outRids, outKeys, outIncluded, max);
+}
+
+// -----------------------------------------------------------------------------
+// TypedScanCursor::readEntries
+// -----------------------------------------------------------------------------
+template <class T>
+size_t TypedScanCursor<T>::readEntries(RecordId* out, T* outKeys, char* outIncluded, size_t max)
+{
+	if(completed || max == 0) return 0;
+
+	currentLatch->lockShared();
+	bool resumed = false;
+	size_t numOut = 0;
+	int step = entryStep();
+	while(numOut < max) {
+		if(!(resumed ? seekNextEntry(false) : resumeScan())) {
+			completed = true;
+			break;
+		}
+		resumed = true;
+		size_t leafStart = numOut;
+
+		//if the last key of the leaf in scan order is in range all of them are, otherwise find where the scan ends
+		LeafNode<T>* leaf = (LeafNode<T>*) currentPageData;
+		int leafEnd = (direction == ASCENDING) ? leaf->numKeys : -1;
+		int end = withinEndBound(leaf->keyAt(leafEnd - step)) ? leafEnd : endOfScan();
+		int last = ((size_t) ((end - nextEntry) * step) <= max - numOut) ? end : nextEntry + step * (int) (max - numOut);
+
+		//copy the rids kept on the leaf, up to a key with a posting list
+		int i = nextEntry;
+		while(i != last && leaf->ridAt(i).slot_number != POSTINGSLOT) {
+			out[numOut++] = leaf->ridAt(i);
+			i += step;
+		}
+		if(outKeys != NULL) {
+			for(int k = nextEntry; k != i; k += step) outKeys[numOut - (i - k) * step] = leaf->keyAt(k);
+		}
+		if(i != nextEntry) {
+			resumeKey = leaf->keyAt(i - step);
+			resumeRid = leaf->ridAt(i - step);
+			resumeInclusive = false;
+			nextEntry = i;
+		}
+		if(i != last) {
+			//every rid of a posting list has the key of its entry, readPosting leaves it in resumeKey
+			size_t numPosting = readPosting(out + numOut, max - numOut);
+			if(outKeys != NULL) std::fill(outKeys + numOut, outKeys + numOut + numPosting, resumeKey);
+			numOut += numPosting;
+		}
+
+		//the included columns of what was just copied are on the pages of rows of this leaf
+		if(outIncluded != NULL && numOut > leafStart) {
+			index->getIncludedRows(leaf->includedPageNo, out + leafStart, numOut - leafStart, outIncluded + leafStart * index->includedLength);
+		}
+		if(i != last) continue;
+
+		if(last != leafEnd && last == end) {
+			completed = true;
 			break;
 		}
-		case STRING: {
-			std::string key = *((std::string*) keyPtr);
-			LeafNodeString* leaf = (LeafNodeString*) page;
-			for(int i = 0; i < leafOccupancy; i++) {
-				if(strcmp(leaf->keyArray[0], "") == 0 || strcmp(key.c_str(), leaf->keyArray[0]) < 0) return 0;
-                else if(strcmp(key.c_str(), leaf->keyArray[i]) == 0) throw DuplicateKeyException();
-				else if(strcmp(key.c_str(), leaf->keyArray[i]) > 0 && i != leafOccupancy - 1 && strcmp(key.c_str(), leaf->keyArray[i + 1]) < 0) return i + 1;
-				else if(strcmp(key.c_str(), leaf->keyArray[i]) > 0 && (i == leafOccupancy - 1 || strcmp(leaf->keyArray[i + 1], "") == 0)) return i + 1;
-			}
-			break;
+	}
+
+	scanVersion = currentLatch->getVersion();
+	scanMergeCount = index->mergeCount.load();
+	currentLatch->unlockShared();
+	return numOut;
+}
+
+// -----------------------------------------------------------------------------
+// TypedScanCursor::endOfScan
+// -----------------------------------------------------------------------------
+template <class T>
+int TypedScanCursor<T>::endOfScan() const
+{
+	const LeafNode<T>* leaf = (const LeafNode<T>*) currentPageData;
+	if(direction == ASCENDING) return (highOp == LT) ? leaf->lowerBound(highVal) : leaf->upperBound(highVal);
+	return ((lowOp == GT) ? leaf->upperBound(lowVal) : leaf->lowerBound(lowVal)) - 1;
+}
+
+// -----------------------------------------------------------------------------
+// Heap order scans
+// -----------------------------------------------------------------------------
+
+/**
+ * Orders the heads of the runs of rids being merged so the smallest rid is on top of the heap
+ */
+struct RidRunHeadGreater {
+	bool operator()(const std::pair<RecordId, int> &a, const std::pair<RecordId, int> &b) const {
+		return ridLess(b.first, a.first);
+	}
+};
+
+// -----------------------------------------------------------------------------
+// HeapOrderCursor::HeapOrderCursor
+// -----------------------------------------------------------------------------
+HeapOrderCursor::HeapOrderCursor(BufMgr* bufMgr, const std::string& spillFileName, ScanCursor* source, size_t memoryRids)
+	: bufMgr(bufMgr), spillFileName(spillFileName), spillFile(NULL), nextRid(0)
+{
+	if(memoryRids == 0) memoryRids = 1;
+
+	try {
+		//take the rids off the scan a batch at a time, straight into the sort buffer
+		while(true) {
+			if(rids.size() == memoryRids) writeRun();
+			size_t numRids = rids.size();
+			rids.resize(std::min(memoryRids, numRids + COUNTSCANBATCH));
+			size_t found = source->scanNextBatch(&rids[numRids], rids.size() - numRids);
+			rids.resize(numRids + found);
+			if(found == 0) break;
+		}
+		delete source;
+		source = NULL;
+
+		if(spillFile == NULL) {
+			std::sort(rids.begin(), rids.end(), ridLess);
+			return;
+		}
+
+		//the rids left in memory make the last run, then groups of runs are merged into longer runs until they can all be merged at once
+		if(!rids.empty()) writeRun();
+		std::vector<RecordId>().swap(rids);
+		while((int) runFirstPage.size() > BULKLOADMERGEFANIN) {
+			std::vector<PageId> mergedRuns;
+			for(int r = 0; r < (int) runFirstPage.size(); r += BULKLOADMERGEFANIN) {
+				SortRunWriter<RidRunPage> writer(bufMgr, spillFile);
+				startMerge(r, std::min(r + BULKLOADMERGEFANIN, (int) runFirstPage.size()));
+				RecordId rid;
+				while(peekRid(rid)) {
+					writer.add(rid);
+					advanceMerge();
+				}
+				writer.finish();
+				mergedRuns.push_back(writer.firstPageNo);
+			}
+			runFirstPage.swap(mergedRuns);
+		}
+		startMerge(0, (int) runFirstPage.size());
+	} catch(...) {
+		delete source;
+		try {
+			removeSpillFile();
+		} catch(...) {
+		}
+		throw;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// HeapOrderCursor::~HeapOrderCursor
+// -----------------------------------------------------------------------------
+HeapOrderCursor::~HeapOrderCursor()
+{
+	removeSpillFile();
+}
+
+// -----------------------------------------------------------------------------
+// HeapOrderCursor::writeRun
+// -----------------------------------------------------------------------------
+void HeapOrderCursor::writeRun()
+{
+	if(spillFile == NULL) spillFile = createSortFile(spillFileName);
+
+	std::sort(rids.begin(), rids.end(), ridLess);
+	SortRunWriter<RidRunPage> writer(bufMgr, spillFile);
+	for(size_t i = 0; i < rids.size(); i++) writer.add(rids[i]);
+	writer.finish();
+
+	runFirstPage.push_back(writer.firstPageNo);
+	rids.clear();
+}
+
+// -----------------------------------------------------------------------------
+// HeapOrderCursor::startMerge
+// -----------------------------------------------------------------------------
+void HeapOrderCursor::startMerge(int firstRun, int lastRun)
+{
+	int numRuns = lastRun - firstRun;
+	mergePageNo.assign(numRuns, NULL);
+	mergePage.assign(numRuns, NULL);
+	mergeNextEntry.assign(numRuns, 0);
+	mergeHeads.clear();
+
+	//pin the first page of every run and queue up its first rid, no run is empty
+	for(int r = 0; r < numRuns; r++) {
+		Page* runPage;
+		bufReadPage(bufMgr, spillFile, runFirstPage[firstRun + r], runPage);
+		mergePageNo[r] = runFirstPage[firstRun + r];
+		mergePage[r] = (RidRunPage*) runPage;
+		mergeHeads.push_back(std::make_pair(mergePage[r]->entries[0], r));
+	}
+	std::make_heap(mergeHeads.begin(), mergeHeads.end(), RidRunHeadGreater());
+}
+
+// -----------------------------------------------------------------------------
+// HeapOrderCursor::advanceMerge
+// -----------------------------------------------------------------------------
+void HeapOrderCursor::advanceMerge()
+{
+	std::pop_heap(mergeHeads.begin(), mergeHeads.end(), RidRunHeadGreater());
+	int r = mergeHeads.back().second;
+	mergeHeads.pop_back();
+
+	//move on to the next rid of that run, and to the next page of the run when this one is used up
+	mergeNextEntry[r]++;
+	if(mergeNextEntry[r] == mergePage[r]->numEntries) {
+		PageId nextPageNo = mergePage[r]->nextPageNo;
+		bufUnPinPage(bufMgr, spillFile, mergePageNo[r], false);
+		mergePageNo[r] = NULL;
+		if(nextPageNo == NULL) return;
+
+		Page* runPage;
+		bufReadPage(bufMgr, spillFile, nextPageNo, runPage);
+		mergePageNo[r] = nextPageNo;
+		mergePage[r] = (RidRunPage*) runPage;
+		mergeNextEntry[r] = 0;
+	}
+	mergeHeads.push_back(std::make_pair(mergePage[r]->entries[mergeNextEntry[r]], r));
+	std::push_heap(mergeHeads.begin(), mergeHeads.end(), RidRunHeadGreater());
+}
+
+// -----------------------------------------------------------------------------
+// HeapOrderCursor::peekRid
+// -----------------------------------------------------------------------------
+bool HeapOrderCursor::peekRid(RecordId& outRid) const
+{
+	if(spillFile == NULL) {
+		if(nextRid == rids.size()) return false;
+		outRid = rids[nextRid];
+		return true;
+	}
+
+	if(mergeHeads.empty()) return false;
+	outRid = mergeHeads.front().first;
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// HeapOrderCursor::removeSpillFile
+// -----------------------------------------------------------------------------
+void HeapOrderCursor::removeSpillFile()
+{
+	if(spillFile == NULL) return;
+
+	for(size_t r = 0; r < mergePageNo.size(); r++) {
+		if(mergePageNo[r] != NULL) bufUnPinPage(bufMgr, spillFile, mergePageNo[r], false);
+	}
+	mergePageNo.clear();
+	mergeHeads.clear();
+
+	bufFlushFile(bufMgr, spillFile);
+	delete spillFile;
+	spillFile = NULL;
+	File::remove(spillFileName);
+}
+
+// -----------------------------------------------------------------------------
+// HeapOrderCursor::scanNext
+// -----------------------------------------------------------------------------
+const void HeapOrderCursor::scanNext(RecordId& outRid)
+{
+	if(!peekRid(outRid)) throw IndexScanCompletedException();
+
+	if(spillFile == NULL) nextRid++;
+	else advanceMerge();
+}
+
+// -----------------------------------------------------------------------------
+// HeapOrderCursor::scanNextBatch
+// -----------------------------------------------------------------------------
+size_t HeapOrderCursor::scanNextBatch(RecordId* out, size_t max)
+{
+	if(spillFile == NULL) {
+		size_t numOut = std::min(max, rids.size() - nextRid);
+		std::copy(rids.begin() + nextRid, rids.begin() + nextRid + numOut, out);
+		nextRid += numOut;
+		return numOut;
+	}
+
+	size_t numOut = 0;
+	while(numOut < max && peekRid(out[numOut])) {
+		advanceMerge();
+		numOut++;
+	}
+	return numOut;
+}
+
+// -----------------------------------------------------------------------------
+// HeapOrderCursor::scanNextPage
+// -----------------------------------------------------------------------------
+size_t HeapOrderCursor::scanNextPage(RecordId* out, size_t max)
+{
+	size_t numOut = 0;
+	RecordId rid;
+	while(numOut < max && peekRid(rid) && (numOut == 0 || rid.page_number == out[0].page_number)) {
+		out[numOut++] = rid;
+		if(spillFile == NULL) nextRid++;
+		else advanceMerge();
+	}
+	return numOut;
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::insertIntoNonLeafPage
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::insertIntoNonLeafPage(Page* page, const T& key, PageId pageId, unsigned int count) {
+	NonLeafNode<T>* node = (NonLeafNode<T>*) page;
+
+	//the new child goes right of the key that separates it from the child that split
+	node->insertAt(node->upperBound(key), key, pageId, count);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::insertIntoLeafPage
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::insertIntoLeafPage(PageId pageNo, Page* page, const T& key, const RecordId rid, const char* includedBytes, bool &restructured, PageId &newPageId, T &middleKey) {
+	LeafNode<T>* leaf = (LeafNode<T>*) page;
+	int index = findIndexIntoKeyArray(page, key);
+	PageId includedPageNo = leaf->includedPageNo;
+
+	if(index < leaf->numKeys && leaf->isKeyAt(index, key)) {
+		//the leaf itself only changes when the key starts its posting list, or its rows start a new first page
+		RecordId entryRid = leaf->ridAt(index);
+		addToPosting(leaf->ridAt(index), rid);
+		if(includedBytes != NULL) putIncludedRow(leaf->includedPageNo, rid, includedBytes);
+		if(!(leaf->ridAt(index) == entryRid) || leaf->includedPageNo != includedPageNo) logPage(pageNo, page);
+		restructured = false;
+		return;
+	}
+
+	if(!leaf->hasRoom(key)) {
+		restructureLeaf(pageNo, page, index, key, rid, includedBytes, newPageId, middleKey);
+		logPage(pageNo, page);
+		restructured = true;
+		return;
+	}
+
+	//a leaf whose rows start a new first page is logged whole, and the entry with it
+	if(includedBytes != NULL) {
+		putIncludedRow(leaf->includedPageNo, rid, includedBytes);
+		if(leaf->includedPageNo != includedPageNo) logPage(pageNo, page);
+	}
+	leaf->insertAt(index, key, rid);
+	logLeafChange(LOGLEAFINSERT, pageNo, page, key, rid);
+	restructured = false;
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::restructureLeaf
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::restructureLeaf(PageId fullPageNo, Page* fullPage, int index, const T& key, const RecordId rid, const char* includedBytes, PageId &newPageId, T &middleKey) {
+	INDEX_STAT(leafSplits, 1);
+	LeafNode<T>* leaf = (LeafNode<T>*) fullPage;
+
+	//lay the entries out with the new one in its place
+	std::vector<RIDKeyPair<T> > entries;
+	leaf->getEntries(entries);
+	RIDKeyPair<T> pair;
+	pair.set(rid, key);
+	entries.insert(entries.begin() + index, pair);
+
+	T lowKey, highKey;
+	const T* low = leaf->getLowKey(lowKey) ? &lowKey : NULL;
+	const T* high = leaf->getHighKey(highKey) ? &highKey : NULL;
+
+	//the new leaf takes the greater half of the entries, the separator between the halves is copied up into the parent
+	int split = splitLeafEntries(entries, low, high, middleKey);
+
+	Page* newPage;
+	allocNode(newPageId, newPage);
+	LeafNode<T>* newLeaf = (LeafNode<T>*) newPage;
+	newLeaf->init();
+	newLeaf->build(&middleKey, high, entries.data() + split, entries.size() - split);
+	leaf->build(low, &middleKey, entries.data(), split);
+
+	//the rows of included columns follow their entries, the new one included
+	moveIncludedRows(fullPage, newPage, false);
+	if(includedBytes != NULL) putIncludedRow((index < split ? leaf : newLeaf)->includedPageNo, rid, includedBytes);
+
+	//the new leaf goes right after the full one in the chain and takes over its high key
+	newLeaf->rightSibPageNo = leaf->rightSibPageNo;
+	newLeaf->leftSibPageNo = fullPageNo;
+	leaf->rightSibPageNo = newPageId;
+	setLeftSibling(newLeaf->rightSibPageNo, newPageId);
+
+	logPage(newPageId, newPage);
+	unPinPage(newPageId, true);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::setLeftSibling
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::setLeftSibling(PageId pageNo, PageId leftPageNo) {
+	if(pageNo == NULL) return;
+
+	Page* page;
+	readPage(pageNo, page);
+	PageLatch* latch = latches.get(pageNo);
+	latch->lockExclusive();
+	((LeafNode<T>*) page)->leftSibPageNo = leftPageNo;
+	logPage(pageNo, page);
+	latch->unlockExclusive();
+	unPinPage(pageNo, true);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::restructureNonLeaf
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::restructureNonLeaf(Page* fullPage, const T& key, PageId newPageIdFromChild, unsigned int countFromChild, PageId &newPageId, T &middleKey) {
+	INDEX_STAT(nonLeafSplits, 1);
+	NonLeafNode<T>* node = (NonLeafNode<T>*) fullPage;
+
+	//lay the keys and pages out as if the node had room for one more key
+	std::vector<PageKeyPair<T> > entries;
+	node->getEntries(entries);
+	PageKeyPair<T> pair;
+	pair.set(newPageIdFromChild, key, countFromChild);
+	entries.insert(entries.begin() + node->upperBound(key) + 1, pair);
+
+	T lowKey, highKey;
+	const T* low = node->getLowKey(lowKey) ? &lowKey : NULL;
+	const T* high = node->getHighKey(highKey) ? &highKey : NULL;
+
+	//the middle key moves up into the parent, the keys after it go to the new node
+	int split = splitNonLeafEntries(entries, low, high);
+	middleKey = entries[split].key;
+
+	Page* newPage;
+	allocNode(newPageId, newPage);
+	NonLeafNode<T>* newNode = (NonLeafNode<T>*) newPage;
+	newNode->init(node->level);
+	newNode->build(&middleKey, high, entries.data() + split, entries.size() - split);
+	node->build(low, &middleKey, entries.data(), split);
+
+	//the new node goes right after the full one on its level and takes over its high key
+	newNode->rightSibPageNo = node->rightSibPageNo;
+	node->rightSibPageNo = newPageId;
+
+	logPage(newPageId, newPage);
+	unPinPage(newPageId, true);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::traverseAndInsert
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::traverseAndInsert(const T& key, const RecordId rid, const char* includedBytes) {
+	std::vector<LatchedPage> path;
+
+	//position of each page of path among the page numbers of the one before it
+	std::vector<int> slots;
+
+	//the root pointer has to stay put while the root itself may split
+	rootLatch.lockExclusive();
+	bool rootLatched = true;
+
+	LatchedPage root;
+	root.pageNo = rootPageNum;
+	root.page = rootPage;
+	root.latch = latches.get(rootPageNum);
+	root.keepPinned = true;
+	root.latch->lockExclusive();
+	if(((NonLeafNode<T>*) rootPage)->hasRoomForAny()) {
+		rootLatch.unlockExclusive();
+		rootLatched = false;
+	}
+	path.push_back(root);
+	slots.push_back(-1);
+
+	//go down latching exclusively, letting go of everything above a node that has room for one more entry.
+	//the counts of a counted index change all the way up, so nothing is let go of there
+	for(int depth = 1; ; depth++) {
+		NonLeafNode<T>* node = (NonLeafNode<T>*) path.back().page;
+		bool childIsLeaf = (node->level == 1);
+		int slot = findIndexIntoPageNoArray(path.back().page, key);
+
+		LatchedPage child;
+		bool pinned;
+		child.pageNo = node->childAt(slot);
+		readNode(child.pageNo, !childIsLeaf && depth < residentLevels, child.page, pinned);
+		child.latch = latches.get(child.pageNo);
+		child.keepPinned = !pinned;
+		child.latch->lockExclusive();
+
+		bool safe = childIsLeaf ? ((LeafNode<T>*) child.page)->hasRoom(key) : ((NonLeafNode<T>*) child.page)->hasRoomForAny();
+		if(safe && !counted) {
+			releasePath(path, false);
+			slots.clear();
+			if(rootLatched) {
+				rootLatch.unlockExclusive();
+				rootLatched = false;
+			}
+		}
+		path.push_back(child);
+		slots.push_back(slot);
+
+		if(childIsLeaf) break;
+	}
+
+	bool restructured;
+	PageId newPageId;
+	T middleKey;
+	try {
+		insertIntoLeafPage(path.back().pageNo, path.back().page, key, rid, includedBytes, restructured, newPageId, middleKey);
+	} catch(const DuplicateKeyException &e) {
+		releasePath(path, false);
+		if(rootLatched) rootLatch.unlockExclusive();
+		throw;
+	}
+
+	//rids under the page created by the last split, only counted in a counted index
+	unsigned int newCount = 0;
+	if(counted && restructured) {
+		NonLeafNode<T>* parent = (NonLeafNode<T>*) path[path.size() - 2].page;
+		newCount = parent->countAt(slots.back()) + 1 - nodeCount(path.back().page, true);
+	}
+
+	//add the page created by each split to the parent, splitting the parent too if it is full. In a counted index
+	//every node on the path has one rid more under the child the key went to, less those it split off
+	for(int i = (int) path.size() - 2; i >= 0 && (restructured || counted); i--) {
+		Page* page = path[i].page;
+		NonLeafNode<T>* node = (NonLeafNode<T>*) page;
+		if(counted) node->countAt(slots[i + 1]) += 1 - newCount;
+		if(!restructured) continue;
+
+		if(node->hasRoom(middleKey)) {
+			insertIntoNonLeafPage(page, middleKey, newPageId, newCount);
+			restructured = false;
+			newCount = 0;
+		} else {
+			unsigned int total = counted ? nodeCount(page, false) + newCount : 0;
+			T childMiddleKey = middleKey;
+			restructureNonLeaf(page, childMiddleKey, newPageId, newCount, newPageId, middleKey);
+			if(counted) newCount = total - nodeCount(page, false);
+		}
+	}
+
+	//only possible if nothing on the path was safe, so the root is path[0] and rootLatch is still held
+	if(restructured) {
+		logPath(path);
+		growRoot(middleKey, newPageId, newCount);
+	}
+
+	releasePath(path, true);
+	if(rootLatched) rootLatch.unlockExclusive();
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::growRoot
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::growRoot(const T& middleKey, PageId newPageId, unsigned int newCount) {
+	INDEX_STAT(rootSplits, 1);
+	//create a new NonLeafPage and put the middle key on it
+	Page* newRootPage;
+	PageId newRootPageId;
+	allocNode(newRootPageId, newRootPage);
+	NonLeafNode<T>* newRoot = (NonLeafNode<T>*) newRootPage;
+
+	//we know this can never be just above the leaves so set level to 0
+	newRoot->init(0);
+
+	//the left child is the old root page
+	newRoot->childAt(0) = rootPageNum;
+	if(counted) newRoot->countAt(0) = nodeCount(rootPage, false);
+
+	//the only value in the new root is the middle value passed up from the old root, the right child is the one that was added by the split
+	newRoot->insertAt(0, middleKey, newPageId, newCount);
+
+	//the old root stays pinned until the index is closed and the class references move to the new one
+	formerRoots.push_back(rootPageNum);
+	rootPageNum = newRootPageId;
+	rootPage = newRootPage;
+
+	//update the meta info
+	//read in the metainfo so it can be updated
+	Page* metadataPage;
+	readPage(headerPageNum, metadataPage);
+	IndexMetaInfo* metadata = (IndexMetaInfo*) metadataPage;
+	metadata->rootPageNo = newRootPageId;
+
+	//unpin the metadataPage
+	unPinPage(headerPageNum, true);
+
+	//recovery finds the new root only together with the splits below it
+	logPage(newRootPageId, newRootPage);
+	logRootPage(newRootPageId);
+	appendAction();
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::traverseAndDelete
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::traverseAndDelete(const T& key, const RecordId* rid, bool allowUnderflow) {
+	std::vector<LatchedPage> path;
+
+	//position of each page of path among the page numbers of the one before it
+	std::vector<int> slots;
+
+	//the root pointer has to stay put while the root itself may collapse
+	rootLatch.lockExclusive();
+	bool rootLatched = true;
+
+	LatchedPage root;
+	root.pageNo = rootPageNum;
+	root.page = rootPage;
+	root.latch = latches.get(rootPageNum);
+	root.keepPinned = true;
+	root.latch->lockExclusive();
+	NonLeafNode<T>* rootNode = (NonLeafNode<T>*) rootPage;
+	if(rootNode->level == 1 || rootNode->numKeys > 1) {
+		rootLatch.unlockExclusive();
+		rootLatched = false;
+	}
+	path.push_back(root);
+	slots.push_back(-1);
+
+	//go down latching exclusively, letting go of everything above a node that can lose an entry and stay half full.
+	//the counts of a counted index change all the way up, so nothing is let go of there
+	for(int depth = 1; ; depth++) {
+		NonLeafNode<T>* node = (NonLeafNode<T>*) path.back().page;
+		bool childIsLeaf = (node->level == 1);
+		int slot = findIndexIntoPageNoArray(path.back().page, key);
+
+		LatchedPage child;
+		bool pinned;
+		child.pageNo = node->childAt(slot);
+		readNode(child.pageNo, !childIsLeaf && depth < residentLevels, child.page, pinned);
+		child.latch = latches.get(child.pageNo);
+		child.keepPinned = !pinned;
+		child.latch->lockExclusive();
+
+		bool safe;
+		if(childIsLeaf) {
+			LeafNode<T>* leaf = (LeafNode<T>*) child.page;
+			int index = leaf->lowerBound(key);
+			safe = index < leaf->numKeys && leaf->canLoseEntry(index);
+		} else {
+			safe = ((NonLeafNode<T>*) child.page)->canLoseEntry();
+		}
+		if(safe && !counted) {
+			releasePath(path, false);
+			slots.clear();
+			if(rootLatched) {
+				rootLatch.unlockExclusive();
+				rootLatched = false;
+			}
+		}
+		path.push_back(child);
+		slots.push_back(slot);
+
+		if(childIsLeaf) break;
+	}
+
+	//a delete of every rid of a key takes the whole posting list with it
+	unsigned int removed = 1;
+	if(counted && rid == NULL) {
+		LeafNode<T>* leaf = (LeafNode<T>*) path.back().page;
+		int index = leaf->lowerBound(key);
+		if(index < leaf->numKeys && leaf->isKeyAt(index, key) && leaf->ridAt(index).slot_number == POSTINGSLOT) removed = postingLength(leaf->ridAt(index).page_number);
+	}
+
+	bool entryRemoved;
+	if(!removeFromLeafPage(path.back().pageNo, path.back().page, key, rid, entryRemoved)) {
+		releasePath(path, false);
+		if(rootLatched) rootLatch.unlockExclusive();
+		throw NoSuchKeyFoundException();
+	}
+
+	if(counted) {
+		for(int i = (int) path.size() - 2; i >= 0; i--) ((NonLeafNode<T>*) path[i].page)->countAt(slots[i + 1]) -= removed;
+	}
+
+	//rebalance from the leaf up as long as merges take keys out of nodes that then underflow themselves
+	for(int i = (int) path.size() - 1; i > 0 && !allowUnderflow; i--) {
+		bool isLeaf = (i == (int) path.size() - 1);
+		bool underfull = isLeaf ? ((LeafNode<T>*) path[i].page)->isUnderfull() : ((NonLeafNode<T>*) path[i].page)->isUnderfull();
+		if(!underfull) break;
+		if(!rebalance(path[i - 1], slots[i], path[i], isLeaf)) break;
+	}
+
+	//only possible if nothing on the path was safe, so the root is path[0] and rootLatch is still held
+	if(rootLatched && rootNode->numKeys == 0 && rootNode->level == 0) {
+		//the only child becomes the root and takes over the pin the index holds on the root
+		PageId newRootPageId = rootNode->childAt(0);
+		Page* newRootPage;
+		readPage(newRootPageId, newRootPage);
+
+		freeNode(rootPageNum, rootPage);
+		mergeCount++;
+		path[0].keepPinned = false;
+		rootPageNum = newRootPageId;
+		rootPage = newRootPage;
+
+		Page* metadataPage;
+		readPage(headerPageNum, metadataPage);
+		((IndexMetaInfo*) metadataPage)->rootPageNo = newRootPageId;
+		unPinPage(headerPageNum, true);
+		logRootPage(newRootPageId);
+		appendAction();
+	}
+
+	releasePath(path, true);
+	if(rootLatched) rootLatch.unlockExclusive();
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::rebalance
+// -----------------------------------------------------------------------------
+template <class T>
+bool TypedBTreeIndex<T>::rebalance(LatchedPage &parent, int slot, LatchedPage &child, bool childIsLeaf) {
+	NonLeafNode<T>* parentNode = (NonLeafNode<T>*) parent.page;
+
+	//an only child, which is only left under a root, has nobody to share with
+	if(parentNode->numKeys == 0) return false;
+
+	//latch the sibling left to right with the node, like scans moving through the leaves do.
+	//nobody else can get at the node while we hold the parent, so it is fine to let go of it for that
+	LatchedPage sibling;
+	bool pinned;
+	sibling.pageNo = parentNode->childAt(slot > 0 ? slot - 1 : 1);
+	readNode(sibling.pageNo, false, sibling.page, pinned);
+	sibling.latch = latches.get(sibling.pageNo);
+	sibling.keepPinned = !pinned;
+	if(slot > 0) {
+		child.latch->unlockExclusive();
+		sibling.latch->lockExclusive();
+		child.latch->lockExclusive();
+	} else {
+		sibling.latch->lockExclusive();
+	}
+
+	LatchedPage &left = (slot > 0) ? sibling : child;
+	LatchedPage &right = (slot > 0) ? child : sibling;
+	int leftSlot = (slot > 0) ? slot - 1 : 0;
+
+	bool merged = childIsLeaf ? rebalanceLeaves(parent.page, leftSlot, left.page, right.page) : rebalanceNonLeaves(parent.page, leftSlot, left.page, right.page);
+	if(merged && childIsLeaf) setLeftSibling(((LeafNode<T>*) left.page)->rightSibPageNo, left.pageNo);
+	if(merged) freeNode(right.pageNo, right.page);
+
+	//scans parked on either node find out before they can latch it again
+	mergeCount++;
+
+	//the nodes go into the log together, before the sibling is let go of
+	logPage(parent.pageNo, parent.page);
+	logPage(left.pageNo, left.page);
+	if(!merged) logPage(right.pageNo, right.page);
+	appendAction();
+
+	sibling.latch->unlockExclusive();
+	if(!sibling.keepPinned) unPinPage(sibling.pageNo, true);
+	return merged;
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::rebalanceLeaves
+// -----------------------------------------------------------------------------
+template <class T>
+bool TypedBTreeIndex<T>::rebalanceLeaves(Page* parentPage, int leftSlot, Page* leftPage, Page* rightPage) {
+	NonLeafNode<T>* parent = (NonLeafNode<T>*) parentPage;
+	LeafNode<T>* left = (LeafNode<T>*) leftPage;
+	LeafNode<T>* right = (LeafNode<T>*) rightPage;
+
+	std::vector<RIDKeyPair<T> > entries;
+	left->getEntries(entries);
+	right->getEntries(entries);
+
+	T lowKey, highKey;
+	const T* low = left->getLowKey(lowKey) ? &lowKey : NULL;
+	const T* high = right->getHighKey(highKey) ? &highKey : NULL;
+
+	//everything fits on the left leaf, which takes the place of the right one in the chain
+	unsigned int total = parent->countAt(leftSlot) + parent->countAt(leftSlot + 1);
+	if(LeafNode<T>::fits(low, high, entries.data(), entries.size())) {
+		left->build(low, high, entries.data(), entries.size());
+		left->rightSibPageNo = right->rightSibPageNo;
+		moveIncludedRows(leftPage, rightPage, true);
+		parent->countAt(leftSlot) = total;
+		removeFromNonLeafPage(parentPage, leftSlot);
+		return true;
+	}
+
+	//otherwise split the entries evenly, unless the parent has no room for a longer separator between them
+	T separator;
+	int split = splitLeafEntries(entries, low, high, separator);
+	if(!parent->canReplaceKey(leftSlot, separator)) return false;
+
+	left->build(low, &separator, entries.data(), split);
+	right->build(&separator, high, entries.data() + split, entries.size() - split);
+	moveIncludedRows(leftPage, rightPage, false);
+	parent->replaceKey(leftSlot, separator);
+	if(counted) {
+		parent->countAt(leftSlot) = nodeCount(leftPage, true);
+		parent->countAt(leftSlot + 1) = total - parent->countAt(leftSlot);
+	}
+	return false;
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::rebalanceNonLeaves
+// -----------------------------------------------------------------------------
+template <class T>
+bool TypedBTreeIndex<T>::rebalanceNonLeaves(Page* parentPage, int leftSlot, Page* leftPage, Page* rightPage) {
+	NonLeafNode<T>* parent = (NonLeafNode<T>*) parentPage;
+	NonLeafNode<T>* left = (NonLeafNode<T>*) leftPage;
+	NonLeafNode<T>* right = (NonLeafNode<T>*) rightPage;
+
+	//lay the keys and pages of both nodes out in one sequence, with the separator from the parent between them
+	std::vector<PageKeyPair<T> > entries;
+	left->getEntries(entries);
+	const int leftCount = entries.size();
+	right->getEntries(entries);
+	entries[leftCount].key = parent->keyAt(leftSlot);
+
+	T lowKey, highKey;
+	const T* low = left->getLowKey(lowKey) ? &lowKey : NULL;
+	const T* high = right->getHighKey(highKey) ? &highKey : NULL;
+
+	//everything fits in the left node, which takes the place of the right one on its level
+	unsigned int total = parent->countAt(leftSlot) + parent->countAt(leftSlot + 1);
+	if(NonLeafNode<T>::fits(low, high, entries.data(), entries.size())) {
+		left->build(low, high, entries.data(), entries.size());
+		left->rightSibPageNo = right->rightSibPageNo;
+		parent->countAt(leftSlot) = total;
+		removeFromNonLeafPage(parentPage, leftSlot);
+		return true;
+	}
+
+	//otherwise the middle key goes up as the new separator and the keys on either side of it are split evenly
+	int split = splitNonLeafEntries(entries, low, high);
+	T separator = entries[split].key;
+	if(!parent->canReplaceKey(leftSlot, separator)) return false;
+
+	left->build(low, &separator, entries.data(), split);
+	right->build(&separator, high, entries.data() + split, entries.size() - split);
+	parent->replaceKey(leftSlot, separator);
+	if(counted) {
+		parent->countAt(leftSlot) = nodeCount(leftPage, false);
+		parent->countAt(leftSlot + 1) = total - parent->countAt(leftSlot);
+	}
+	return false;
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::removeFromLeafPage
+// -----------------------------------------------------------------------------
+template <class T>
+bool TypedBTreeIndex<T>::removeFromLeafPage(PageId pageNo, Page* page, const T& key, const RecordId* rid, bool &entryRemoved) {
+	LeafNode<T>* leaf = (LeafNode<T>*) page;
+	entryRemoved = false;
+	int index = leaf->lowerBound(key);
+	if(index == leaf->numKeys || !leaf->isKeyAt(index, key)) return false;
+
+	RecordId entryRid = leaf->ridAt(index);
+	PageId includedPageNo = leaf->includedPageNo;
+	if(entryRid.slot_number == POSTINGSLOT) {
+		//the key keeps at least one of its other rids, the leaf only changes if that is the last one or its rows lose their first page
+		if(rid != NULL) {
+			if(!removeFromPosting(leaf->ridAt(index), *rid)) return false;
+			removeIncludedRow(leaf->includedPageNo, *rid);
+			if(!(leaf->ridAt(index) == entryRid) || leaf->includedPageNo != includedPageNo) logPage(pageNo, page);
+			return true;
+		}
+		if(includedPageNo != NULL) {
+			std::vector<RecordId> rids;
+			getPostingRids(entryRid.page_number, rids);
+			removeIncludedRows(leaf->includedPageNo, rids);
+		}
+		freePosting(entryRid.page_number);
+	} else if(rid != NULL && !(entryRid == *rid)) {
+		return false;
+	} else {
+		removeIncludedRow(leaf->includedPageNo, entryRid);
+	}
+
+	//a leaf whose rows lost their first page is logged whole, and the removal with it
+	if(leaf->includedPageNo != includedPageNo) logPage(pageNo, page);
+	leaf->removeAt(index);
+	logLeafChange(LOGLEAFDELETE, pageNo, page, key, entryRid);
+	entryRemoved = true;
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::addToPosting
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::addToPosting(RecordId &entryRid, const RecordId rid) {
+	if(entryRid == rid) throw DuplicateKeyException();
+
+	Page* page;
+	PageId pageNo;
+	PostingPage* posting;
+
+	//the second rid of a key starts its posting list
+	if(entryRid.slot_number != POSTINGSLOT) {
+		allocNode(pageNo, page);
+		posting = (PostingPage*) page;
+		posting->nextPageNo = NULL;
+		posting->numRids = 2;
+		posting->ridArray[0] = ridLess(rid, entryRid) ? rid : entryRid;
+		posting->ridArray[1] = ridLess(rid, entryRid) ? entryRid : rid;
+		logPage(pageNo, page);
+		unPinPage(pageNo, true);
+
+		entryRid.page_number = pageNo;
+		entryRid.slot_number = POSTINGSLOT;
+		return;
+	}
+
+	//the rid goes on the first page whose last rid is not smaller, or on the last page
+	pageNo = entryRid.page_number;
+	readPage(pageNo, page);
+	posting = (PostingPage*) page;
+	while(posting->nextPageNo != NULL && ridLess(posting->ridArray[posting->numRids - 1], rid)) {
+		PageId nextPageNo = posting->nextPageNo;
+		unPinPage(pageNo, false);
+		pageNo = nextPageNo;
+		readPage(pageNo, page);
+		posting = (PostingPage*) page;
+	}
+
+	RecordId* end = posting->ridArray + posting->numRids;
+	int index = std::lower_bound(posting->ridArray, end, rid, ridLess) - posting->ridArray;
+	if(index < posting->numRids && posting->ridArray[index] == rid) {
+		unPinPage(pageNo, false);
+		throw DuplicateKeyException();
+	}
+
+	//a full page gives its upper half to a new page linked in right after it
+	if(posting->numRids == POSTINGPAGESIZE) {
+		Page* newPage;
+		PageId newPageNo;
+		allocNode(newPageNo, newPage);
+		PostingPage* newPosting = (PostingPage*) newPage;
+
+		const int leftCount = POSTINGPAGESIZE / 2;
+		newPosting->numRids = POSTINGPAGESIZE - leftCount;
+		memcpy(newPosting->ridArray, posting->ridArray + leftCount, newPosting->numRids * sizeof(RecordId));
+		newPosting->nextPageNo = posting->nextPageNo;
+		posting->nextPageNo = newPageNo;
+		posting->numRids = leftCount;
+		logPage(pageNo, page);
+		logPage(newPageNo, newPage);
+
+		if(index > leftCount) {
+			unPinPage(pageNo, true);
+			pageNo = newPageNo;
+			posting = newPosting;
+			index -= leftCount;
+		} else {
+			unPinPage(newPageNo, true);
+		}
+	}
+
+	memmove(posting->ridArray + index + 1, posting->ridArray + index, (posting->numRids - index) * sizeof(RecordId));
+	posting->ridArray[index] = rid;
+	posting->numRids++;
+	logPage(pageNo, (Page*) posting);
+	unPinPage(pageNo, true);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::removeFromPosting
+// -----------------------------------------------------------------------------
+template <class T>
+bool TypedBTreeIndex<T>::removeFromPosting(RecordId &entryRid, const RecordId rid) {
+	PageId prevPageNo = NULL;
+	PageId pageNo = entryRid.page_number;
+	Page* page;
+	readPage(pageNo, page);
+	PostingPage* posting = (PostingPage*) page;
+
+	//the rids only get bigger further down the list
+	while(ridLess(posting->ridArray[posting->numRids - 1], rid)) {
+		PageId nextPageNo = posting->nextPageNo;
+		unPinPage(pageNo, false);
+		if(nextPageNo == NULL) return false;
+		prevPageNo = pageNo;
+		pageNo = nextPageNo;
+		readPage(pageNo, page);
+		posting = (PostingPage*) page;
+	}
+
+	RecordId* end = posting->ridArray + posting->numRids;
+	int index = std::lower_bound(posting->ridArray, end, rid, ridLess) - posting->ridArray;
+	if(!(posting->ridArray[index] == rid)) {
+		unPinPage(pageNo, false);
+		return false;
+	}
+
+	posting->numRids--;
+	memmove(posting->ridArray + index, posting->ridArray + index + 1, (posting->numRids - index) * sizeof(RecordId));
+
+	//a list down to its last rid goes back to keeping it on the leaf
+	if(prevPageNo == NULL && posting->nextPageNo == NULL && posting->numRids == 1) {
+		entryRid = posting->ridArray[0];
+		freeNode(pageNo, page);
+		unPinPage(pageNo, true);
+		return true;
+	}
+
+	if(posting->numRids > 0) {
+		logPage(pageNo, page);
+		unPinPage(pageNo, true);
+		return true;
+	}
+
+	//unlink the page that is now empty, from the entry if it was the first one
+	PageId nextPageNo = posting->nextPageNo;
+	freeNode(pageNo, page);
+	unPinPage(pageNo, true);
+	if(prevPageNo == NULL) {
+		entryRid.page_number = nextPageNo;
+	} else {
+		Page* prevPage;
+		readPage(prevPageNo, prevPage);
+		((PostingPage*) prevPage)->nextPageNo = nextPageNo;
+		logPage(prevPageNo, prevPage);
+		unPinPage(prevPageNo, true);
+	}
+
+	//the list may be down to a single page with a single rid now
+	readPage(entryRid.page_number, page);
+	posting = (PostingPage*) page;
+	if(posting->nextPageNo == NULL && posting->numRids == 1) {
+		pageNo = entryRid.page_number;
+		entryRid = posting->ridArray[0];
+		freeNode(pageNo, page);
+		unPinPage(pageNo, true);
+	} else {
+		unPinPage(entryRid.page_number, false);
+	}
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::freePosting
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::freePosting(PageId firstPageNo) {
+	PageId pageNo = firstPageNo;
+	while(pageNo != NULL) {
+		Page* page;
+		readPage(pageNo, page);
+		PageId nextPageNo = ((PostingPage*) page)->nextPageNo;
+		freeNode(pageNo, page);
+		unPinPage(pageNo, true);
+		pageNo = nextPageNo;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::postingLength
+// -----------------------------------------------------------------------------
+template <class T>
+unsigned int TypedBTreeIndex<T>::postingLength(PageId firstPageNo) {
+	unsigned int length = 0;
+	PageId pageNo = firstPageNo;
+	while(pageNo != NULL) {
+		Page* page;
+		readPage(pageNo, page);
+		PostingPage* posting = (PostingPage*) page;
+		length += posting->numRids;
+		PageId nextPageNo = posting->nextPageNo;
+		unPinPage(pageNo, false);
+		pageNo = nextPageNo;
+	}
+	return length;
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::nodeCount
+// -----------------------------------------------------------------------------
+template <class T>
+unsigned int TypedBTreeIndex<T>::nodeCount(Page* page, bool isLeaf) {
+	unsigned int count = 0;
+	if(isLeaf) {
+		LeafNode<T>* leaf = (LeafNode<T>*) page;
+		for(int i = 0; i < leaf->numKeys; i++) {
+			RecordId rid = leaf->ridAt(i);
+			count += (rid.slot_number == POSTINGSLOT) ? postingLength(rid.page_number) : 1;
+		}
+	} else {
+		NonLeafNode<T>* node = (NonLeafNode<T>*) page;
+		for(int i = 0; i <= node->numKeys; i++) count += node->countAt(i);
+	}
+	return count;
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::getPostingRids
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::getPostingRids(PageId firstPageNo, std::vector<RecordId> &rids) {
+	PageId pageNo = firstPageNo;
+	while(pageNo != NULL) {
+		Page* page;
+		readPage(pageNo, page);
+		PostingPage* posting = (PostingPage*) page;
+		rids.insert(rids.end(), posting->ridArray, posting->ridArray + posting->numRids);
+		PageId nextPageNo = posting->nextPageNo;
+		unPinPage(pageNo, false);
+		pageNo = nextPageNo;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::getLeafRids
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::getLeafRids(Page* page, std::vector<RecordId> &rids) {
+	LeafNode<T>* leaf = (LeafNode<T>*) page;
+	for(int i = 0; i < leaf->numKeys; i++) {
+		RecordId rid = leaf->ridAt(i);
+		if(rid.slot_number == POSTINGSLOT) getPostingRids(rid.page_number, rids);
+		else rids.push_back(rid);
+	}
+	std::sort(rids.begin(), rids.end(), ridLess);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::putIncludedRow
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::putIncludedRow(PageId &firstPageNo, const RecordId rid, const char* bytes) {
+	const int rowSize = includedRowSize();
+	const int pageRows = INCLUDEDPAGESIZE / rowSize;
+	Page* page;
+	PageId pageNo;
+	IncludedPage* rows;
+
+	//the first row of a leaf starts its list
+	if(firstPageNo == NULL) {
+		allocNode(pageNo, page);
+		rows = (IncludedPage*) page;
+		rows->nextPageNo = NULL;
+		rows->numRows = 1;
+		memcpy(rows->rows, &rid, sizeof(RecordId));
+		memcpy(rows->rows + sizeof(RecordId), bytes, includedLength);
+		logPage(pageNo, page);
+		unPinPage(pageNo, true);
+		firstPageNo = pageNo;
+		return;
+	}
+
+	//the row goes on the first page whose last rid is not smaller, or on the last page
+	pageNo = firstPageNo;
+	readPage(pageNo, page);
+	rows = (IncludedPage*) page;
+	while(rows->nextPageNo != NULL && ridLess(includedRowRid(rows, rows->numRows - 1, rowSize), rid)) {
+		PageId nextPageNo = rows->nextPageNo;
+		unPinPage(pageNo, false);
+		pageNo = nextPageNo;
+		readPage(pageNo, page);
+		rows = (IncludedPage*) page;
+	}
+
+	//a rid that has a row already gets its bytes replaced
+	int index = findIncludedRow(rows, rid, rowSize);
+	if(index < rows->numRows && includedRowRid(rows, index, rowSize) == rid) {
+		memcpy(rows->rows + index * rowSize + sizeof(RecordId), bytes, includedLength);
+		logPage(pageNo, page);
+		unPinPage(pageNo, true);
+		return;
+	}
+
+	//a full page gives its upper half to a new page linked in right after it
+	if(rows->numRows == pageRows) {
+		Page* newPage;
+		PageId newPageNo;
+		allocNode(newPageNo, newPage);
+		IncludedPage* newRows = (IncludedPage*) newPage;
+
+		const int leftCount = pageRows / 2;
+		newRows->numRows = pageRows - leftCount;
+		memcpy(newRows->rows, rows->rows + leftCount * rowSize, newRows->numRows * rowSize);
+		newRows->nextPageNo = rows->nextPageNo;
+		rows->nextPageNo = newPageNo;
+		rows->numRows = leftCount;
+		logPage(pageNo, page);
+		logPage(newPageNo, newPage);
+
+		if(index > leftCount) {
+			unPinPage(pageNo, true);
+			pageNo = newPageNo;
+			rows = newRows;
+			index -= leftCount;
+		} else {
+			unPinPage(newPageNo, true);
+		}
+	}
+
+	char* row = rows->rows + index * rowSize;
+	memmove(row + rowSize, row, (rows->numRows - index) * rowSize);
+	memcpy(row, &rid, sizeof(RecordId));
+	memcpy(row + sizeof(RecordId), bytes, includedLength);
+	rows->numRows++;
+	logPage(pageNo, (Page*) rows);
+	unPinPage(pageNo, true);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::removeIncludedRow
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::removeIncludedRow(PageId &firstPageNo, const RecordId rid) {
+	if(firstPageNo == NULL) return;
+
+	const int rowSize = includedRowSize();
+	PageId prevPageNo = NULL;
+	PageId pageNo = firstPageNo;
+	Page* page;
+	readPage(pageNo, page);
+	IncludedPage* rows = (IncludedPage*) page;
+
+	//the rids only get bigger further down the list
+	while(ridLess(includedRowRid(rows, rows->numRows - 1, rowSize), rid)) {
+		PageId nextPageNo = rows->nextPageNo;
+		unPinPage(pageNo, false);
+		if(nextPageNo == NULL) return;
+		prevPageNo = pageNo;
+		pageNo = nextPageNo;
+		readPage(pageNo, page);
+		rows = (IncludedPage*) page;
+	}
+
+	int index = findIncludedRow(rows, rid, rowSize);
+	if(!(includedRowRid(rows, index, rowSize) == rid)) {
+		unPinPage(pageNo, false);
+		return;
+	}
+
+	rows->numRows--;
+	char* row = rows->rows + index * rowSize;
+	memmove(row, row + rowSize, (rows->numRows - index) * rowSize);
+	if(rows->numRows > 0) {
+		logPage(pageNo, page);
+		unPinPage(pageNo, true);
+		return;
+	}
+
+	//unlink the page that is now empty, from the leaf if it was the first one
+	PageId nextPageNo = rows->nextPageNo;
+	freeNode(pageNo, page);
+	unPinPage(pageNo, true);
+	if(prevPageNo == NULL) {
+		firstPageNo = nextPageNo;
+	} else {
+		Page* prevPage;
+		readPage(prevPageNo, prevPage);
+		((IncludedPage*) prevPage)->nextPageNo = nextPageNo;
+		logPage(prevPageNo, prevPage);
+		unPinPage(prevPageNo, true);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::removeIncludedRows
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::removeIncludedRows(PageId &firstPageNo, const std::vector<RecordId> &rids) {
+	if(firstPageNo == NULL || rids.empty()) return;
+
+	//keep the rows of every other rid, both lists are in ridLess order
+	const int rowSize = includedRowSize();
+	std::vector<char> rows;
+	readIncludedRows(firstPageNo, rows);
+	std::vector<char> kept;
+	kept.reserve(rows.size());
+	size_t next = 0;
+	for(size_t offset = 0; offset < rows.size(); offset += rowSize) {
+		RecordId rid;
+		memcpy(&rid, &rows[offset], sizeof(RecordId));
+		while(next < rids.size() && ridLess(rids[next], rid)) next++;
+		if(next < rids.size() && rids[next] == rid) continue;
+		kept.insert(kept.end(), rows.begin() + offset, rows.begin() + offset + rowSize);
+	}
+	if(kept.size() == rows.size()) return;
+	writeIncludedRows(firstPageNo, kept.data(), (int) (kept.size() / rowSize));
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::readIncludedRows
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::readIncludedRows(PageId firstPageNo, std::vector<char> &rows) {
+	const int rowSize = includedRowSize();
+	PageId pageNo = firstPageNo;
+	while(pageNo != NULL) {
+		Page* page;
+		readPage(pageNo, page);
+		IncludedPage* rowPage = (IncludedPage*) page;
+		rows.insert(rows.end(), rowPage->rows, rowPage->rows + rowPage->numRows * rowSize);
+		PageId nextPageNo = rowPage->nextPageNo;
+		unPinPage(pageNo, false);
+		pageNo = nextPageNo;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::writeIncludedRows
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::writeIncludedRows(PageId &firstPageNo, const char* rows, int numRows) {
+	const int rowSize = includedRowSize();
+	const int pageRows = INCLUDEDPAGESIZE / rowSize;
+	PageId* link = &firstPageNo;
+	PageId prevPageNo = NULL;
+	Page* prevPage = NULL;
+
+	//fill the pages of the list in order, adding pages at its end while there are rows left
+	int written = 0;
+	while(written < numRows) {
+		Page* page;
+		PageId pageNo = *link;
+		if(pageNo == NULL) {
+			allocNode(pageNo, page);
+			((IncludedPage*) page)->nextPageNo = NULL;
+			*link = pageNo;
+		} else {
+			readPage(pageNo, page);
+		}
+		IncludedPage* rowPage = (IncludedPage*) page;
+		rowPage->numRows = std::min(pageRows, numRows - written);
+		memcpy(rowPage->rows, rows + written * rowSize, rowPage->numRows * rowSize);
+		written += rowPage->numRows;
+
+		if(prevPage != NULL) {
+			logPage(prevPageNo, prevPage);
+			unPinPage(prevPageNo, true);
+		}
+		prevPageNo = pageNo;
+		prevPage = page;
+		link = &rowPage->nextPageNo;
+	}
+
+	//whatever is past the last row is let go of
+	PageId pageNo = *link;
+	*link = NULL;
+	if(prevPage != NULL) {
+		logPage(prevPageNo, prevPage);
+		unPinPage(prevPageNo, true);
+	}
+	while(pageNo != NULL) {
+		Page* page;
+		readPage(pageNo, page);
+		PageId nextPageNo = ((IncludedPage*) page)->nextPageNo;
+		freeNode(pageNo, page);
+		unPinPage(pageNo, true);
+		pageNo = nextPageNo;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::moveIncludedRows
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::moveIncludedRows(Page* leftPage, Page* rightPage, bool merged) {
+	LeafNode<T>* left = (LeafNode<T>*) leftPage;
+	LeafNode<T>* right = (LeafNode<T>*) rightPage;
+	if(left->includedPageNo == NULL && right->includedPageNo == NULL) return;
+
+	const int rowSize = includedRowSize();
+	std::vector<char> rows;
+	readIncludedRows(left->includedPageNo, rows);
+	readIncludedRows(right->includedPageNo, rows);
+	sortIncludedRows(rows, rowSize);
+	if(merged) {
+		writeIncludedRows(left->includedPageNo, rows.data(), (int) (rows.size() / rowSize));
+		writeIncludedRows(right->includedPageNo, NULL, 0);
+		return;
+	}
+
+	//a row goes with the leaf its rid is on now
+	std::vector<RecordId> leftRids;
+	getLeafRids(leftPage, leftRids);
+	std::vector<char> leftRows, rightRows;
+	for(size_t offset = 0; offset < rows.size(); offset += rowSize) {
+		RecordId rid;
+		memcpy(&rid, &rows[offset], sizeof(RecordId));
+		std::vector<char> &to = std::binary_search(leftRids.begin(), leftRids.end(), rid, ridLess) ? leftRows : rightRows;
+		to.insert(to.end(), rows.begin() + offset, rows.begin() + offset + rowSize);
+	}
+	writeIncludedRows(left->includedPageNo, leftRows.data(), (int) (leftRows.size() / rowSize));
+	writeIncludedRows(right->includedPageNo, rightRows.data(), (int) (rightRows.size() / rowSize));
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::getIncludedRows
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::getIncludedRows(PageId firstPageNo, const RecordId* rids, size_t count, char* out) {
+	//visit the rids in the order of the rows, so the list is walked once
+	std::vector<size_t> order(count);
+	for(size_t i = 0; i < count; i++) order[i] = i;
+	std::sort(order.begin(), order.end(), RidIndexLess(rids));
+
+	const int rowSize = includedRowSize();
+	PageId pageNo = firstPageNo;
+	Page* page = NULL;
+	IncludedPage* rows = NULL;
+	int index = 0;
+	if(pageNo != NULL) {
+		readPage(pageNo, page);
+		rows = (IncludedPage*) page;
+	}
+	for(size_t i = 0; i < count; i++) {
+		const RecordId &rid = rids[order[i]];
+		char* to = out + order[i] * includedLength;
+
+		//move on past the rows of smaller rids, page by page
+		while(rows != NULL) {
+			index = findIncludedRow(rows, rid, rowSize);
+			if(index < rows->numRows || rows->nextPageNo == NULL) break;
+			PageId nextPageNo = rows->nextPageNo;
+			unPinPage(pageNo, false);
+			pageNo = nextPageNo;
+			readPage(pageNo, page);
+			rows = (IncludedPage*) page;
+		}
+
+		if(rows != NULL && index < rows->numRows && includedRowRid(rows, index, rowSize) == rid) {
+			memcpy(to, rows->rows + index * rowSize + sizeof(RecordId), includedLength);
+		} else {
+			memset(to, 0, includedLength);
 		}
-		default: {break;}
 	}
+	if(rows != NULL) unPinPage(pageNo, false);
+}
 
-	//should always return in the switch statement
-	return -1;
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::removeFromNonLeafPage
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::removeFromNonLeafPage(Page* page, int slot) {
+	((NonLeafNode<T>*) page)->removeAt(slot);
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::findIndexIntoPageNoArray (assumes non leaf page)
+// TypedBTreeIndex::allocNode
 // -----------------------------------------------------------------------------
-int BTreeIndex::findIndexIntoPageNoArray(Page* page, const void* keyPtr) {
-	switch(attributeType) {
-		case INTEGER: {
-			int key = *((int*) keyPtr);
-			NonLeafNodeInt* nodeInt = (NonLeafNodeInt*) page;
+template <class T>
+const void TypedBTreeIndex<T>::allocNode(PageId &pageNo, Page* &page) {
+	std::lock_guard<std::mutex> guard(freeListLatch);
+	if(freePageNo == NULL) {
+		bufAllocPage(bufMgr, file, pageNo, page);
+		return;
+	}
 
-			for(int i = 0; i < nodeOccupancy; i++) {
-				if(key < nodeInt->keyArray[0]) {
-					return 0; 
-				}
-				else if(key >= nodeInt->keyArray[i] && !(i == nodeOccupancy - 1 || nodeInt->keyArray[i+1] == INT_MAX) && key < nodeInt->keyArray[i + 1]) {
-					return i + 1;
-				}
-				else if(key >= nodeInt->keyArray[i] && (i == nodeOccupancy - 1 || nodeInt->keyArray[i + 1] == INT_MAX)) {
-					return i + 1;
-				}
-			}
+	//take the first page off the free list
+	pageNo = freePageNo;
+	readPage(pageNo, page);
+	freePageNo = ((FreePage*) page)->nextPageNo;
 
-			break;
+	Page* metadataPage;
+	readPage(headerPageNum, metadataPage);
+	((IndexMetaInfo*) metadataPage)->freePageNo = freePageNo;
+	unPinPage(headerPageNum, true);
+
+	//if the new node never makes it into the log, recovery only loses the page
+	appendFreeList(freePageNo, NULL);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::freeNode
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::freeNode(PageId pageNo, Page* page) {
+	if(loggedAction != NULL) {
+		loggedAction->freedPageNos.push_back(pageNo);
+		loggedAction->freedPages.push_back(page);
+	} else {
+		pushFreePage(pageNo, page);
+	}
+
+	//nobody can be on the way to the page, its parent is latched exclusively
+	if(residentPages.get(pageNo)->exchange(NULL) != NULL) unPinPage(pageNo, true);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::pushFreePage
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::pushFreePage(PageId pageNo, Page* page) {
+	std::lock_guard<std::mutex> guard(freeListLatch);
+	PageId nextPageNo = freePageNo;
+	((FreePage*) page)->nextPageNo = nextPageNo;
+	freePageNo = pageNo;
+
+	Page* metadataPage;
+	readPage(headerPageNum, metadataPage);
+	((IndexMetaInfo*) metadataPage)->freePageNo = freePageNo;
+	unPinPage(headerPageNum, true);
+
+	appendFreeList(pageNo, &nextPageNo);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::readNode
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::readNode(PageId pageNo, bool keepResident, Page* &page, bool &pinned) {
+	//a mapped file is all resident already
+	if(mappedFile != NULL) {
+		readPage(pageNo, page);
+		pinned = false;
+		return;
+	}
+
+	std::atomic<Page*>* resident = residentPages.get(pageNo);
+	page = resident->load(std::memory_order_acquire);
+	if(page != NULL) {
+		pinned = false;
+		return;
+	}
+
+	readPage(pageNo, page);
+	pinned = true;
+	if(!keepResident) return;
+
+	//threads reading the node at once all pin it, the first to get here hands its pin over to the table
+	Page* expected = NULL;
+	if(resident->compare_exchange_strong(expected, page)) {
+		pinned = false;
+		std::lock_guard<std::mutex> guard(residentLatch);
+		residentPageNos.push_back(pageNo);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::releasePath
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::releasePath(std::vector<LatchedPage> &path, bool dirty) {
+	if(dirty) {
+		logPath(path);
+		appendAction();
+	}
+	for(size_t i = 0; i < path.size(); i++) {
+		path[i].latch->unlockExclusive();
+		if(!path[i].keepPinned) unPinPage(path[i].pageNo, dirty);
+	}
+	path.clear();
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::findIndexIntoKeyArray (assumes leaf page)
+// -----------------------------------------------------------------------------
+template <class T>
+int TypedBTreeIndex<T>::findIndexIntoKeyArray(Page* page, const T& key) {
+	LeafNode<T>* leaf = (LeafNode<T>*) page;
+
+	//the first key that is not smaller
+	return leaf->lowerBound(key);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::findIndexIntoPageNoArray (assumes non leaf page)
+// -----------------------------------------------------------------------------
+template <class T>
+int TypedBTreeIndex<T>::findIndexIntoPageNoArray(Page* page, const T& key) {
+	NonLeafNode<T>* node = (NonLeafNode<T>*) page;
+
+	//child i holds the keys in [key i - 1, key i)
+	return node->upperBound(key);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::traverse
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::traverse(const T& key, bool exclusiveLeaf, std::vector<PageId>* stack, PageId &leafId, Page* &leafPage, PageLatch* &leafLatch) {
+	bool coupled = (concurrencyMode == LATCH_COUPLING);
+
+	//latch coupling latches the root before letting go of the root pointer, so a root split cannot happen in between.
+	//a B_LINK descent may start from a root that was just split, it finds its way by moving right
+	rootLatch.lockShared();
+	PageId pageNo = rootPageNum;
+	Page* page = rootPage;
+	PageLatch* latch = latches.get(pageNo);
+	if(coupled) latch->lockShared();
+	rootLatch.unlockShared();
+	if(!coupled) latch->lockShared();
+
+	//the root and resident nodes are kept pinned by the index, the pages below are pinned here
+	bool pinned = false;
+	for(int depth = 1; ; depth++) {
+		if(!coupled) moveRight<NonLeafNode<T> >(key, false, pageNo, page, latch, pinned);
+
+		NonLeafNode<T>* node = (NonLeafNode<T>*) page;
+		bool childIsLeaf = (node->level == 1);
+		PageId childPageId = node->childAt(findIndexIntoPageNoArray(page, key));
+		if(stack != NULL) stack->push_back(pageNo);
+
+		//read in the child, latch coupling latches it before unlatching this page
+		Page* child;
+		bool childPinned;
+		readNode(childPageId, !childIsLeaf && depth < residentLevels, child, childPinned);
+		PageLatch* childLatch = latches.get(childPageId);
+		if(!coupled) {
+			latch->unlockShared();
+			if(pinned) unPinPage(pageNo, false);
+		}
+		if(childIsLeaf && exclusiveLeaf) childLatch->lockExclusive();
+		else childLatch->lockShared();
+		if(coupled) {
+			latch->unlockShared();
+			if(pinned) unPinPage(pageNo, false);
 		}
-		case DOUBLE: {
-		    double key = *((double*) keyPtr);
-			NonLeafNodeDouble* nodeDouble = (NonLeafNodeDouble*) page;
 
-			for(int i = 0; i < nodeOccupancy; i++) {
-				if(key < nodeDouble->keyArray[0]) {
-					return 0; 
-				}
-				else if(key >= nodeDouble->keyArray[i] && !(i == nodeOccupancy - 1 || nodeDouble->keyArray[i+1] == DBL_MAX) && key < nodeDouble->keyArray[i + 1]) {
-					return i + 1;
-				}
-				else if(key >= nodeDouble->keyArray[i] && (i == nodeOccupancy - 1 || nodeDouble->keyArray[i + 1] == DBL_MAX)) {
-					return i + 1;
-				}
-			}
-			break;
+		pageNo = childPageId;
+		page = child;
+		latch = childLatch;
+		pinned = childPinned;
+
+		if(childIsLeaf) break;
+	}
+	if(!coupled) moveRight<LeafNode<T> >(key, exclusiveLeaf, pageNo, page, latch, pinned);
+
+	leafId = pageNo;
+	leafPage = page;
+	leafLatch = latch;
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::moveRight
+// -----------------------------------------------------------------------------
+template <class T>
+template <class Node>
+const void TypedBTreeIndex<T>::moveRight(const T& key, bool exclusive, PageId &pageNo, Page* &page, PageLatch* &latch, bool &pinned) {
+	while(true) {
+		Node* node = (Node*) page;
+		if(!node->pastHighKey(key)) return;
+
+		//the node was split after we found it, the key is further right
+		Page* nextPage;
+		bool nextPinned;
+		PageId nextPageId = node->rightSibPageNo;
+		readNode(nextPageId, false, nextPage, nextPinned);
+		PageLatch* nextLatch = latches.get(nextPageId);
+		if(exclusive) {
+			nextLatch->lockExclusive();
+			latch->unlockExclusive();
+		} else {
+			nextLatch->lockShared();
+			latch->unlockShared();
 		}
-		case STRING: {
-			std::string key = *((std::string*) keyPtr);
-			NonLeafNodeString* nodeString = (NonLeafNodeString*) page;
+		if(pinned) unPinPage(pageNo, false);
 
-			for(int i = 0; i < nodeOccupancy; i++) {
-				if(strcmp(key.c_str(), nodeString->keyArray[0]) < 0) {
-					return 0; 
-				}
-				else if(strcmp(key.c_str(), nodeString->keyArray[i]) >= 0 && !(i == nodeOccupancy - 1 || strcmp(nodeString->keyArray[i+1], "") == 0) && strcmp(key.c_str(), nodeString->keyArray[i + 1]) < 0) {
-					return i + 1;
-				}
-				else if(strcmp(key.c_str(), nodeString->keyArray[i]) >= 0 && (i == nodeOccupancy - 1 || strcmp(nodeString->keyArray[i + 1], "") == 0)) {
-					return i + 1;
-				}
+		pageNo = nextPageId;
+		page = nextPage;
+		latch = nextLatch;
+		pinned = nextPinned;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::blinkInsert
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::blinkInsert(const T& key, const RecordId rid, const char* includedBytes) {
+	//go down to the leaf remembering the non-leaf nodes on the way
+	std::vector<PageId> stack;
+	PageId pageNo;
+	Page* page;
+	PageLatch* latch;
+	traverse(key, true, &stack, pageNo, page, latch);
+	bool pinned = true;
+
+	bool restructured;
+	PageId newPageId;
+	T middleKey;
+	try {
+		insertIntoLeafPage(pageNo, page, key, rid, includedBytes, restructured, newPageId, middleKey);
+	} catch(const DuplicateKeyException &e) {
+		latch->unlockExclusive();
+		unPinPage(pageNo, false);
+		throw;
+	}
+
+	//latches are only ever taken left to right on a level or going up, so holding a node while latching
+	//its parent cannot deadlock
+	int height = 0;
+	while(restructured) {
+		height++;
+
+		//latch the parent before letting go of the node that split
+		PageId parentNo;
+		Page* parentPage;
+		PageLatch* parentLatch;
+		bool parentPinned;
+		if(!stack.empty()) {
+			parentNo = stack.back();
+			stack.pop_back();
+			readNode(parentNo, false, parentPage, parentPinned);
+			parentLatch = latches.get(parentNo);
+			parentLatch->lockExclusive();
+		} else {
+			rootLatch.lockExclusive();
+			if(rootPageNum == pageNo) {
+				//the root split, nobody else can split it again before the new root is in place
+				growRoot(middleKey, newPageId, 0);
+				rootLatch.unlockExclusive();
+				break;
 			}
-			break;
+			rootLatch.unlockExclusive();
+
+			//the tree grew above the node since we passed it
+			findNodeAtHeight(middleKey, height, parentNo, parentPage, parentLatch, parentPinned);
 		}
-		default: {break;}
+
+		//the node and the one split off it go into the log as they are, right links make that a whole tree
+		appendAction();
+		latch->unlockExclusive();
+		if(pinned) unPinPage(pageNo, true);
+
+		//the parent may have been split too since we passed it
+		moveRight<NonLeafNode<T> >(middleKey, true, parentNo, parentPage, parentLatch, parentPinned);
+
+		if(((NonLeafNode<T>*) parentPage)->hasRoom(middleKey)) {
+			insertIntoNonLeafPage(parentPage, middleKey, newPageId, 0);
+			restructured = false;
+		} else {
+			T childMiddleKey = middleKey;
+			restructureNonLeaf(parentPage, childMiddleKey, newPageId, 0, newPageId, middleKey);
+		}
+		logPage(parentNo, parentPage);
+
+		pageNo = parentNo;
+		page = parentPage;
+		latch = parentLatch;
+		pinned = parentPinned;
+	}
+
+	appendAction();
+	latch->unlockExclusive();
+	if(pinned) unPinPage(pageNo, true);
+}
+
+// -----------------------------------------------------------------------------
+// TypedBTreeIndex::findNodeAtHeight
+// -----------------------------------------------------------------------------
+template <class T>
+const void TypedBTreeIndex<T>::findNodeAtHeight(const T& key, int height, PageId &pageNo, Page* &page, PageLatch* &latch, bool &pinned) {
+	rootLatch.lockShared();
+	PageId rootNo = rootPageNum;
+	Page* root = rootPage;
+	rootLatch.unlockShared();
+
+	//the height of the root is the number of non-leaf levels, count them down the leftmost nodes
+	int rootHeight = 1;
+	PageId leftNo = rootNo;
+	Page* left = root;
+	bool leftPinned = false;
+	while(((NonLeafNode<T>*) left)->level != 1) {
+		PageLatch* leftLatch = latches.get(leftNo);
+		leftLatch->lockShared();
+		PageId childNo = ((NonLeafNode<T>*) left)->childAt(0);
+		leftLatch->unlockShared();
+		if(leftPinned) unPinPage(leftNo, false);
+
+		readNode(childNo, false, left, leftPinned);
+		leftNo = childNo;
+		rootHeight++;
+	}
+	if(leftPinned) unPinPage(leftNo, false);
+
+	//go down by key until the wanted height, one latch at a time
+	pageNo = rootNo;
+	page = root;
+	latch = latches.get(pageNo);
+	latch->lockShared();
+	pinned = false;
+	for(int h = rootHeight; h > height; h--) {
+		moveRight<NonLeafNode<T> >(key, false, pageNo, page, latch, pinned);
+		PageId childNo = ((NonLeafNode<T>*) page)->childAt(findIndexIntoPageNoArray(page, key));
+		latch->unlockShared();
+		if(pinned) unPinPage(pageNo, false);
+
+		pageNo = childNo;
+		readNode(pageNo, false, page, pinned);
+		latch = latches.get(pageNo);
+		latch->lockShared();
 	}
 
-	//should always return in the switch statement
-	return -1;
+	//the caller moves right again once it holds the node exclusively
+	latch->unlockShared();
+	latch->lockExclusive();
 }
 
+template class TypedScanCursor<int>;
+template class TypedScanCursor<double>;
+template class TypedScanCursor<StringKey>;
+template class TypedBTreeIndex<int>;
+template class TypedBTreeIndex<double>;
+template class TypedBTreeIndex<StringKey>;
+
 // -----------------------------------------------------------------------------
-// BTreeIndex::findMiddleValue (called by restructure)
+// BTreeIndex::BTreeIndex -- Constructor
 // -----------------------------------------------------------------------------
-void BTreeIndex::findMiddleValue(Page* page, bool isLeaf, const void* keyPtr, int &middleIndex) {
-	switch(attributeType) {
+BTreeIndex::BTreeIndex(const std::string & relationName, std::string & outIndexName, BufMgr *bufMgrIn, const int attrByteOffset, const Datatype attrType, const BuildMethod buildMethod, const double fillFactor, const ConcurrencyMode concurrencyMode, const DeleteMode deleteMode, const int residentLevels, const OpenMode openMode, const CountMode countMode, const int buildThreads, const int includedOffset, const int includedLength) {
+    //create the filename
+    std::ostringstream idxStr;
+    idxStr << relationName << '.' << attrByteOffset;
+    outIndexName = idxStr.str();
+
+	this->attributeType = attrType;
+	index = NULL;
+
+	//the key type is picked once here, everything after this runs on the typed tree
+	switch(attrType) {
 		case INTEGER: {
-			if(isLeaf) {
-				LeafNodeInt* leaf = (LeafNodeInt*) page;
-				int key = *((int*) keyPtr);
-				if(leafOccupancy % 2 == 0) {
-					if(key > leaf->keyArray[leafOccupancy/2 - 1] && key < leaf->keyArray[leafOccupancy/2]) {
-						middleInt = key;
-						middleIndex = leafOccupancy/2;
-					}
-					else if(key > leaf->keyArray[leafOccupancy/2]) {
-						middleInt = (leaf->keyArray[leafOccupancy/2]);
-						middleIndex = leafOccupancy/2;
-					}
-					else {
-						middleInt = (leaf->keyArray[leafOccupancy/2 - 1]);
-						middleIndex = leafOccupancy/2 - 1;
-					}
-				} else {
-					middleInt = (leaf->keyArray[leafOccupancy/2]);
-					middleIndex = leafOccupancy/2;
-				}
-			} else {
-				NonLeafNodeInt* node = (NonLeafNodeInt*) page;
-				int key = *((int*) keyPtr);
-				if(nodeOccupancy % 2 == 0) {
-					if(key > node->keyArray[nodeOccupancy/2 - 1] && key < node->keyArray[nodeOccupancy/2]) {
-						middleInt = key;
-						middleIndex = nodeOccupancy/2 - 1;
-					}
-					else if(key > node->keyArray[nodeOccupancy/2]) {
-						middleInt = (node->keyArray[nodeOccupancy/2]);
-						middleIndex = nodeOccupancy/2;
-					}
-					else if(key < node->keyArray[nodeOccupancy/2 - 1]){
-						middleInt = (node->keyArray[nodeOccupancy/2 - 1]);
-						middleIndex = nodeOccupancy/2 - 1;
-					} else {
-						//ERROR it equals some key passed it. Too late to throw error here as the data is already in the database 
-					}
-				} else {
-					if(key > node->keyArray[nodeOccupancy/2-1] && key < node->keyArray[nodeOccupancy/2]) {
-						middleInt = key;
-						middleIndex = nodeOccupancy/2 - 1;
-					} else if(key > node->keyArray[nodeOccupancy/2] && key < node->keyArray[nodeOccupancy/2 + 1]) {
-						middleInt = key;
-						middleIndex = nodeOccupancy/2;
-					} else if(key < node->keyArray[nodeOccupancy/2-1]) {
-						middleInt = (node->keyArray[nodeOccupancy/2-1]);
-						middleIndex = nodeOccupancy/2 - 1;
-					} else if(key > node->keyArray[nodeOccupancy/2]) {
-						middleInt = (node->keyArray[nodeOccupancy/2]);
-						middleIndex = nodeOccupancy/2;
-					} else {
-						//ERROR
-					}
-				}
-			}
+			index = new TypedBTreeIndex<int>(relationName, outIndexName, bufMgrIn, attrByteOffset, buildMethod, fillFactor, concurrencyMode, deleteMode, residentLevels, openMode, countMode, buildThreads, includedOffset, includedLength);
 			break;
 		}
 		case DOUBLE: {
-			if(isLeaf) {
-				LeafNodeDouble* leaf = (LeafNodeDouble*) page;
-				double key = *((double*) keyPtr);
-				if(leafOccupancy % 2 == 0) {
-					if(key > leaf->keyArray[leafOccupancy/2 - 1] && key < leaf->keyArray[leafOccupancy/2]) {
-						middleDouble = key;
-						middleIndex = leafOccupancy/2;
-					}
-					else if(key > leaf->keyArray[leafOccupancy/2]) {
-						middleDouble = (leaf->keyArray[leafOccupancy/2]);
-						middleIndex = leafOccupancy/2;
-					}
-					else {
-						middleDouble = (leaf->keyArray[leafOccupancy/2 - 1]);
-						middleIndex = leafOccupancy/2 - 1;
-					}
-				} else {
-					middleDouble = (leaf->keyArray[leafOccupancy/2]);
-					middleIndex = leafOccupancy/2;
-				}
-			} else {
-				NonLeafNodeDouble* node = (NonLeafNodeDouble*) page;
-				double key = *((double*) keyPtr);
-				if(nodeOccupancy % 2 == 0) {
-					if(key > node->keyArray[nodeOccupancy/2 - 1] && key < node->keyArray[nodeOccupancy/2]) {
-						middleDouble = key;
-						middleIndex = nodeOccupancy/2 - 1;
-					}
-					else if(key > node->keyArray[nodeOccupancy/2]) {
-						middleDouble = (node->keyArray[nodeOccupancy/2]);
-						middleIndex = nodeOccupancy/2;
-					}
-					else if(key < node->keyArray[nodeOccupancy/2 - 1]){
-						middleDouble = (node->keyArray[nodeOccupancy/2 - 1]);
-						middleIndex = nodeOccupancy/2 - 1;
-					} else {
-						//ERROR it equals some key passed it. Too late to throw error here as the data is already in the database 
-					}
-				} else {
-					if(key > node->keyArray[nodeOccupancy/2-1] && key < node->keyArray[nodeOccupancy/2]) {
-						middleDouble = key;
-						middleIndex = nodeOccupancy/2 - 1;
-					} else if(key > node->keyArray[nodeOccupancy/2] && key < node->keyArray[nodeOccupancy/2 + 1]) {
-						middleDouble = key;
-						middleIndex = nodeOccupancy/2;
-					} else if(key < node->keyArray[nodeOccupancy/2-1]) {
-						middleDouble = (node->keyArray[nodeOccupancy/2-1]);
-						middleIndex = nodeOccupancy/2 - 1;
-					} else if(key > node->keyArray[nodeOccupancy/2]) {
-						middleDouble = (node->keyArray[nodeOccupancy/2]);
-						middleIndex = nodeOccupancy/2;
-					} else {
-						//ERROR
-					}
-				}
-			}
+			index = new TypedBTreeIndex<double>(relationName, outIndexName, bufMgrIn, attrByteOffset, buildMethod, fillFactor, concurrencyMode, deleteMode, residentLevels, openMode, countMode, buildThreads, includedOffset, includedLength);
 			break;
 		}
 		case STRING: {
-			if(isLeaf) {
-				LeafNodeString* leaf = (LeafNodeString*) page;
-				std::string key = *((std::string*) keyPtr);
-				if(leafOccupancy % 2 == 0) {
-					if(strcmp(key.c_str(), leaf->keyArray[leafOccupancy/2 - 1]) > 0 && strcmp(key.c_str(), leaf->keyArray[leafOccupancy/2]) < 0) {
-						middleString.assign(key);
-						middleIndex = leafOccupancy/2;
-					}
-					else if(strcmp(key.c_str(), leaf->keyArray[leafOccupancy/2]) > 0) {
-						middleString.assign(leaf->keyArray[leafOccupancy/2]);
-						middleIndex = leafOccupancy/2;
-					}
-					else {
-						middleString.assign(leaf->keyArray[leafOccupancy/2 - 1]);
-						middleIndex = leafOccupancy/2 - 1;
-					}
-				} else {
-					middleString.assign(leaf->keyArray[leafOccupancy/2]);
-					middleIndex = leafOccupancy/2;
-				}
-			} else {
-				NonLeafNodeString* node = (NonLeafNodeString*) page;
-				std::string key = *((std::string*) keyPtr);
-				if(nodeOccupancy % 2 == 0) {
-					if(strcmp(key.c_str(), node->keyArray[nodeOccupancy/2 - 1]) > 0 && strcmp(key.c_str(), node->keyArray[nodeOccupancy/2]) < 0) {
-						middleString.assign(key);
-						middleIndex = nodeOccupancy/2 - 1;
-					}
-					else if(strcmp(key.c_str(), node->keyArray[nodeOccupancy/2]) > 0) {
-						middleString.assign(node->keyArray[nodeOccupancy/2]);
-						middleIndex = nodeOccupancy/2;
-					}
-					else if(strcmp(key.c_str(), node->keyArray[nodeOccupancy/2 - 1]) < 0){
-						middleString.assign(node->keyArray[nodeOccupancy/2 - 1]);
-						middleIndex = nodeOccupancy/2 - 1;
-					} else {
-						//ERROR it equals some key passed it. Too late to throw error here as the data is already in the database 
-					}
-				} else {
-					if(strcmp(key.c_str(), node->keyArray[nodeOccupancy/2-1]) > 0 && strcmp(key.c_str(), node->keyArray[nodeOccupancy/2]) < 0) {
-						middleString.assign(key);
-						middleIndex = nodeOccupancy/2 - 1;
-					} else if(strcmp(key.c_str(), node->keyArray[nodeOccupancy/2]) > 0 && strcmp(key.c_str(), node->keyArray[nodeOccupancy/2 + 1]) < 0) {
-						middleString.assign(key);
-						middleIndex = nodeOccupancy/2;
-					} else if(strcmp(key.c_str(), node->keyArray[nodeOccupancy/2-1]) < 0) {
-						middleString.assign(node->keyArray[nodeOccupancy/2-1]);
-						middleIndex = nodeOccupancy/2 - 1;
-					} else if(strcmp(key.c_str(), node->keyArray[nodeOccupancy/2]) > 0) {
-						middleString.assign(node->keyArray[nodeOccupancy/2]);
-						middleIndex = nodeOccupancy/2;
-					} else {
-						//ERROR
-					}
-				}
-			}
+			index = new TypedBTreeIndex<StringKey>(relationName, outIndexName, bufMgrIn, attrByteOffset, buildMethod, fillFactor, concurrencyMode, deleteMode, residentLevels, openMode, countMode, buildThreads, includedOffset, includedLength);
+			break;
+		}
+		default: {
+			std::cout << "ERROR: non valid data type passed to BTreeIndex constructor" << std::endl;
 			break;
 		}
-		default: {break; }
 	}
-	
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::traverse
+// BTreeIndex::~BTreeIndex -- destructor
 // -----------------------------------------------------------------------------
-const void BTreeIndex::traverse(Page* page, int pageLevel, const void* keyPtr, PageId &leafId) {
-	switch(attributeType) {
-		case INTEGER: {
-			if(pageLevel == 0) {
-				//find the index based on the key pointer
-				int index = findIndexIntoPageNoArray(page, keyPtr);
+BTreeIndex::~BTreeIndex()
+{
+	delete index;
+}
 
-				//read in that page and traverse down
-				Page* child;
-				bufMgr->readPage(file, ((NonLeafNodeInt*) page)->pageNoArray[index], child);
-				traverse(child, ((NonLeafNodeInt*) child)->level, keyPtr, leafId);
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertEntry
+// -----------------------------------------------------------------------------
+const void BTreeIndex::insertEntry(const void *key, const RecordId rid)
+{
+	index->insertEntry(key, rid);
+}
 
-				//unpin the node page
-				bufMgr->unPinPage(file, ((NonLeafNodeInt*) page)->pageNoArray[index], false);
-			} else {
-				//page is one above the leaf level
-				int index = findIndexIntoPageNoArray(page, keyPtr);
-				leafId = ((NonLeafNodeInt*) page)->pageNoArray[index];
-			}
-			break;
-		}
-		case DOUBLE: {
-            if(pageLevel == 0) {
-				//find the index based on the key pointer
-				int index = findIndexIntoPageNoArray(page, keyPtr);
+const void BTreeIndex::insertEntry(const void *key, const RecordId rid, const void* includedBytes)
+{
+	index->insertEntry(key, rid, includedBytes);
+}
 
-				//read in that page and traverse down
-				Page* child;
-				bufMgr->readPage(file, ((NonLeafNodeDouble*) page)->pageNoArray[index], child);
-				traverse(child, ((NonLeafNodeDouble*) child)->level, keyPtr, leafId);
+// -----------------------------------------------------------------------------
+// BTreeIndex::deleteEntry
+// -----------------------------------------------------------------------------
+const void BTreeIndex::deleteEntry(const void *key)
+{
+	index->deleteEntry(key);
+}
 
-				//unpin the node page
-				bufMgr->unPinPage(file, ((NonLeafNodeDouble*) page)->pageNoArray[index], false);
-			} else {
-				//page is one above the leaf level
-				int index = findIndexIntoPageNoArray(page, keyPtr);
-				leafId = ((NonLeafNodeDouble*) page)->pageNoArray[index];
-			}
-			break;
-		}
-		case STRING: {
+const void BTreeIndex::deleteEntry(const void *key, const RecordId rid)
+{
+	index->deleteEntry(key, rid);
+}
 
-            std::cout << *((std::string*) keyPtr) << std::endl;
-			if(pageLevel == 0) {
-				//find the index based on the key pointer
-				int index = findIndexIntoPageNoArray(page, keyPtr);
+// -----------------------------------------------------------------------------
+// BTreeIndex::openScan
+// -----------------------------------------------------------------------------
+ScanCursor* BTreeIndex::openScan(const void* lowValParm, const Operator lowOpParm, const void* highValParm, const Operator highOpParm, const ScanDirection direction)
+{
+	return index->openScan(lowValParm, lowOpParm, highValParm, highOpParm, direction);
+}
 
-				//read in that page and traverse down
-				Page* child;
-				bufMgr->readPage(file, ((NonLeafNodeString*) page)->pageNoArray[index], child);
-				traverse(child, ((NonLeafNodeString*) child)->level, keyPtr, leafId);
+// -----------------------------------------------------------------------------
+// BTreeIndex::openHeapOrderScan
+// -----------------------------------------------------------------------------
+HeapOrderCursor* BTreeIndex::openHeapOrderScan(const void* lowValParm, const Operator lowOpParm, const void* highValParm, const Operator highOpParm, size_t memoryRids)
+{
+	return index->openHeapOrderScan(lowValParm, lowOpParm, highValParm, highOpParm, memoryRids);
+}
 
-				//unpin the node page
-				bufMgr->unPinPage(file, ((NonLeafNodeString*) page)->pageNoArray[index], false);
-			} else {
-				//page is one above the leaf level
-				int index = findIndexIntoPageNoArray(page, keyPtr);
-				leafId = ((NonLeafNodeString*) page)->pageNoArray[index];
-			}
-			break;
-			break;
-		}
-		default: { break; }
-	}
+// -----------------------------------------------------------------------------
+// BTreeIndex::startScan
+// -----------------------------------------------------------------------------
+const void BTreeIndex::startScan(const void* lowValParm, const Operator lowOpParm, const void* highValParm, const Operator highOpParm, const ScanDirection direction)
+{
+	index->startScan(lowValParm, lowOpParm, highValParm, highOpParm, direction);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::scanNext
+// -----------------------------------------------------------------------------
+const void BTreeIndex::scanNext(RecordId& outRid)
+{
+	index->scanNext(outRid);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::scanNextBatch
+// -----------------------------------------------------------------------------
+size_t BTreeIndex::scanNextBatch(RecordId* out, size_t max)
+{
+	return index->scanNextBatch(out, max);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::scanNextEntries
+// -----------------------------------------------------------------------------
+size_t BTreeIndex::scanNextEntries(RecordId* outRids, void* outKeys, void* outIncluded, size_t max)
+{
+	return index->scanNextEntries(outRids, outKeys, outIncluded, max);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::endScan
+// -----------------------------------------------------------------------------
+const void BTreeIndex::endScan()
+{
+	index->endScan();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::lookup
+// -----------------------------------------------------------------------------
+bool BTreeIndex::lookup(const void* key, RecordId& outRid)
+{
+	return index->lookup(key, outRid);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::lookupBatch
+// -----------------------------------------------------------------------------
+size_t BTreeIndex::lookupBatch(const void* const* keys, size_t numKeys, RecordId* outRids, bool* found)
+{
+	return index->lookupBatch(keys, numKeys, outRids, found);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::countRange
+// -----------------------------------------------------------------------------
+size_t BTreeIndex::countRange(const void* lowValParm, const Operator lowOpParm, const void* highValParm, const Operator highOpParm)
+{
+	return index->countRange(lowValParm, lowOpParm, highValParm, highOpParm);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::estimateRange
+// -----------------------------------------------------------------------------
+double BTreeIndex::estimateRange(const void* lowValParm, const Operator lowOpParm, const void* highValParm, const Operator highOpParm)
+{
+	return index->estimateRange(lowValParm, lowOpParm, highValParm, highOpParm);
 }
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::setReadAhead
+// -----------------------------------------------------------------------------
+void BTreeIndex::setReadAhead(int numLeaves)
+{
+	index->setReadAhead(numLeaves);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::getReadAheadStats
+// -----------------------------------------------------------------------------
+ReadAheadStats BTreeIndex::getReadAheadStats()
+{
+	return index->getReadAheadStats();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::getStats
+// -----------------------------------------------------------------------------
+IndexStats BTreeIndex::getStats(bool walkLeaves)
+{
+	return index->getStats(walkLeaves);
+}
+
 }
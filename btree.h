@@ -10,12 +10,24 @@
 #include <iostream>
 #include <string>
 #include "string.h"
+#include <limits.h>
+#include <float.h>
 #include <sstream>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <deque>
 
 #include "types.h"
 #include "page.h"
 #include "file.h"
 #include "buffer.h"
+#include "page_latch.h"
+#include "async_io.h"
+#include "write_ahead_log.h"
+#include "index_stats.h"
 
 namespace badgerdb
 {
@@ -42,45 +54,240 @@ enum Operator
 };
 
 /**
- * @brief Size of String key.
+ * @brief Order in which a scan returns the keys of its range. Passed to BTreeIndex::startScan() and openScan().
  */
-const  int STRINGSIZE = 10;
+enum ScanDirection
+{
+	ASCENDING,	/* From the low end of the range up, moving right through the leaves */
+	DESCENDING	/* From the high end of the range down, moving left through the leaves */
+};
 
 /**
- * @brief Number of key slots in B+Tree leaf for INTEGER key.
+ * @brief How a new index is populated from its base relation. Passed to the BTreeIndex constructor.
  */
-//                                                  sibling ptr             key               rid
-const  int INTARRAYLEAFSIZE = ( Page::SIZE - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( RecordId ) );
+enum BuildMethod
+{
+	INSERT_BUILD,	/* Call insertEntry for every tuple of the relation */
+	BULK_LOAD		/* Sort all entries, then pack the leaves and non-leaf levels bottom-up */
+};
 
 /**
- * @brief Number of key slots in B+Tree leaf for DOUBLE key.
+ * @brief How threads coordinate their latches while going down the tree. Passed to the BTreeIndex constructor.
+ */
+enum ConcurrencyMode
+{
+	LATCH_COUPLING,	/* Hold the latch of a node until the child is latched */
+	B_LINK			/* Hold one latch at a time on the way down and follow right links past nodes split in between */
+};
+
+/**
+ * @brief What a delete does with a node it leaves less than half full. Passed to the BTreeIndex constructor.
  */
-//                                                     sibling ptr               key               rid
-const  int DOUBLEARRAYLEAFSIZE = ( Page::SIZE - sizeof( PageId ) ) / ( sizeof( double ) + sizeof( RecordId ) );
+enum DeleteMode
+{
+	MERGE_ON_UNDERFLOW,	/* Borrow entries from a sibling, or merge with it and free the page */
+	LAZY_DELETE			/* Only take the entry off its leaf, nodes may stay underfull or even empty */
+};
 
 /**
- * @brief Number of key slots in B+Tree leaf for STRING key.
+ * @brief How the BTreeIndex constructor opens the index file.
  */
-//                                                    sibling ptr           key                      rid
-const  int STRINGARRAYLEAFSIZE = ( Page::SIZE - sizeof( PageId ) ) / ( 10 * sizeof(char) + sizeof( RecordId ) );
+enum OpenMode
+{
+	READ_WRITE,			/* Go through the buffer manager, creating and populating the file if it does not exist */
+	READ_WRITE_LOGGED,	/* As READ_WRITE, but every insert and delete is in the write-ahead log of the file when it returns */
+	READ_ONLY_MAPPED	/* Map an existing file into memory and read the nodes in place, inserts and deletes throw */
+};
 
 /**
- * @brief Number of key slots in B+Tree non-leaf for INTEGER key.
+ * @brief What the non-leaf nodes of a new index file keep besides keys and page numbers. Passed to the BTreeIndex
+ * constructor.
+ */
+enum CountMode
+{
+	UNCOUNTED,		/* Nothing else */
+	SUBTREE_COUNTS	/* The number of rids under every child, kept up to date by every insert and delete, see BTreeIndex::countRange */
+};
+
+/**
+ * @brief The buffer manager is not thread safe, so every call the indexes make into it goes through this latch.
+ * Code that calls the buffer manager itself has to hold it too while another thread may be inside an index, or
+ * while a scan with read-ahead is open, see BTreeIndex::setReadAhead.
+ */
+extern std::mutex bufMgrLatch;
+
+/**
+ * @brief Pass as residentLevels to the BTreeIndex constructor to keep every non-leaf level of the tree resident.
+ */
+const  int ALLLEVELSRESIDENT = INT_MAX;
+
+/**
+ * @brief Longest STRING key. Attribute values are read up to their NULL terminator or this many characters.
+ */
+const  int STRINGSIZE = 255;
+
+/**
+ * @brief Number of pages worth of key-rid pairs a bulk load sorts in memory before spilling a sorted run to disk.
+ */
+const  int BULKLOADRUNPAGES = 64;
+
+/**
+ * @brief Maximum number of sorted runs a bulk load merges in one pass. Each run being merged keeps one page pinned.
+ */
+const  int BULKLOADMERGEFANIN = 16;
+
+/**
+ * @brief Number of pages of every run a bulk load has the sort file read ahead while merging.
+ */
+const  int BULKLOADPREFETCHPAGES = 8;
+
+/**
+ * @brief Number of writes a bulk load keeps in flight on the AsyncPageWriter that writes the leaves, and their rows
+ * of included columns, past the buffer pool.
+ */
+const  int BULKLOADWRITEDEPTH = 16;
+
+/**
+ * @brief Pass as buildThreads to the BTreeIndex constructor to have a bulk load scan the relation with as many
+ * threads as the machine has hardware threads.
+ */
+const  int HARDWARETHREADS = 0;
+
+/**
+ * @brief Number of relation pages a thread of a bulk load reads in at a time before extracting their keys.
+ */
+const  int BUILDSCANPAGES = 16;
+
+/**
+ * @brief Number of rids countRange takes off the scan at a time when counting an index without SUBTREE_COUNTS.
+ */
+const  int COUNTSCANBATCH = 256;
+
+/**
+ * @brief Number of rids a heap order scan sorts in memory before spilling a sorted run to disk. See
+ * BTreeIndex::openHeapOrderScan.
+ */
+const  int HEAPORDERSCANRIDS = 64 * 1024;
+
+/**
+ * @brief Number of registers in the distinct key sketch of IndexStatistics. Its estimate is off by about
+ * 1.04 / sqrt(SKETCHREGISTERS), some 3%.
+ */
+const  int SKETCHREGISTERS = 1024;
+
+/**
+ * @brief Number of keys a build samples to place the bucket bounds of the histogram of IndexStatistics.
+ */
+const  int HISTOGRAMSAMPLESIZE = 32768;
+
+/**
+ * @brief STRING key of any length up to STRINGSIZE. Only the first length characters of key are used and
+ * it is not NULL terminated. The STRING nodes store keys with just their own length, see StringNode.
+*/
+struct StringKey{
+	int length;
+	char key[ STRINGSIZE ];
+};
+
+/**
+ * @brief Scramble the bits of a 64-bit value so that every bit of the result depends on all of them
+ * (the finalizer of splitmix64).
+*/
+inline unsigned long long mixBits( unsigned long long value )
+{
+	value = ( value ^ ( value >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+	value = ( value ^ ( value >> 27 ) ) * 0x94d049bb133111ebULL;
+	return value ^ ( value >> 31 );
+}
+
+/**
+ * @brief Compare two strings of the given lengths byte by byte, a string sorts before any longer string it is
+ * a prefix of. Returns a number less than, equal to or greater than zero like memcmp.
+*/
+inline int compareStrings( const char* s1, int length1, const char* s2, int length2 )
+{
+	int result = memcmp( s1, s2, length1 < length2 ? length1 : length2 );
+	return result != 0 ? result : length1 - length2;
+}
+
+/**
+ * @brief Number of leading bytes two strings have in common.
+*/
+inline int commonPrefixLength( const char* s1, int length1, const char* s2, int length2 )
+{
+	int n = length1 < length2 ? length1 : length2;
+	int i = 0;
+	while( i < n && s1[i] == s2[i] ) i++;
+	return i;
+}
+
+/**
+ * @brief Overloaded operators to compare two STRING keys.
+*/
+inline bool operator<( const StringKey& k1, const StringKey& k2 )
+{
+	return compareStrings( k1.key, k1.length, k2.key, k2.length ) < 0;
+}
+
+inline bool operator<=( const StringKey& k1, const StringKey& k2 )
+{
+	return compareStrings( k1.key, k1.length, k2.key, k2.length ) <= 0;
+}
+
+inline bool operator==( const StringKey& k1, const StringKey& k2 )
+{
+	return k1.length == k2.length && memcmp( k1.key, k2.key, k1.length ) == 0;
+}
+
+inline bool operator!=( const StringKey& k1, const StringKey& k2 )
+{
+	return !( k1 == k2 );
+}
+
+/**
+ * @brief Number of key slots in B+Tree leaf for key type T.
+ */
+//                                                                     sibling ptrs, included page   key count       high key              key              rid
+template <class T>
+constexpr int leafArraySize() { return ( Page::SIZE - 3 * sizeof( PageId ) - sizeof( int ) - sizeof( T ) ) / ( sizeof( T ) + sizeof( RecordId ) ); }
+
+/**
+ * @brief Number of key slots in B+Tree non-leaf for key type T.
+ */
+//                                                                           level       key count      extra pageNo      extra count             sibling ptr       high key              key            pageNo              count
+template <class T>
+constexpr int nonLeafArraySize() { return ( Page::SIZE - sizeof( int ) - sizeof( int ) - sizeof( PageId ) - sizeof( unsigned int ) - sizeof( PageId ) - sizeof( T ) ) / ( sizeof( T ) + sizeof( PageId ) + sizeof( unsigned int ) ); }
+
+/**
+ * @brief Number of key slots in B+Tree leaf for INTEGER key.
  */
-//                                                     level     extra pageNo                  key       pageNo
-const  int INTARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( PageId ) );
+const  int INTARRAYLEAFSIZE = leafArraySize<int>();
 
 /**
  * @brief Number of key slots in B+Tree leaf for DOUBLE key.
  */
-//                                                        level        extra pageNo                 key            pageNo   -1 due to structure padding
-const  int DOUBLEARRAYNONLEAFSIZE = (( Page::SIZE - sizeof( int ) - sizeof( PageId ) ) / ( sizeof( double ) + sizeof( PageId ) )) - 1;
+const  int DOUBLEARRAYLEAFSIZE = leafArraySize<double>();
+
+/**
+ * @brief Number of key slots in B+Tree non-leaf for INTEGER key.
+ */
+const  int INTARRAYNONLEAFSIZE = nonLeafArraySize<int>();
 
 /**
- * @brief Number of key slots in B+Tree leaf for STRING key.
+ * @brief Number of key slots in B+Tree non-leaf for DOUBLE key.
  */
-//                                                        level        extra pageNo             key                   pageNo
-const  int STRINGARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) ) / ( 10 * sizeof(char) + sizeof( PageId ) );
+const  int DOUBLEARRAYNONLEAFSIZE = nonLeafArraySize<double>();
+
+/**
+ * @brief Order of record ids, by page number and then by slot number. The rids of a key come out of a scan
+ * in this order, so the records they point to are fetched going forward through the relation.
+*/
+inline bool ridLess( const RecordId& r1, const RecordId& r2 )
+{
+	if( r1.page_number != r2.page_number )
+		return r1.page_number < r2.page_number;
+	return r1.slot_number < r2.slot_number;
+}
 
 /**
  * @brief Structure to store a key-rid pair. It is used to pass the pair to functions that 
@@ -107,17 +314,22 @@ class PageKeyPair{
 public:
 	PageId pageNo;
 	T key;
-	void set( int p, T k)
+
+  /**
+   * Number of rids under the page, see NonLeafNode::countArray.
+   */
+	unsigned int count;
+	void set( int p, T k, unsigned int c )
 	{
 		pageNo = p;
 		key = k;
+		count = c;
 	}
 };
 
 /**
  * @brief Overloaded operator to compare the key values of two rid-key pairs
- * and if they are the same compares to see if the first pair has
- * a smaller rid.pageNo value.
+ * and if they are the same compares their rids with ridLess.
 */
 template <class T>
 bool operator<( const RIDKeyPair<T>& r1, const RIDKeyPair<T>& r2 )
@@ -125,7 +337,7 @@ bool operator<( const RIDKeyPair<T>& r1, const RIDKeyPair<T>& r2 )
 	if( r1.key != r2.key )
 		return r1.key < r2.key;
 	else
-		return r1.rid.page_number < r2.rid.page_number;
+		return ridLess( r1.rid, r2.rid );
 }
 
 /**
@@ -156,292 +368,2334 @@ struct IndexMetaInfo{
    * Page number of root page of the B+ Tree inside the file index file.
    */
 	PageId rootPageNo;
-};
 
-/*
-Each node is a page, so once we read the page in we just cast the pointer to the page to this struct and use it to access the parts
-These structures basically are the format in which the information is stored in the pages for the index file depending on what kind of 
-node they are. The level memeber of each non leaf structure seen below is set to 1 if the nodes 
-at this level are just above the leaf nodes. Otherwise set to 0.
-*/
+  /**
+   * First page of the list of pages freed by merges, NULL if there are none.
+   */
+	PageId freePageNo;
 
-/**
- * @brief Structure for all non-leaf nodes when the key is of INTEGER type.
-*/
-struct NonLeafNodeInt{
   /**
-   * Level of the node in the tree.
+   * True if the non-leaf nodes count the rids under every child, see SUBTREE_COUNTS. Fixed when the file is created.
    */
-	int level;
+	bool counted;
 
   /**
-   * Stores keys.
+   * Page holding the IndexStatistics collected while the file was built, NULL if it has none.
    */
-	int keyArray[ INTARRAYNONLEAFSIZE ];
+	PageId statisticsPageNo;
 
   /**
-   * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
+   * Offset and length of the bytes of every record kept with its leaf entry, see IncludedPage, length 0 if there
+   * is none.
    */
-	PageId pageNoArray[ INTARRAYNONLEAFSIZE + 1 ];
+	int includedOffset;
+	int includedLength;
 };
 
 /**
- * @brief Structure for all non-leaf nodes when the key is of DOUBLE type.
+ * @brief Slot number that marks a leaf entry whose key has more than one rid. The page number of the rid
+ * of the entry is then the first page of the posting list of the key. Records are numbered from slot 1,
+ * so no real record id has it.
+ */
+const  SlotId POSTINGSLOT = 0;
+
+/**
+ * @brief Number of rids on a posting list page.
+ */
+//                                                 next page        rid count           rid
+const  int POSTINGPAGESIZE = ( Page::SIZE - sizeof( PageId ) - sizeof( int ) ) / sizeof( RecordId );
+
+/**
+ * @brief Structure of the pages holding the rids of a key that has more than one. They are chained from the
+ * leaf entry of the key and keep its rids in ridLess order. A posting list belongs to the leaf its key is on
+ * and is only read or changed under the latch of that leaf.
 */
-struct NonLeafNodeDouble{
+struct PostingPage{
   /**
-   * Level of the node in the tree.
+   * Next page of the list, NULL for the last one.
    */
-	int level;
+	PageId nextPageNo;
 
   /**
-   * Stores keys.
+   * Number of rids in use. They always occupy ridArray[0 .. numRids - 1].
    */
-	double keyArray[ DOUBLEARRAYNONLEAFSIZE ];
+	int numRids;
 
   /**
-   * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
+   * The rids, in increasing order across the whole list.
    */
-	PageId pageNoArray[ DOUBLEARRAYNONLEAFSIZE + 1 ];
+	RecordId ridArray[ POSTINGPAGESIZE ];
 };
 
 /**
- * @brief Structure for all non-leaf nodes when the key is of STRING type.
+ * @brief Number of bytes for rows on an included column page.
+ */
+//                                                 next page        row count
+const  int INCLUDEDPAGESIZE = Page::SIZE - sizeof( PageId ) - sizeof( int );
+
+/**
+ * @brief Structure of the pages holding the included columns of the entries of a leaf, see
+ * IndexMetaInfo::includedLength. They are chained from the leaf and belong to it like its posting lists: splits
+ * and merges move the rows along with the entries, so a scan reads them in key order with the leaves. A row is the
+ * rid of an entry, or of a posting list of it, followed by the includedLength bytes of its record.
 */
-struct NonLeafNodeString{
+struct IncludedPage{
   /**
-   * Level of the node in the tree.
+   * Next page of the list, NULL for the last one.
    */
-	int level;
+	PageId nextPageNo;
 
   /**
-   * Stores keys.
+   * Number of rows in use. They always occupy the front of rows.
    */
-	char keyArray[ STRINGARRAYNONLEAFSIZE ][ STRINGSIZE ];
+	int numRows;
 
   /**
-   * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
+   * The rows, in ridLess order of their rids across the whole list.
    */
-	PageId pageNoArray[ STRINGARRAYNONLEAFSIZE + 1 ];
+	char rows[ INCLUDEDPAGESIZE ];
 };
 
 /**
- * @brief Structure for all leaf nodes when the key is of INTEGER type.
+ * @brief Number of buckets in the histogram of IndexStatistics for key type T, as many as fit on a page up to 64.
+ */
+template <class T>
+constexpr int histogramSize()
+{
+	//the two counts and numBuckets with its padding, the sketch and the highest key, then a key and a count per bucket
+	int fit = ( Page::SIZE - 4 * sizeof( long long ) - SKETCHREGISTERS - sizeof( T ) ) / ( sizeof( T ) + sizeof( long long ) );
+	return fit < 64 ? fit : 64;
+}
+
+/**
+ * @brief Structure of the page with the statistics of the keys an index was built from, for BTreeIndex::estimateRange.
+ * The histogram is equi-depth: its buckets hold about as many rids each, and bucket i holds the keys from
+ * bucketBounds[i] to bucketBounds[i + 1], both included. A bucket whose two bounds are the same holds a single key
+ * that has at least the rids of a whole bucket. The bounds come from a sample of the keys, so buckets share rids of a
+ * key on their common bound. The sketch is a HyperLogLog of every key. The statistics are not kept up to date by
+ * inserts and deletes after the build.
 */
-struct LeafNodeInt{
+template <class T>
+struct IndexStatistics{
   /**
-   * Stores keys.
+   * Number of rids the index was built with.
    */
-	int keyArray[ INTARRAYLEAFSIZE ];
+	long long numRids;
 
   /**
-   * Stores RecordIds.
+   * Number of distinct keys among them, as the sketch estimates it.
    */
-	RecordId ridArray[ INTARRAYLEAFSIZE ];
+	long long distinctKeys;
 
   /**
-   * Page number of the leaf on the right side.
-	 * This linking of leaves allows to easily move from one leaf to the next leaf during index scan.
+   * Number of buckets in use, 0 for an empty index.
    */
-	PageId rightSibPageNo;
-};
+	int numBuckets;
 
-/**
- * @brief Structure for all leaf nodes when the key is of DOUBLE type.
-*/
-struct LeafNodeDouble{
   /**
-   * Stores keys.
+   * Lowest key, the bounds between buckets and highest key, numBuckets + 1 of them.
    */
-	double keyArray[ DOUBLEARRAYLEAFSIZE ];
+	T bucketBounds[ histogramSize<T>() + 1 ];
 
   /**
-   * Stores RecordIds.
+   * Number of rids in each bucket.
    */
-	RecordId ridArray[ DOUBLEARRAYLEAFSIZE ];
+	long long bucketCounts[ histogramSize<T>() ];
 
   /**
-   * Page number of the leaf on the right side.
-	 * This linking of leaves allows to easily move from one leaf to the next leaf during index scan.
+   * Registers of the distinct key sketch, each the longest run of trailing zero bits seen in the hashes of its keys, plus one.
    */
-	PageId rightSibPageNo;
+	unsigned char sketch[ SKETCHREGISTERS ];
 };
 
 /**
- * @brief Structure for all leaf nodes when the key is of STRING type.
+ * @brief Structure of an index page freed by a merge until a split reuses it.
 */
-struct LeafNodeString{
+struct FreePage{
   /**
-   * Stores keys.
+   * Next page of the free list, NULL for the last one.
+   */
+	PageId nextPageNo;
+};
+
+/**
+ * @brief Structure for the pages of the temporary file a bulk load spills its sorted runs to.
+ * A run is a chain of pages linked through nextPageNo, each holding numEntries pairs in sorted order.
+*/
+template <class T>
+struct SortRunPage{
+	typedef RIDKeyPair<T> Entry;
+
+  /**
+   * Number of pairs a single run page can hold.
    */
-	char keyArray[ STRINGARRAYLEAFSIZE ][ STRINGSIZE ];
+	static const int CAPACITY = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) ) / sizeof( RIDKeyPair<T> );
 
   /**
-   * Stores RecordIds.
+   * Number of valid pairs stored on this page.
    */
-	RecordId ridArray[ STRINGARRAYLEAFSIZE ];
+	int numEntries;
 
   /**
-   * Page number of the leaf on the right side.
-	 * This linking of leaves allows to easily move from one leaf to the next leaf during index scan.
+   * Page number of the next page of the same run, NULL on the last page of a run.
    */
-	PageId rightSibPageNo;
+	PageId nextPageNo;
+
+  /**
+   * Stores key-rid pairs.
+   */
+	RIDKeyPair<T> entries[ CAPACITY ];
 };
 
 /**
- * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
- * relation. This index supports only one scan at a time.
+ * @brief Structure for the pages of the temporary file a heap order scan spills its sorted rids to, chained into
+ * runs like those of SortRunPage.
 */
-class BTreeIndex {
+struct RidRunPage{
+	typedef RecordId Entry;
 
- private:
+  /**
+   * Number of rids a single run page can hold.
+   */
+	static const int CAPACITY = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) ) / sizeof( RecordId );
 
   /**
-   * File object for the index file.
+   * Number of valid rids stored on this page.
    */
-	File		*file;
+	int numEntries;
 
   /**
-   * Buffer Manager Instance.
+   * Page number of the next page of the same run, NULL on the last page of a run.
    */
-	BufMgr	*bufMgr;
+	PageId nextPageNo;
 
   /**
-   * Page number of meta page.
+   * Stores rids.
    */
-	PageId	headerPageNum;
+	RecordId entries[ CAPACITY ];
+};
 
+/*
+Each node is a page, so once we read the page in we just cast the pointer to the page to this struct and use it to access the parts
+These structures basically are the format in which the information is stored in the pages for the index file depending on what kind of 
+node they are. The level memeber of each non leaf structure seen below is set to 1 if the nodes 
+at this level are just above the leaf nodes. Otherwise set to 0.
+Every node on a level is linked to the next one on its right and knows the high key that separates them, so a
+thread that lands on a node after it was split can still find its key by moving right (a B-link tree).
+INTEGER and DOUBLE nodes keep their keys in fixed arrays. STRING nodes store every key with just its own length
+on a slotted page, see StringNode. The tree only goes through the member functions below, which both layouts have.
+Fence keys are passed by pointer, NULL standing for no bound on that side.
+The entries of a non-leaf are given as the page number of every child with the key left of it: entries[0] is the
+first child, whose key is the low key of the node, and entries[i] is child i with key i - 1.
+*/
+
+/**
+ * @brief Structure for all non-leaf nodes, templated on the key type.
+*/
+template <class T>
+struct NonLeafNode{
   /**
-   * page number of root page of B+ tree inside index file.
+   * Number of keys a node holds at most. Space used by entries is measured with entryWeight, in these units.
    */
-	PageId	rootPageNum;
+	static const int CAPACITY = nonLeafArraySize<T>();
 
   /**
-  * Page pointer to rootPage. Only page to be kept in buffer from constructor to destructor
-  */
-	Page* rootPage;
+   * Largest entryWeight of any key.
+   */
+	static const int MAXENTRYWEIGHT = 1;
 
   /**
-   * Datatype of attribute over which index is built.
+   * Level of the node in the tree.
    */
-	Datatype	attributeType;
+	int level;
 
   /**
-   * Offset of attribute, over which index is built, inside records. 
+   * Number of keys in use. They always occupy keyArray[0 .. numKeys - 1].
    */
-	int 		attrByteOffset;
+	int numKeys;
 
   /**
-   * Number of keys in leaf node, depending upon the type of key.
+   * Stores keys.
    */
-	int			leafOccupancy;
+	T keyArray[ nonLeafArraySize<T>() ];
 
   /**
-   * Number of keys in non-leaf node, depending upon the type of key.
+   * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
    */
-	int			nodeOccupancy;
+	PageId pageNoArray[ nonLeafArraySize<T>() + 1 ];
 
+  /**
+   * Number of rids under each child, posting lists included. Only kept up to date in an index with
+   * IndexMetaInfo::counted set.
+   */
+	unsigned int countArray[ nonLeafArraySize<T>() + 1 ];
 
-	// MEMBERS SPECIFIC TO SCANNING
+  /**
+   * Page number of the node on the right side on the same level, NULL for the last node of a level.
+   */
+	PageId rightSibPageNo;
 
   /**
-   * True if an index scan has been started.
+   * Upper bound, exclusive, of the keys under this node. Only set if rightSibPageNo is, the keys from
+   * highKey on are found by following rightSibPageNo.
    */
-	bool		scanExecuting;
+	T highKey;
 
   /**
-   * Index of next entry to be scanned in current leaf being scanned.
+   * Space taken by a key and its child, see CAPACITY.
    */
-	int			nextEntry;
+	static int entryWeight( const T& key ) { return 1; }
 
   /**
-   * Page number of current page being scanned.
+   * Whether a node with the given fence keys has room for entries[0 .. count - 1].
    */
-	PageId	currentPageNum;
+	static bool fits( const T* lowKey, const T* highKey, const PageKeyPair<T>* entries, int count ) { return count - 1 <= CAPACITY; }
 
   /**
-   * Current Page being scanned.
+   * Make this an empty node on the given level with no right sibling.
    */
-	Page		*currentPageData;
+	void init( int level );
 
   /**
-   * Low INTEGER value for scan.
+   * Replace the keys, children and fence keys of the node by the given ones. Leaves level and rightSibPageNo alone.
    */
-	int			lowValInt;
+	void build( const T* lowKey, const T* highKey, const PageKeyPair<T>* entries, int count );
 
   /**
-   * Low DOUBLE value for scan.
+   * Append the entries of the node to entries.
    */
-	double	lowValDouble;
+	void getEntries( std::vector<PageKeyPair<T> >& entries ) const;
+
+	T keyAt( int i ) const { return keyArray[i]; }
+	PageId& childAt( int i ) { return pageNoArray[i]; }
+	unsigned int& countAt( int i ) { return countArray[i]; }
 
   /**
-   * Low STRING value for scan.
+   * Index of the first key greater than key, which is also the child key belongs to.
    */
-	std::string	lowValString;
+	int upperBound( const T& key ) const;
 
   /**
-   * High INTEGER value for scan.
+   * Low key of the node, if it has one. Array nodes do not keep it.
    */
-	int			highValInt;
+	bool getLowKey( T& key ) const { return false; }
 
   /**
-   * High DOUBLE value for scan.
+   * High key of the node, if it has one.
    */
-	double	highValDouble;
+	bool getHighKey( T& key ) const { key = highKey; return rightSibPageNo != NULL; }
 
   /**
-   * High STRING value for scan.
+   * Whether key belongs to a node further right on the same level.
    */
-	std::string highValString;
-	
+	bool pastHighKey( const T& key ) const { return rightSibPageNo != NULL && !( key < highKey ); }
+
+	bool hasRoom( const T& key ) const { return numKeys < CAPACITY; }
+
   /**
-   * Low Operator. Can only be GT(>) or GTE(>=).
+   * Whether the node has room for any key a split below it could push up.
    */
-	Operator	lowOp;
+	bool hasRoomForAny() const { return numKeys < CAPACITY; }
 
   /**
-   * High Operator. Can only be LT(<) or LTE(<=).
+   * Whether the node stays at least half full after losing any one of its keys.
    */
-	Operator	highOp;
+	bool canLoseEntry() const { return numKeys > CAPACITY / 2; }
 
-	/**
-	* When restructuring an index on integers, this is the value the new page was split on
-	*/
-	int middleInt;
+	bool isUnderfull() const { return numKeys < CAPACITY / 2; }
 
-	/**
-	* When restructuring an index on doubles, this is the value the new page was split on
-	*/
-	double middleDouble;
+  /**
+   * Insert key at index i with rightChild, which has rightCount rids under it, as the child right of it.
+   */
+	void insertAt( int i, const T& key, PageId rightChild, unsigned int rightCount );
 
-	/**
-	* When restructuring an index on strings, this is the value the new page was split on
-	*/
-	std::string middleString;
+  /**
+   * Remove key i and the child right of it.
+   */
+	void removeAt( int i );
 
-	
- public:
+	bool canReplaceKey( int i, const T& key ) const { return true; }
+	void replaceKey( int i, const T& key ) { keyArray[i] = key; }
+};
+
+/**
+ * @brief Structure for all leaf nodes, templated on the key type.
+*/
+template <class T>
+struct LeafNode{
+  /**
+   * Number of entries a leaf holds at most. Space used by entries is measured with entryWeight, in these units.
+   */
+	static const int CAPACITY = leafArraySize<T>();
+
+  /**
+   * Largest entryWeight of any key.
+   */
+	static const int MAXENTRYWEIGHT = 1;
+
+  /**
+   * Stores keys.
+   */
+	T keyArray[ leafArraySize<T>() ];
+
+  /**
+   * Stores RecordIds.
+   */
+	RecordId ridArray[ leafArraySize<T>() ];
+
+  /**
+   * Page number of the leaf on the right side.
+	 * This linking of leaves allows to easily move from one leaf to the next leaf during index scan.
+   */
+	PageId rightSibPageNo;
+
+  /**
+   * Page number of the leaf on the left side, which descending scans move to.
+   */
+	PageId leftSibPageNo;
+
+  /**
+   * First page of the included columns of the entries, see IncludedPage, NULL if there are none.
+   */
+	PageId includedPageNo;
+
+  /**
+   * Number of keys in use. They always occupy keyArray[0 .. numKeys - 1].
+   */
+	int numKeys;
+
+  /**
+   * Upper bound, exclusive, of the keys on this leaf. Only set if rightSibPageNo is.
+   */
+	T highKey;
+
+  /**
+   * Space taken by an entry, see CAPACITY.
+   */
+	static int entryWeight( const T& key ) { return 1; }
+
+  /**
+   * Whether a leaf with the given fence keys has room for entries[0 .. count - 1].
+   */
+	static bool fits( const T* lowKey, const T* highKey, const RIDKeyPair<T>* entries, int count ) { return count <= CAPACITY; }
+
+  /**
+   * Make this an empty leaf with no siblings.
+   */
+	void init();
+
+  /**
+   * Replace the entries and fence keys of the leaf by the given ones. Leaves the sibling links and the included
+   * columns alone.
+   */
+	void build( const T* lowKey, const T* highKey, const RIDKeyPair<T>* entries, int count );
+
+  /**
+   * Append the entries of the leaf to entries.
+   */
+	void getEntries( std::vector<RIDKeyPair<T> >& entries ) const;
+
+	T keyAt( int i ) const { return keyArray[i]; }
+	bool isKeyAt( int i, const T& key ) const { return keyArray[i] == key; }
+	RecordId& ridAt( int i ) { return ridArray[i]; }
+
+  /**
+   * Index of the first key not less than key.
+   */
+	int lowerBound( const T& key ) const;
+
+  /**
+   * Index of the first key greater than key.
+   */
+	int upperBound( const T& key ) const;
+
+	bool getLowKey( T& key ) const { return false; }
+	bool getHighKey( T& key ) const { key = highKey; return rightSibPageNo != NULL; }
+	bool pastHighKey( const T& key ) const { return rightSibPageNo != NULL && !( key < highKey ); }
+
+	bool hasRoom( const T& key ) const { return numKeys < CAPACITY; }
+
+  /**
+   * Whether the leaf stays at least half full after losing entry i.
+   */
+	bool canLoseEntry( int i ) const { return numKeys > CAPACITY / 2; }
+
+	bool isUnderfull() const { return numKeys < CAPACITY / 2; }
+
+  /**
+   * Share of the node its entries take.
+   */
+	double fill() const { return (double) numKeys / CAPACITY; }
+
+	void insertAt( int i, const T& key, const RecordId& rid );
+	void removeAt( int i );
+};
+
+/**
+ * @brief Bytes of a STRING node after its header, shared by its slots and its key bytes.
+ */
+//                                                      header, see StringNode
+const  int STRINGNODEDATASIZE = Page::SIZE - 44;
+
+/**
+ * @brief Child of a STRING non-leaf as its slot holds it: the page number and the number of rids under it, see
+ * NonLeafNode::countArray.
+*/
+struct StringChild{
+	PageId pageNo;
+	unsigned int count;
+};
+
+/**
+ * @brief Slot of a STRING node, locating the bytes of one key inside the node and holding its rid or child.
+*/
+template <class Payload>
+struct StringSlot{
+  /**
+   * Where the key bytes past the prefix of the node start in data.
+   */
+	unsigned short offset;
+
+  /**
+   * Number of key bytes past the prefix of the node.
+   */
+	unsigned short length;
+
+	Payload payload;
+};
+
+/**
+ * @brief Slotted page layout of the STRING nodes. Slots in key order grow from the front of data and the key
+ * bytes they point to grow from the back, so a node holds as many keys as their actual lengths allow.
+ * The node also stores its low and high fence keys, the bounds of the keys that can be on it, and every key
+ * under it starts with the bytes the fences have in common. That prefix is stored once, as part of the low
+ * fence, and only the rest of each key is kept in its slot.
+ * Space freed by removing keys is reclaimed by compacting the key bytes once an insert needs it.
+*/
+template <class Payload>
+struct StringNode{
+	typedef StringSlot<Payload> Slot;
+
+  /**
+   * Bytes a node has for entries, see NonLeafNode::CAPACITY. Room for both fences and one more entry is kept
+   * aside, so a node filled up to CAPACITY by a bulk load still fits.
+   */
+	static const int CAPACITY = STRINGNODEDATASIZE - 3 * STRINGSIZE - sizeof( Slot );
+
+	static const int MAXENTRYWEIGHT = sizeof( Slot ) + STRINGSIZE;
+
+  /**
+   * Level of the node in the tree, only used by non-leaves.
+   */
+	int level;
+
+  /**
+   * Number of keys in use, their slots occupy the front of data.
+   */
+	int numKeys;
+
+	PageId rightSibPageNo;
+
+  /**
+   * Page number of the child left of the first key and the number of rids under it, only used by non-leaves.
+   */
+	PageId firstPageNo;
+	unsigned int firstCount;
+
+  /**
+   * Page number of the leaf on the left side, only used by leaves.
+   */
+	PageId leftSibPageNo;
+
+  /**
+   * First page of the included columns of the entries, see LeafNode::includedPageNo, only used by leaves.
+   */
+	PageId includedPageNo;
+
+  /**
+   * Offset in data of the lowest key byte in use, key bytes occupy data[heapStart .. STRINGNODEDATASIZE - 1].
+   */
+	unsigned short heapStart;
+
+  /**
+   * Bytes between heapStart and the end of data that no key uses any more.
+   */
+	unsigned short garbage;
+
+	unsigned short lowOffset;
+	unsigned short lowLength;
+	unsigned short highOffset;
+	unsigned short highLength;
+
+  /**
+   * Number of leading bytes of the low fence every key on the node starts with.
+   */
+	unsigned short prefixLength;
+
+	unsigned char hasLowKey;
+	unsigned char hasHighKey;
+
+	char data[ STRINGNODEDATASIZE ];
+
+	static int entryWeight( const StringKey& key ) { return sizeof( Slot ) + key.length; }
+
+  /**
+   * Bytes of data a node with the given fences needs for count keys of keyBytes bytes in total.
+   */
+	static int bytesNeeded( const StringKey* lowKey, const StringKey* highKey, int count, int keyBytes );
+
+	StringKey keyAt( int i ) const;
+	bool isKeyAt( int i, const StringKey& key ) const;
+	int lowerBound( const StringKey& key ) const;
+	int upperBound( const StringKey& key ) const;
+	bool getLowKey( StringKey& key ) const;
+	bool getHighKey( StringKey& key ) const;
+	bool pastHighKey( const StringKey& key ) const;
+	bool hasRoom( const StringKey& key ) const { return freeBytes() >= (int) sizeof( Slot ) + key.length - prefixLength; }
+	bool hasRoomForAny() const { return freeBytes() >= (int) sizeof( Slot ) + STRINGSIZE - prefixLength; }
+	bool isUnderfull() const { return usedBytes() < STRINGNODEDATASIZE / 2; }
+	double fill() const { return (double) usedBytes() / STRINGNODEDATASIZE; }
+	void insertAt( int i, const StringKey& key, const Payload& payload );
+	void removeAt( int i );
+	bool canReplaceKey( int i, const StringKey& key ) const { return freeBytes() + slots()[i].length >= key.length - prefixLength; }
+	void replaceKey( int i, const StringKey& key );
+
+ protected:
+	Slot* slots() { return (Slot*) data; }
+	const Slot* slots() const { return (const Slot*) data; }
+	int freeBytes() const { return heapStart - numKeys * (int) sizeof( Slot ) + garbage; }
+	int usedBytes() const { return STRINGNODEDATASIZE - freeBytes(); }
+
+  /**
+   * Empty the node and set its fences, which fixes the prefix of its keys.
+   */
+	void clear( const StringKey* lowKey, const StringKey* highKey );
+
+ private:
+  /**
+   * Compare the prefix of the node with the start of key: negative if key sorts before every key with the
+   * prefix, positive if after all of them and 0 if key starts with it.
+   */
+	int comparePrefix( const StringKey& key ) const;
+
+  /**
+   * Compare key i with key, which has to start with the prefix of the node.
+   */
+	int compareSuffix( int i, const StringKey& key ) const;
+
+  /**
+   * Copy length bytes to the heap, there has to be room for them in front of heapStart.
+   */
+	unsigned short addToHeap( const char* bytes, int length );
+
+  /**
+   * Move all key bytes in use to the end of data, turning the garbage into free space in front of heapStart.
+   */
+	void compact();
+};
+
+template <>
+struct NonLeafNode<StringKey> : public StringNode<StringChild>{
+	static bool fits( const StringKey* lowKey, const StringKey* highKey, const PageKeyPair<StringKey>* entries, int count );
+	void init( int level );
+	void build( const StringKey* lowKey, const StringKey* highKey, const PageKeyPair<StringKey>* entries, int count );
+	void getEntries( std::vector<PageKeyPair<StringKey> >& entries ) const;
+	PageId& childAt( int i ) { return i == 0 ? firstPageNo : slots()[i - 1].payload.pageNo; }
+	unsigned int& countAt( int i ) { return i == 0 ? firstCount : slots()[i - 1].payload.count; }
+	void insertAt( int i, const StringKey& key, PageId rightChild, unsigned int rightCount );
+	bool canLoseEntry() const { return usedBytes() - MAXENTRYWEIGHT >= STRINGNODEDATASIZE / 2; }
+};
+
+template <>
+struct LeafNode<StringKey> : public StringNode<RecordId>{
+	static bool fits( const StringKey* lowKey, const StringKey* highKey, const RIDKeyPair<StringKey>* entries, int count );
+	void init();
+	void build( const StringKey* lowKey, const StringKey* highKey, const RIDKeyPair<StringKey>* entries, int count );
+	void getEntries( std::vector<RIDKeyPair<StringKey> >& entries ) const;
+	RecordId& ridAt( int i ) { return slots()[i].payload; }
+	bool canLoseEntry( int i ) const { return usedBytes() - (int) sizeof( Slot ) - slots()[i].length >= STRINGNODEDATASIZE / 2; }
+};
+
+/**
+ * @brief Structure for all non-leaf nodes when the key is of INTEGER type.
+*/
+typedef NonLeafNode<int> NonLeafNodeInt;
+
+/**
+ * @brief Structure for all non-leaf nodes when the key is of DOUBLE type.
+*/
+typedef NonLeafNode<double> NonLeafNodeDouble;
+
+/**
+ * @brief Structure for all non-leaf nodes when the key is of STRING type.
+*/
+typedef NonLeafNode<StringKey> NonLeafNodeString;
+
+/**
+ * @brief Structure for all leaf nodes when the key is of INTEGER type.
+*/
+typedef LeafNode<int> LeafNodeInt;
+
+/**
+ * @brief Structure for all leaf nodes when the key is of DOUBLE type.
+*/
+typedef LeafNode<double> LeafNodeDouble;
+
+/**
+ * @brief Structure for all leaf nodes when the key is of STRING type.
+*/
+typedef LeafNode<StringKey> LeafNodeString;
+
+static_assert( sizeof( NonLeafNodeInt ) <= Page::SIZE && sizeof( LeafNodeInt ) <= Page::SIZE, "INTEGER nodes must fit on a page" );
+static_assert( sizeof( NonLeafNodeDouble ) <= Page::SIZE && sizeof( LeafNodeDouble ) <= Page::SIZE, "DOUBLE nodes must fit on a page" );
+static_assert( sizeof( NonLeafNodeString ) <= Page::SIZE && sizeof( LeafNodeString ) <= Page::SIZE, "STRING nodes must fit on a page" );
+static_assert( sizeof( IndexStatistics<int> ) <= Page::SIZE && sizeof( IndexStatistics<double> ) <= Page::SIZE
+	&& sizeof( IndexStatistics<StringKey> ) <= Page::SIZE, "Index statistics must fit on a page" );
+
+/**
+ * @brief Per key type constants and conversions used by TypedBTreeIndex. Comparisons use the
+ * operators of the key type itself.
+*/
+template <class T>
+struct KeyTraits;
+
+template <>
+struct KeyTraits<int>{
+  /**
+   * Datatype stored in the meta page for this key type.
+   */
+	static const Datatype TYPE = INTEGER;
+
+  /**
+   * Value stored in unused key slots.
+   */
+	static int nullKey() { return INT_MAX; }
+
+  /**
+   * Key passed in through the const void* API.
+   */
+	static int fromPtr( const void* ptr ) { return *( (const int*) ptr ); }
+
+  /**
+   * Key stored at the attribute offset inside a record of the base relation.
+   */
+	static int fromRecord( const char* src ) { int key; memcpy( &key, src, sizeof( int ) ); return key; }
+
+  /**
+   * Key to put in a parent between two neighbouring nodes whose keys end with left and start with right.
+   * Any key in (left, right] would do, so key types that take less room when shorter pick the shortest one.
+   */
+	static int separator( int left, int right ) { return right; }
+
+  /**
+   * Where key lies on a line that increases with the key, for spreading the rids of a histogram bucket between its bounds.
+   */
+	static double position( int key ) { return key; }
+
+  /**
+   * Hash of key for the distinct key sketch, equal keys have equal hashes.
+   */
+	static unsigned long long hash( int key ) { return mixBits( (unsigned int) key ); }
+};
+
+template <>
+struct KeyTraits<double>{
+	static const Datatype TYPE = DOUBLE;
+	static double nullKey() { return DBL_MAX; }
+	static double fromPtr( const void* ptr ) { return *( (const double*) ptr ); }
+	static double fromRecord( const char* src ) { double key; memcpy( &key, src, sizeof( double ) ); return key; }
+	static double separator( double left, double right ) { return right; }
+	static double position( double key ) { return key; }
+	static unsigned long long hash( double key )
+	{
+		//-0.0 and 0.0 are the same key
+		unsigned long long bits = 0;
+		if( key != 0 ) memcpy( &bits, &key, sizeof( double ) );
+		return mixBits( bits );
+	}
+};
+
+template <>
+struct KeyTraits<StringKey>{
+	static const Datatype TYPE = STRING;
+	static StringKey nullKey() { StringKey key; key.length = 0; memset( key.key, 0, STRINGSIZE ); return key; }
+	static StringKey fromPtr( const void* ptr ) { return fromRecord( (const char*) ptr ); }
+	static StringKey fromRecord( const char* src )
+	{
+		StringKey key;
+		key.length = strnlen( src, STRINGSIZE );
+		memcpy( key.key, src, key.length );
+		return key;
+	}
+
+  /**
+   * The shortest prefix of right that is still greater than left.
+   */
+	static StringKey separator( const StringKey& left, const StringKey& right )
+	{
+		StringKey key;
+		key.length = commonPrefixLength( left.key, left.length, right.key, right.length ) + 1;
+		memcpy( key.key, right.key, key.length );
+		return key;
+	}
+
+  /**
+   * The first 8 characters as the digits of a fraction in base 256, so keys that only differ later share a position.
+   */
+	static double position( const StringKey& key )
+	{
+		double position = 0;
+		double scale = 1.0 / 256;
+		for( int i = 0; i < 8 && i < key.length; i++, scale /= 256 ) position += (unsigned char) key.key[i] * scale;
+		return position;
+	}
+
+  /**
+   * FNV-1a of the characters.
+   */
+	static unsigned long long hash( const StringKey& key )
+	{
+		unsigned long long hash = 14695981039346656037ULL;
+		for( int i = 0; i < key.length; i++ ) hash = ( hash ^ (unsigned char) key.key[i] ) * 1099511628211ULL;
+		return mixBits( hash );
+	}
+};
+
+/**
+ * @brief A scan over a range of keys of a B+ Tree index, returned by BTreeIndex::openScan. Any number of
+ * cursors may be open on one index at once, each keeping only its own current leaf pinned. Deleting the
+ * cursor ends the scan; this has to happen before the index itself is destroyed.
+*/
+class ScanCursor {
+ public:
+	virtual ~ScanCursor() {}
+
+  /**
+	 * Fetch the record id of the next index entry that matches the scan. See BTreeIndex::scanNext.
+   * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+	 * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+	**/
+	virtual const void scanNext(RecordId& outRid) = 0;
+
+  /**
+	 * Fetch the record ids of the next index entries that match the scan, up to max of them. See BTreeIndex::scanNextBatch.
+   * @param out	Receives the record ids
+   * @param max	Room in out
+   * @return Number of record ids stored in out, 0 once the scan is completed
+	**/
+	virtual size_t scanNextBatch(RecordId* out, size_t max) = 0;
+};
+
+/**
+ * @brief A scan whose rids come in heap order, by page number and within a page by slot number, rather than in
+ * key order. Returned by BTreeIndex::openHeapOrderScan. The scan of the index is run to its end when the cursor is
+ * opened, so no leaf stays pinned. Rids past the memory budget are sorted into runs on a temporary file, which are
+ * merged as the rids are handed out and removed with the cursor.
+*/
+class HeapOrderCursor : public ScanCursor {
+
+ private:
+
+  /**
+   * Buffer Manager Instance.
+   */
+	BufMgr	*bufMgr;
+
+  /**
+   * Name of the temporary file of the runs.
+   */
+	std::string	spillFileName;
+
+  /**
+   * The temporary file of the runs, NULL if every rid fit in memory.
+   */
+	File		*spillFile;
+
+  /**
+   * Unless the rids were spilled, all of them in heap order.
+   */
+	std::vector<RecordId>	rids;
+
+  /**
+   * Index in rids of the next rid to hand out.
+   */
+	size_t	nextRid;
+
+  /**
+   * First page of every run on spillFile, in the order they were written.
+   */
+	std::vector<PageId>	runFirstPage;
+
+  /**
+   * Page each run being merged is on, pinned, NULL once the run is used up.
+   */
+	std::vector<PageId>	mergePageNo;
+	std::vector<RidRunPage*>	mergePage;
+
+  /**
+   * Index of the next rid of each run being merged on its page.
+   */
+	std::vector<int>	mergeNextEntry;
+
+  /**
+   * The next rid of every run being merged that is not used up, with the run, as a heap with the smallest on top.
+   */
+	std::vector<std::pair<RecordId, int> >	mergeHeads;
+
+ public:
+
+  /**
+   * Take every rid off the source scan, spilling sorted runs of memoryRids of them, and delete the source.
+   * @param bufMgr				Buffer manager to read and write the temporary file through
+   * @param spillFileName	Name of the temporary file, only created if the rids do not fit in memory
+   * @param source				Scan the rids come from, deleted here even if this throws
+   * @param memoryRids		Number of rids sorted in memory at a time
+   */
+	HeapOrderCursor(BufMgr* bufMgr, const std::string& spillFileName, ScanCursor* source, size_t memoryRids);
+
+  /**
+   * Unpin the pages of the runs being merged and remove the temporary file.
+   */
+	~HeapOrderCursor();
+
+	const void scanNext(RecordId& outRid);
+	size_t scanNextBatch(RecordId* out, size_t max);
+
+  /**
+	 * Fetch the record ids of the next heap page with any, up to max of them. The rest of a page that has more than
+	 * max come with the next call.
+   * @param out	Receives the record ids, all with the same page number
+   * @param max	Room in out
+   * @return Number of record ids stored in out, 0 once the scan is completed
+	**/
+	size_t scanNextPage(RecordId* out, size_t max);
+
+ private:
+
+	/**
+	* Sort the rids in memory and write them out as a new run, creating the temporary file first if need be.
+	*/
+	void writeRun();
+
+	/**
+	* Pin the first page of runs firstRun to lastRun, excluding lastRun, and queue up their first rids.
+	*/
+	void startMerge(int firstRun, int lastRun);
+
+	/**
+	* Move the merge on past the rid on top of mergeHeads.
+	*/
+	void advanceMerge();
+
+	/**
+	* The next rid to hand out, without moving on past it.
+	*
+	*@param outRid The rid
+	*@return False once the scan is completed
+	*/
+	bool peekRid(RecordId& outRid) const;
+
+	/**
+	* Unpin the pages of the runs being merged and remove the temporary file, if there is one.
+	*/
+	void removeSpillFile();
+};
+
+/**
+ * @brief How often scans moving on to the next leaf found it already fetched by the read-ahead.
+ * See BTreeIndex::setReadAhead.
+*/
+struct ReadAheadStats{
+  /**
+   * Leaves the read-ahead had fetched by the time a scan moved on to them.
+   */
+	unsigned long long hits;
+
+  /**
+   * Leaves a scan had to read itself, because the read-ahead had not got to them yet or fetched other leaves
+   * than the scan ended up on.
+   */
+	unsigned long long misses;
+};
+
+/**
+ * @brief Interface of a B+ Tree index with the key type erased. Keys are passed as pointers to
+ * an integer / double / char string. Implemented by TypedBTreeIndex for every key type.
+*/
+class BTreeIndexBase {
+ public:
+	virtual ~BTreeIndexBase() {}
+	virtual const void insertEntry(const void* key, const RecordId rid) = 0;
+	virtual const void insertEntry(const void* key, const RecordId rid, const void* includedBytes) = 0;
+	virtual const void deleteEntry(const void* key) = 0;
+	virtual const void deleteEntry(const void* key, const RecordId rid) = 0;
+	virtual ScanCursor* openScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp, const ScanDirection direction) = 0;
+	virtual HeapOrderCursor* openHeapOrderScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp, size_t memoryRids) = 0;
+	virtual const void startScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp, const ScanDirection direction) = 0;
+	virtual const void scanNext(RecordId& outRid) = 0;
+	virtual size_t scanNextBatch(RecordId* out, size_t max) = 0;
+	virtual size_t scanNextEntries(RecordId* outRids, void* outKeys, void* outIncluded, size_t max) = 0;
+	virtual const void endScan() = 0;
+	virtual bool lookup(const void* key, RecordId& outRid) = 0;
+	virtual size_t lookupBatch(const void* const* keys, size_t numKeys, RecordId* outRids, bool* found) = 0;
+	virtual size_t countRange(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp) = 0;
+	virtual double estimateRange(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp) = 0;
+	virtual void setReadAhead(int numLeaves) = 0;
+	virtual ReadAheadStats getReadAheadStats() = 0;
+	virtual IndexStats getStats(bool walkLeaves) = 0;
+};
+
+/**
+ * @brief A page held by a thread descending the tree: pinned, unless it is the root or a resident node the index
+ * keeps pinned, and latched in the mode the thread needs.
+*/
+struct LatchedPage{
+  /**
+   * Page number of the page.
+   */
+	PageId pageNo;
+
+  /**
+   * The page in the buffer pool.
+   */
+	Page* page;
+
+  /**
+   * Latch of the page.
+   */
+	PageLatch* latch;
+
+  /**
+   * True if the pin belongs to the index rather than to the thread, as it does for the root and resident nodes.
+   */
+	bool keepPinned;
+};
+
+/**
+ * @brief What one insert or delete on a READ_WRITE_LOGGED index still has to do with the write-ahead log: the pages
+ * it changed and has not logged yet, and whatever has to wait until its records are durable.
+*/
+struct LogAction{
+  /**
+   * Pages changed and not logged yet, logged whole by TypedBTreeIndex::appendAction. They are still latched
+   * by the thread, or only reachable through a page that is.
+   */
+	std::vector<PageId> pageNos;
+	std::vector<Page*> pages;
+
+  /**
+   * Records for the next group, made before pages are added to it.
+   */
+	std::vector<char> records;
+
+  /**
+   * Pages unpinned dirty. They stay pinned until the log is durable, so the buffer manager cannot write them out
+   * before their records.
+   */
+	std::vector<PageId> dirtyPageNos;
+
+  /**
+   * Pages taken out of the tree. They go on the free list once the group that takes them out is in the log,
+   * so a page cannot be reused in the log before it is unlinked there.
+   */
+	std::vector<PageId> freedPageNos;
+	std::vector<Page*> freedPages;
+
+  /**
+   * Log sequence number of the last group appended, 0 if none.
+   */
+	unsigned long long lsn;
+};
+
+template <class T>
+class TypedBTreeIndex;
+
+template <class T>
+struct ParallelScanState;
+
+/**
+ * @brief ScanCursor over a TypedBTreeIndex. The leaf it is on stays pinned, but is only latched inside the
+ * constructor and scanNext, so inserts can go on between two calls.
+*/
+template <class T>
+class TypedScanCursor : public ScanCursor {
+
+	friend class TypedBTreeIndex<T>;
+
+ private:
+
+  /**
+   * The index being scanned.
+   */
+	TypedBTreeIndex<T>	*index;
+
+  /**
+   * Index of next entry to be scanned in current leaf being scanned, valid while the version of
+   * the leaf is still scanVersion.
+   */
+	int			nextEntry;
+
+  /**
+   * True once the scan is completed.
+   */
+	bool		completed;
+
+  /**
+   * ASCENDING or DESCENDING, nextEntry moves right or left through the leaves accordingly.
+   */
+	ScanDirection	direction;
+
+  /**
+   * If the next entry has a posting list, the page of it the next rid is on. NULL for the first page.
+   */
+	PageId	postingPageNo;
+
+  /**
+   * If the next entry has a posting list, the index of the next rid on postingPageNo.
+   */
+	int			postingIndex;
+
+  /**
+   * Page number of current page being scanned.
+   */
+	PageId	currentPageNum;
+
+  /**
+   * Current Page being scanned.
+   */
+	Page		*currentPageData;
+
+  /**
+   * Latch of the current page being scanned.
+   */
+	PageLatch	*currentLatch;
+
+  /**
+   * Version of the current page when nextEntry was computed.
+   */
+	unsigned int	scanVersion;
+
+  /**
+   * Merge count of the index when nextEntry was computed.
+   */
+	unsigned int	scanMergeCount;
+
+  /**
+   * The scan continues from the entries greater than this key, or greater than or equal to it if
+   * resumeInclusive is set, and from the entries less than it in a DESCENDING scan. Used to find the place
+   * again when a leaf changed between two calls.
+   */
+	T			resumeKey;
+
+  /**
+   * Unless resumeInclusive is set, the last rid returned. The rest of the posting list of resumeKey
+   * continues after it.
+   */
+	RecordId	resumeRid;
+
+  /**
+   * See resumeKey.
+   */
+	bool		resumeInclusive;
+
+  /**
+   * Low value for scan.
+   */
+	T			lowVal;
+
+  /**
+   * High value for scan.
+   */
+	T			highVal;
+	
+  /**
+   * Low Operator. Can only be GT(>) or GTE(>=).
+   */
+	Operator	lowOp;
+
+  /**
+   * High Operator. Can only be LT(<) or LTE(<=).
+   */
+	Operator	highOp;
+
+	// READ-AHEAD STATE, GUARDED BY THE readAheadLatch OF THE INDEX
+
+  /**
+   * Leaves right of the current one fetched by the read-ahead, left to right, each with the pin it took.
+   */
+	std::deque<std::pair<PageId, Page*> >	readAheadPages;
+
+  /**
+   * Next leaf for the read-ahead to fetch, NULL once it has reached the end of the scan or was called off.
+   */
+	PageId	readAheadNext;
+
+  /**
+   * Merge count of the index when readAheadNext was read off its left sibling. If it changed by the time the
+   * leaf is latched, a merge may have freed the page.
+   */
+	unsigned int	readAheadMergeCount;
+
+  /**
+   * Bumped whenever the leaves fetched so far turn out to be of no use, so a fetch in flight is dropped.
+   */
+	unsigned int	readAheadGeneration;
+
+  /**
+   * True while the cursor is on the read-ahead queue of the index or being fetched for.
+   */
+	bool		readAheadQueued;
+
+  /**
+   * Number of leaves after the last one fetched whose reads were already started on the AsyncPageReader.
+   */
+	int			readAheadIssued;
+
+ public:
+
+  /**
+   * Find the first entry of the scan and pin its leaf. See BTreeIndex::startScan for the parameters.
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+   * @throws  BadScanrangeException If lowVal > highval
+	 * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+   */
+	TypedScanCursor(TypedBTreeIndex<T>* index, const T& lowVal, const Operator lowOp, const T& highVal, const Operator highOp, const ScanDirection direction);
+
+  /**
+   * Unpin the current leaf and the leaves read ahead, after waiting for a fetch in flight.
+   */
+	~TypedScanCursor();
+
+	const void scanNext(RecordId& outRid);
+	size_t scanNextBatch(RecordId* out, size_t max);
+
+  /**
+	 * Fetch the next index entries that match the scan, up to max of them, with their keys and included columns.
+	 * See BTreeIndex::scanNextEntries.
+	**/
+	size_t scanNextEntries(RecordId* outRids, T* outKeys, char* outIncluded, size_t max);
+
+ private:
+
+	/**
+	* Copy the rids of the next entries of the scan, up to max of them, their keys unless outKeys is NULL and their
+	* included columns unless outIncluded is NULL. See scanNextBatch.
+	*/
+	size_t readEntries(RecordId* out, T* outKeys, char* outIncluded, size_t max);
+
+	/**
+	* With the current leaf latched shared, find the next entry of the scan like seekNextEntry. Trusts nextEntry if
+	* no writer had the leaf since the last call, searches the leaf again if a writer may only have added entries
+	* to it, and goes down from the root again if a delete may have moved entries off it or freed it.
+	*
+	*@return True if there is an entry within the high end of the scan
+	*/
+	bool resumeScan();
+
+	/**
+	* With the current leaf latched shared, find the next entry of the scan, moving right through the leaves as
+	* needed, or left in a DESCENDING scan. The leaf the entry is on is left current and latched.
+	*
+	*@param search Find the entry from resumeKey, rather than trusting nextEntry
+	*@return True if there is an entry within the end of the scan
+	*/
+	bool seekNextEntry(bool search);
+
+	/**
+	* Make the leaf left of the current one current, latched shared, and find the resume point on it. Goes down
+	* from the root again if that leaf split or a merge went on while neither leaf was latched.
+	*
+	*@return False if the current leaf is the leftmost one
+	*/
+	bool moveLeft();
+
+	/**
+	* Set nextEntry, and the place in its posting list, to the first rid after the resume point on the current leaf.
+	* nextEntry is the number of keys if that is further right, or -1 in a DESCENDING scan if it is further left.
+	*/
+	void seekResumePoint();
+
+	/**
+	* Copy rids of the posting list of entry nextEntry, from the current place in it, and move on. Once the
+	* list is used up nextEntry moves on to the next entry. The current leaf has to be latched.
+	*
+	*@param out Receives the rids
+	*@param max Room in out
+	*@return Number of rids copied
+	*/
+	size_t readPosting(RecordId* out, size_t max);
+
+	/**
+	* With the current leaf latched, have the read-ahead of the index fetch the leaves right of it that the scan
+	* may need, if read-ahead is on and fewer than that many are fetched already.
+	*/
+	void readAhead();
+
+	/**
+	* Take leaf pageNo from the leaves read ahead, with its pin. If it is not the first of them, the leaves changed
+	* since they were fetched and all of them are dropped.
+	*
+	*@param pageNo The leaf the scan moves on to
+	*@param page The leaf, if it was read ahead
+	*@return False if the caller has to read the leaf itself
+	*/
+	bool takeReadAhead(PageId pageNo, Page* &page);
+
+	/**
+	* Call the read-ahead off, wait for a fetch in flight and unpin the leaves read ahead.
+	*/
+	void stopReadAhead();
+
+	/**
+	* True if key satisfies the high end of the scan
+	*/
+	bool withinHighBound(const T& key) const { return highOp == LT ? key < highVal : key <= highVal; }
+
+	/**
+	* True if key satisfies the low end of the scan
+	*/
+	bool withinLowBound(const T& key) const { return lowOp == GT ? lowVal < key : lowVal <= key; }
+
+	/**
+	* True if key satisfies the end of the scan it moves towards
+	*/
+	bool withinEndBound(const T& key) const { return direction == ASCENDING ? withinHighBound(key) : withinLowBound(key); }
+
+	/**
+	* Index of the first entry of the current leaf past the end of the scan, in the direction of the scan
+	*/
+	int endOfScan() const;
+
+	/**
+	* 1 or -1, the step from one entry to the next in the direction of the scan
+	*/
+	int entryStep() const { return direction == ASCENDING ? 1 : -1; }
+};
+
+/**
+ * @brief B+ Tree index on a single attribute whose key type T (int, double or StringKey) is fixed at
+ * compile time, so the comparisons, null keys and key copies are inlined into the tree algorithms.
+ * Any number of threads may insert at once while the scan runs. Every page has a reader/writer latch and a
+ * descent couples them top-down (crabbing): inserts first descend with shared latches and latch only the
+ * leaf exclusively, and only if that leaf is full descend again holding exclusive latches on the nodes
+ * that may split. In B_LINK mode no thread holds more than a couple of latches at once, see blinkInsert.
+ * Scans run through TypedScanCursor, any number of them at once.
+*/
+template <class T>
+class TypedBTreeIndex : public BTreeIndexBase {
+
+	friend class TypedScanCursor<T>;
+
+ private:
+
+  /**
+   * File object for the index file.
+   */
+	File		*file;
+
+  /**
+   * Buffer Manager Instance.
+   */
+	BufMgr	*bufMgr;
+
+  /**
+   * The whole index file in READ_ONLY_MAPPED mode, NULL otherwise. Page n starts at filePagePosition(n).
+   * In that mode file is NULL and the buffer manager is never called.
+   */
+	char		*mappedFile;
+
+  /**
+   * Length of mappedFile in bytes.
+   */
+	size_t	mappedSize;
+
+  /**
+   * Page number of meta page.
+   */
+	PageId	headerPageNum;
+
+  /**
+   * page number of root page of B+ tree inside index file.
+   */
+	PageId	rootPageNum;
+
+  /**
+  * Page pointer to rootPage. Only page to be kept in buffer from constructor to destructor
+  */
+	Page* rootPage;
+
+  /**
+   * Offset of attribute, over which index is built, inside records. 
+   */
+	int 		attrByteOffset;
+
+  /**
+   * Offset and length of the included columns inside records, see IndexMetaInfo::includedOffset.
+   */
+	int			includedOffset;
+	int			includedLength;
+
+  /**
+   * Latch of every page of the index file.
+   */
+	PageLatchTable latches;
+
+  /**
+   * Latch guarding rootPageNum and rootPage. It is taken before the latch of the root page itself,
+   * exclusively only by an insert that may split the root.
+   */
+	PageLatch rootLatch;
+
+  /**
+   * How threads latch the nodes on the way down.
+   */
+	ConcurrencyMode concurrencyMode;
+
+  /**
+   * True if the non-leaf nodes count the rids under every child, as IndexMetaInfo::counted of the file says.
+   */
+	bool		counted;
+
+  /**
+   * Copy of the statistics page of the file, NULL if it has none.
+   */
+	IndexStatistics<T>* statistics;
+
+  /**
+   * Pages that used to be the root. They stay pinned like the root, since a B_LINK descent may still start from one.
+   */
+	std::vector<PageId> formerRoots;
+
+  /**
+   * Number of non-leaf levels, counting the root, whose nodes stay pinned once read. See BTreeIndex::BTreeIndex.
+   */
+	int residentLevels;
+
+  /**
+   * Buffer pool page of every resident non-leaf, NULL for the other pages. A descent takes the page from here
+   * instead of going through the buffer manager. The pin on each page belongs to the table.
+   */
+	PageTable<std::atomic<Page*> > residentPages;
+
+  /**
+   * Every page number ever made resident, for the destructor to find the pins left. A page freed and made
+   * resident again shows up twice.
+   */
+	std::vector<PageId> residentPageNos;
+
+  /**
+   * Guards residentPageNos.
+   */
+	std::mutex	residentLatch;
+
+  /**
+   * What deletes do with underfull nodes. B_LINK descents may hold a page number without its latch, so in
+   * that mode deletes are always lazy.
+   */
+	DeleteMode	deleteMode;
+
+  /**
+   * In-memory copy of IndexMetaInfo::freePageNo.
+   */
+	PageId	freePageNo;
+
+  /**
+   * Guards the free page list.
+   */
+	std::mutex	freeListLatch;
+
+  /**
+   * Bumped, while the pages involved are still latched, every time a delete moves entries to another leaf or
+   * frees a page. Scans parked on a leaf compare it to tell whether their entries may have left that leaf.
+   */
+	std::atomic<unsigned int>	mergeCount;
+
+  /**
+   * Write-ahead log of the index file in READ_WRITE_LOGGED mode, NULL otherwise.
+   */
+	WriteAheadLog	*log;
+
+  /**
+   * Set for every page logged whole since the log was last emptied. From then on a key inserted into or deleted
+   * from a leaf is logged by itself, since recovery has the leaf to apply it to.
+   */
+	PageTable<std::atomic<bool> > loggedPages;
+
+  /**
+   * Pages changed by the groups in the log, for checkpointLog to write out. A page may be in here more than once.
+   */
+	std::vector<PageId>	unwrittenPageNos;
+
+  /**
+   * Guards unwrittenPageNos.
+   */
+	std::mutex	unwrittenLatch;
+
+  /**
+   * Held shared by every insert and delete on a logged index from startLogAction to finishLogAction, and
+   * exclusively by checkpointLog, so the log is emptied between inserts and deletes.
+   */
+	PageLatch	checkpointLatch;
+
+
+	// MEMBERS SPECIFIC TO SCANNING
+
+  /**
+   * Prefix of the names of the temporary files of heap order scans, and the number of the next one.
+   */
+	std::string	spillFileName;
+	std::atomic<unsigned int>	spillCount;
+
+  /**
+   * Number of leaves every scan keeps fetched ahead of the one it is on, 0 for no read-ahead.
+   */
+	int			readAheadLeaves;
+
+  /**
+   * Fetches the leaves of the cursors on readAheadQueue. Started by the first setReadAhead that turns read-ahead on.
+   */
+	std::thread	readAheadThread;
+
+  /**
+   * Guards the read-ahead queue, the counters and the read-ahead state of every cursor.
+   */
+	std::mutex	readAheadLatch;
+
+  /**
+   * Signalled when a cursor is put on readAheadQueue or the read-ahead thread has to stop.
+   */
+	std::condition_variable	readAheadWork;
+
+  /**
+   * Signalled when the read-ahead thread is done with a cursor.
+   */
+	std::condition_variable	readAheadDone;
+
+  /**
+   * Cursors waiting for the read-ahead thread, in the order they asked.
+   */
+	std::deque<TypedScanCursor<T>*>	readAheadQueue;
+
+  /**
+   * Tells the read-ahead thread to stop.
+   */
+	bool		readAheadStop;
+
+  /**
+   * Counts of the leaves scans moved on to since read-ahead was turned on.
+   */
+	ReadAheadStats	readAheadStats;
+
+  /**
+   * The counters of every thread that called into the index, see getStats.
+   */
+	IndexStatsRegistry	statsRegistry;
+
+  /**
+   * Cursor of the scan run through startScan, scanNext and endScan. NULL if no such scan has been started.
+   */
+	TypedScanCursor<T>	*scan;
+
+ public:
+
+  /**
+   * Open the index file if it exists, otherwise create it and populate it from the base relation.
+   * See BTreeIndex::BTreeIndex.
+   */
+	TypedBTreeIndex(const std::string & relationName, const std::string & indexName,
+						BufMgr *bufMgrIn,	const int attrByteOffset,
+						const BuildMethod buildMethod, const double fillFactor, const ConcurrencyMode concurrencyMode,
+						const DeleteMode deleteMode, const int residentLevels, const OpenMode openMode,
+						const CountMode countMode, const int buildThreads, const int includedOffset, const int includedLength);
+
+  /**
+   * End any initialized scan, unpin the root and the resident non-leaves, flush the index file and remove
+   * its log. See BTreeIndex::~BTreeIndex.
+   */
+	~TypedBTreeIndex();
+
+	const void insertEntry(const void* key, const RecordId rid);
+	const void insertEntry(const void* key, const RecordId rid, const void* includedBytes);
+	const void deleteEntry(const void* key);
+	const void deleteEntry(const void* key, const RecordId rid);
+	ScanCursor* openScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp, const ScanDirection direction);
+	HeapOrderCursor* openHeapOrderScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp, size_t memoryRids);
+	const void startScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp, const ScanDirection direction);
+	const void scanNext(RecordId& outRid);
+	size_t scanNextBatch(RecordId* out, size_t max);
+	size_t scanNextEntries(RecordId* outRids, void* outKeys, void* outIncluded, size_t max);
+	const void endScan();
+	bool lookup(const void* key, RecordId& outRid);
+	size_t lookupBatch(const void* const* keys, size_t numKeys, RecordId* outRids, bool* found);
+	size_t countRange(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+	double estimateRange(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+	void setReadAhead(int numLeaves);
+	ReadAheadStats getReadAheadStats();
+	IndexStats getStats(bool walkLeaves);
+
+  /**
+   * Insert a new entry using the pair <key,rid>. See BTreeIndex::insertEntry.
+   *
+   * @param key The key to insert
+   * @param rid The rid to insert
+   * @param includedBytes The included columns of the record, NULL for none
+   */
+	const void insertEntry(const T& key, const RecordId rid, const char* includedBytes = NULL);
+
+  /**
+   * Delete the entry with the given key, or only the given rid of it. See BTreeIndex::deleteEntry.
+   *
+   * @param key The key to delete
+   * @param rid The rid to delete, NULL for all rids of the key
+   */
+	const void deleteEntry(const T& key, const RecordId* rid);
+
+  /**
+   * Begin a scan of the index on a cursor of its own. See BTreeIndex::openScan.
+   */
+	TypedScanCursor<T>* openScan(const T& lowVal, const Operator lowOp, const T& highVal, const Operator highOp, const ScanDirection direction = ASCENDING);
+
+  /**
+   * Begin a filtered scan of the index. See BTreeIndex::startScan.
+   */
+	const void startScan(const T& lowVal, const Operator lowOp, const T& highVal, const Operator highOp, const ScanDirection direction);
+
+  /**
+   * Find the first rid of key. See BTreeIndex::lookup.
+   */
+	bool lookup(const T& key, RecordId& outRid);
+
+  /**
+   * Count the rids in a range. See BTreeIndex::countRange.
+   */
+	size_t countRange(const T& lowVal, const Operator lowOp, const T& highVal, const Operator highOp);
+
+  /**
+   * Estimate the rids in a range. See BTreeIndex::estimateRange.
+   */
+	double estimateRange(const T& lowVal, const Operator lowOp, const T& highVal, const Operator highOp);
+
+ private:
+
+	/**
+	* Insert key and rid into a leaf that has room for it. Descends with shared latches and latches only the leaf
+	* exclusively.
+	*
+	*@param key The key we are trying to insert into the tree
+	*@param rid The associated record id of the key
+	*@param includedBytes The included columns of the record, NULL for none
+	*@return False, with nothing changed, if the leaf was full
+	*/
+	bool optimisticInsert(const T& key, const RecordId rid, const char* includedBytes);
+
+	/**
+	* Insert key and rid, splitting the leaf and as many of its ancestors as needed. Descends with exclusive
+	* latches and lets go of everything above a node as soon as that node cannot split.
+	*
+	*@param key The key we are trying to insert into the tree
+	*@param rid The associated record id of the key
+	*@param includedBytes The included columns of the record, NULL for none
+	*/
+	const void traverseAndInsert(const T& key, const RecordId rid, const char* includedBytes);
+
+	/**
+	* Put a new root above the old root and the page split from it, and record it in the meta page.
+	* The caller holds rootLatch exclusively and has logged the pages changed by the splits below, which go
+	* into the log together with the new root.
+	*
+	*@param middleKey The key separating the old root and newPageId
+	*@param newPageId The page split from the old root
+	*@param newCount Number of rids under newPageId, for a counted index
+	*/
+	const void growRoot(const T& middleKey, PageId newPageId, unsigned int newCount);
+
+	/**
+	* B_LINK insert. Goes down holding one latch at a time, remembering the nodes it passed, and then back up
+	* inserting the key split off each full node into its parent. A node stays latched only until its parent is.
+	*
+	*@param key The key we are trying to insert into the tree
+	*@param rid The associated record id of the key
+	*@param includedBytes The included columns of the record, NULL for none
+	*/
+	const void blinkInsert(const T& key, const RecordId rid, const char* includedBytes);
+
+	/**
+	* Find the node at the given height above the leaves that key belongs under, by going down from the root.
+	* Used by blinkInsert when the node that split was not below any node it passed on the way down,
+	* because the tree grew since. The node is returned latched exclusively.
+	*
+	*@param key The key that has to go into the node
+	*@param height Height of the node, 1 for the nodes just above the leaves
+	*@param pageNo Page number of the node
+	*@param page The node
+	*@param latch Latch of the node
+	*@param pinned True if the node has to be unpinned once left, false if it is the root or resident
+	*/
+	const void findNodeAtHeight(const T& key, int height, PageId &pageNo, Page* &page, PageLatch* &latch, bool &pinned);
+
+	/**
+	* If key is not below the high key of the latched node, follow right links until it is, coupling the latches
+	* left to right. Node is NonLeafNode<T> or LeafNode<T>.
+	*
+	*@param key The key being looked for
+	*@param exclusive The latch is held exclusively
+	*@param pageNo Page number of the node, updated
+	*@param page The node, updated
+	*@param latch Latch of the node, updated
+	*@param pinned True if the node has to be unpinned once left, false for the root and resident nodes the index keeps pinned, updated
+	*/
+	template <class Node>
+	const void moveRight(const T& key, bool exclusive, PageId &pageNo, Page* &page, PageLatch* &latch, bool &pinned);
+
+	/**
+	* Delete key from its leaf, descending like optimisticInsert.
+	*
+	*@param key The key to delete
+	*@param rid The rid to delete, NULL for all rids of the key
+	*@param allowUnderflow Delete even if that leaves the leaf less than half full
+	*@return False, with nothing deleted, if the leaf would underflow and that is not allowed
+	*@throws NoSuchKeyFoundException If the key, or the rid of it, is not in the tree
+	*/
+	bool optimisticDelete(const T& key, const RecordId* rid, bool allowUnderflow);
+
+	/**
+	* Delete key holding exclusive latches on every node that may underflow, like traverseAndInsert does for
+	* splits. Underfull nodes are rebalanced from the leaf up and the root collapses onto its only child once
+	* it has no keys left. A counted index comes down here for every delete, to take the rids off the counts up
+	* the path.
+	*
+	*@param key The key to delete
+	*@param rid The rid to delete, NULL for all rids of the key
+	*@param allowUnderflow Leave underfull nodes as they are, for lazy deletes
+	*@throws NoSuchKeyFoundException If the key, or the rid of it, is not in the tree
+	*/
+	const void traverseAndDelete(const T& key, const RecordId* rid, bool allowUnderflow);
+
+	/**
+	* Bring child, which fell below half full, back up by moving entries over from a sibling or merging the two.
+	* The sibling on the left is used unless child is the first one of parent. The right node of a merge is freed.
+	*
+	*@param parent The parent, latched exclusively
+	*@param slot Position of child in the page numbers of parent
+	*@param child The node, latched exclusively
+	*@param childIsLeaf True if child is a leaf
+	*@return True if the nodes were merged, which takes a key out of parent
+	*/
+	bool rebalance(LatchedPage &parent, int slot, LatchedPage &child, bool childIsLeaf);
+
+	/**
+	* Merge two neighbouring leaves, or even out their entries if they do not fit on one. Entries are left where
+	* they are if the parent has no room for the separator evening them out would need.
+	*
+	*@param parentPage The parent of both leaves
+	*@param leftSlot Position of the left leaf in the page numbers of parent
+	*@param leftPage The left leaf
+	*@param rightPage The right leaf
+	*@return True if the right leaf was merged into the left one
+	*/
+	bool rebalanceLeaves(Page* parentPage, int leftSlot, Page* leftPage, Page* rightPage);
+
+	/**
+	* Merge two neighbouring non-leaf nodes with the separator between them, or even out their keys if they do not
+	* fit in one and the parent has room for the new separator.
+	*
+	*@param parentPage The parent of both nodes
+	*@param leftSlot Position of the left node in the page numbers of parent
+	*@param leftPage The left node
+	*@param rightPage The right node
+	*@return True if the right node was merged into the left one
+	*/
+	bool rebalanceNonLeaves(Page* parentPage, int leftSlot, Page* leftPage, Page* rightPage);
+
+	/**
+	* Take the entry with the given key off a leaf, or only one rid of it if the key has others left. Every page
+	* changed is logged.
+	*
+	*@param pageNo Page number of the leaf
+	*@param page The leaf
+	*@param key The key to delete
+	*@param rid The rid to delete, NULL for all rids of the key
+	*@param entryRemoved Set if the entry of the key was taken off the leaf
+	*@return False if the key, or the rid of it, is not on the leaf
+	*/
+	bool removeFromLeafPage(PageId pageNo, Page* page, const T& key, const RecordId* rid, bool &entryRemoved);
+
+	/**
+	* Add rid to the rids of a key already on a leaf, starting its posting list if it had just the one rid.
+	* The leaf has to be latched exclusively.
+	*
+	*@param entryRid The rid of the entry of the key on the leaf, updated
+	*@param rid The rid to add
+	*@throws DuplicateKeyException If the key already has this rid
+	*/
+	const void addToPosting(RecordId &entryRid, const RecordId rid);
+
+	/**
+	* Take rid out of the posting list of a key. A list left with one rid is freed and the rid goes back onto
+	* the leaf entry. The leaf has to be latched exclusively.
+	*
+	*@param entryRid The rid of the entry of the key on the leaf, updated
+	*@param rid The rid to delete
+	*@return False if the key does not have this rid
+	*/
+	bool removeFromPosting(RecordId &entryRid, const RecordId rid);
+
+	/**
+	* Free every page of a posting list
+	*/
+	const void freePosting(PageId firstPageNo);
+
+	/**
+	* Number of rids in a posting list
+	*/
+	unsigned int postingLength(PageId firstPageNo);
+
+	/**
+	* Number of rids under a node: on a leaf, posting lists included, and for a non-leaf the sum of its counts.
+	*/
+	unsigned int nodeCount(Page* page, bool isLeaf);
+
+	/**
+	* Append the rids of a posting list to rids
+	*/
+	const void getPostingRids(PageId firstPageNo, std::vector<RecordId> &rids);
+
+	/**
+	* Every rid on a leaf, posting lists included, in ridLess order
+	*/
+	const void getLeafRids(Page* page, std::vector<RecordId> &rids);
+
+	/**
+	* Bytes a row of an IncludedPage takes, the rid and the included columns
+	*/
+	int includedRowSize() const { return sizeof( RecordId ) + includedLength; }
+
+	/**
+	* Set the included columns of rid in the rows of a leaf, starting its list of rows if it has none. The leaf
+	* has to be latched exclusively.
+	*
+	*@param firstPageNo The first page of the rows of the leaf, updated
+	*@param rid The rid of the row
+	*@param bytes The includedLength bytes of its record
+	*/
+	const void putIncludedRow(PageId &firstPageNo, const RecordId rid, const char* bytes);
+
+	/**
+	* Take the row of rid, if there is one, out of the rows of a leaf. A page left empty is freed. The leaf has to
+	* be latched exclusively.
+	*
+	*@param firstPageNo The first page of the rows of the leaf, updated
+	*@param rid The rid of the row
+	*/
+	const void removeIncludedRow(PageId &firstPageNo, const RecordId rid);
+
+	/**
+	* Take the rows of rids, which are in ridLess order, out of the rows of a leaf. The leaf has to be latched
+	* exclusively.
+	*/
+	const void removeIncludedRows(PageId &firstPageNo, const std::vector<RecordId> &rids);
+
+	/**
+	* Append every row of a list of rows to rows
+	*/
+	const void readIncludedRows(PageId firstPageNo, std::vector<char> &rows);
+
+	/**
+	* Replace the rows of a list by numRows rows in ridLess order, reusing its pages and freeing those left over.
+	* No rows free the whole list. Every page written is logged.
+	*/
+	const void writeIncludedRows(PageId &firstPageNo, const char* rows, int numRows);
+
+	/**
+	* Give the rows of two neighbouring leaves, whose entries were just split or shared out between them, to the
+	* leaf that holds their rid now. Both leaves have to be latched exclusively.
+	*
+	*@param leftPage The left leaf
+	*@param rightPage The right leaf
+	*@param merged True if the right leaf gave all of its entries to the left one
+	*/
+	const void moveIncludedRows(Page* leftPage, Page* rightPage, bool merged);
+
+	/**
+	* Copy the included columns of count rids on a leaf to out, includedLength bytes each in the order of rids.
+	* The rows are read in one pass along their list, and a rid without one gets zeros. The leaf has to be latched.
+	*
+	*@param firstPageNo The first page of the rows of the leaf
+	*@param rids The rids
+	*@param count Number of rids
+	*@param out Receives the included columns
+	*/
+	const void getIncludedRows(PageId firstPageNo, const RecordId* rids, size_t count, char* out);
+
+	/**
+	* Find key on a leaf the caller holds latched.
+	*
+	*@param leafPage The leaf
+	*@param key The key to find
+	*@param outRid Set to the first rid of key in ridLess order, if it is there
+	*@return False if key is not on the leaf
+	*/
+	bool findOnLeaf(Page* leafPage, const T& key, RecordId& outRid);
+
+	/**
+	* Let go of the nodes lookupBatch keeps below the first keep of its path, from the bottom up.
+	*
+	*@param path The path, from the root down
+	*@param keep Number of nodes to keep
+	*@param atLeaf True if the path ends at a leaf, which is then the only node latched in B_LINK mode. Cleared once it goes
+	*/
+	const void releaseLookupPath(std::vector<LatchedPage> &path, size_t keep, bool &atLeaf);
+
+	/**
+	* Count the rids under a node of a counted index that are within the bounds given. A node entirely within them
+	* is taken from the count in its parent, so only the nodes a bound falls into are read.
+	*
+	*@param page The node, kept from changing by the caller
+	*@param isLeaf True if page is a leaf
+	*@param depth Depth of page, the root being at 1
+	*@param lowVal Low bound, NULL if every key under the node is above it
+	*@param lowOp GT or GTE
+	*@param highVal High bound, NULL if every key under the node is below it
+	*@param highOp LT or LTE
+	*/
+	size_t countSubtree(Page* page, bool isLeaf, int depth, const T* lowVal, const Operator lowOp, const T* highVal, const Operator highOp);
+
+	/**
+	* Fill in the shape of the tree, going down its left edge, and if asked along the leaves from the leftmost one.
+	* Each node is latched shared while it is read.
+	*
+	*@param stats Gets treeHeight, and numLeaves and leafFill if walkLeaves is set
+	*@param walkLeaves Whether to read every leaf
+	*/
+	void treeShape(IndexStats &stats, bool walkLeaves);
+
+	/**
+	* Take key slot and the page number right of it out of a non-leaf
+	*/
+	const void removeFromNonLeafPage(Page* page, int slot);
+
+	/**
+	* Body of the read-ahead thread. Takes the cursors off readAheadQueue one by one until told to stop.
+	*/
+	void readAheadLoop();
+
+	/**
+	* Fetch leaves for cursor, following right links from readAheadNext, until it has readAheadLeaves of them or
+	* the leaves pass the high end of its scan. The latch is let go of while a leaf is read. Every readAheadLeaves
+	* leaves, the reads of the next ones are started on reader, so they come off the disk together rather than one
+	* right link at a time.
+	*
+	*@param cursor The cursor to fetch for
+	*@param lock Holds readAheadLatch
+	*@param reader Reads the index file in the background, NULL if it could not be opened
+	*/
+	void fetchAhead(TypedScanCursor<T>* cursor, std::unique_lock<std::mutex> &lock, AsyncPageReader* reader);
+
+	/**
+	* Start reading the leaves right of the one key is on, as many as there are up to count, under the same
+	* parent. Goes down from the root the way traverse does, but stops at level 1.
+	*
+	*@param key A key on the leaf
+	*@param count Maximum number of leaves to read
+	*@param reader Reads the index file in the background
+	*@return Number of leaves whose reads were started
+	*/
+	int prefetchLeaves(const T& key, int count, AsyncPageReader* reader);
+
+	/**
+	* Allocate a page for a new node, reusing a freed one if there is any. The page is returned pinned.
+	*/
+	const void allocNode(PageId &pageNo, Page* &page);
+
+	/**
+	* Put a pinned page no longer part of the tree on the free list. If the page was resident it stops being so and
+	* its resident pin is dropped, any pin of the caller the caller still unpins. With a log the page only goes on
+	* the list at the end of the insert or delete, see LogAction::freedPageNos.
+	*/
+	const void freeNode(PageId pageNo, Page* page);
+
+	/**
+	* Put a pinned page on the free list and in the meta page, and log that.
+	*/
+	const void pushFreePage(PageId pageNo, Page* page);
+
+	/**
+	* Read a node below the root. A resident node comes straight from residentPages, any other through the buffer
+	* manager, pinned. The caller holds the latch of the parent, or in B_LINK mode knows the node is never freed.
+	*
+	*@param pageNo Page number of the node
+	*@param keepResident Make the node resident if it is not yet, only for non-leaves at the top residentLevels levels
+	*@param page The node
+	*@param pinned True if the caller has to unpin the node once done with it
+	*/
+	const void readNode(PageId pageNo, bool keepResident, Page* &page, bool &pinned);
+
+	/**
+	* Read a page of the index file, pinned through the buffer manager, or straight out of the mapping in
+	* READ_ONLY_MAPPED mode.
+	*
+	*@param pageNo Page number of the page
+	*@param page The page
+	*@throws InvalidPageException If a mapped file has no such page
+	*/
+	const void readPage(PageId pageNo, Page* &page);
+
+	/**
+	* Unpin a page read by readPage. Nothing to do for a mapped file.
+	*
+	*@param pageNo Page number of the page
+	*@param dirty True if the page was changed
+	*/
+	const void unPinPage(PageId pageNo, bool dirty);
+
+	/**
+	* Throw BadIndexInfoException unless the meta page of an existing index file matches what it is opened with.
+	*
+	*@param metadata The meta page
+	*@param relationName Name of the base relation
+	*/
+	const void checkMetaInfo(const IndexMetaInfo* metadata, const std::string & relationName);
+
+	/**
+	* Set counted, and make the index latch couple if it is set.
+	*
+	*@param counted IndexMetaInfo::counted of the file
+	*/
+	const void setCounted(const bool counted);
+
+	/**
+	* Map the existing index file indexName into memory read-only, check its meta page and find the root.
+	*
+	*@param relationName Name of the base relation
+	*@param indexName Name of the index file
+	*@throws FileNotFoundException If the file does not exist
+	*@throws BadIndexInfoException If the meta page does not match
+	*/
+	const void openMapped(const std::string & relationName, const std::string & indexName);
+
+	/**
+	* Put statistics on a new page and record it in the meta page. Only while the file is built, before the log is opened.
+	*/
+	const void writeStatistics();
+
+	/**
+	* Read the statistics page of the file into statistics, if it has one.
+	*
+	*@param pageNo IndexMetaInfo::statisticsPageNo of the file
+	*/
+	const void readStatistics(PageId pageNo);
+
+	/**
+	* Replay the log an existing index file was left with by a crash, write the file out and remove the log.
+	* In READ_WRITE_LOGGED mode the log is then opened for the inserts and deletes, after writing out a file just
+	* built. Called with nothing of the file pinned, but the root and resident nodes of a file just built.
+	*
+	*@param indexName Name of the index file
+	*@param openMode How the index is opened
+	*@param built True if the file was just created and built, any log of the same name is then left over from an earlier file
+	*/
+	const void openLog(const std::string & indexName, const OpenMode openMode, const bool built);
+
+	/**
+	* Apply every complete group of the log to the pages and the meta page.
+	*/
+	const void redoLog(WriteAheadLog &walLog);
+
+	/**
+	* Read a page for redoLog, allocating it if the file does not reach it yet.
+	*/
+	const void readLoggedPage(PageId pageNo, Page* &page);
+
+	/**
+	* Unpin the root, the former roots and the resident nodes and write the whole index file out. Only while no other
+	* thread is in the index.
+	*/
+	const void flushIndex();
+
+	/**
+	* Write every page the log changed to the index file without going through the buffer manager, which would
+	* have to evict pages scans still hold pinned, and empty the log. Nothing to do unless the log has grown past
+	* CHECKPOINTLOGSIZE. Called by an insert or delete once it is finished.
+	*/
+	const void checkpointLog();
+
+	/**
+	* Make action the LogAction of the calling thread and hold checkpointLatch shared, if the index has a log.
+	*/
+	const void startLogAction(LogAction &action);
+
+	/**
+	* Put the pages action freed on the free list, wait until its records are durable and unpin its dirty pages.
+	* Then release checkpointLatch and write the pages out if the log has grown too long.
+	*/
+	const void finishLogAction(LogAction &action);
+
+	/**
+	* Log a page whole at the next appendAction, as it is by then. Nothing to do without a LogAction.
+	*
+	*@param pageNo Page number of the page
+	*@param page The page, changed under a latch the thread holds
+	*/
+	const void logPage(PageId pageNo, Page* page);
+
+	/**
+	* Log key inserted into or deleted from a leaf. Only the key and rid are logged if the log has the leaf whole
+	* already, otherwise the leaf is logged whole.
+	*
+	*@param type LOGLEAFINSERT or LOGLEAFDELETE
+	*@param pageNo Page number of the leaf
+	*@param page The leaf
+	*@param key The key
+	*@param rid The rid inserted
+	*/
+	const void logLeafChange(LogRecordType type, PageId pageNo, Page* page, const T& key, const RecordId rid);
+
+	/**
+	* Log every page of path whole.
+	*/
+	const void logPath(std::vector<LatchedPage> &path);
+
+	/**
+	* Log the new root, with the next appendAction.
+	*/
+	const void logRootPage(PageId pageNo);
+
+	/**
+	* Append the records and pages logged since the last call as one group, before the latches are let go of.
+	*/
+	const void appendAction();
+
+	/**
+	* Append a change to the free list as a group of its own. The caller holds freeListLatch, so the changes
+	* end up in the log in the order they were made.
+	*
+	*@param pageNo The new head of the list
+	*@param nextPageNo Its next page if it was just freed, NULL if it was taken off the list
+	*/
+	const void appendFreeList(PageId pageNo, const PageId* nextPageNo);
+
+	/**
+	* Add the pages of the records of a group just appended to unwrittenPageNos.
+	*/
+	const void addUnwrittenPages(const std::vector<char> &group);
+
+	/**
+	* Unlatch and unpin the pages of path and empty it. Changed pages are logged first.
+	*
+	*@param path Pages latched exclusively, from the top down
+	*@param dirty True if the pages may have been changed
+	*/
+	const void releasePath(std::vector<LatchedPage> &path, bool dirty);
+
+	/**
+	* Insert key and rid onto a leaf page, splitting it if it is full. If it was split, restructured will be true,
+	* newPageId will have the PageId of the new leaf holding the greater half of the entries and middleKey the key
+	* separating the two leaves, which need to be added to the parent. The included columns go onto the leaf that
+	* ends up with the entry. Every page changed is logged.
+	*
+	*@param pageNo Page number of the leaf
+	*@param page The leaf page we want to insert on
+	*@param key The key to insert
+	*@param rid The associated record id of the key
+	*@param includedBytes The included columns of the record, NULL for none
+	*@param restructured True if page was split
+	*@param newPageId The id of the new leaf created by the split
+	*@param middleKey The separator between the two leaves, the low key of the new one
+	*/
+	const void insertIntoLeafPage(PageId pageNo, Page* page, const T& key, const RecordId rid, const char* includedBytes, bool &restructured, PageId &newPageId, T &middleKey);
+
+	/**
+	*	Find the index into page where key would go, or is if it is already there. Assumes a leaf page
+	*
+	*@param page The page you want to insert the key on
+	*@param key The key you wish to insert
+	*/
+	int findIndexIntoKeyArray(Page* page, const T& key);
+
+	/**
+	*When traversing down the tree we need to find the PageId of the child to traverse into given a 
+	* specific key value to look for. Assumes a non-leaf page
+	*
+	*@param page The page on which we are trying to find the child PageId
+	*@param key The key we are trying to find
+	*/
+	int findIndexIntoPageNoArray(Page* page, const T& key);
+
+	/**
+	*Insert onto page, the key and its associated pageId. Assumes the page has room for it
+	*
+	*@param page The page on which we want to insert this value
+	*@param key The key you want to insert
+	*@param pageId The new pageId 
+	*@param count Number of rids under pageId, for a counted index
+	*/
+	const void insertIntoNonLeafPage(Page* page, const T& key, PageId pageId, unsigned int count);
+
+	/**
+	*Split a full leaf while inserting key and rid at index. The greater half of the entries, by the space they
+	* take, move to a new leaf, and the included columns of their rids with them
+	*
+	*@param fullPageNo Page number of fullPage
+	*@param fullPage The page we want to split
+	*@param index Where key belongs on fullPage
+	*@param key The key being inserted
+	*@param rid The associated record id of the key
+	*@param includedBytes The included columns of the record, NULL for none
+	*@param newPageId the PageId of the new leaf created by this function
+	*@param middleKey The shortest key separating the two leaves, to be copied up into the parent
+	*/
+	const void restructureLeaf(PageId fullPageNo, Page* fullPage, int index, const T& key, const RecordId rid, const char* includedBytes, PageId &newPageId, T &middleKey);
+
+	/**
+	* Point the left link of a leaf at a new left neighbour, latching the leaf exclusively meanwhile. The caller
+	* holds the neighbour, so the latch is taken left to right like everywhere else.
+	*
+	*@param pageNo Page number of the leaf, nothing is done if it is NULL
+	*@param leftPageNo Page number of the leaf now on its left
+	*/
+	const void setLeftSibling(PageId pageNo, PageId leftPageNo);
+
+	/**
+	*Split a full non-leaf while inserting key and the page to its right. The greater half of the entries
+	* move to a new page and the middle key is pushed up
+	*
+	*@param fullPage The page we want to split
+	*@param key The key being inserted
+	*@param newPageIdFromChild The PageId from the child we are going to insert as a result of a previous split
+	*@param countFromChild Number of rids under newPageIdFromChild, for a counted index
+	*@param newPageId the PageId of the new page created by this function
+	*@param middleKey The key moved up into the parent
+	*/
+	const void restructureNonLeaf(Page* fullPage, const T& key, PageId newPageIdFromChild, unsigned int countFromChild, PageId &newPageId, T &middleKey);
+
+	/**
+	*Traverse down from the root to the leaf key belongs on, with shared latches coupled on the way or, in B_LINK
+	* mode, held one at a time. The leaf is returned pinned and latched, shared unless exclusiveLeaf is set.
+	*
+	*@param key The key we are searching for
+	*@param exclusiveLeaf Latch the leaf exclusively
+	*@param stack If not NULL, the page number of every non-leaf passed is pushed on it, the root first
+	*@param leafId PageId of the leaf on which key lies
+	*@param leafPage The leaf
+	*@param leafLatch Latch of the leaf
+	*/
+	const void traverse(const T& key, bool exclusiveLeaf, std::vector<PageId>* stack, PageId &leafId, Page* &leafPage, PageLatch* &leafLatch);
+
+	/**
+	* Build the tree bottom-up from every tuple of the relation. The relation pages are shared out among numThreads
+	* threads, which each sort the key-rid pairs of theirs in memory, or in sorted runs spilled to a temporary file
+	* when there are more than their share of BULKLOADRUNPAGES pages of them. The sorted pairs of the threads are
+	* then merged, in memory or from the runs. The rows of included columns of an index that has them go through
+	* the sort along with their pairs. Leaves are filled left to right, followed by each non-leaf level, and the
+	* root is left pinned.
+	*
+	*@param relationName Name of the base relation
+	*@param indexName Name of the index file, used to name the temporary sort file
+	*@param fillFactor Fraction of every node to fill
+	*@param numThreads Number of threads scanning the relation
+	*/
+	void bulkLoad(const std::string & relationName, const std::string & indexName, const double fillFactor, const int numThreads);
+
+	/**
+	* One thread of the scan of a bulk load. Takes BUILDSCANPAGES relation pages at a time until there are none left,
+	* adding the key-rid pair of every record to its buffer, with its row of included columns if the index has them,
+	* and its key to its statistics. A full buffer is sorted and written out as a run, what is left at the end is
+	* sorted in place.
+	*
+	*@param state What the threads of the scan share
+	*@param threadNum Which of the buffers and statistics of state are this thread's
+	*/
+	void parallelScanThread(ParallelScanState<T>* state, int threadNum);
+
+	/**
+	* Append sorted entries to the sort file as a new run, and their rows of included columns to a list of rows
+	* alongside it
+	*
+	*@param sortFile The temporary sort file
+	*@param entries The sorted pairs to write out. Cleared on return
+	*@param rows The row of every pair, empty if the index has no included columns. Cleared on return
+	*@param runFirstPage Page number of the first page of every run, the new run is appended
+	*@param runFirstRowPage Page number of the first page of the rows of every run, appended to if there are rows
+	*/
+	void writeSortRun(File* sortFile, std::vector<RIDKeyPair<T> > &entries, std::vector<char> &rows, std::vector<PageId> &runFirstPage, std::vector<PageId> &runFirstRowPage);
+
+	/**
+	* Merge the runs [firstRun, lastRun) of the sort file, handing every pair in sorted order to sink.add(), with
+	* its row of included columns or NULL
+	*
+	*@param sortFile The temporary sort file
+	*@param runFirstPage Page number of the first page of every run
+	*@param runFirstRowPage Page number of the first page of the rows of every run, empty if there are none
+	*@param firstRun First run to merge
+	*@param lastRun One past the last run to merge
+	*@param sink Receives the merged pairs
+	*@param reader Reads the sort file ahead of the merge, NULL to leave every read to the buffer manager
+	*/
+	template <class Sink>
+	void mergeSortRuns(File* sortFile, const std::vector<PageId> &runFirstPage, const std::vector<PageId> &runFirstRowPage, int firstRun, int lastRun, Sink &sink, AsyncPageReader* reader);
+};
+
+/**
+ * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
+ * relation. startScan, scanNext and endScan run one scan at a time, openScan any number of them.
+ * The tree itself is a TypedBTreeIndex for the key type picked once in the constructor,
+ * this class only forwards the const void* API to it.
+*/
+class BTreeIndex {
+
+ private:
+
+  /**
+   * The index for the key type of the attribute.
+   */
+	BTreeIndexBase	*index;
+
+  /**
+   * Datatype of attribute over which index is built.
+   */
+	Datatype	attributeType;
+
+ public:
 
   /**
    * BTreeIndex Constructor. 
 	 * Check to see if the corresponding index file exists. If so, open the file.
 	 * If not, create it and insert entries for every tuple in the base relation using FileScan class.
+	 * With BULK_LOAD the entries are sorted first (externally if they do not fit in memory) and the tree is
+	 * packed bottom-up, leaves first on consecutive page numbers.
    *
    * @param relationName        Name of file.
    * @param outIndexName        Return the name of index file.
    * @param bufMgrIn						Buffer Manager Instance
    * @param attrByteOffset			Offset of attribute, over which index is to be built, in the record
    * @param attrType						Datatype of attribute over which index is built
-   * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute, but values in metapage(relationName, attribute byte offset, attribute type etc.) do not match with values received through constructor parameters.
+   * @param buildMethod					How to populate a newly created index file. Either way the build also keeps the statistics of the keys for estimateRange
+   * @param fillFactor					Fraction (0, 1] of every leaf and non-leaf filled by a bulk load
+   * @param concurrencyMode			How concurrent inserts and scans latch the nodes on the way down
+   * @param deleteMode					What deletes do with nodes they leave less than half full
+   * @param residentLevels			Number of non-leaf levels, counting the root, kept pinned once read so that descents skip the buffer manager above them. 1 keeps only the root pinned, ALLLEVELSRESIDENT every non-leaf. Each resident node holds a frame of the buffer pool until it is freed or the index is closed.
+   * @param openMode						READ_ONLY_MAPPED maps an existing index file into memory and reads the nodes straight from it, without copying them into the buffer pool or pinning them. Scans then hand out rids from the mapped leaves. Inserts and deletes throw, and the file must not be changed while it is open. READ_WRITE_LOGGED appends every change of an insert or delete to the write-ahead log of the index file, named after it with LOGFILESUFFIX, and returns once that is durable, committing the changes of concurrent inserts and deletes together. The index file itself is written when the buffer manager evicts pages, when the log grows past CHECKPOINTLOGSIZE, which empties it, and when the index is closed. An index file left with a log by a crash is replayed from it when opened READ_WRITE or READ_WRITE_LOGGED.
+   * @param countMode					SUBTREE_COUNTS has the non-leaf nodes of a new index file count the rids under each child, for countRange. Every insert and delete then latches its whole path down from the root exclusively to keep the counts exact, so writers of such an index run one at a time, and concurrencyMode is LATCH_COUPLING whatever is passed. An existing file keeps the mode it was created with.
+   * @param buildThreads				Number of threads a bulk load scans and sorts the relation with, HARDWARETHREADS for one per hardware thread. Each thread keeps up to BUILDSCANPAGES relation pages pinned at a time. An INSERT_BUILD and an existing file ignore it.
+   * @param includedOffset			Offset inside the record of the included columns
+   * @param includedLength			Number of bytes of every record, from includedOffset, that the build copies into a new index for scanNextEntries, kept with the leaf entries in key order, see IncludedPage. 0 for none, at most INCLUDEDPAGESIZE / 2 - sizeof(RecordId). An existing file has to be opened with the values it was created with.
+   * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute, but values in metapage(relationName, attribute byte offset, attribute type etc.) do not match with values received through constructor parameters, or in READ_ONLY_MAPPED mode if it has a log to replay, or if includedLength is out of range.
+   * @throws  FileNotFoundException     If the index file does not exist in READ_ONLY_MAPPED mode.
    */
 	BTreeIndex(const std::string & relationName, std::string & outIndexName,
-						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType);
+						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType,
+						const BuildMethod buildMethod = INSERT_BUILD, const double fillFactor = 1.0,
+						const ConcurrencyMode concurrencyMode = LATCH_COUPLING,
+						const DeleteMode deleteMode = MERGE_ON_UNDERFLOW, const int residentLevels = 1,
+						const OpenMode openMode = READ_WRITE, const CountMode countMode = UNCOUNTED,
+						const int buildThreads = 1, const int includedOffset = 0, const int includedLength = 0);
 	
 
   /**
    * BTreeIndex Destructor. 
 	 * End any initialized scan, flush index file, after unpinning any pinned pages, from the buffer manager
-	 * and delete file instance thereby closing the index file.
+	 * and delete file instance thereby closing the index file. The log of a READ_WRITE_LOGGED index is removed once
+	 * the file is synced.
 	 * Destructor should not throw any exceptions. All exceptions should be caught in here itself. 
 	 * */
 	~BTreeIndex();
@@ -453,12 +2707,85 @@ class BTreeIndex {
 	 * This splitting will require addition of new leaf page number entry into the parent non-leaf, which may in-turn get split.
 	 * This may continue all the way upto the root causing the root to get split. If root gets split, metapage needs to be changed accordingly.
 	 * Make sure to unpin pages as soon as you can.
+	 * A key that is already in the index keeps all its rids, in a posting list once it has more than one.
    * @param key			Key to insert, pointer to integer/double/char string
    * @param rid			Record ID of a record whose entry is getting inserted into the index.
+	 * @throws  DuplicateKeyException If the index already has this rid for the key.
+	 * @throws  ReadOnlyIndexException If the index was opened READ_ONLY_MAPPED.
 	**/
 	const void insertEntry(const void* key, const RecordId rid);
 
 
+  /**
+	 * Insert a new entry like insertEntry, and set the included columns of its record. An entry inserted without
+	 * them gets zeros.
+   * @param key			Key to insert, pointer to integer/double/char string
+   * @param rid			Record ID of a record whose entry is getting inserted into the index.
+   * @param includedBytes	The includedLength bytes of the record at includedOffset
+	 * @throws  BadIndexInfoException If the index has no included columns.
+	 * @throws  DuplicateKeyException If the index already has this rid for the key.
+	 * @throws  ReadOnlyIndexException If the index was opened READ_ONLY_MAPPED.
+	**/
+	const void insertEntry(const void* key, const RecordId rid, const void* includedBytes);
+
+
+  /**
+	 * Delete the entry with the given key, with all of its rids.
+	 * Find the leaf the key is on and take the entry off it. With MERGE_ON_UNDERFLOW a leaf left less than half full
+	 * borrows entries from a sibling or is merged with it, which takes a key out of the parent, which may in turn
+	 * underflow, up to the root. A root left with a single child is replaced by that child. Freed pages are reused
+	 * by later splits.
+   * @param key			Key to delete, pointer to integer/double/char string
+	 * @throws  NoSuchKeyFoundException If the key is not in the index.
+	 * @throws  ReadOnlyIndexException If the index was opened READ_ONLY_MAPPED.
+	**/
+	const void deleteEntry(const void* key);
+
+
+  /**
+	 * Delete one rid of a key, as deleteEntry(key) does once the key has no other rid left.
+   * @param key			Key of the entry, pointer to integer/double/char string
+   * @param rid			Record ID to delete
+	 * @throws  NoSuchKeyFoundException If the key does not have this rid in the index.
+	 * @throws  ReadOnlyIndexException If the index was opened READ_ONLY_MAPPED.
+	**/
+	const void deleteEntry(const void* key, const RecordId rid);
+
+
+  /**
+	 * Begin a filtered scan of the index on a cursor of its own, independent of startScan and of any other
+	 * cursor. The caller owns the cursor and ends the scan by deleting it, before the index is destroyed.
+   * @param lowVal	Low value of range, pointer to integer / double / char string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char string
+   * @param highOp	High operator (LT/LTE)
+   * @param direction	DESCENDING to return the keys from highVal down, see startScan
+   * @return The cursor, positioned before the first matching entry
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
+   * @throws  BadScanrangeException If lowVal > highval
+	 * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+	**/
+	ScanCursor* openScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp, const ScanDirection direction = ASCENDING);
+
+
+  /**
+	 * Begin a scan of the index whose rids come sorted by page number and slot number, so every page of the relation
+	 * they are on is read once and in file order, like a bitmap heap scan. The whole range is scanned before this
+	 * returns and no leaf stays pinned; rids beyond memoryRids are sorted in runs on a temporary file next to the index.
+	 * The caller owns the cursor and ends the scan by deleting it, before the index is destroyed.
+   * @param lowVal	Low value of range, pointer to integer / double / char string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char string
+   * @param highOp	High operator (LT/LTE)
+   * @param memoryRids	Number of rids sorted in memory at a time
+   * @return The cursor, positioned before the first rid
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+   * @throws  BadScanrangeException If lowVal > highval
+	 * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+	**/
+	HeapOrderCursor* openHeapOrderScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp, size_t memoryRids = HEAPORDERSCANRIDS);
+
+
   /**
 	 * Begin a filtered scan of the index.  For instance, if the method is called 
 	 * using ("a",GT,"d",LTE) then we should seek all entries with a value 
@@ -466,19 +2793,23 @@ class BTreeIndex {
 	 * If another scan is already executing, that needs to be ended here.
 	 * Set up all the variables for scan. Start from root to find out the leaf page that contains the first RecordID
 	 * that satisfies the scan parameters. Keep that page pinned in the buffer pool.
+	 * A DESCENDING scan starts at the leaf of highVal instead and moves left through the leaves, returning the keys
+	 * from the greatest down. The rids of one key still come in ridLess order. The scan lets go of a leaf before it
+	 * latches the one on its left, so it never waits on writers, which latch leaves left to right.
    * @param lowVal	Low value of range, pointer to integer / double / char string
    * @param lowOp		Low operator (GT/GTE)
    * @param highVal	High value of range, pointer to integer / double / char string
    * @param highOp	High operator (LT/LTE)
+   * @param direction	ASCENDING or DESCENDING order of the keys
    * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
    * @throws  BadScanrangeException If lowVal > highval
 	 * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
 	**/
-	const void startScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+	const void startScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp, const ScanDirection direction = ASCENDING);
 
 
   /**
-	 * Fetch the record id of the next index entry that matches the scan.
+	 * Fetch the record id of the next index entry that matches the scan. The rids of a key come in ridLess order.
 	 * Return the next record from current page being scanned. If current page has been scanned to its entirety, move on to the right sibling of current page, if any exists, to start scanning that page. Make sure to unpin any pages that are no longer required.
    * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
 	 * @throws ScanNotInitializedException If no scan has been initialized.
@@ -487,83 +2818,129 @@ class BTreeIndex {
 	const void scanNext(RecordId& outRid);  // returned record id
 
 
+  /**
+	 * Fetch the record ids of the next index entries that match the scan, up to max of them.
+	 * The rids of a leaf are copied in one go, the high end of the scan is only checked against the last key of
+	 * each leaf unless the scan ends on it, the low end of a DESCENDING scan against the first key. The end of the scan is reported by the return value, not by an exception.
+   * @param out	Receives the record ids
+   * @param max	Room in out
+   * @return Number of record ids stored in out, fewer than max only near the end of the scan and 0 once it is completed
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	**/
+	size_t scanNextBatch(RecordId* out, size_t max);
+
+
+  /**
+	 * Fetch the next index entries that match the scan, up to max of them, like scanNextBatch, with their keys and
+	 * included columns, so a query that only needs those does not read the relation. The keys are copied straight
+	 * off the leaves.
+   * @param outRids	Receives the record ids
+   * @param outKeys	Receives the keys, an array of int / double / StringKey for INTEGER / DOUBLE / STRING, or NULL
+   * @param outIncluded	Receives includedLength bytes for every entry, or NULL
+   * @param max	Room in the arrays
+   * @return Number of entries stored, fewer than max only near the end of the scan and 0 once it is completed
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	 * @throws BadIndexInfoException If outIncluded is given and the index has no included columns.
+	**/
+	size_t scanNextEntries(RecordId* outRids, void* outKeys, void* outIncluded, size_t max);
+
+
   /**
 	 * Terminate the current scan. Unpin any pinned pages. Reset scan specific variables.
 	 * @throws ScanNotInitializedException If no scan has been initialized.
 	**/
 	const void endScan();
 
-	/**
-	* Starting at page, traverse down the tree to find the leaf where the value at keyPtr will be inserted.
-	* If the child was full and was restructured, restrctured will be true and newPageId will have the
-	* PageId of the new page that the child created. This new page would need to be added to the parent (page)
-	*
-	*@param page The page we want to traverse down into
-	*@param pageLevel The level of page
-	*@param isRoot Pass in true if page == rootPage
-	*@param keyPtr A pointer to the key we are trying to insert into the tree
-	*@param rid The associated record id of the key
-	*@param restructured True if the child was restructured
-	*@param newPageId The id of the new page created by the child
-	*@param comingFromLeaf True if we are coming from one level above the leaf. Needed to set the level of new pages created to 1
-	*/
-	const void traverseAndInsert(Page* page, int pageLevel, bool isRoot, const void* keyPtr, const RecordId rid, bool &restructured, PageId &newPageId, bool &comingFromLeaf);
 
-	/**
-	*	Find the index into  page where the value at keyPtr would go. Assumes a leaf page
-	*
-	*@param page The page you want to insert the key on
-	*@param keyPtr Pointer to the key you wish to insert
-	*/
-	int findIndexIntoKeyArray(Page* page, const void* keyPtr);
+  /**
+	 * Find the record id of a key, without touching the scan of startScan and without throwing if the key is not
+	 * there. Goes down to the leaf of the key like a scan does, and unpins it before returning. A key with more
+	 * than one rid gives the first of them in ridLess order, openScan returns all of them.
+   * @param key			Key to find, pointer to integer/double/char string
+   * @param outRid	Set to the record id of the key if it is found
+   * @return False if the key is not in the index
+	**/
+	bool lookup(const void* key, RecordId& outRid);
 
-	/**
-	*When traversing down the tree we need to find the PageId of the child to traverse into given a 
-	* specific key value to look for. Assumes a non-leaf page
-	*
-	*@param page The page on which we are trying to find the child PageId
-	*@param keyPtr Pointer to the key we are trying to find
-	*/
-	int findIndexIntoPageNoArray(Page* page, const void* keyPtr);
 
-	/**
-	*Find the middle value and index in a page based on a key passed in
-	*
-	*@param page The page on which you want to find the middle value
-	*@param isLeaf 
-	*@param keyPtr Pointer to the key to determine what the middle value is. Might change based on the value of the key
-	*@param middleIndex Returned by this function. Start copying values from the next value after middleIndex onto the new page when restructuring 
-	*/
-	void findMiddleValue(Page* page, bool isLeaf, const void* keyPtr, int &middleIndex);
+  /**
+	 * Find the record ids of several keys, as lookup does for each of them. The keys are looked up in key order,
+	 * going back up from the leaf of one key only as far as the lowest node the next one is under, so keys close
+	 * together share most of their descent. With LATCH_COUPLING the nodes on the way down stay latched until the
+	 * batch moves past them.
+   * @param keys			Keys to find, each a pointer to integer/double/char string
+   * @param numKeys		Number of keys
+   * @param outRids		Set to the record id of keys[i] at i, for every key found
+   * @param found			Set to whether keys[i] was found at i
+   * @return Number of keys found
+	**/
+	size_t lookupBatch(const void* const* keys, size_t numKeys, RecordId* outRids, bool* found);
 
-	/**
-	*Insert onto page, the value at keyPtr and its associated pageId
-	*
-	*@param page The page on which we want to insert this value
-	*@param keyPtr Pointer to the key you want to insert
-	*@param pageId The new pageId 
-	*/
-	const void insertIntoNonLeafPage(Page* page, const void* keyPtr, PageId pageId);
 
-	/**
-	*Take a full page of values and copy the largest half of entries onto a new page
-	*
-	*@param fullPage The page we want to split
-	*@param isLeaf
-	*@param keyPtr The key we are trying to insert. The middle value and therefor the split value will depend on this key
-	*@param newPageIdFromChild The PageId from the child we are going to insert as a result of a previous split
-	*@param newPageId the PageId of the new page created by this function. It will contain the greater half of data
-	*/
-	const void restructure(Page* fullPage, bool isLeaf, const void* keyPtr, PageId newPageIdFromChild, PageId &newPageId);
+  /**
+	 * Count the record ids a scan with the same parameters would return, without returning them, and without
+	 * disturbing the scan of startScan. An index created with SUBTREE_COUNTS adds up the counts of the children
+	 * entirely within the range and only reads the nodes the two bounds fall into, one path down for each,
+	 * plus the posting lists of the keys on the two leaves it ends on. Any other index scans the range.
+   * @param lowVal	Low value of range, pointer to integer / double / char string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char string
+   * @param highOp	High operator (LT/LTE)
+   * @return Number of rids in the range, 0 if there are none
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
+   * @throws  BadScanrangeException If lowVal > highval
+	**/
+	size_t countRange(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
 
-	/**
-	*Simple recursive traversing algorithm based on the key. Used in start scan to find the PageId of the lowValParm
-	*
-	*@param page The starting page of the search
-	*@param keyPtr Pointer to the key we are searching for
-	*@param leafId PageId of the lead on which the value at keyPtr lies
-	*/
-	const void traverse(Page* page, int pageLevel, const void* keyPtr, PageId &leafId);
+
+  /**
+	 * Estimate how many record ids a scan with the same parameters would return from the statistics the index
+	 * collected while it was built, without reading any node: an equi-depth histogram of the keys and a sketch of
+	 * how many distinct keys there are. The rids of a bucket are taken to be spread evenly between its bounds, and a
+	 * range within the keys of the index is taken to hold at least the average number of rids of a key. Inserts and
+	 * deletes after the build do not change the statistics. An index file built before they were kept has none,
+	 * and then the range is counted as countRange does.
+   * @param lowVal	Low value of range, pointer to integer / double / char string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char string
+   * @param highOp	High operator (LT/LTE)
+   * @return Estimated number of rids in the range
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
+   * @throws  BadScanrangeException If lowVal > highval
+	**/
+	double estimateRange(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+
+
+  /**
+	 * Set how many leaves right of the current one every scan keeps fetched into the buffer pool, so a scan moving on
+	 * to the next leaf does not wait for it to be read. A background thread fetches them, following the right links and
+	 * stopping at the first leaf whose first key is past the high end of the scan. The leaves fetched stay pinned until
+	 * the scan gets to them or ends, so every open scan may hold numLeaves more frames. Since the read-ahead calls the
+	 * buffer manager between the calls into the index, the caller holds bufMgrLatch around its own buffer manager calls
+	 * while a scan is open. The thread also starts the reads of the next numLeaves leaves together on an
+	 * AsyncPageReader, up to numLeaves at once, so the right links it follows lead to pages already on their way.
+	 * Call while no scan is open. Does nothing in READ_ONLY_MAPPED mode, where the leaves are not fetched into the pool.
+   * @param numLeaves	Leaves to fetch ahead, 0 (the default) to turn read-ahead off
+	**/
+	void setReadAhead(int numLeaves);
+
+
+  /**
+	 * How many of the leaves scans moved on to were already fetched by the read-ahead, to tune setReadAhead by.
+	 * Only counted while read-ahead is on.
+	**/
+	ReadAheadStats getReadAheadStats();
+
+
+  /**
+	 * Snapshot of the counters of the index, added up over the threads that called into it: pages read and unpinned,
+	 * splits, node searches and their key comparisons, lookups and deletes, and latency histograms of insertEntry,
+	 * startScan and scanNext. Each thread updates counters of its own, so the calls do not contend on them. Every
+	 * counter stays 0 when the index is compiled with BADGERDB_NO_INDEX_STATS defined, which removes their updates.
+	 * The shape of the tree comes from going down its left edge, and from reading every leaf if asked to.
+   * @param walkLeaves	Whether to read every leaf for numLeaves and leafFill
+	**/
+	IndexStats getStats(bool walkLeaves = false);
 
 };
 
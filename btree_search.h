@@ -0,0 +1,136 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include "string.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "btree.h"
+
+namespace badgerdb
+{
+
+/**
+ * @brief Once the binary search has narrowed the keys down to this many, the rest are compared
+ * all at once with vector instructions instead of halving further.
+ */
+const  int SEARCHVECTORTHRESHOLD = 16;
+
+/**
+ * @brief Count the keys in keys[0 .. n - 1] that are less than key, or less than or equal to key
+ * if inclusive is set. The INTEGER version compares 8 keys per instruction with AVX2 and 4 with SSE2.
+ */
+template <bool inclusive>
+inline int countKeysBelow(const int* keys, int n, int key)
+{
+	int count = 0;
+	int i = 0;
+#if defined(__AVX2__)
+	__m256i keyVec = _mm256_set1_epi32(key);
+	for(; i + 8 <= n; i += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i*) (keys + i));
+		//inclusive counts the keys that are not greater than key
+		__m256i cmp = inclusive ? _mm256_cmpgt_epi32(v, keyVec) : _mm256_cmpgt_epi32(keyVec, v);
+		int matches = __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(cmp)));
+		count += inclusive ? 8 - matches : matches;
+	}
+#elif defined(__SSE2__)
+	__m128i keyVec = _mm_set1_epi32(key);
+	for(; i + 4 <= n; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i*) (keys + i));
+		__m128i cmp = inclusive ? _mm_cmpgt_epi32(v, keyVec) : _mm_cmpgt_epi32(keyVec, v);
+		int matches = __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(cmp)));
+		count += inclusive ? 4 - matches : matches;
+	}
+#endif
+	for(; i < n; i++) count += inclusive ? (keys[i] <= key) : (keys[i] < key);
+	return count;
+}
+
+/**
+ * @brief DOUBLE version of countKeysBelow. Compares 4 keys per instruction with AVX2 and 2 with SSE2.
+ */
+template <bool inclusive>
+inline int countKeysBelow(const double* keys, int n, double key)
+{
+	int count = 0;
+	int i = 0;
+#if defined(__AVX2__)
+	__m256d keyVec = _mm256_set1_pd(key);
+	for(; i + 4 <= n; i += 4) {
+		__m256d v = _mm256_loadu_pd(keys + i);
+		__m256d cmp = _mm256_cmp_pd(v, keyVec, inclusive ? _CMP_LE_OQ : _CMP_LT_OQ);
+		count += __builtin_popcount(_mm256_movemask_pd(cmp));
+	}
+#elif defined(__SSE2__)
+	__m128d keyVec = _mm_set1_pd(key);
+	for(; i + 2 <= n; i += 2) {
+		__m128d v = _mm_loadu_pd(keys + i);
+		__m128d cmp = inclusive ? _mm_cmple_pd(v, keyVec) : _mm_cmplt_pd(v, keyVec);
+		count += __builtin_popcount(_mm_movemask_pd(cmp));
+	}
+#endif
+	for(; i < n; i++) count += inclusive ? (keys[i] <= key) : (keys[i] < key);
+	return count;
+}
+
+/**
+ * @brief Branch-free binary search over the sorted keys[0 .. numKeys - 1]. Returns the number of keys less than
+ * key (a lower bound), or less than or equal to key if inclusive is set (an upper bound).
+ * The halving step only moves a pointer with a conditional move, and the last SEARCHVECTORTHRESHOLD
+ * candidates are counted with countKeysBelow.
+ */
+template <bool inclusive, class T>
+inline int searchKeyArray(const T* keys, int numKeys, T key)
+{
+	const T* base = keys;
+	int n = numKeys;
+
+	//the answer always lies in [base, base + n]
+	while(n > SEARCHVECTORTHRESHOLD) {
+		int half = n / 2;
+		bool below = inclusive ? base[half] <= key : base[half] < key;
+		base = below ? base + half : base;
+		n -= half;
+	}
+
+	//every halving compared one key, the tail compares the n left
+#ifdef BADGERDB_INDEX_STATS
+	if(statsCounters != NULL) {
+		int halvings = 0;
+		for(int left = numKeys; left > SEARCHVECTORTHRESHOLD; left -= left / 2) halvings++;
+		countStat(statsCounters->keyComparisons, halvings + n);
+		countStat(statsCounters->nodeSearches, 1);
+	}
+#endif
+	return (int) (base - keys) + countKeysBelow<inclusive>(base, n, key);
+}
+
+/**
+ * @brief Index of the first key that is greater than or equal to key.
+ */
+template <class T>
+inline int lowerBoundKey(const T* keys, int numKeys, T key)
+{
+	return searchKeyArray<false>(keys, numKeys, key);
+}
+
+/**
+ * @brief Index of the first key that is greater than key.
+ */
+template <class T>
+inline int upperBoundKey(const T* keys, int numKeys, T key)
+{
+	return searchKeyArray<true>(keys, numKeys, key);
+}
+
+}
@@ -0,0 +1,143 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "index_stats.h"
+
+namespace badgerdb
+{
+
+thread_local IndexCounters* statsCounters = NULL;
+
+//the registry the calling thread last got its counters from, and those counters
+static thread_local unsigned long long cachedRegistryId = 0;
+static thread_local IndexCounters* cachedCounters = NULL;
+
+static std::atomic<unsigned long long> nextRegistryId(1);
+
+// -----------------------------------------------------------------------------
+// LatencyHistogram::count
+// -----------------------------------------------------------------------------
+unsigned long long LatencyHistogram::count() const
+{
+	unsigned long long total = 0;
+	for(int i = 0; i < LATENCYBUCKETS; i++) total += buckets[i];
+	return total;
+}
+
+// -----------------------------------------------------------------------------
+// LatencyHistogram::percentile
+// -----------------------------------------------------------------------------
+double LatencyHistogram::percentile(double fraction) const
+{
+	unsigned long long total = count();
+	if(total == 0) return 0;
+
+	//the first bucket that brings the calls up to the fraction asked for
+	unsigned long long rank = (unsigned long long) (fraction * total);
+	unsigned long long seen = 0;
+	for(int i = 0; i < LATENCYBUCKETS; i++) {
+		seen += buckets[i];
+		if(seen > rank) return (double) (1ULL << (i + 1));
+	}
+	return (double) (1ULL << LATENCYBUCKETS);
+}
+
+// -----------------------------------------------------------------------------
+// IndexCounters::IndexCounters
+// -----------------------------------------------------------------------------
+IndexCounters::IndexCounters()
+{
+	pageReads.store(0);
+	pageUnpins.store(0);
+	leafSplits.store(0);
+	nonLeafSplits.store(0);
+	rootSplits.store(0);
+	nodeSearches.store(0);
+	keyComparisons.store(0);
+	lookups.store(0);
+	deletes.store(0);
+	for(int k = 0; k < NUMLATENCYKINDS; k++) {
+		for(int i = 0; i < LATENCYBUCKETS; i++) latencies[k][i].store(0);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// IndexStatsRegistry::IndexStatsRegistry
+// -----------------------------------------------------------------------------
+IndexStatsRegistry::IndexStatsRegistry()
+{
+	id = nextRegistryId.fetch_add(1);
+}
+
+// -----------------------------------------------------------------------------
+// IndexStatsRegistry::~IndexStatsRegistry
+// -----------------------------------------------------------------------------
+IndexStatsRegistry::~IndexStatsRegistry()
+{
+	for(size_t i = 0; i < threadCounters.size(); i++) delete threadCounters[i].second;
+}
+
+// -----------------------------------------------------------------------------
+// IndexStatsRegistry::local
+// -----------------------------------------------------------------------------
+IndexCounters* IndexStatsRegistry::local()
+{
+	//a thread mostly calls into the same index over and over
+	if(cachedRegistryId == id) return cachedCounters;
+
+	std::lock_guard<std::mutex> guard(latch);
+	std::thread::id self = std::this_thread::get_id();
+	IndexCounters* counters = NULL;
+	for(size_t i = 0; i < threadCounters.size() && counters == NULL; i++) {
+		if(threadCounters[i].first == self) counters = threadCounters[i].second;
+	}
+	if(counters == NULL) {
+		counters = new IndexCounters();
+		threadCounters.push_back(std::make_pair(self, counters));
+	}
+	cachedRegistryId = id;
+	cachedCounters = counters;
+	return counters;
+}
+
+// -----------------------------------------------------------------------------
+// IndexStatsRegistry::read
+// -----------------------------------------------------------------------------
+void IndexStatsRegistry::read(IndexStats &stats)
+{
+	stats.pageReads = 0;
+	stats.pageUnpins = 0;
+	stats.leafSplits = 0;
+	stats.nonLeafSplits = 0;
+	stats.rootSplits = 0;
+	stats.nodeSearches = 0;
+	stats.keyComparisons = 0;
+	stats.lookups = 0;
+	stats.deletes = 0;
+	for(int k = 0; k < NUMLATENCYKINDS; k++) {
+		for(int i = 0; i < LATENCYBUCKETS; i++) stats.latencies[k].buckets[i] = 0;
+	}
+
+	std::lock_guard<std::mutex> guard(latch);
+	for(size_t t = 0; t < threadCounters.size(); t++) {
+		const IndexCounters* counters = threadCounters[t].second;
+		stats.pageReads += counters->pageReads.load(std::memory_order_relaxed);
+		stats.pageUnpins += counters->pageUnpins.load(std::memory_order_relaxed);
+		stats.leafSplits += counters->leafSplits.load(std::memory_order_relaxed);
+		stats.nonLeafSplits += counters->nonLeafSplits.load(std::memory_order_relaxed);
+		stats.rootSplits += counters->rootSplits.load(std::memory_order_relaxed);
+		stats.nodeSearches += counters->nodeSearches.load(std::memory_order_relaxed);
+		stats.keyComparisons += counters->keyComparisons.load(std::memory_order_relaxed);
+		stats.lookups += counters->lookups.load(std::memory_order_relaxed);
+		stats.deletes += counters->deletes.load(std::memory_order_relaxed);
+		for(int k = 0; k < NUMLATENCYKINDS; k++) {
+			for(int i = 0; i < LATENCYBUCKETS; i++) stats.latencies[k].buckets[i] += counters->latencies[k][i].load(std::memory_order_relaxed);
+		}
+	}
+}
+
+}
@@ -0,0 +1,225 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <chrono>
+
+// Counters are kept unless BADGERDB_NO_INDEX_STATS is defined, which compiles every update of them out
+#ifndef BADGERDB_NO_INDEX_STATS
+#define BADGERDB_INDEX_STATS
+#endif
+
+namespace badgerdb
+{
+
+/**
+ * @brief Number of buckets of a LatencyHistogram. Bucket i counts the calls that took from 2^i up to 2^(i + 1)
+ * nanoseconds, bucket 0 those under 2 and the last one everything longer.
+ */
+const  int LATENCYBUCKETS = 40;
+
+/**
+ * @brief The calls whose latency is kept in a histogram.
+ */
+enum LatencyKind
+{
+	INSERT_LATENCY,		/* BTreeIndex::insertEntry */
+	STARTSCAN_LATENCY,	/* BTreeIndex::startScan */
+	SCANNEXT_LATENCY,	/* BTreeIndex::scanNext and ScanCursor::scanNext */
+	NUMLATENCYKINDS
+};
+
+/**
+ * @brief How long the calls of one kind took, in power of two buckets of nanoseconds.
+ */
+struct LatencyHistogram{
+	unsigned long long buckets[LATENCYBUCKETS];
+
+  /**
+   * Number of calls timed.
+   */
+	unsigned long long count() const;
+
+  /**
+   * Upper end, in nanoseconds, of the bucket the call at the given fraction of them in latency order falls into,
+   * 0 if no call was timed.
+   * @param fraction	0.5 for the median, 0.99 for the 99th percentile
+   */
+	double percentile(double fraction) const;
+};
+
+/**
+ * @brief Snapshot of what an index has done since it was opened, see BTreeIndex::getStats. Every counter adds up
+ * the calls of all threads into the index. Pages a scan's read-ahead thread fetches are not counted.
+ */
+struct IndexStats{
+  /**
+   * Pages read through the buffer manager, or looked up in the mapping in READ_ONLY_MAPPED mode. The root and
+   * resident non-leaves are not read again once they are in memory.
+   */
+	unsigned long long pageReads;
+
+  /**
+   * Pages unpinned again.
+   */
+	unsigned long long pageUnpins;
+
+  /**
+   * Leaves and non-leaves split by inserts, and how often the root split, growing the tree by a level.
+   */
+	unsigned long long leafSplits;
+	unsigned long long nonLeafSplits;
+	unsigned long long rootSplits;
+
+  /**
+   * Binary searches within a node and the key comparisons they made, a vectorized comparison of several keys
+   * counting once for every key.
+   */
+	unsigned long long nodeSearches;
+	unsigned long long keyComparisons;
+
+  /**
+   * Calls of lookup and of deleteEntry. lookupBatch counts once for every key.
+   */
+	unsigned long long lookups;
+	unsigned long long deletes;
+
+  /**
+   * Latencies of insertEntry, startScan and scanNext. The count of each is the number of calls.
+   */
+	LatencyHistogram latencies[NUMLATENCYKINDS];
+
+  /**
+   * Levels of the tree, leaves included.
+   */
+	int treeHeight;
+
+  /**
+   * Number of leaves and the average share of a leaf its entries take. Only filled in when getStats is asked to
+   * walk the leaves, -1 otherwise.
+   */
+	long long numLeaves;
+	double leafFill;
+};
+
+/**
+ * @brief The counters of one thread for one index. Only the thread writes them, so an update is a plain load and
+ * store; getStats reads them from another thread.
+ */
+struct IndexCounters{
+	std::atomic<unsigned long long> pageReads;
+	std::atomic<unsigned long long> pageUnpins;
+	std::atomic<unsigned long long> leafSplits;
+	std::atomic<unsigned long long> nonLeafSplits;
+	std::atomic<unsigned long long> rootSplits;
+	std::atomic<unsigned long long> nodeSearches;
+	std::atomic<unsigned long long> keyComparisons;
+	std::atomic<unsigned long long> lookups;
+	std::atomic<unsigned long long> deletes;
+	std::atomic<unsigned long long> latencies[NUMLATENCYKINDS][LATENCYBUCKETS];
+
+	IndexCounters();
+};
+
+/**
+ * @brief Counters of the index the thread is in a call of, set by a StatsScope. NULL outside of them.
+ */
+extern thread_local IndexCounters* statsCounters;
+
+/**
+ * @brief Add n to a counter of the calling thread.
+ */
+inline void countStat(std::atomic<unsigned long long> &counter, unsigned long long n)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+#ifdef BADGERDB_INDEX_STATS
+#define INDEX_STAT(counter, n) do { IndexCounters* statsCountersNow = statsCounters; if(statsCountersNow != NULL) countStat(statsCountersNow->counter, (n)); } while(0)
+#else
+#define INDEX_STAT(counter, n) do { } while(0)
+#endif
+
+/**
+ * @brief The IndexCounters of every thread that has called into one index. A thread gets its own the first
+ * time it does, and they are added up when read.
+ */
+class IndexStatsRegistry {
+
+ private:
+
+  /**
+   * Tells registries apart in the cache of the last one each thread used, even once one is gone.
+   */
+	unsigned long long id;
+
+  /**
+   * Guards threadCounters.
+   */
+	std::mutex	latch;
+
+	std::vector<std::pair<std::thread::id, IndexCounters*> > threadCounters;
+
+ public:
+
+	IndexStatsRegistry();
+	~IndexStatsRegistry();
+
+  /**
+   * The counters of the calling thread.
+   */
+	IndexCounters* local();
+
+  /**
+   * Set the counters of stats to the sums over every thread.
+   */
+	void read(IndexStats &stats);
+};
+
+/**
+ * @brief Points statsCounters at the counters of the calling thread for one index while a call into it runs,
+ * and times the call if it is of a LatencyKind. Calls within another keep to the counters of the outer one.
+ * An empty class when BADGERDB_NO_INDEX_STATS is defined.
+ */
+class StatsScope {
+
+#ifdef BADGERDB_INDEX_STATS
+ private:
+	IndexCounters* previous;
+	int latencyKind;
+	std::chrono::steady_clock::time_point start;
+
+ public:
+  /**
+   * @param registry	Counters of the index called
+   * @param kind			LatencyKind of the call, NUMLATENCYKINDS to leave it untimed
+   */
+	StatsScope(IndexStatsRegistry &registry, int kind = NUMLATENCYKINDS) : previous(statsCounters), latencyKind(kind) {
+		statsCounters = registry.local();
+		if(latencyKind != NUMLATENCYKINDS) start = std::chrono::steady_clock::now();
+	}
+
+	~StatsScope() {
+		if(latencyKind != NUMLATENCYKINDS) {
+			long long nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+			int bucket = (nanos < 2) ? 0 : 63 - __builtin_clzll((unsigned long long) nanos);
+			countStat(statsCounters->latencies[latencyKind][bucket < LATENCYBUCKETS ? bucket : LATENCYBUCKETS - 1], 1);
+		}
+		statsCounters = previous;
+	}
+#else
+ public:
+	StatsScope(IndexStatsRegistry &registry, int kind = NUMLATENCYKINDS) {}
+#endif
+};
+
+}
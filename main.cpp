@@ -6,6 +6,13 @@
  */
 
 #include <vector>
+#include <thread>
+#include <random>
+#include <algorithm>
+#include <math.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
 #include "btree.h"
 #include "page.h"
 #include "filescan.h"
@@ -19,6 +26,9 @@
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/scan_not_initialized_exception.h"
 #include "exceptions/end_of_file_exception.h"
+#include "exceptions/duplicate_key_exception.h"
+#include "exceptions/read_only_index_exception.h"
+#include "exceptions/bad_index_info_exception.h"
 
 #define checkPassFail(a, b) 																				\
 {																																		\
@@ -43,6 +53,9 @@ int testNum = 1;
 const std::string relationName = "relA";
 //If the relation size is changed then the second parameter 2 chechPassFail may need to be changed to number of record that are expected to be found during the scan, else tests will erroneously be reported to have failed.
 const int	relationSize = 400000;
+//Number of threads and keys the concurrent tests insert on top of the relation
+const int	numInsertThreads = 4;
+const int	concurrentInserts = 100000;
 std::string intIndexName, doubleIndexName, stringIndexName;
 
 // This is the structure for tuples in the base relation
@@ -67,13 +80,47 @@ BufMgr * bufMgr = new BufMgr(100);
 void createRelationForward();
 void createRelationBackward();
 void createRelationRandom();
-void intTests();
+void intTests(BuildMethod buildMethod);
 int intScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+void concurrentTests(const ConcurrencyMode concurrencyMode, const int residentLevels = 1);
+void concurrentInsertThread(BTreeIndex *index, int threadNum);
+void deleteTests(const DeleteMode deleteMode, const int residentLevels = 1);
+void concurrentDeleteThread(BTreeIndex *index, int threadNum);
+void dupTests();
+void readAheadTests();
+void mappedTests();
+void walTests();
+void walCrash(const ConcurrencyMode concurrencyMode);
+void walCheckpointTests();
+void countTests(BuildMethod buildMethod);
+int intCountMismatches(BTreeIndex *index, int highVal);
+void lookupTests();
+int intLookupMismatches(BTreeIndex *index);
+void statisticsTests();
+void parallelBuildTests();
+void statsTests();
+void heapOrderTests();
+int intHeapOrderCount(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp, size_t memoryRids);
+void includedTests();
+int intEntryCount(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp, size_t batchSize, bool withIncluded);
+int wideEntryCount(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+void descendingTests();
+int intDescendingCount(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp, size_t batchSize);
+int intRidOrderCount(BTreeIndex *index, int key, size_t batchSize);
+int intCount(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+void concurrentScanThread(BTreeIndex *index, int *badScans);
+int intCursorCount(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+int intJoinCount(BTreeIndex *index, int outerHigh, int innerHigh);
+int intBatchCount(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp, size_t batchSize);
 void indexTests();
-void doubleTests();
+void doubleTests(BuildMethod buildMethod);
 int doubleScan(BTreeIndex *index, double lowVal, Operator lowOp, double highVal, Operator highOp);
-void stringTests();
+void stringTests(BuildMethod buildMethod);
 int stringScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+int stringEntryCount(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+void longStringTests(BuildMethod buildMethod);
+void longStringKey(char *key, int i);
+int longStringCount(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
 void test1();
 void test2();
 void test3();
@@ -102,7 +149,7 @@ int main(int argc, char **argv)
 			std::cout << "leaf size:" << DOUBLEARRAYLEAFSIZE << " non-leaf size:" << DOUBLEARRAYNONLEAFSIZE << std::endl;
 			break;
 		case 3:
-			std::cout << "leaf size:" << STRINGARRAYLEAFSIZE << " non-leaf size:" << STRINGARRAYNONLEAFSIZE << std::endl;
+			std::cout << "node bytes:" << STRINGNODEDATASIZE << " max key length:" << STRINGSIZE << std::endl;
 			break;
 	}
 
@@ -374,7 +421,175 @@ void indexTests()
 {
   if(testNum == 1)
   {
-    intTests();
+    intTests(INSERT_BUILD);
+		try
+		{
+			File::remove(intIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+    intTests(BULK_LOAD);
+		try
+		{
+			File::remove(intIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+    concurrentTests(LATCH_COUPLING);
+		try
+		{
+			File::remove(intIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+    concurrentTests(B_LINK);
+		try
+		{
+			File::remove(intIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+    concurrentTests(B_LINK, ALLLEVELSRESIDENT);
+		try
+		{
+			File::remove(intIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+    deleteTests(MERGE_ON_UNDERFLOW);
+		try
+		{
+			File::remove(intIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+    deleteTests(LAZY_DELETE);
+		try
+		{
+			File::remove(intIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+    deleteTests(MERGE_ON_UNDERFLOW, ALLLEVELSRESIDENT);
+		try
+		{
+			File::remove(intIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+    dupTests();
+		try
+		{
+			File::remove(intIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+    readAheadTests();
+		try
+		{
+			File::remove(intIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+    mappedTests();
+		try
+		{
+			File::remove(intIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+    walTests();
+		try
+		{
+			File::remove(intIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+    walCheckpointTests();
+		try
+		{
+			File::remove(intIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+    countTests(INSERT_BUILD);
+		try
+		{
+			File::remove(intIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+    countTests(BULK_LOAD);
+		try
+		{
+			File::remove(intIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+    lookupTests();
+		try
+		{
+			File::remove(intIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+    statisticsTests();
+		try
+		{
+			File::remove(intIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+    parallelBuildTests();
+		try
+		{
+			File::remove(intIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+    statsTests();
+		try
+		{
+			File::remove(intIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+    heapOrderTests();
+		try
+		{
+			File::remove(intIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+    includedTests();
+		try
+		{
+			File::remove(intIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+    descendingTests();
 		try
 		{
 			File::remove(intIndexName);
@@ -385,7 +600,15 @@ void indexTests()
   }
   else if(testNum == 2)
   {
-    doubleTests();
+    doubleTests(INSERT_BUILD);
+		try
+		{
+			File::remove(doubleIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+    doubleTests(BULK_LOAD);
 		try
 		{
 			File::remove(doubleIndexName);
@@ -396,104 +619,1702 @@ void indexTests()
   }
   else if(testNum == 3)
   {
-    stringTests();
+    stringTests(INSERT_BUILD);
+		try
+		{
+			File::remove(stringIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+    stringTests(BULK_LOAD);
+		try
+		{
+			File::remove(stringIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+    longStringTests(INSERT_BUILD);
+    longStringTests(BULK_LOAD);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// intTests
+// -----------------------------------------------------------------------------
+
+void intTests(BuildMethod buildMethod)
+{
+  std::cout << "Create a B+ Tree index on the integer field";
+  if( buildMethod == BULK_LOAD ) { std::cout << " by bulk loading it"; }
+  std::cout << std::endl;
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, buildMethod, 0.8);
+
+	// run some tests
+	checkPassFail(intScan(&index,25,GT,40,LT), 14)
+	checkPassFail(intScan(&index,20,GTE,35,LTE), 16)
+	checkPassFail(intScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(intScan(&index,996,GT,1001,LT), 4)
+	checkPassFail(intScan(&index,0,GT,1,LT), 0)
+	checkPassFail(intScan(&index,300,GT,400,LT), 99)
+	checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+	checkPassFail(intJoinCount(&index, 100, 50), 5000)
+	checkPassFail(intBatchCount(&index,300,GT,400,LTE,7), 100)
+	checkPassFail(intBatchCount(&index,0,GTE,relationSize,LT,1000), relationSize)
+}
+
+int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+  RecordId scanRid;
+	Page *curPage;
+
+  std::cout << "Scan for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+  int numResults = 0;
+	
+	try
+	{
+  	index->startScan(&lowVal, lowOp, &highVal, highOp);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+		return 0;
+	}
+
+	while(1)
+	{
 		try
 		{
-			File::remove(stringIndexName);
+			index->scanNext(scanRid);
+			RECORD myRec;
+			{
+				// the read-ahead of the index may be in the buffer manager at the same time
+				std::lock_guard<std::mutex> guard(bufMgrLatch);
+				bufMgr->readPage(file1, scanRid.page_number, curPage);
+				myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+				bufMgr->unPinPage(file1, scanRid.page_number, false);
+			}
+
+			if( numResults < 5 )
+			{
+				std::cout << "at:" << scanRid.page_number << "," << scanRid.slot_number;
+				std::cout << " -->:" << myRec.i << ":" << myRec.d << ":" << myRec.s << ":" <<std::endl;
+			}
+			else if( numResults == 5 )
+			{
+				std::cout << "..." << std::endl;
+			}
+		}
+		catch(IndexScanCompletedException e)
+		{
+			break;
+		}
+
+		numResults++;
+	}
+
+  if( numResults >= 5 )
+  {
+    std::cout << "Number of results: " << numResults << std::endl;
+  }
+  index->endScan();
+  std::cout << std::endl;
+
+	return numResults;
+}
+
+// -----------------------------------------------------------------------------
+// concurrentTests
+// -----------------------------------------------------------------------------
+
+void concurrentTests(const ConcurrencyMode concurrencyMode, const int residentLevels)
+{
+  std::cout << "Insert into a B+ Tree index on the integer field from " << numInsertThreads << " threads while scanning it"
+		<< (concurrencyMode == B_LINK ? " (B-link)" : " (latch coupling)")
+		<< (residentLevels == ALLLEVELSRESIDENT ? " with every non-leaf resident" : "") << std::endl;
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, INSERT_BUILD, 0.8, concurrencyMode,
+		MERGE_ON_UNDERFLOW, residentLevels);
+
+	std::vector<std::thread> threads;
+	for(int t = 0; t < numInsertThreads; t++)
+	{
+		threads.push_back(std::thread(concurrentInsertThread, &index, t));
+	}
+	int badCursorScans = 0;
+	std::thread cursorThread(concurrentScanThread, &index, &badCursorScans);
+
+	// the keys of the relation do not change, so every lookup and every scan over them has to see all of them
+	int badLookups = intLookupMismatches(&index);
+	int badScans = 0;
+	for(int i = 0; i < 20; i++)
+	{
+		if(intCount(&index, 0, GTE, relationSize, LT) != relationSize) badScans++;
+	}
+
+	for(int t = 0; t < numInsertThreads; t++)
+	{
+		threads[t].join();
+	}
+	cursorThread.join();
+
+	checkPassFail(badLookups, 0)
+	checkPassFail(badScans, 0)
+	checkPassFail(badCursorScans, 0)
+	checkPassFail(intCount(&index, relationSize, GTE, relationSize + concurrentInserts, LT), concurrentInserts)
+	checkPassFail(intCount(&index, relationSize + 1000, GT, relationSize + 2000, LTE), 1000)
+	checkPassFail(intCount(&index, 0, GTE, relationSize + concurrentInserts, LT), relationSize + concurrentInserts)
+}
+
+void concurrentInsertThread(BTreeIndex * index, int threadNum)
+{
+	// every thread inserts its own share of the new keys in random order
+	std::vector<int> keys;
+	for(int key = relationSize + threadNum; key < relationSize + concurrentInserts; key += numInsertThreads)
+	{
+		keys.push_back(key);
+	}
+	std::mt19937 generator(threadNum);
+	std::shuffle(keys.begin(), keys.end(), generator);
+
+	for(size_t i = 0; i < keys.size(); i++)
+	{
+		RecordId keyRid;
+		keyRid.page_number = keys[i];
+		keyRid.slot_number = 1;
+		index->insertEntry(&keys[i], keyRid);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// deleteTests
+// -----------------------------------------------------------------------------
+
+void deleteTests(const DeleteMode deleteMode, const int residentLevels)
+{
+  std::cout << "Delete from a B+ Tree index on the integer field" << (deleteMode == LAZY_DELETE ? " lazily" : "")
+		<< (residentLevels == ALLLEVELSRESIDENT ? " with every non-leaf resident" : "") << std::endl;
+	// keys deleted first, the odd ones of a range, which leaves every leaf there half full
+	const int oddDeletes = (300000 - 1000) / 2;
+
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, BULK_LOAD, 1.0, LATCH_COUPLING, deleteMode, residentLevels);
+
+		for(int key = 1001; key < 300000; key += 2)
+		{
+			index.deleteEntry(&key);
+		}
+		checkPassFail(intScan(&index,1000,GTE,1010,LT), 5)
+		checkPassFail(intCount(&index, 0, GTE, relationSize, LT), relationSize - oddDeletes)
+
+		int missing = 1001;
+		int thrown = 0;
+		try
+		{
+			index.deleteEntry(&missing);
+		}
+		catch(NoSuchKeyFoundException e)
+		{
+			thrown = 1;
+		}
+		checkPassFail(thrown, 1)
+
+		// then all but every thousandth key from several threads, while scanning
+		std::vector<std::thread> threads;
+		for(int t = 0; t < numInsertThreads; t++)
+		{
+			threads.push_back(std::thread(concurrentDeleteThread, &index, t));
+		}
+		int badScans = 0;
+		for(int i = 0; i < 20; i++)
+		{
+			int numResults = intCount(&index, 0, GTE, relationSize, LT);
+			if(numResults < relationSize / 1000 || numResults > relationSize - oddDeletes) badScans++;
+		}
+		for(int t = 0; t < numInsertThreads; t++)
+		{
+			threads[t].join();
+		}
+
+		checkPassFail(badScans, 0)
+		checkPassFail(intScan(&index,2000,GTE,5000,LTE), 4)
+		checkPassFail(intCount(&index, 0, GTE, relationSize, LT), relationSize / 1000)
+	}
+
+	// open the shrunk index again, the splits of new inserts take the pages freed by the merges
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, BULK_LOAD, 1.0, B_LINK, deleteMode, residentLevels);
+		checkPassFail(intCount(&index, 0, GTE, relationSize, LT), relationSize / 1000)
+
+		for(int key = 0; key < 100000; key++)
+		{
+			if(key % 1000 == 0) continue;
+			RecordId keyRid;
+			keyRid.page_number = key;
+			keyRid.slot_number = 1;
+			index.insertEntry(&key, keyRid);
+		}
+		checkPassFail(intCount(&index, 0, GTE, relationSize, LT), 100000 + (relationSize - 100000) / 1000)
+	}
+}
+
+void concurrentDeleteThread(BTreeIndex * index, int threadNum)
+{
+	// every thread deletes its own share of the keys that are left, in random order
+	std::vector<int> keys;
+	for(int key = threadNum; key < relationSize; key += numInsertThreads)
+	{
+		bool deleted = (key >= 1001 && key < 300000 && key % 2 == 1);
+		if(key % 1000 != 0 && !deleted) keys.push_back(key);
+	}
+	std::mt19937 generator(threadNum);
+	std::shuffle(keys.begin(), keys.end(), generator);
+
+	for(size_t i = 0; i < keys.size(); i++)
+	{
+		index->deleteEntry(&keys[i]);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// dupTests
+// -----------------------------------------------------------------------------
+
+void dupTests()
+{
+  std::cout << "Duplicate keys in a B+ Tree index on the integer field" << std::endl;
+	// rids past the relation, key 500 gets enough of them to need several posting list pages
+	const int manyRids = 1500;
+
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+		RecordId keyRid;
+		for(int key = 999; key >= 0; key--)
+		{
+			keyRid.page_number = relationSize + key;
+			keyRid.slot_number = 1;
+			index.insertEntry(&key, keyRid);
+		}
+		int key = 500;
+		for(int j = manyRids - 1; j >= 0; j--)
+		{
+			keyRid.page_number = 2 * relationSize + j / 3;
+			keyRid.slot_number = 1 + j % 3;
+			index.insertEntry(&key, keyRid);
+		}
+		checkPassFail(intCount(&index, 0, GTE, 1000, LT), 2000 + manyRids)
+		checkPassFail(intRidOrderCount(&index, 500, 1), manyRids + 2)
+		checkPassFail(intRidOrderCount(&index, 500, 7), manyRids + 2)
+		checkPassFail(intRidOrderCount(&index, 501, 1000), 2)
+
+		// only the exact same key and rid is a duplicate
+		int thrown = 0;
+		try
+		{
+			index.insertEntry(&key, keyRid);
+		}
+		catch(DuplicateKeyException e)
+		{
+			thrown = 1;
+		}
+		checkPassFail(thrown, 1)
+
+		for(int j = 0; j < manyRids; j++)
+		{
+			keyRid.page_number = 2 * relationSize + j / 3;
+			keyRid.slot_number = 1 + j % 3;
+			index.deleteEntry(&key, keyRid);
+		}
+		keyRid.page_number = relationSize + key;
+		keyRid.slot_number = 1;
+		index.deleteEntry(&key, keyRid);
+		checkPassFail(intRidOrderCount(&index, 500, 1), 1)
+
+		thrown = 0;
+		try
+		{
+			index.deleteEntry(&key, keyRid);
+		}
+		catch(NoSuchKeyFoundException e)
+		{
+			thrown = 1;
+		}
+		checkPassFail(thrown, 1)
+
+		key = 501;
+		index.deleteEntry(&key);
+		checkPassFail(intCount(&index, 0, GTE, 1000, LT), 1997)
+	}
+
+	// a bulk load puts the rids of every key of a relation with many records per key in posting lists
+	std::string dupRelationName = "relDup";
+	std::string dupIndexName;
+	try
+	{
+		File::remove(dupRelationName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	{
+		PageFile dupFile(dupRelationName, true);
+		PageId pageNo;
+		Page page = dupFile.allocatePage(pageNo);
+		for(int i = 0; i < 20000; i++)
+		{
+			record1.i = i % 100;
+			std::string data(reinterpret_cast<char*>(&record1), sizeof(record1));
+			while(1)
+			{
+				try
+				{
+					page.insertRecord(data);
+					break;
+				}
+				catch(InsufficientSpaceException e)
+				{
+					dupFile.writePage(pageNo, page);
+					page = dupFile.allocatePage(pageNo);
+				}
+			}
+		}
+		dupFile.writePage(pageNo, page);
+	}
+	{
+		BTreeIndex index(dupRelationName, dupIndexName, bufMgr, offsetof(tuple,i), INTEGER, BULK_LOAD);
+		checkPassFail(intCount(&index, 0, GTE, 100, LT), 20000)
+		checkPassFail(intRidOrderCount(&index, 7, 64), 200)
+
+		// every key has the same number of rids, which the distinct count gives any one of them
+		int key = 7;
+		checkPassFail((fabs(index.estimateRange(&key, GTE, &key, LTE) - 200) < 20), true)
+	}
+	File::remove(dupIndexName);
+	File::remove(dupRelationName);
+}
+
+int intRidOrderCount(BTreeIndex * index, int key, size_t batchSize)
+{
+	// the rids of one key, in batches, have to come in increasing order
+	std::vector<RecordId> rids(batchSize);
+	int numResults = 0;
+	int outOfOrder = 0;
+	RecordId lastRid;
+
+	try
+	{
+  	index->startScan(&key, GTE, &key, LTE);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+		return 0;
+	}
+
+	size_t numRids;
+	while((numRids = index->scanNextBatch(&rids[0], batchSize)) > 0)
+	{
+		for(size_t i = 0; i < numRids; i++)
+		{
+			if(numResults > 0 && !ridLess(lastRid, rids[i])) outOfOrder++;
+			lastRid = rids[i];
+			numResults++;
+		}
+	}
+
+  index->endScan();
+	return outOfOrder == 0 ? numResults : -1;
+}
+
+int intCount(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+	// the inserted keys do not point at records of the relation, so only count them
+  RecordId scanRid;
+  int numResults = 0;
+
+	try
+	{
+  	index->startScan(&lowVal, lowOp, &highVal, highOp);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+		return 0;
+	}
+
+	while(1)
+	{
+		try
+		{
+			index->scanNext(scanRid);
+		}
+		catch(IndexScanCompletedException e)
+		{
+			break;
+		}
+		numResults++;
+	}
+
+  index->endScan();
+	return numResults;
+}
+
+void concurrentScanThread(BTreeIndex * index, int * badScans)
+{
+	// scans on cursors of their own run next to the ones started by the main thread
+	for(int i = 0; i < 20; i++)
+	{
+		if(intCursorCount(index, relationSize / 2, GTE, relationSize, LT) != relationSize / 2) (*badScans)++;
+	}
+}
+
+int intCursorCount(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+  RecordId scanRid;
+  int numResults = 0;
+	ScanCursor *cursor;
+
+	try
+	{
+		cursor = index->openScan(&lowVal, lowOp, &highVal, highOp);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+		return 0;
+	}
+
+	while(1)
+	{
+		try
+		{
+			cursor->scanNext(scanRid);
+		}
+		catch(IndexScanCompletedException e)
+		{
+			break;
+		}
+		numResults++;
+	}
+
+	delete cursor;
+	return numResults;
+}
+
+int intBatchCount(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp, size_t batchSize)
+{
+	// the rids come in batches, every one of them has to be found in the relation with the right key
+  std::cout << "Scan for " << (lowOp == GT ? "(" : "[") << lowVal << "," << highVal << (highOp == LT ? ")" : "]")
+		<< " in batches of " << batchSize << std::endl;
+	std::vector<RecordId> rids(batchSize);
+	Page *curPage;
+	int numResults = 0;
+	int badKeys = 0;
+
+	try
+	{
+  	index->startScan(&lowVal, lowOp, &highVal, highOp);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+		return 0;
+	}
+
+	size_t numRids;
+	while((numRids = index->scanNextBatch(&rids[0], batchSize)) > 0)
+	{
+		for(size_t i = 0; i < numRids; i++)
+		{
+			RECORD myRec;
+			{
+				std::lock_guard<std::mutex> guard(bufMgrLatch);
+				bufMgr->readPage(file1, rids[i].page_number, curPage);
+				myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(rids[i]).data()));
+				bufMgr->unPinPage(file1, rids[i].page_number, false);
+			}
+
+			// keys come out in increasing order
+			if(myRec.i != (lowOp == GT ? lowVal + 1 : lowVal) + numResults) badKeys++;
+			numResults++;
+		}
+	}
+
+  index->endScan();
+  std::cout << "Number of results: " << numResults << std::endl << std::endl;
+	return badKeys == 0 ? numResults : -1;
+}
+
+int intJoinCount(BTreeIndex * index, int outerHigh, int innerHigh)
+{
+	// nested loop join of the index with itself, the inner scan is opened again for every outer entry
+	// while the outer one stays open
+  std::cout << "Join [0," << outerHigh << ") with [0," << innerHigh << ") on two cursors" << std::endl;
+	RecordId outerRid;
+	int low = 0;
+	int numResults = 0;
+
+	ScanCursor *outer = index->openScan(&low, GTE, &outerHigh, LT);
+	while(1)
+	{
+		try
+		{
+			outer->scanNext(outerRid);
+		}
+		catch(IndexScanCompletedException e)
+		{
+			break;
+		}
+		numResults += intCursorCount(index, 0, GTE, innerHigh, LT);
+	}
+	delete outer;
+
+  std::cout << "Number of results: " << numResults << std::endl << std::endl;
+	return numResults;
+}
+
+// -----------------------------------------------------------------------------
+// readAheadTests
+// -----------------------------------------------------------------------------
+
+void readAheadTests()
+{
+  std::cout << "Scan a B+ Tree index on the integer field reading leaves ahead" << std::endl;
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, BULK_LOAD);
+	index.setReadAhead(8);
+
+	checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+	checkPassFail(intCount(&index, 0, GTE, relationSize, LT), relationSize)
+	checkPassFail(intBatchCount(&index,0,GTE,relationSize,LT,1000), relationSize)
+	ReadAheadStats stats = index.getReadAheadStats();
+	checkPassFail((stats.hits > 0), 1)
+
+	// a cursor given up halfway through drops the leaves it had read ahead
+	int lowVal = 0;
+	int highVal = relationSize;
+	ScanCursor *cursor = index.openScan(&lowVal, GTE, &highVal, LT);
+	RecordId scanRid;
+	for(int i = 0; i < relationSize / 2; i++)
+	{
+		cursor->scanNext(scanRid);
+	}
+	delete cursor;
+
+	// splits move the leaves around under the leaves read ahead
+	std::vector<std::thread> threads;
+	for(int t = 0; t < numInsertThreads; t++)
+	{
+		threads.push_back(std::thread(concurrentInsertThread, &index, t));
+	}
+	int badScans = 0;
+	std::thread cursorThread(concurrentScanThread, &index, &badScans);
+	for(int i = 0; i < 10; i++)
+	{
+		if(intCount(&index, 0, GTE, relationSize, LT) != relationSize) badScans++;
+	}
+	for(int t = 0; t < numInsertThreads; t++)
+	{
+		threads[t].join();
+	}
+	cursorThread.join();
+
+	checkPassFail(badScans, 0)
+	checkPassFail(intCount(&index, 0, GTE, relationSize + concurrentInserts, LT), relationSize + concurrentInserts)
+
+	index.setReadAhead(0);
+	checkPassFail(intCount(&index, relationSize, GTE, relationSize + concurrentInserts, LT), concurrentInserts)
+}
+
+// -----------------------------------------------------------------------------
+// mappedTests
+// -----------------------------------------------------------------------------
+
+void mappedTests()
+{
+  std::cout << "Reopen a B+ Tree index on the integer field read-only, mapped into memory" << std::endl;
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, BULK_LOAD);
+	}
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, INSERT_BUILD, 1.0, LATCH_COUPLING, MERGE_ON_UNDERFLOW, 1, READ_ONLY_MAPPED);
+
+	checkPassFail(intScan(&index,25,GT,40,LT), 14)
+	checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+	checkPassFail(intCount(&index, 0, GTE, relationSize, LT), relationSize)
+	checkPassFail(intCursorCount(&index, 1000, GTE, 2000, LT), 1000)
+	checkPassFail(intBatchCount(&index,0,GTE,relationSize,LT,1000), relationSize)
+
+	// nothing can be changed through the mapping
+	int key = relationSize;
+	RecordId keyRid;
+	keyRid.page_number = 1;
+	keyRid.slot_number = 1;
+	int thrown = 0;
+	try
+	{
+		index.insertEntry(&key, keyRid);
+	}
+	catch(ReadOnlyIndexException e)
+	{
+		thrown++;
+	}
+	key = 0;
+	try
+	{
+		index.deleteEntry(&key);
+	}
+	catch(ReadOnlyIndexException e)
+	{
+		thrown++;
+	}
+	checkPassFail(thrown, 2)
+	checkPassFail(intCount(&index, 0, GTE, 1, LT), 1)
+
+	// the meta page is checked the same way as through the buffer manager
+	thrown = 0;
+	try
+	{
+		BTreeIndex wrongIndex(relationName, intIndexName, bufMgr, offsetof(tuple,i), DOUBLE, INSERT_BUILD, 1.0, LATCH_COUPLING, MERGE_ON_UNDERFLOW, 1, READ_ONLY_MAPPED);
+	}
+	catch(BadIndexInfoException e)
+	{
+		thrown = 1;
+	}
+	checkPassFail(thrown, 1)
+
+	// an index grown by inserts through the buffer manager, with its pages in the order they were allocated, reads
+	// back rid for rid through the mapping of its BlobFile
+	double lowVal = 1000;
+	double highVal = 250000;
+	std::vector<RecordId> buffered;
+	std::vector<RecordId> mapped;
+	RecordId rids[1000];
+	size_t found;
+	{
+		BTreeIndex doubleIndex(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE, INSERT_BUILD);
+		ScanCursor *cursor = doubleIndex.openScan(&lowVal, GTE, &highVal, LT);
+		while((found = cursor->scanNextBatch(rids, 1000)) > 0) buffered.insert(buffered.end(), rids, rids + found);
+		delete cursor;
+	}
+	{
+		BTreeIndex doubleIndex(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE, INSERT_BUILD, 1.0, LATCH_COUPLING, MERGE_ON_UNDERFLOW, 1, READ_ONLY_MAPPED);
+		ScanCursor *cursor = doubleIndex.openScan(&lowVal, GTE, &highVal, LT);
+		while((found = cursor->scanNextBatch(rids, 1000)) > 0) mapped.insert(mapped.end(), rids, rids + found);
+		delete cursor;
+		checkPassFail(doubleScan(&doubleIndex,25,GT,40,LT), 14)
+	}
+	File::remove(doubleIndexName);
+	checkPassFail((int) buffered.size(), (int) (highVal - lowVal))
+	checkPassFail((buffered == mapped), true)
+}
+
+// -----------------------------------------------------------------------------
+// walTests
+// -----------------------------------------------------------------------------
+
+void walTests()
+{
+  std::cout << "Recover a B+ Tree index on the integer field from its write-ahead log after a crash" << std::endl;
+	// keys inserted by the crashed processes, above any the other tests use
+	const int firstInsert = relationSize + concurrentInserts;
+	const int manyRids = 1500;
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, BULK_LOAD, 1.0, LATCH_COUPLING, MERGE_ON_UNDERFLOW, 1, READ_WRITE_LOGGED);
+	}
+	checkPassFail(File::exists(intIndexName + LOGFILESUFFIX), false)
+
+	// splits, posting lists and merges, then the process dies with whatever the buffer manager has not written out
+	walCrash(LATCH_COUPLING);
+
+	// the log has to be replayed before the file can be mapped
+	int thrown = 0;
+	try
+	{
+		BTreeIndex mappedIndex(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, INSERT_BUILD, 1.0, LATCH_COUPLING, MERGE_ON_UNDERFLOW, 1, READ_ONLY_MAPPED);
+	}
+	catch(BadIndexInfoException e)
+	{
+		thrown = 1;
+	}
+	checkPassFail(thrown, 1)
+
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(intCount(&index, 0, GTE, firstInsert + 20000, LT), relationSize - 100000 + manyRids + 20000)
+		checkPassFail(intCount(&index, 500, GTE, 500, LTE), manyRids + 1)
+		checkPassFail(intScan(&index,99990,GTE,200010,LT), 20)
+		checkPassFail(intCount(&index, firstInsert, GTE, firstInsert + 20000, LT), 20000)
+	}
+	checkPassFail(File::exists(intIndexName + LOGFILESUFFIX), false)
+
+	// inserts from several threads at once, which commit together
+	walCrash(B_LINK);
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+	checkPassFail(intCount(&index, relationSize, GTE, firstInsert, LT), concurrentInserts)
+	checkPassFail(intCount(&index, 0, GTE, firstInsert + 20000, LT), relationSize - 100000 + manyRids + 20000 + concurrentInserts)
+}
+
+void walCrash(const ConcurrencyMode concurrencyMode)
+{
+	pid_t pid = fork();
+	if(pid == 0)
+	{
+		BTreeIndex * index = new BTreeIndex(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, INSERT_BUILD, 1.0,
+			concurrencyMode, MERGE_ON_UNDERFLOW, 1, READ_WRITE_LOGGED);
+		if(concurrencyMode == B_LINK)
+		{
+			std::vector<std::thread> threads;
+			for(int t = 0; t < numInsertThreads; t++)
+			{
+				threads.push_back(std::thread(concurrentInsertThread, index, t));
+			}
+			for(int t = 0; t < numInsertThreads; t++)
+			{
+				threads[t].join();
+			}
+		}
+		else
+		{
+			RecordId keyRid;
+			for(int key = relationSize + concurrentInserts; key < relationSize + concurrentInserts + 20000; key++)
+			{
+				keyRid.page_number = key;
+				keyRid.slot_number = 1;
+				index->insertEntry(&key, keyRid);
+			}
+			int key = 500;
+			for(int j = 0; j < 1500; j++)
+			{
+				keyRid.page_number = 2 * relationSize + j;
+				keyRid.slot_number = 1;
+				index->insertEntry(&key, keyRid);
+			}
+			for(key = 100000; key < 200000; key++)
+			{
+				index->deleteEntry(&key);
+			}
+		}
+		// no destructor, nothing is written out that the buffer manager has not written out already
+		_exit(0);
+	}
+
+	int status = -1;
+	waitpid(pid, &status, 0);
+	checkPassFail(status, 0)
+	checkPassFail(File::exists(intIndexName + LOGFILESUFFIX), true)
+}
+
+// -----------------------------------------------------------------------------
+// walCheckpointTests
+// -----------------------------------------------------------------------------
+
+void walCheckpointTests()
+{
+  std::cout << "Keep the write-ahead log of a B+ Tree index on the integer field bounded while inserting" << std::endl;
+	const std::string logName = intIndexName + LOGFILESUFFIX;
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, BULK_LOAD, 1.0, LATCH_COUPLING, MERGE_ON_UNDERFLOW, 1, READ_WRITE_LOGGED);
+
+	// keys above the relation all over the leaves being split, until the log has been emptied twice
+	int inserted = 0;
+	int checkpoints = 0;
+	off_t logSize = 0;
+	off_t maxLogSize = 0;
+	RecordId keyRid;
+	while(checkpoints < 2 && inserted < relationSize)
+	{
+		int key = relationSize + (int) (((long long) inserted * 7919) % relationSize);
+		keyRid.page_number = key;
+		keyRid.slot_number = 1;
+		index.insertEntry(&key, keyRid);
+		inserted++;
+
+		struct stat logStat;
+		stat(logName.c_str(), &logStat);
+		if(logStat.st_size < logSize) checkpoints++;
+		logSize = logStat.st_size;
+		maxLogSize = std::max(maxLogSize, logSize);
+	}
+	checkPassFail(checkpoints, 2)
+	// one insert past the limit splits at most a page on every level and the root
+	checkPassFail((maxLogSize < (off_t) (CHECKPOINTLOGSIZE + 16 * Page::SIZE)), true)
+	checkPassFail(intCount(&index, relationSize, GTE, 2 * relationSize, LT), inserted)
+	checkPassFail(intCount(&index, 0, GTE, relationSize, LT), relationSize)
+}
+
+// -----------------------------------------------------------------------------
+// countTests
+// -----------------------------------------------------------------------------
+
+void countTests(BuildMethod buildMethod)
+{
+  std::cout << "Count ranges of a B+ Tree index on the integer field with subtree counts" << (buildMethod == BULK_LOAD ? ", bulk loaded" : "") << std::endl;
+	const int manyRids = 1500;
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, buildMethod, 1.0, B_LINK, MERGE_ON_UNDERFLOW, 1, READ_WRITE, SUBTREE_COUNTS);
+		int lowVal = 0;
+		int highVal = relationSize;
+		checkPassFail(index.countRange(&lowVal, GTE, &highVal, LT), relationSize)
+		checkPassFail(intCountMismatches(&index, relationSize), 0)
+
+		// the counts of a range outside of the concurrent inserts stay exact while they go on
+		std::vector<std::thread> threads;
+		for(int t = 0; t < numInsertThreads; t++)
+		{
+			threads.push_back(std::thread(concurrentInsertThread, &index, t));
+		}
+		int badCounts = 0;
+		for(int i = 0; i < 20; i++)
+		{
+			if(index.countRange(&lowVal, GTE, &highVal, LT) != relationSize) badCounts++;
+		}
+		for(int t = 0; t < numInsertThreads; t++)
+		{
+			threads[t].join();
+		}
+		checkPassFail(badCounts, 0)
+		highVal = relationSize + concurrentInserts;
+		checkPassFail(index.countRange(&lowVal, GTE, &highVal, LT), relationSize + concurrentInserts)
+
+		// a posting list counts all of its rids, then merges move the counts of the leaves they empty
+		RecordId keyRid;
+		int key = 500;
+		for(int j = 0; j < manyRids; j++)
+		{
+			keyRid.page_number = 2 * relationSize + j;
+			keyRid.slot_number = 1;
+			index.insertEntry(&key, keyRid);
+		}
+		checkPassFail(intCountMismatches(&index, relationSize + concurrentInserts), 0)
+		for(key = 100000; key < 200000; key++)
+		{
+			index.deleteEntry(&key);
+		}
+		keyRid.page_number = 2 * relationSize;
+		key = 500;
+		index.deleteEntry(&key, keyRid);
+		key = 501;
+		index.deleteEntry(&key);
+		checkPassFail(intCountMismatches(&index, relationSize + concurrentInserts), 0)
+		checkPassFail(index.countRange(&lowVal, GTE, &highVal, LT), relationSize + concurrentInserts - 100000 + manyRids - 2)
+
+		key = 500;
+		index.deleteEntry(&key);
+		checkPassFail(intCountMismatches(&index, relationSize + concurrentInserts), 0)
+	}
+
+	// the file keeps counting whatever it is opened with
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(intCountMismatches(&index, relationSize + concurrentInserts), 0)
+		for(int key = 100000; key < 150000; key++)
+		{
+			RecordId keyRid;
+			keyRid.page_number = key;
+			keyRid.slot_number = 1;
+			index.insertEntry(&key, keyRid);
+		}
+		checkPassFail(intCountMismatches(&index, relationSize + concurrentInserts), 0)
+	}
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, INSERT_BUILD, 1.0, LATCH_COUPLING, MERGE_ON_UNDERFLOW, 1, READ_ONLY_MAPPED);
+		checkPassFail(intCountMismatches(&index, relationSize + concurrentInserts), 0)
+	}
+	File::remove(intIndexName);
+
+	// without counts the range is scanned
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, buildMethod);
+	checkPassFail(intCountMismatches(&index, relationSize), 0)
+
+	int lowVal = 10;
+	int highVal = 5;
+	int thrown = 0;
+	try
+	{
+		index.countRange(&lowVal, GTE, &highVal, LT);
+	}
+	catch(BadScanrangeException e)
+	{
+		thrown++;
+	}
+	try
+	{
+		index.countRange(&highVal, LT, &lowVal, GT);
+	}
+	catch(BadOpcodesException e)
+	{
+		thrown++;
+	}
+	checkPassFail(thrown, 2)
+}
+
+int intCountMismatches(BTreeIndex * index, int highVal)
+{
+	// ranges ending inside and outside of leaves, on keys that are there and that are not, against scans of them
+	const int ranges[][4] = {
+		{0, GTE, highVal, LT}, {-10, GT, highVal + 10, LTE}, {25, GT, 40, LT}, {25, GTE, 40, LTE},
+		{500, GTE, 500, LTE}, {500, GT, 500, LTE}, {499, GTE, 501, LTE}, {99990, GTE, 200010, LT},
+		{150000, GT, 150000, LT}, {highVal - 5, GTE, highVal + 5, LT}};
+	int mismatches = 0;
+	for(size_t r = 0; r < sizeof(ranges) / sizeof(ranges[0]); r++)
+	{
+		int lowVal = ranges[r][0];
+		int high = ranges[r][2];
+		if((int) index->countRange(&lowVal, (Operator) ranges[r][1], &high, (Operator) ranges[r][3]) != intCount(index, lowVal, (Operator) ranges[r][1], high, (Operator) ranges[r][3])) mismatches++;
+	}
+
+	std::mt19937 generator(highVal);
+	std::uniform_int_distribution<int> keys(0, highVal);
+	for(int r = 0; r < 50; r++)
+	{
+		int lowVal = keys(generator);
+		int high = lowVal + keys(generator) / (1 + r);
+		if((int) index->countRange(&lowVal, GTE, &high, LT) != intCount(index, lowVal, GTE, high, LT)) mismatches++;
+	}
+	return mismatches;
+}
+
+// -----------------------------------------------------------------------------
+// lookupTests
+// -----------------------------------------------------------------------------
+
+void lookupTests()
+{
+  std::cout << "Point lookups in a B+ Tree index on the integer field" << std::endl;
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, BULK_LOAD, 1.0, B_LINK);
+
+		// lookups leave the scan of startScan where it was
+		int lowVal = 25;
+		int highVal = 40;
+		index.startScan(&lowVal, GT, &highVal, LT);
+		checkPassFail(intLookupMismatches(&index), 0)
+		int numResults = 0;
+		try
+		{
+			RecordId scanRid;
+			while(1)
+			{
+				index.scanNext(scanRid);
+				numResults++;
+			}
+		}
+		catch(IndexScanCompletedException e)
+		{
+		}
+		index.endScan();
+		checkPassFail(numResults, 14)
+
+		// a key with more rids gives the first of them
+		RecordId keyRid;
+		int key = 500;
+		for(int j = 0; j < 1500; j++)
+		{
+			keyRid.page_number = 2 * relationSize + j;
+			keyRid.slot_number = 1;
+			index.insertEntry(&key, keyRid);
+		}
+		RecordId firstRid;
+		checkPassFail(intRidOrderCount(&index, 500, 1), 1501)
+		index.startScan(&key, GTE, &key, LTE);
+		index.scanNext(firstRid);
+		index.endScan();
+		checkPassFail(index.lookup(&key, keyRid), true)
+		checkPassFail((keyRid == firstRid), true)
+
+		// missing keys are no exception, found or not every slot of a batch is set
+		int keys[] = { -1, 0, relationSize, 500, relationSize - 1, 700 };
+		const void* keyPtrs[6];
+		RecordId rids[6];
+		bool found[6];
+		for(int i = 0; i < 6; i++)
+		{
+			keyPtrs[i] = &keys[i];
+		}
+		key = 700;
+		index.deleteEntry(&key);
+		checkPassFail(index.lookup(&key, keyRid), false)
+		checkPassFail(index.lookupBatch(keyPtrs, 6, rids, found), 3)
+		checkPassFail((found[0] || found[2] || found[5]), false)
+		checkPassFail((found[1] && found[3] && found[4]), true)
+		checkPassFail((rids[3] == firstRid), true)
+	}
+
+	// the same through the mapping, where only the key deleted is missing
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, INSERT_BUILD, 1.0, LATCH_COUPLING, MERGE_ON_UNDERFLOW, 1, READ_ONLY_MAPPED);
+	checkPassFail(intLookupMismatches(&index), 1)
+}
+
+// -----------------------------------------------------------------------------
+// statisticsTests
+// -----------------------------------------------------------------------------
+
+void statisticsTests()
+{
+  std::cout << "Estimate ranges of a B+ Tree index on the integer field from the statistics of its build" << std::endl;
+	int lowVal = relationSize / 4;
+	int highVal = 3 * relationSize / 4;
+	double estimate;
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, BULK_LOAD);
+
+		// half the keys are between the quartiles and all of them in a range around them
+		estimate = index.estimateRange(&lowVal, GTE, &highVal, LT);
+		checkPassFail((fabs(estimate - relationSize / 2) < relationSize / 50), true)
+		int lowest = -1;
+		int highest = relationSize;
+		checkPassFail(index.estimateRange(&lowest, GT, &highest, LT), relationSize)
+
+		// a single key has as many rids as the average key, a range past the keys none
+		int key = 1000;
+		double keyEstimate = index.estimateRange(&key, GTE, &key, LTE);
+		checkPassFail((keyEstimate > 0.9 && keyEstimate < 1.1), true)
+		checkPassFail(index.estimateRange(&highest, GTE, &highest, LTE), 0)
+		lowest = -100;
+		highest = -1;
+		checkPassFail(index.estimateRange(&lowest, GTE, &highest, LTE), 0)
+
+		// keys inserted after the build are not in the statistics
+		for(key = relationSize; key < relationSize + 1000; key++)
+		{
+			RecordId keyRid;
+			keyRid.page_number = key;
+			keyRid.slot_number = 1;
+			index.insertEntry(&key, keyRid);
+		}
+		lowest = relationSize;
+		highest = relationSize + 1000;
+		checkPassFail(index.estimateRange(&lowest, GTE, &highest, LT), 0)
+		checkPassFail(intCount(&index, relationSize, GTE, relationSize + 1000, LT), 1000)
+
+		int thrown = 0;
+		try
+		{
+			index.estimateRange(&highVal, GTE, &lowVal, LT);
+		}
+		catch(BadScanrangeException e)
+		{
+			thrown = 1;
+		}
+		checkPassFail(thrown, 1)
+	}
+
+	// the statistics are kept in the file
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, INSERT_BUILD);
+		checkPassFail((index.estimateRange(&lowVal, GTE, &highVal, LT) == estimate), true)
+	}
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, INSERT_BUILD, 1.0, LATCH_COUPLING, MERGE_ON_UNDERFLOW, 1, READ_ONLY_MAPPED);
+		checkPassFail((index.estimateRange(&lowVal, GTE, &highVal, LT) == estimate), true)
+	}
+	File::remove(intIndexName);
+
+	// a relation without records leaves no buckets, whichever way the index is built
+	const std::string emptyRelationName = "relEmpty";
+	{
+		PageFile emptyRelation = PageFile::create(emptyRelationName);
+	}
+	for(int bulk = 0; bulk < 2; bulk++)
+	{
+		std::string emptyIndexName;
+		{
+			BTreeIndex index(emptyRelationName, emptyIndexName, bufMgr, offsetof(tuple,i), INTEGER, bulk ? BULK_LOAD : INSERT_BUILD);
+			checkPassFail(index.estimateRange(&lowVal, GTE, &highVal, LT), 0)
+		}
+		File::remove(emptyIndexName);
+	}
+	File::remove(emptyRelationName);
+
+	// an insert build collects them the same way
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, INSERT_BUILD);
+	estimate = index.estimateRange(&lowVal, GTE, &highVal, LT);
+	checkPassFail((fabs(estimate - relationSize / 2) < relationSize / 50), true)
+}
+
+// -----------------------------------------------------------------------------
+// parallelBuildTests
+// -----------------------------------------------------------------------------
+
+void parallelBuildTests()
+{
+  std::cout << "Create a B+ Tree index on the integer field by bulk loading it from several threads" << std::endl;
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, BULK_LOAD, 0.8, LATCH_COUPLING, MERGE_ON_UNDERFLOW, 1, READ_WRITE, UNCOUNTED, 4);
+
+		// the pages the threads took are merged back into one key order
+		checkPassFail(intScan(&index,25,GT,40,LT), 14)
+		checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+		checkPassFail(intBatchCount(&index,0,GTE,relationSize,LT,1000), relationSize)
+		checkPassFail(intLookupMismatches(&index), 0)
+
+		// the statistics of the threads are merged as well
+		int lowVal = relationSize / 4;
+		int highVal = 3 * relationSize / 4;
+		double estimate = index.estimateRange(&lowVal, GTE, &highVal, LT);
+		checkPassFail((fabs(estimate - relationSize / 2) < relationSize / 50), true)
+	}
+	File::remove(intIndexName);
+
+	// one thread per hardware thread, and counted subtrees
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, BULK_LOAD, 1.0, LATCH_COUPLING, MERGE_ON_UNDERFLOW, 1, READ_WRITE, SUBTREE_COUNTS, HARDWARETHREADS);
+	checkPassFail(intBatchCount(&index,300,GT,400,LTE,7), 100)
+	checkPassFail(intCountMismatches(&index, relationSize), 0)
+}
+
+// -----------------------------------------------------------------------------
+// statsTests
+// -----------------------------------------------------------------------------
+
+void statsTests()
+{
+  std::cout << "Counters of a B+ Tree index on the integer field" << std::endl;
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, INSERT_BUILD);
+
+	// the shape of the tree does not depend on the counters being compiled in
+	IndexStats stats = index.getStats();
+	checkPassFail((stats.treeHeight >= 2), true)
+	checkPassFail(stats.numLeaves, -1)
+	IndexStats walked = index.getStats(true);
+	checkPassFail(walked.treeHeight, stats.treeHeight)
+	checkPassFail((walked.numLeaves > 1 && walked.leafFill > 0.4 && walked.leafFill <= 1), true)
+
+#ifdef BADGERDB_INDEX_STATS
+	// the build went through insertEntry once for every record and split its way up from one leaf
+	checkPassFail(stats.latencies[INSERT_LATENCY].count(), (unsigned long long) relationSize)
+	checkPassFail(stats.leafSplits, (unsigned long long) walked.numLeaves - 1)
+	checkPassFail(stats.rootSplits, (unsigned long long) stats.treeHeight - 2)
+	checkPassFail((stats.nodeSearches > 0 && stats.keyComparisons >= stats.nodeSearches), true)
+	checkPassFail((stats.latencies[INSERT_LATENCY].percentile(0.5) <= stats.latencies[INSERT_LATENCY].percentile(0.99)), true)
+
+	// a lookup reads and unpins the same pages, walking the leaves did not count
+	RecordId rid;
+	int key = 1000;
+	checkPassFail(index.lookup(&key, rid), true)
+	IndexStats after = index.getStats();
+	checkPassFail(after.lookups, stats.lookups + 1)
+	checkPassFail((after.pageReads > stats.pageReads), true)
+	checkPassFail(after.pageReads - stats.pageReads, after.pageUnpins - stats.pageUnpins)
+
+	// every scanNext is timed, the one that finds the scan completed as well
+	checkPassFail(intScan(&index,25,GT,40,LT), 14)
+	IndexStats scanned = index.getStats();
+	checkPassFail(scanned.latencies[STARTSCAN_LATENCY].count(), 1ULL)
+	checkPassFail(scanned.latencies[SCANNEXT_LATENCY].count(), 15ULL)
+
+	// counters of other threads are added in
+	std::thread lookupThread([&index]() {
+		RecordId threadRid;
+		for(int k = 0; k < 100; k++) index.lookup(&k, threadRid);
+	});
+	lookupThread.join();
+	checkPassFail(index.getStats().lookups, scanned.lookups + 100)
+#endif
+}
+
+// -----------------------------------------------------------------------------
+// heapOrderTests
+// -----------------------------------------------------------------------------
+
+void heapOrderTests()
+{
+  std::cout << "Scan a B+ Tree index on the integer field in heap order" << std::endl;
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, BULK_LOAD, 0.8);
+
+	// sorted in memory, spilled to a few runs, and spilled to more runs than are merged in one pass
+	checkPassFail(intHeapOrderCount(&index,25,GT,40,LT,HEAPORDERSCANRIDS), 14)
+	checkPassFail(intHeapOrderCount(&index,3000,GTE,4000,LT,300), 1000)
+	checkPassFail(intHeapOrderCount(&index,0,GTE,relationSize,LT,relationSize / (2 * BULKLOADMERGEFANIN + 1)), relationSize)
+	checkPassFail(intHeapOrderCount(&index,-10,GT,-1,LT,HEAPORDERSCANRIDS), 0)
+
+	// the runs are removed with the cursor
+	checkPassFail(File::exists(intIndexName + ".rids1"), false)
+	checkPassFail(File::exists(intIndexName + ".rids2"), false)
+
+	// single rids and batches come in the same order whether the rids were spilled or not
+	int lowVal = 1000;
+	int highVal = 9000;
+	HeapOrderCursor *inMemory = index.openHeapOrderScan(&lowVal, GTE, &highVal, LT);
+	HeapOrderCursor *spilled = index.openHeapOrderScan(&lowVal, GTE, &highVal, LT, 500);
+	RecordId rids[7];
+	int numRids = 0;
+	int mismatches = 0;
+	size_t found;
+	while((found = spilled->scanNextBatch(rids, 7)) > 0)
+	{
+		for(size_t i = 0; i < found; i++)
+		{
+			RecordId scanRid;
+			inMemory->scanNext(scanRid);
+			if(!(scanRid == rids[i])) mismatches++;
+			numRids++;
+		}
+	}
+	delete inMemory;
+	delete spilled;
+	checkPassFail(mismatches, 0)
+	checkPassFail(numRids, highVal - lowVal)
+}
+
+int intHeapOrderCount(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp, size_t memoryRids)
+{
+	// every page of the relation with a rid comes once and in file order, its rids in slot order and all in range
+  std::cout << "Scan for " << (lowOp == GT ? "(" : "[") << lowVal << "," << highVal << (highOp == LT ? ")" : "]")
+		<< " in heap order, sorting " << memoryRids << " rids at a time" << std::endl;
+	HeapOrderCursor *cursor;
+
+	try
+	{
+		cursor = index->openHeapOrderScan(&lowVal, lowOp, &highVal, highOp, memoryRids);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+		return 0;
+	}
+
+	// room for every rid of a page, so a page never takes two calls
+	std::vector<RecordId> rids(Page::SIZE);
+	Page *curPage;
+	PageId lastPageNo = 0;
+	int numResults = 0;
+	int badRids = 0;
+	size_t numRids;
+	while((numRids = cursor->scanNextPage(&rids[0], rids.size())) > 0)
+	{
+		if(rids[0].page_number <= lastPageNo) badRids++;
+		lastPageNo = rids[0].page_number;
+
+		std::lock_guard<std::mutex> guard(bufMgrLatch);
+		bufMgr->readPage(file1, lastPageNo, curPage);
+		for(size_t i = 0; i < numRids; i++)
+		{
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(rids[i]).data()));
+			if(i > 0 && rids[i].slot_number <= rids[i - 1].slot_number) badRids++;
+			if((lowOp == GT ? myRec.i <= lowVal : myRec.i < lowVal) || (highOp == LT ? myRec.i >= highVal : myRec.i > highVal)) badRids++;
 		}
-  	catch(FileNotFoundException e)
-  	{
-  	}
-  }
+		bufMgr->unPinPage(file1, lastPageNo, false);
+		numResults += numRids;
+	}
+
+	delete cursor;
+  std::cout << "Number of results: " << numResults << std::endl << std::endl;
+	return badRids == 0 ? numResults : -1;
 }
 
 // -----------------------------------------------------------------------------
-// intTests
+// includedTests
 // -----------------------------------------------------------------------------
 
-void intTests()
+void includedTests()
 {
-  std::cout << "Create a B+ Tree index on the integer field" << std::endl;
-  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+  std::cout << "Scan a B+ Tree index on the integer field for its keys and the double field included" << std::endl;
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, BULK_LOAD, 0.8, LATCH_COUPLING,
+			MERGE_ON_UNDERFLOW, 1, READ_WRITE, UNCOUNTED, 4, offsetof(tuple,d), sizeof(double));
+		checkPassFail(intEntryCount(&index,25,GT,40,LT,7,true), 14)
+		checkPassFail(intEntryCount(&index,0,GTE,relationSize,LT,1000,true), relationSize)
+
+		// a record whose key changed is inserted again with the bytes it was given
+		int key = 1000;
+		RecordId rid;
+		checkPassFail(index.lookup(&key, rid), true)
+		index.deleteEntry(&key);
+		int newKey = relationSize;
+		double newValue = relationSize;
+		index.insertEntry(&newKey, rid, &newValue);
+		checkPassFail(intEntryCount(&index,999,GTE,1001,LTE,10,true), 2)
+		checkPassFail(intEntryCount(&index,relationSize,GTE,relationSize,LTE,10,true), 1)
+	}
 
-	// run some tests
-	checkPassFail(intScan(&index,25,GT,40,LT), 14)
-	checkPassFail(intScan(&index,20,GTE,35,LTE), 16)
-	checkPassFail(intScan(&index,-3,GT,3,LT), 3)
-	checkPassFail(intScan(&index,996,GT,1001,LT), 4)
-	checkPassFail(intScan(&index,0,GT,1,LT), 0)
-	checkPassFail(intScan(&index,300,GT,400,LT), 99)
-	checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, INSERT_BUILD, 0.8, LATCH_COUPLING,
+			MERGE_ON_UNDERFLOW, 1, READ_WRITE, UNCOUNTED, 1, offsetof(tuple,d), sizeof(double));
+		checkPassFail(intEntryCount(&index,3000,GTE,4000,LT,256,true), 1000)
+		checkPassFail(intEntryCount(&index,relationSize,GTE,relationSize,LTE,10,true), 1)
+	}
+
+	// the bytes of a logged insert come back with its entry after a crash
+	pid_t pid = fork();
+	if(pid == 0)
+	{
+		BTreeIndex * index = new BTreeIndex(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, INSERT_BUILD, 0.8, LATCH_COUPLING,
+			MERGE_ON_UNDERFLOW, 1, READ_WRITE_LOGGED, UNCOUNTED, 1, offsetof(tuple,d), sizeof(double));
+		for(int key = 5000; key < 7000; key++)
+		{
+			RecordId keyRid;
+			index->lookup(&key, keyRid);
+			index->deleteEntry(&key);
+			int newKey = relationSize + key;
+			double newValue = newKey;
+			index->insertEntry(&newKey, keyRid, &newValue);
+		}
+		// no destructor, nothing is written out that the buffer manager has not written out already
+		_exit(0);
+	}
+	int status = -1;
+	waitpid(pid, &status, 0);
+	checkPassFail(status, 0)
+	checkPassFail(File::exists(intIndexName + LOGFILESUFFIX), true)
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, INSERT_BUILD, 0.8, LATCH_COUPLING,
+			MERGE_ON_UNDERFLOW, 1, READ_WRITE, UNCOUNTED, 1, offsetof(tuple,d), sizeof(double));
+		checkPassFail(intEntryCount(&index,relationSize + 5000,GTE,relationSize + 7000,LT,100,true), 2000)
+		checkPassFail(intEntryCount(&index,5000,GTE,7000,LT,100,true), 0)
+	}
+	File::remove(intIndexName);
+
+	// whole records fit as included columns, and follow their entries through splits
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, BULK_LOAD, 0.8, LATCH_COUPLING,
+			MERGE_ON_UNDERFLOW, 1, READ_WRITE, UNCOUNTED, 2, 0, sizeof(tuple));
+		for(int key = 0; key < 1000; key++)
+		{
+			RecordId keyRid;
+			index.lookup(&key, keyRid);
+			RECORD wide;
+			memset(&wide, 0, sizeof(RECORD));
+			wide.i = relationSize + key;
+			wide.d = (double) wide.i;
+			int newKey = wide.i;
+			index.insertEntry(&newKey, keyRid, &wide);
+		}
+		checkPassFail(wideEntryCount(&index,2000,GTE,3000,LT), 1000)
+		checkPassFail(wideEntryCount(&index,relationSize,GTE,relationSize + 1000,LT), 1000)
+	}
+	File::remove(intIndexName);
+
+	// the rows of included columns have to fit two to a page
+	int tooLong = 0;
+	try
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, INSERT_BUILD, 0.8, LATCH_COUPLING,
+			MERGE_ON_UNDERFLOW, 1, READ_WRITE, UNCOUNTED, 1, 0, Page::SIZE);
+	}
+	catch(BadIndexInfoException e)
+	{
+		tooLong = 1;
+	}
+	checkPassFail(tooLong, 1)
+
+	// an index without included columns still hands out its keys
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, INSERT_BUILD);
+	checkPassFail(intEntryCount(&index,300,GT,400,LTE,7,false), 100)
+
+	int lowVal = 0;
+	int highVal = 10;
+	RecordId rid;
+	int key;
+	double value;
+	int thrown = 0;
+	index.startScan(&lowVal, GTE, &highVal, LT);
+	try
+	{
+		index.scanNextEntries(&rid, &key, &value, 1);
+	}
+	catch(BadIndexInfoException e)
+	{
+		thrown = 1;
+	}
+	index.endScan();
+	checkPassFail(thrown, 1)
 }
 
-int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+int intEntryCount(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp, size_t batchSize, bool withIncluded)
 {
-  RecordId scanRid;
-	Page *curPage;
+	// the keys come in increasing order and within the range, the double field of every record with its key
+  std::cout << "Scan for the keys" << (withIncluded ? " and included columns" : "") << " of "
+		<< (lowOp == GT ? "(" : "[") << lowVal << "," << highVal << (highOp == LT ? ")" : "]")
+		<< " in batches of " << batchSize << std::endl;
+	std::vector<RecordId> rids(batchSize);
+	std::vector<int> keys(batchSize);
+	std::vector<double> values(batchSize);
+	int numResults = 0;
+	int badEntries = 0;
 
-  std::cout << "Scan for ";
-  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
-  std::cout << lowVal << "," << highVal;
-  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
-  std::cout << std::endl;
+	try
+	{
+  	index->startScan(&lowVal, lowOp, &highVal, highOp);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+		return 0;
+	}
+
+	size_t numEntries;
+	int lastKey = lowVal;
+	while((numEntries = index->scanNextEntries(&rids[0], &keys[0], withIncluded ? &values[0] : NULL, batchSize)) > 0)
+	{
+		for(size_t i = 0; i < numEntries; i++)
+		{
+			if(keys[i] < lastKey || (highOp == LT ? keys[i] >= highVal : keys[i] > highVal)) badEntries++;
+			if(lowOp == GT && keys[i] == lowVal) badEntries++;
+			if(withIncluded && values[i] != (double) keys[i]) badEntries++;
+			lastKey = keys[i];
+			numResults++;
+		}
+	}
+
+  index->endScan();
+  std::cout << "Number of results: " << numResults << std::endl << std::endl;
+	return badEntries == 0 ? numResults : -1;
+}
+
+int wideEntryCount(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+	// every key comes with the whole record it was inserted with
+  std::cout << "Scan for the keys and whole records of " << (lowOp == GT ? "(" : "[") << lowVal << "," << highVal
+		<< (highOp == LT ? ")" : "]") << std::endl;
+	const size_t batchSize = 64;
+	RecordId rids[batchSize];
+	int keys[batchSize];
+	RECORD records[batchSize];
+	int numResults = 0;
+	int badEntries = 0;
 
-  int numResults = 0;
-	
 	try
 	{
   	index->startScan(&lowVal, lowOp, &highVal, highOp);
 	}
 	catch(NoSuchKeyFoundException e)
 	{
-    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
 		return 0;
 	}
 
-	while(1)
+	size_t numEntries;
+	while((numEntries = index->scanNextEntries(rids, keys, records, batchSize)) > 0)
 	{
-		try
+		for(size_t i = 0; i < numEntries; i++)
 		{
-			index->scanNext(scanRid);
-			bufMgr->readPage(file1, scanRid.page_number, curPage);
-			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
-			bufMgr->unPinPage(file1, scanRid.page_number, false);
+			if(records[i].i != keys[i] || records[i].d != (double) keys[i]) badEntries++;
+			numResults++;
+		}
+	}
 
-			if( numResults < 5 )
-			{
-				std::cout << "at:" << scanRid.page_number << "," << scanRid.slot_number;
-				std::cout << " -->:" << myRec.i << ":" << myRec.d << ":" << myRec.s << ":" <<std::endl;
-			}
-			else if( numResults == 5 )
-			{
-				std::cout << "..." << std::endl;
-			}
+  index->endScan();
+  std::cout << "Number of results: " << numResults << std::endl << std::endl;
+	return badEntries == 0 ? numResults : -1;
+}
+
+// -----------------------------------------------------------------------------
+// descendingTests
+// -----------------------------------------------------------------------------
+
+void descendingTests()
+{
+  std::cout << "Scan a B+ Tree index on the integer field in descending order" << std::endl;
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, BULK_LOAD, 0.8);
+		checkPassFail(intDescendingCount(&index,25,GT,40,LT,1), 14)
+		checkPassFail(intDescendingCount(&index,25,GTE,40,LTE,7), 16)
+		checkPassFail(intDescendingCount(&index,0,GTE,relationSize,LT,1000), relationSize)
+		checkPassFail(intDescendingCount(&index,-10,GT,-1,LT,1), 0)
+
+		// scanNext returns the rids one at a time, from the high end down
+		int lowVal = 10;
+		int highVal = 12;
+		int mismatches = 0;
+		index.startScan(&lowVal, GTE, &highVal, LTE, DESCENDING);
+		for(int key = highVal; key >= lowVal; key--)
+		{
+			RecordId scanRid;
+			RecordId lookupRid;
+			index.scanNext(scanRid);
+			if(!index.lookup(&key, lookupRid) || !(scanRid == lookupRid)) mismatches++;
+		}
+		int thrown = 0;
+		try
+		{
+			RecordId scanRid;
+			index.scanNext(scanRid);
 		}
 		catch(IndexScanCompletedException e)
 		{
-			break;
+			thrown = 1;
 		}
+		index.endScan();
+		checkPassFail(mismatches, 0)
+		checkPassFail(thrown, 1)
+	}
+	File::remove(intIndexName);
 
-		numResults++;
+	{
+		// leaves split by the inserts of other threads are found moving left as well
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, INSERT_BUILD, 0.8, B_LINK);
+		std::vector<std::thread> threads;
+		for(int t = 0; t < numInsertThreads; t++)
+		{
+			threads.push_back(std::thread(concurrentInsertThread, &index, t));
+		}
+		int badScans = 0;
+		for(int i = 0; i < 5; i++)
+		{
+			if(intDescendingCount(&index, 0, GTE, relationSize, LT, 1000) != relationSize) badScans++;
+			if(intDescendingCount(&index, 0, GTE, relationSize + concurrentInserts, LT, 1000) < relationSize) badScans++;
+		}
+		for(int t = 0; t < numInsertThreads; t++)
+		{
+			threads[t].join();
+		}
+		checkPassFail(badScans, 0)
+		checkPassFail(intDescendingCount(&index, 0, GTE, relationSize + concurrentInserts, LT, 1000), relationSize + concurrentInserts)
+
+		// the rids of a key with a posting list still come in ridLess order
+		int key = 5000;
+		for(int i = 0; i < 2 * POSTINGPAGESIZE; i++)
+		{
+			RecordId keyRid;
+			keyRid.page_number = relationSize + i;
+			keyRid.slot_number = 1;
+			index.insertEntry(&key, keyRid);
+		}
+		checkPassFail(intDescendingCount(&index, 4990, GTE, 5010, LTE, 1), 21 + 2 * POSTINGPAGESIZE)
+		checkPassFail(intDescendingCount(&index, 4990, GTE, 5010, LTE, 100), 21 + 2 * POSTINGPAGESIZE)
+	}
+	File::remove(intIndexName);
+
+	{
+		// and so are the leaves merged by the deletes of other threads
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, BULK_LOAD, 1.0, LATCH_COUPLING, MERGE_ON_UNDERFLOW);
+		for(int key = 1001; key < 300000; key += 2)
+		{
+			index.deleteEntry(&key);
+		}
+		const int oddDeletes = (300000 - 1000) / 2;
+		checkPassFail(intDescendingCount(&index, 0, GTE, relationSize, LT, 1000), relationSize - oddDeletes)
+
+		std::vector<std::thread> threads;
+		for(int t = 0; t < numInsertThreads; t++)
+		{
+			threads.push_back(std::thread(concurrentDeleteThread, &index, t));
+		}
+		int badScans = 0;
+		for(int i = 0; i < 5; i++)
+		{
+			int numResults = intDescendingCount(&index, 0, GTE, relationSize, LT, 1000);
+			if(numResults < relationSize / 1000 || numResults > relationSize - oddDeletes) badScans++;
+		}
+		for(int t = 0; t < numInsertThreads; t++)
+		{
+			threads[t].join();
+		}
+		checkPassFail(badScans, 0)
+		checkPassFail(intDescendingCount(&index, 0, GTE, relationSize, LT, 1), relationSize / 1000)
+	}
+}
+
+int intDescendingCount(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp, size_t batchSize)
+{
+	// the keys come in decreasing order and within the range, the rids of one key in ridLess order
+  std::cout << "Scan for " << (lowOp == GT ? "(" : "[") << lowVal << "," << highVal << (highOp == LT ? ")" : "]")
+		<< " in descending order in batches of " << batchSize << std::endl;
+	std::vector<RecordId> rids(batchSize);
+	std::vector<int> keys(batchSize);
+	int numResults = 0;
+	int badEntries = 0;
+
+	try
+	{
+  	index->startScan(&lowVal, lowOp, &highVal, highOp, DESCENDING);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+		return 0;
+	}
+
+	size_t numEntries;
+	int lastKey = highVal;
+	RecordId lastRid = {0, 0};
+	while((numEntries = index->scanNextEntries(&rids[0], &keys[0], NULL, batchSize)) > 0)
+	{
+		for(size_t i = 0; i < numEntries; i++)
+		{
+			if(keys[i] > lastKey || (lowOp == GT ? keys[i] <= lowVal : keys[i] < lowVal)) badEntries++;
+			if(highOp == LT && keys[i] == highVal) badEntries++;
+			if(numResults > 0 && keys[i] == lastKey && !ridLess(lastRid, rids[i])) badEntries++;
+			lastKey = keys[i];
+			lastRid = rids[i];
+			numResults++;
+		}
 	}
 
-  if( numResults >= 5 )
-  {
-    std::cout << "Number of results: " << numResults << std::endl;
-  }
   index->endScan();
-  std::cout << std::endl;
+  std::cout << "Number of results: " << numResults << std::endl << std::endl;
+	return badEntries == 0 ? numResults : -1;
+}
 
-	return numResults;
+int intLookupMismatches(BTreeIndex * index)
+{
+	// every key of the relation, in batches of 100 and on its own, finds the record it came from
+	const int batchSize = 100;
+	int keys[batchSize];
+	const void* keyPtrs[batchSize];
+	RecordId rids[batchSize];
+	bool found[batchSize];
+	int mismatches = 0;
+	for(int first = 0; first < relationSize; first += batchSize)
+	{
+		for(int i = 0; i < batchSize; i++)
+		{
+			keys[i] = first + i;
+			keyPtrs[i] = &keys[i];
+		}
+		index->lookupBatch(keyPtrs, batchSize, rids, found);
+		for(int i = 0; i < batchSize; i++)
+		{
+			RecordId lookupRid;
+			if(!found[i] || !index->lookup(&keys[i], lookupRid) || !(lookupRid == rids[i]))
+			{
+				mismatches++;
+				continue;
+			}
+			if(keys[i] % 97 != 0) continue;
+
+			Page *curPage;
+			std::lock_guard<std::mutex> guard(bufMgrLatch);
+			bufMgr->readPage(file1, rids[i].page_number, curPage);
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(rids[i]).data()));
+			bufMgr->unPinPage(file1, rids[i].page_number, false);
+			if(myRec.i != keys[i]) mismatches++;
+		}
+	}
+
+	// one batch of every key twice in random order, and keys past both ends, finds what the lookups on their own do
+	std::vector<int> shuffledKeys;
+	for(int key = -10; key < relationSize + 10; key++)
+	{
+		shuffledKeys.push_back(key);
+		shuffledKeys.push_back(key);
+	}
+	std::mt19937 generator(relationSize);
+	std::shuffle(shuffledKeys.begin(), shuffledKeys.end(), generator);
+	std::vector<const void*> shuffledPtrs;
+	for(size_t i = 0; i < shuffledKeys.size(); i++)
+	{
+		shuffledPtrs.push_back(&shuffledKeys[i]);
+	}
+	std::vector<RecordId> shuffledRids(shuffledKeys.size());
+	bool* shuffledFound = new bool[shuffledKeys.size()];
+	index->lookupBatch(shuffledPtrs.data(), shuffledKeys.size(), shuffledRids.data(), shuffledFound);
+	for(size_t i = 0; i < shuffledKeys.size(); i++)
+	{
+		RecordId lookupRid;
+		bool lookupFound = index->lookup(&shuffledKeys[i], lookupRid);
+		if(shuffledFound[i] != lookupFound || (lookupFound && !(lookupRid == shuffledRids[i]))) mismatches++;
+	}
+	delete[] shuffledFound;
+	return mismatches;
 }
 
 // -----------------------------------------------------------------------------
 // doubleTests
 // -----------------------------------------------------------------------------
 
-void doubleTests()
+void doubleTests(BuildMethod buildMethod)
 {
-  std::cout << "Create a B+ Tree index on the double field" << std::endl;
-  BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE);
+  std::cout << "Create a B+ Tree index on the double field";
+  if( buildMethod == BULK_LOAD ) { std::cout << " by bulk loading it"; }
+  std::cout << std::endl;
+  BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE, buildMethod, 0.8);
 
 	// run some tests
 	checkPassFail(doubleScan(&index,25,GT,40,LT), 14)
@@ -503,6 +2324,10 @@ void doubleTests()
 	checkPassFail(doubleScan(&index,0,GT,1,LT), 0)
 	checkPassFail(doubleScan(&index,300,GT,400,LT), 99)
 	checkPassFail(doubleScan(&index,3000,GTE,4000,LT), 1000)
+
+	double lowVal = 3000;
+	double highVal = 4000;
+	checkPassFail((fabs(index.estimateRange(&lowVal, GTE, &highVal, LT) - 1000) < 200), true)
 }
 
 int doubleScan(BTreeIndex * index, double lowVal, Operator lowOp, double highVal, Operator highOp)
@@ -533,9 +2358,13 @@ int doubleScan(BTreeIndex * index, double lowVal, Operator lowOp, double highVal
 		try
 		{
 			index->scanNext(scanRid);
-			bufMgr->readPage(file1, scanRid.page_number, curPage);
-			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
-			bufMgr->unPinPage(file1, scanRid.page_number, false);
+			RECORD myRec;
+			{
+				std::lock_guard<std::mutex> guard(bufMgrLatch);
+				bufMgr->readPage(file1, scanRid.page_number, curPage);
+				myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+				bufMgr->unPinPage(file1, scanRid.page_number, false);
+			}
 
 			if( numResults < 5 )
 			{
@@ -569,10 +2398,13 @@ int doubleScan(BTreeIndex * index, double lowVal, Operator lowOp, double highVal
 // stringTests
 // -----------------------------------------------------------------------------
 
-void stringTests()
+void stringTests(BuildMethod buildMethod)
 {
-  std::cout << "Create a B+ Tree index on the string field" << std::endl;
-  BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+  std::cout << "Create a B+ Tree index on the string field";
+  if( buildMethod == BULK_LOAD ) { std::cout << " by bulk loading it"; }
+  std::cout << std::endl;
+  BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING, buildMethod, 0.8, LATCH_COUPLING,
+		MERGE_ON_UNDERFLOW, 1, READ_WRITE, UNCOUNTED, 1, offsetof(tuple,i), sizeof(int));
 
 	// run some tests
 	checkPassFail(stringScan(&index,25,GT,28,LT), 2)
@@ -582,6 +2414,177 @@ void stringTests()
 	checkPassFail(stringScan(&index,0,GT,1,LT), 0)
 	checkPassFail(stringScan(&index,300,GT,400,LT), 99)
 	checkPassFail(stringScan(&index,3000,GTE,4000,LT), 1000)
+	checkPassFail(stringEntryCount(&index,3000,GTE,4000,LT), 1000)
+
+	// the buckets of the histogram are only a few for long keys, but a range over many of them is estimated
+	// closely. There are 110000 keys from "1" on, 10000 of 5 digits and 100000 of 6
+	const char* lowVal = "1";
+	const char* highVal = "2";
+	double estimate = index.estimateRange(lowVal, GTE, highVal, LT);
+	checkPassFail((fabs(estimate - 110000) < 10000), true)
+}
+
+int stringEntryCount(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+	// every key comes as the string of its record, with the integer field included
+  std::cout << "Scan for the keys and included columns of " << (lowOp == GT ? "(" : "[") << lowVal << "," << highVal
+		<< (highOp == LT ? ")" : "]") << std::endl;
+  char lowValStr[100];
+  sprintf(lowValStr,"%05d string record",lowVal);
+  char highValStr[100];
+  sprintf(highValStr,"%05d string record",highVal);
+	const size_t batchSize = 64;
+	RecordId rids[batchSize];
+	StringKey keys[batchSize];
+	int values[batchSize];
+	int numResults = 0;
+	int badEntries = 0;
+
+	try
+	{
+  	index->startScan(lowValStr, lowOp, highValStr, highOp);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+		return 0;
+	}
+
+	size_t numEntries;
+	while((numEntries = index->scanNextEntries(rids, keys, values, batchSize)) > 0)
+	{
+		for(size_t i = 0; i < numEntries; i++)
+		{
+			char expected[100];
+			int length = sprintf(expected, "%05d string record", values[i]);
+			if(keys[i].length != length || memcmp(keys[i].key, expected, length) != 0) badEntries++;
+			if(values[i] != (lowOp == GT ? lowVal + 1 : lowVal) + numResults) badEntries++;
+			numResults++;
+		}
+	}
+
+  index->endScan();
+  std::cout << "Number of results: " << numResults << std::endl << std::endl;
+	return badEntries == 0 ? numResults : -1;
+}
+
+// -----------------------------------------------------------------------------
+// longStringTests
+// -----------------------------------------------------------------------------
+
+void longStringTests(BuildMethod buildMethod)
+{
+  std::cout << "Create a B+ Tree index on long string keys of varying length";
+  if( buildMethod == BULK_LOAD ) { std::cout << " by bulk loading it"; }
+  std::cout << std::endl;
+	// keys share a long prefix and are up to 60 characters, so the nodes hold far more of them than fixed width slots would
+	const int numKeys = 20000;
+	std::string longRelationName = "relLong";
+	std::string longIndexName;
+	try
+	{
+		File::remove(longRelationName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	{
+		PageFile longFile(longRelationName, true);
+		PageId pageNo;
+		Page page = longFile.allocatePage(pageNo);
+		for(int i = 0; i < numKeys; i++)
+		{
+			longStringKey(record1.s, i);
+			record1.i = i;
+			std::string data(reinterpret_cast<char*>(&record1), sizeof(record1));
+			while(1)
+			{
+				try
+				{
+					page.insertRecord(data);
+					break;
+				}
+				catch(InsufficientSpaceException e)
+				{
+					longFile.writePage(pageNo, page);
+					page = longFile.allocatePage(pageNo);
+				}
+			}
+		}
+		longFile.writePage(pageNo, page);
+	}
+	{
+		BTreeIndex index(longRelationName, longIndexName, bufMgr, offsetof(tuple,s), STRING, buildMethod);
+		checkPassFail(longStringCount(&index, 0, GTE, numKeys - 1, LTE), numKeys)
+		checkPassFail(longStringCount(&index, 100, GTE, 200, LT), 100)
+		checkPassFail(longStringCount(&index, 777, GTE, 777, LTE), 1)
+
+		// deleting most keys merges and redistributes nodes of keys of different lengths
+		char key[64];
+		RecordId keyRid;
+		keyRid.page_number = 0;
+		keyRid.slot_number = 1;
+		for(int i = 0; i < numKeys; i++)
+		{
+			longStringKey(key, i);
+			if(i % 4 != 0) index.deleteEntry(key);
+		}
+		checkPassFail(longStringCount(&index, 0, GTE, numKeys - 1, LTE), numKeys / 4)
+		checkPassFail(longStringCount(&index, 100, GTE, 200, LT), 25)
+
+		for(int i = 0; i < numKeys; i++)
+		{
+			longStringKey(key, i);
+			if(i % 4 != 0) index.insertEntry(key, keyRid);
+		}
+		checkPassFail(longStringCount(&index, 0, GTE, numKeys - 1, LTE), numKeys)
+	}
+	File::remove(longIndexName);
+	File::remove(longRelationName);
+}
+
+void longStringKey(char *key, int i)
+{
+	// the tail makes the length of the keys vary without changing their order
+	sprintf(key, "customer/account/identifier/%05d/", i);
+	int length = strlen(key);
+	int tail = (i * 7) % 27;
+	memset(key + length, 'x', tail);
+	key[length + tail] = '\0';
+}
+
+int longStringCount(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+	char lowKey[64];
+	char highKey[64];
+	longStringKey(lowKey, lowVal);
+	longStringKey(highKey, highVal);
+
+	RecordId scanRid;
+	int numResults = 0;
+	try
+	{
+		index->startScan(lowKey, lowOp, highKey, highOp);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+		return 0;
+	}
+
+	while(1)
+	{
+		try
+		{
+			index->scanNext(scanRid);
+		}
+		catch(IndexScanCompletedException e)
+		{
+			break;
+		}
+		numResults++;
+	}
+
+	index->endScan();
+	return numResults;
 }
 
 int stringScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
@@ -617,9 +2620,13 @@ int stringScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Oper
 		try
 		{
 			index->scanNext(scanRid);
-			bufMgr->readPage(file1, scanRid.page_number, curPage);
-			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
-			bufMgr->unPinPage(file1, scanRid.page_number, false);
+			RECORD myRec;
+			{
+				std::lock_guard<std::mutex> guard(bufMgrLatch);
+				bufMgr->readPage(file1, scanRid.page_number, curPage);
+				myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+				bufMgr->unPinPage(file1, scanRid.page_number, false);
+			}
 
 			if( numResults < 5 )
 			{
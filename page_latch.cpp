@@ -0,0 +1,70 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <thread>
+#include "page_latch.h"
+
+namespace badgerdb
+{
+
+// -----------------------------------------------------------------------------
+// PageLatch::lockShared
+// -----------------------------------------------------------------------------
+void PageLatch::lockShared()
+{
+	while(true) {
+		int s = state.load(std::memory_order_relaxed);
+
+		//readers stay out while a writer holds or waits for the latch
+		if((s & (WRITER | WRITERWAITING)) == 0 &&
+			state.compare_exchange_weak(s, s + READER, std::memory_order_acquire, std::memory_order_relaxed)) {
+			return;
+		}
+		std::this_thread::yield();
+	}
+}
+
+// -----------------------------------------------------------------------------
+// PageLatch::unlockShared
+// -----------------------------------------------------------------------------
+void PageLatch::unlockShared()
+{
+	state.fetch_sub(READER, std::memory_order_release);
+}
+
+// -----------------------------------------------------------------------------
+// PageLatch::lockExclusive
+// -----------------------------------------------------------------------------
+void PageLatch::lockExclusive()
+{
+	while(true) {
+		int s = state.load(std::memory_order_relaxed);
+
+		//no readers and no writer, only possibly other waiting writers
+		if((s & ~WRITERWAITING) == 0) {
+			if(state.compare_exchange_weak(s, WRITER, std::memory_order_acquire, std::memory_order_relaxed)) return;
+			continue;
+		}
+
+		//let the readers drain and keep new ones from coming in
+		if((s & WRITERWAITING) == 0) state.fetch_or(WRITERWAITING, std::memory_order_relaxed);
+		std::this_thread::yield();
+	}
+}
+
+// -----------------------------------------------------------------------------
+// PageLatch::unlockExclusive
+// -----------------------------------------------------------------------------
+void PageLatch::unlockExclusive()
+{
+	version.fetch_add(1, std::memory_order_relaxed);
+
+	//other writers may have set the waiting bit while we held the latch, leave it for them
+	state.fetch_and(~WRITER, std::memory_order_release);
+}
+
+}
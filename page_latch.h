@@ -0,0 +1,158 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+
+#include "types.h"
+
+namespace badgerdb
+{
+
+/**
+ * @brief Number of entries allocated together by a PageTable.
+ */
+const  int LATCHCHUNKSIZE = 1024;
+
+/**
+ * @brief Maximum number of chunks of a PageTable, which bounds the page numbers it can hold.
+ */
+const  int LATCHMAXCHUNKS = 1 << 14;
+
+/**
+ * @brief Reader/writer latch protecting the contents of one B+ tree page.
+ * Latches are held for short critical sections only, so waiting threads spin and yield instead of sleeping.
+ * A waiting writer keeps new readers out so that writers are not starved.
+ */
+class PageLatch {
+
+ private:
+
+  /**
+   * Set while a writer holds the latch.
+   */
+	static const int WRITER = 1;
+
+  /**
+   * Set while a writer is waiting for the latch.
+   */
+	static const int WRITERWAITING = 2;
+
+  /**
+   * Added to state for every reader holding the latch.
+   */
+	static const int READER = 4;
+
+  /**
+   * Reader count and writer bits.
+   */
+	std::atomic<int> state;
+
+  /**
+   * Bumped every time a writer releases the latch.
+   */
+	std::atomic<unsigned int> version;
+
+ public:
+
+	PageLatch() : state(0), version(0) {}
+
+  /**
+   * Acquire the latch in shared mode.
+   */
+	void lockShared();
+
+  /**
+   * Release the latch held in shared mode.
+   */
+	void unlockShared();
+
+  /**
+   * Acquire the latch in exclusive mode.
+   */
+	void lockExclusive();
+
+  /**
+   * Release the latch held in exclusive mode. The page is assumed to have changed, so its version moves on.
+   */
+	void unlockExclusive();
+
+  /**
+   * Number of times the page was released by a writer. Lets a reader that let go of the latch tell whether
+   * the page may have changed since, without keeping other threads out in between.
+   */
+	unsigned int getVersion() const { return version.load(std::memory_order_acquire); }
+};
+
+/**
+ * @brief One T for every page of an index file, looked up by page number without taking a lock.
+ * Entries are allocated, value-initialized, in chunks of LATCHCHUNKSIZE the first time a page of the chunk is
+ * looked up and live as long as the table, so a pointer returned by get stays valid.
+ */
+template <class T>
+class PageTable {
+
+ private:
+
+  /**
+   * Chunks of entries, chunk i holds the entries of pages [i * LATCHCHUNKSIZE, (i + 1) * LATCHCHUNKSIZE).
+   */
+	std::atomic<T*> chunks[ LATCHMAXCHUNKS ];
+
+  /**
+   * Serializes the allocation of new chunks.
+   */
+	std::mutex allocLatch;
+
+ public:
+
+	PageTable()
+	{
+		for(int i = 0; i < LATCHMAXCHUNKS; i++) chunks[i].store(NULL, std::memory_order_relaxed);
+	}
+
+	~PageTable()
+	{
+		for(int i = 0; i < LATCHMAXCHUNKS; i++) delete [] chunks[i].load(std::memory_order_relaxed);
+	}
+
+  /**
+   * Entry of page pageNo.
+   */
+	T* get(PageId pageNo)
+	{
+		T* chunk = chunks[pageNo / LATCHCHUNKSIZE].load(std::memory_order_acquire);
+		if(chunk == NULL) chunk = allocChunk(pageNo / LATCHCHUNKSIZE);
+		return &chunk[pageNo % LATCHCHUNKSIZE];
+	}
+
+ private:
+
+  /**
+   * Allocate chunk i unless another thread got to it first.
+   */
+	T* allocChunk(int i)
+	{
+		std::lock_guard<std::mutex> guard(allocLatch);
+
+		T* chunk = chunks[i].load(std::memory_order_acquire);
+		if(chunk == NULL) {
+			chunk = new T[LATCHCHUNKSIZE]();
+			chunks[i].store(chunk, std::memory_order_release);
+		}
+		return chunk;
+	}
+};
+
+/**
+ * @brief One PageLatch for every page of an index file.
+ */
+typedef PageTable<PageLatch> PageLatchTable;
+
+}
@@ -0,0 +1,21 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "read_only_index_exception.h"
+
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+ReadOnlyIndexException::ReadOnlyIndexException() : BadgerDbException(""){
+  std::stringstream ss;
+  ss << "Attempting to change an index opened read-only";
+  message_.assign(ss.str());
+}
+
+}
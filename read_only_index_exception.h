@@ -0,0 +1,32 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when an index opened read-only is asked to change.
+ */
+class ReadOnlyIndexException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a read only index exception for an insert or delete on a mapped index
+   */
+  ReadOnlyIndexException();
+
+
+ protected:
+
+};
+
+}
@@ -0,0 +1,394 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "btree.h"
+
+namespace badgerdb
+{
+
+/**
+ * Number of keys a binary search over count keys compares, at most
+ */
+static inline int searchComparisons(int count)
+{
+	int comparisons = 0;
+	while(count > 0) {
+		count /= 2;
+		comparisons++;
+	}
+	return comparisons;
+}
+
+// -----------------------------------------------------------------------------
+// StringNode::bytesNeeded
+// -----------------------------------------------------------------------------
+template <class Payload>
+int StringNode<Payload>::bytesNeeded(const StringKey* lowKey, const StringKey* highKey, int count, int keyBytes)
+{
+	int bytes = count * (int) sizeof(Slot) + keyBytes;
+	if(lowKey != NULL) bytes += lowKey->length;
+	if(highKey != NULL) bytes += highKey->length;
+
+	//every key leaves the common prefix of the fences out
+	if(lowKey != NULL && highKey != NULL) {
+		bytes -= count * commonPrefixLength(lowKey->key, lowKey->length, highKey->key, highKey->length);
+	}
+	return bytes;
+}
+
+// -----------------------------------------------------------------------------
+// StringNode::clear
+// -----------------------------------------------------------------------------
+template <class Payload>
+void StringNode<Payload>::clear(const StringKey* lowKey, const StringKey* highKey)
+{
+	numKeys = 0;
+	heapStart = STRINGNODEDATASIZE;
+	garbage = 0;
+	hasLowKey = (lowKey != NULL);
+	hasHighKey = (highKey != NULL);
+	lowOffset = lowLength = highOffset = highLength = 0;
+	prefixLength = 0;
+
+	if(hasLowKey) {
+		lowLength = lowKey->length;
+		lowOffset = addToHeap(lowKey->key, lowKey->length);
+	}
+	if(hasHighKey) {
+		highLength = highKey->length;
+		highOffset = addToHeap(highKey->key, highKey->length);
+	}
+
+	//every key in [lowKey, highKey) starts with the bytes the two have in common
+	if(hasLowKey && hasHighKey) prefixLength = commonPrefixLength(lowKey->key, lowKey->length, highKey->key, highKey->length);
+}
+
+// -----------------------------------------------------------------------------
+// StringNode::keyAt
+// -----------------------------------------------------------------------------
+template <class Payload>
+StringKey StringNode<Payload>::keyAt(int i) const
+{
+	const Slot &slot = slots()[i];
+	StringKey key;
+	key.length = prefixLength + slot.length;
+	memcpy(key.key, data + lowOffset, prefixLength);
+	memcpy(key.key + prefixLength, data + slot.offset, slot.length);
+	return key;
+}
+
+// -----------------------------------------------------------------------------
+// StringNode::isKeyAt
+// -----------------------------------------------------------------------------
+template <class Payload>
+bool StringNode<Payload>::isKeyAt(int i, const StringKey& key) const
+{
+	return comparePrefix(key) == 0 && compareSuffix(i, key) == 0;
+}
+
+// -----------------------------------------------------------------------------
+// StringNode::lowerBound
+// -----------------------------------------------------------------------------
+template <class Payload>
+int StringNode<Payload>::lowerBound(const StringKey& key) const
+{
+	//the prefix is compared once, the binary search only looks at the rest of the keys
+	int result = comparePrefix(key);
+	INDEX_STAT(nodeSearches, 1);
+	INDEX_STAT(keyComparisons, 1);
+	if(result != 0) return result < 0 ? 0 : numKeys;
+
+	int low = 0;
+	int high = numKeys;
+	while(low < high) {
+		int middle = (low + high) / 2;
+		if(compareSuffix(middle, key) < 0) low = middle + 1;
+		else high = middle;
+	}
+	INDEX_STAT(keyComparisons, searchComparisons(numKeys));
+	return low;
+}
+
+// -----------------------------------------------------------------------------
+// StringNode::upperBound
+// -----------------------------------------------------------------------------
+template <class Payload>
+int StringNode<Payload>::upperBound(const StringKey& key) const
+{
+	int result = comparePrefix(key);
+	INDEX_STAT(nodeSearches, 1);
+	INDEX_STAT(keyComparisons, 1);
+	if(result != 0) return result < 0 ? 0 : numKeys;
+
+	int low = 0;
+	int high = numKeys;
+	while(low < high) {
+		int middle = (low + high) / 2;
+		if(compareSuffix(middle, key) <= 0) low = middle + 1;
+		else high = middle;
+	}
+	INDEX_STAT(keyComparisons, searchComparisons(numKeys));
+	return low;
+}
+
+// -----------------------------------------------------------------------------
+// StringNode::getLowKey
+// -----------------------------------------------------------------------------
+template <class Payload>
+bool StringNode<Payload>::getLowKey(StringKey& key) const
+{
+	if(!hasLowKey) return false;
+	key.length = lowLength;
+	memcpy(key.key, data + lowOffset, lowLength);
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// StringNode::getHighKey
+// -----------------------------------------------------------------------------
+template <class Payload>
+bool StringNode<Payload>::getHighKey(StringKey& key) const
+{
+	if(!hasHighKey) return false;
+	key.length = highLength;
+	memcpy(key.key, data + highOffset, highLength);
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// StringNode::pastHighKey
+// -----------------------------------------------------------------------------
+template <class Payload>
+bool StringNode<Payload>::pastHighKey(const StringKey& key) const
+{
+	return hasHighKey && compareStrings(key.key, key.length, data + highOffset, highLength) >= 0;
+}
+
+// -----------------------------------------------------------------------------
+// StringNode::insertAt
+// -----------------------------------------------------------------------------
+template <class Payload>
+void StringNode<Payload>::insertAt(int i, const StringKey& key, const Payload& payload)
+{
+	int length = key.length - prefixLength;
+	if(heapStart - (numKeys + 1) * (int) sizeof(Slot) < length) compact();
+
+	Slot* slot = slots() + i;
+	memmove(slot + 1, slot, (numKeys - i) * sizeof(Slot));
+	slot->offset = addToHeap(key.key + prefixLength, length);
+	slot->length = length;
+	slot->payload = payload;
+	numKeys++;
+}
+
+// -----------------------------------------------------------------------------
+// StringNode::removeAt
+// -----------------------------------------------------------------------------
+template <class Payload>
+void StringNode<Payload>::removeAt(int i)
+{
+	Slot* slot = slots() + i;
+	garbage += slot->length;
+	memmove(slot, slot + 1, (numKeys - i - 1) * sizeof(Slot));
+	numKeys--;
+}
+
+// -----------------------------------------------------------------------------
+// StringNode::replaceKey
+// -----------------------------------------------------------------------------
+template <class Payload>
+void StringNode<Payload>::replaceKey(int i, const StringKey& key)
+{
+	//the old bytes go first, so compact can reclaim them
+	Slot &slot = slots()[i];
+	garbage += slot.length;
+	slot.length = 0;
+
+	int length = key.length - prefixLength;
+	if(heapStart - numKeys * (int) sizeof(Slot) < length) compact();
+	slot.offset = addToHeap(key.key + prefixLength, length);
+	slot.length = length;
+}
+
+// -----------------------------------------------------------------------------
+// StringNode::comparePrefix
+// -----------------------------------------------------------------------------
+template <class Payload>
+int StringNode<Payload>::comparePrefix(const StringKey& key) const
+{
+	if(prefixLength == 0) return 0;
+	int length = key.length < prefixLength ? key.length : prefixLength;
+	int result = memcmp(key.key, data + lowOffset, length);
+	if(result != 0) return result;
+
+	//a key the prefix starts with sorts before it
+	return key.length < prefixLength ? -1 : 0;
+}
+
+// -----------------------------------------------------------------------------
+// StringNode::compareSuffix
+// -----------------------------------------------------------------------------
+template <class Payload>
+int StringNode<Payload>::compareSuffix(int i, const StringKey& key) const
+{
+	const Slot &slot = slots()[i];
+	return compareStrings(data + slot.offset, slot.length, key.key + prefixLength, key.length - prefixLength);
+}
+
+// -----------------------------------------------------------------------------
+// StringNode::addToHeap
+// -----------------------------------------------------------------------------
+template <class Payload>
+unsigned short StringNode<Payload>::addToHeap(const char* bytes, int length)
+{
+	heapStart -= length;
+	memcpy(data + heapStart, bytes, length);
+	return heapStart;
+}
+
+// -----------------------------------------------------------------------------
+// StringNode::compact
+// -----------------------------------------------------------------------------
+template <class Payload>
+void StringNode<Payload>::compact()
+{
+	//copy whatever is still in use to the end of a scratch page, then back in one go
+	char heap[STRINGNODEDATASIZE];
+	int top = STRINGNODEDATASIZE;
+	if(hasLowKey) {
+		top -= lowLength;
+		memcpy(heap + top, data + lowOffset, lowLength);
+		lowOffset = top;
+	}
+	if(hasHighKey) {
+		top -= highLength;
+		memcpy(heap + top, data + highOffset, highLength);
+		highOffset = top;
+	}
+	Slot* slot = slots();
+	for(int i = 0; i < numKeys; i++) {
+		top -= slot[i].length;
+		memcpy(heap + top, data + slot[i].offset, slot[i].length);
+		slot[i].offset = top;
+	}
+	memcpy(data + top, heap + top, STRINGNODEDATASIZE - top);
+	heapStart = top;
+	garbage = 0;
+}
+
+// -----------------------------------------------------------------------------
+// NonLeafNode<StringKey>::fits
+// -----------------------------------------------------------------------------
+bool NonLeafNode<StringKey>::fits(const StringKey* lowKey, const StringKey* highKey, const PageKeyPair<StringKey>* entries, int count)
+{
+	//the first child brings no key
+	int keyBytes = 0;
+	for(int i = 1; i < count; i++) keyBytes += entries[i].key.length;
+	return bytesNeeded(lowKey, highKey, count - 1, keyBytes) <= STRINGNODEDATASIZE;
+}
+
+// -----------------------------------------------------------------------------
+// NonLeafNode<StringKey>::init
+// -----------------------------------------------------------------------------
+void NonLeafNode<StringKey>::init(int level)
+{
+	this->level = level;
+	rightSibPageNo = NULL;
+	leftSibPageNo = NULL;
+	includedPageNo = NULL;
+	firstPageNo = NULL;
+	firstCount = 0;
+	clear(NULL, NULL);
+}
+
+// -----------------------------------------------------------------------------
+// NonLeafNode<StringKey>::build
+// -----------------------------------------------------------------------------
+void NonLeafNode<StringKey>::build(const StringKey* lowKey, const StringKey* highKey, const PageKeyPair<StringKey>* entries, int count)
+{
+	clear(lowKey, highKey);
+	firstPageNo = entries[0].pageNo;
+	firstCount = entries[0].count;
+	for(int i = 1; i < count; i++) insertAt(i - 1, entries[i].key, entries[i].pageNo, entries[i].count);
+}
+
+// -----------------------------------------------------------------------------
+// NonLeafNode<StringKey>::getEntries
+// -----------------------------------------------------------------------------
+void NonLeafNode<StringKey>::getEntries(std::vector<PageKeyPair<StringKey> > &entries) const
+{
+	PageKeyPair<StringKey> entry;
+	entry.pageNo = firstPageNo;
+	entry.count = firstCount;
+	if(!getLowKey(entry.key)) entry.key = KeyTraits<StringKey>::nullKey();
+	entries.push_back(entry);
+	for(int i = 0; i < numKeys; i++) {
+		entry.set(slots()[i].payload.pageNo, keyAt(i), slots()[i].payload.count);
+		entries.push_back(entry);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// NonLeafNode<StringKey>::insertAt
+// -----------------------------------------------------------------------------
+void NonLeafNode<StringKey>::insertAt(int i, const StringKey& key, PageId rightChild, unsigned int rightCount)
+{
+	StringChild child;
+	child.pageNo = rightChild;
+	child.count = rightCount;
+	StringNode<StringChild>::insertAt(i, key, child);
+}
+
+// -----------------------------------------------------------------------------
+// LeafNode<StringKey>::fits
+// -----------------------------------------------------------------------------
+bool LeafNode<StringKey>::fits(const StringKey* lowKey, const StringKey* highKey, const RIDKeyPair<StringKey>* entries, int count)
+{
+	int keyBytes = 0;
+	for(int i = 0; i < count; i++) keyBytes += entries[i].key.length;
+	return bytesNeeded(lowKey, highKey, count, keyBytes) <= STRINGNODEDATASIZE;
+}
+
+// -----------------------------------------------------------------------------
+// LeafNode<StringKey>::init
+// -----------------------------------------------------------------------------
+void LeafNode<StringKey>::init()
+{
+	level = 0;
+	rightSibPageNo = NULL;
+	leftSibPageNo = NULL;
+	includedPageNo = NULL;
+	firstPageNo = NULL;
+	firstCount = 0;
+	clear(NULL, NULL);
+}
+
+// -----------------------------------------------------------------------------
+// LeafNode<StringKey>::build
+// -----------------------------------------------------------------------------
+void LeafNode<StringKey>::build(const StringKey* lowKey, const StringKey* highKey, const RIDKeyPair<StringKey>* entries, int count)
+{
+	clear(lowKey, highKey);
+	for(int i = 0; i < count; i++) insertAt(i, entries[i].key, entries[i].rid);
+}
+
+// -----------------------------------------------------------------------------
+// LeafNode<StringKey>::getEntries
+// -----------------------------------------------------------------------------
+void LeafNode<StringKey>::getEntries(std::vector<RIDKeyPair<StringKey> > &entries) const
+{
+	RIDKeyPair<StringKey> entry;
+	for(int i = 0; i < numKeys; i++) {
+		entry.set(slots()[i].payload, keyAt(i));
+		entries.push_back(entry);
+	}
+}
+
+template struct StringNode<RecordId>;
+template struct StringNode<StringChild>;
+
+}
@@ -0,0 +1,216 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <iostream>
+#include "write_ahead_log.h"
+#include "exceptions/file_not_found_exception.h"
+
+namespace badgerdb
+{
+
+//bytes in front of every group: its length and its checksum
+static const size_t GROUPHEADERSIZE = 2 * sizeof(unsigned int);
+
+//bytes in front of every record: its type, page number and payload length
+static const size_t RECORDHEADERSIZE = sizeof(char) + sizeof(PageId) + sizeof(int);
+
+// -----------------------------------------------------------------------------
+// checksum (FNV-1a)
+// -----------------------------------------------------------------------------
+static unsigned int checksum(const char* bytes, size_t length)
+{
+	unsigned int hash = 2166136261u;
+	for(size_t i = 0; i < length; i++) {
+		hash ^= (unsigned char) bytes[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+// -----------------------------------------------------------------------------
+// WriteAheadLog::WriteAheadLog -- Constructor
+// -----------------------------------------------------------------------------
+WriteAheadLog::WriteAheadLog(const std::string & fileName)
+	: appendedLsn(0), durableLsn(0), writing(false), readOffset(0)
+{
+	fd = open(fileName.c_str(), O_RDWR | O_CREAT, 0644);
+	if(fd < 0) throw FileNotFoundException(fileName);
+
+	struct stat fileStat;
+	if(fstat(fd, &fileStat) == 0) appendedLsn = durableLsn = fileStat.st_size;
+}
+
+// -----------------------------------------------------------------------------
+// WriteAheadLog::~WriteAheadLog -- destructor
+// -----------------------------------------------------------------------------
+WriteAheadLog::~WriteAheadLog()
+{
+	close(fd);
+}
+
+// -----------------------------------------------------------------------------
+// WriteAheadLog::addRecord
+// -----------------------------------------------------------------------------
+void WriteAheadLog::addRecord(std::vector<char> &group, LogRecordType type, PageId pageNo, const void* payload, int length)
+{
+	size_t offset = group.size();
+	group.resize(offset + RECORDHEADERSIZE + length);
+	char* record = &group[offset];
+	record[0] = (char) type;
+	memcpy(record + sizeof(char), &pageNo, sizeof(PageId));
+	memcpy(record + sizeof(char) + sizeof(PageId), &length, sizeof(int));
+	if(length > 0) memcpy(record + RECORDHEADERSIZE, payload, length);
+}
+
+// -----------------------------------------------------------------------------
+// WriteAheadLog::nextRecord
+// -----------------------------------------------------------------------------
+bool WriteAheadLog::nextRecord(const std::vector<char> &group, size_t &offset, LogRecord &record)
+{
+	if(offset + RECORDHEADERSIZE > group.size()) return false;
+	const char* bytes = &group[offset];
+	record.type = (LogRecordType) bytes[0];
+	memcpy(&record.pageNo, bytes + sizeof(char), sizeof(PageId));
+	memcpy(&record.length, bytes + sizeof(char) + sizeof(PageId), sizeof(int));
+	if(record.length < 0 || offset + RECORDHEADERSIZE + record.length > group.size()) return false;
+	record.payload = bytes + RECORDHEADERSIZE;
+	offset += RECORDHEADERSIZE + record.length;
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// WriteAheadLog::append
+// -----------------------------------------------------------------------------
+unsigned long long WriteAheadLog::append(const std::vector<char> &group)
+{
+	unsigned int header[2];
+	header[0] = (unsigned int) group.size();
+	header[1] = checksum(group.data(), group.size());
+
+	std::lock_guard<std::mutex> guard(latch);
+	buffer.insert(buffer.end(), (const char*) header, (const char*) header + GROUPHEADERSIZE);
+	buffer.insert(buffer.end(), group.begin(), group.end());
+	appendedLsn += GROUPHEADERSIZE + group.size();
+	return appendedLsn;
+}
+
+// -----------------------------------------------------------------------------
+// WriteAheadLog::commit
+// -----------------------------------------------------------------------------
+void WriteAheadLog::commit(unsigned long long lsn)
+{
+	std::unique_lock<std::mutex> lock(latch);
+	while(durableLsn < lsn) {
+		//somebody else is writing, what they do not cover goes out with the next write
+		if(writing) {
+			logWritten.wait(lock);
+			continue;
+		}
+
+		//take everything appended so far, other threads keep appending to an empty buffer meanwhile
+		std::vector<char> bytes;
+		bytes.swap(buffer);
+		unsigned long long offset = durableLsn;
+		unsigned long long end = appendedLsn;
+		writing = true;
+		lock.unlock();
+		writeAndSync(bytes, offset);
+		lock.lock();
+
+		durableLsn = end;
+		writing = false;
+		logWritten.notify_all();
+	}
+}
+
+// -----------------------------------------------------------------------------
+// WriteAheadLog::writeAndSync
+// -----------------------------------------------------------------------------
+void WriteAheadLog::writeAndSync(const std::vector<char> &bytes, unsigned long long offset)
+{
+	size_t written = 0;
+	while(written < bytes.size()) {
+		ssize_t result = pwrite(fd, bytes.data() + written, bytes.size() - written, (off_t) (offset + written));
+		if(result < 0 && errno == EINTR) continue;
+		if(result <= 0) {
+			std::cerr << "Write-ahead log could not be written: " << strerror(errno) << std::endl;
+			abort();
+		}
+		written += result;
+	}
+	if(fdatasync(fd) != 0) {
+		std::cerr << "Write-ahead log could not be synced: " << strerror(errno) << std::endl;
+		abort();
+	}
+}
+
+// -----------------------------------------------------------------------------
+// WriteAheadLog::readGroup
+// -----------------------------------------------------------------------------
+bool WriteAheadLog::readGroup(std::vector<char> &group)
+{
+	unsigned int header[2];
+	if(pread(fd, header, GROUPHEADERSIZE, (off_t) readOffset) != (ssize_t) GROUPHEADERSIZE) return false;
+
+	//a length past the end of the log is as torn as a short read
+	if(readOffset + GROUPHEADERSIZE + header[0] > appendedLsn) return false;
+	group.resize(header[0]);
+	if(header[0] > 0 && pread(fd, &group[0], header[0], (off_t) (readOffset + GROUPHEADERSIZE)) != (ssize_t) header[0]) return false;
+	if(checksum(group.data(), group.size()) != header[1]) return false;
+
+	readOffset += GROUPHEADERSIZE + header[0];
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// WriteAheadLog::isEmpty
+// -----------------------------------------------------------------------------
+bool WriteAheadLog::isEmpty()
+{
+	std::lock_guard<std::mutex> guard(latch);
+	return appendedLsn == 0;
+}
+
+// -----------------------------------------------------------------------------
+// WriteAheadLog::size
+// -----------------------------------------------------------------------------
+unsigned long long WriteAheadLog::size()
+{
+	std::lock_guard<std::mutex> guard(latch);
+	return appendedLsn;
+}
+
+// -----------------------------------------------------------------------------
+// WriteAheadLog::checkpoint
+// -----------------------------------------------------------------------------
+void WriteAheadLog::checkpoint(const std::string & dataFileName)
+{
+	//the log can only go once what it would redo is on disk
+	int dataFd = open(dataFileName.c_str(), O_RDONLY);
+	if(dataFd < 0 || fsync(dataFd) != 0) {
+		std::cerr << "Index file could not be synced: " << strerror(errno) << std::endl;
+		abort();
+	}
+	close(dataFd);
+
+	std::lock_guard<std::mutex> guard(latch);
+	if(ftruncate(fd, 0) != 0 || fsync(fd) != 0) {
+		std::cerr << "Write-ahead log could not be emptied: " << strerror(errno) << std::endl;
+		abort();
+	}
+	buffer.clear();
+	appendedLsn = durableLsn = 0;
+	readOffset = 0;
+}
+
+}
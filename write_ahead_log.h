@@ -0,0 +1,186 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+#include "types.h"
+
+namespace badgerdb
+{
+
+/**
+ * @brief Appended to the name of an index file for the name of its write-ahead log.
+ */
+const  char LOGFILESUFFIX[] = ".log";
+
+/**
+ * @brief Size in bytes past which an index writes its pages out and empties its write-ahead log.
+ */
+const  unsigned long long CHECKPOINTLOGSIZE = 4 * 1024 * 1024;
+
+/**
+ * @brief Number of writes an index keeps in flight while it writes the pages of its log out for a checkpoint.
+ */
+const  int CHECKPOINTWRITEDEPTH = 16;
+
+/**
+ * @brief Kinds of record in a WriteAheadLog.
+ */
+enum LogRecordType
+{
+	LOGPAGEIMAGE = 1,	/* The payload is the whole page as it is after the change */
+	LOGLEAFINSERT,		/* A key and rid inserted into the leaf pageNo, the payload is the key followed by the rid */
+	LOGLEAFDELETE,		/* The entry of a key removed from the leaf pageNo, the payload is as for LOGLEAFINSERT */
+	LOGROOTPAGE,			/* pageNo is the new root */
+	LOGFREELIST				/* pageNo is the new head of the free list. If it was just freed, the payload is its next page */
+};
+
+/**
+ * @brief A record as nextRecord finds it in a group. The payload points into the group.
+ */
+struct LogRecord{
+	LogRecordType type;
+	PageId pageNo;
+	int length;
+	const char* payload;
+};
+
+/**
+ * @brief Redo log of an index file. Records are appended in groups that recovery replays whole or not at all,
+ * each the change of one thread to pages it holds latched, and become durable through commit. A thread committing
+ * while another one is writing the log waits for it and then writes out everything appended in the meantime with
+ * one fdatasync, for itself and whoever else is waiting.
+ * On disk every group is its length and a checksum followed by its records. Recovery stops at the first group that
+ * is cut short or does not match its checksum, which is where a crash interrupted the log.
+ * Any number of threads may append and commit at once.
+ */
+class WriteAheadLog {
+
+ private:
+
+  /**
+   * File descriptor of the log.
+   */
+	int			fd;
+
+  /**
+   * Guards everything below.
+   */
+	std::mutex	latch;
+
+  /**
+   * Signalled every time a write of the log completes.
+   */
+	std::condition_variable	logWritten;
+
+  /**
+   * Groups appended and not written yet.
+   */
+	std::vector<char>	buffer;
+
+  /**
+   * Log sequence number of the end of the last group appended, which is its byte offset in the log.
+   */
+	unsigned long long	appendedLsn;
+
+  /**
+   * Everything up to here is written and synced.
+   */
+	unsigned long long	durableLsn;
+
+  /**
+   * True while a thread is writing the log.
+   */
+	bool		writing;
+
+  /**
+   * Where readGroup reads the next group from.
+   */
+	unsigned long long	readOffset;
+
+ public:
+
+  /**
+   * Open the log, creating it if it does not exist. Appends go after whatever it holds.
+   *
+   * @param fileName	Name of the log file
+   * @throws  FileNotFoundException If the file cannot be opened
+   */
+	WriteAheadLog(const std::string & fileName);
+
+  /**
+   * Close the log. Groups not committed are lost.
+   */
+	~WriteAheadLog();
+
+  /**
+   * Add a record to the end of a group.
+   *
+   * @param group		The group
+   * @param type		Kind of record
+   * @param pageNo	Page the record is about
+   * @param payload	Bytes that go with it, NULL if length is 0
+   * @param length	Number of bytes of payload
+   */
+	static void addRecord(std::vector<char> &group, LogRecordType type, PageId pageNo, const void* payload, int length);
+
+  /**
+   * Take the record at offset off a group and move offset past it. False at the end of the group.
+   */
+	static bool nextRecord(const std::vector<char> &group, size_t &offset, LogRecord &record);
+
+  /**
+   * Append a group to the log. It is not durable before commit.
+   *
+   * @return The log sequence number to commit the group with
+   */
+	unsigned long long append(const std::vector<char> &group);
+
+  /**
+   * Wait until everything appended up to lsn is durable. A log that cannot be written is fatal, since the
+   * pages changed cannot be written to the index file either.
+   */
+	void commit(unsigned long long lsn);
+
+  /**
+   * Read the next group from the start of the log. False once there are no more complete groups.
+   * Only while nothing is appended.
+   */
+	bool readGroup(std::vector<char> &group);
+
+  /**
+   * True if the log holds nothing.
+   */
+	bool isEmpty();
+
+  /**
+   * Number of bytes appended since the log was last emptied, committed or not.
+   */
+	unsigned long long size();
+
+  /**
+   * Sync the index file, which the caller has just written out completely, and empty the log. Only while nothing
+   * is appended.
+   *
+   * @param dataFileName	Name of the index file
+   */
+	void checkpoint(const std::string & dataFileName);
+
+ private:
+
+  /**
+   * Write bytes to the log at offset, all of them, and sync it.
+   */
+	void writeAndSync(const std::vector<char> &bytes, unsigned long long offset);
+};
+
+}